@@ -7,35 +7,89 @@
 #include "HomeSpan.h"
 #include "services.h"
 
+// Notice: each AC unit needs its own IR LED, and its own journal region \
+//   (the journal partition holds up to 8 of them)
+const unsigned int UNITS_COUNT = 1;
+
+static_assert(UNITS_COUNT * JOURNAL_REGION_SIZE <= JOURNAL_PARTITION_SIZE, "Journal partition cannot hold a region per AC unit");
+
+const int UNITS_IR_PINS[UNITS_COUNT] = {
+  IR_PIN_PWM
+};
+
+const char *const UNITS_NAMES[UNITS_COUNT] = {
+  "Air Conditioner Remote"
+};
+
+// Notice: serial numbers are derived from the unit index (starting at 1)
+const char *const UNITS_SERIAL_NUMBER_FORMAT = "AC-2022-07-%06u";
+const unsigned int UNITS_SERIAL_NUMBER_SIZE = 18;
+
+char unitsSerialNumbers[UNITS_COUNT][UNITS_SERIAL_NUMBER_SIZE];
+
 void setup() {
   // 115,200 bauds (for serial console)
   Serial.begin(115200);
 
-  // Force CPU to a lower power frequency
-  setCpuFrequencyMhz(80);
+  // Notice: the CPU frequency gets scaled by the service (ie. power \
+  //   management), as to only run fast while latency-critical work is done
+
+  // Setup HomeSpan accessory (or bridge, if there are multiple AC units)
+  if (UNITS_COUNT > 1) {
+    homeSpan.begin(Category::Bridges, "Air Conditioner Bridge", "vsa-industries", "VSA-AC");
+  } else {
+    homeSpan.begin(Category::AirConditioners, "Air Conditioner", "vsa-industries", "VSA-AC");
+  }
 
-  // Setup HomeSpan accessory
-  homeSpan.begin(Category::AirConditioners, "Air Conditioner", "vsa-industries", "VSA-AC");
-  
   homeSpan.setLogLevel(1);
 
   // QR Code ID and Pairing codes are used for the HomeKit QR Code
   homeSpan.setQRID("VSAC");
   homeSpan.setPairingCode("89104319");
 
-  new SpanAccessory();
-    new Service::AccessoryInformation();
-      new Characteristic::Identify();
-      new Characteristic::FirmwareRevision("1.0.0");
-      new Characteristic::HardwareRevision("1.0.0");
-      new Characteristic::Manufacturer("VSA Industries + Crisp X");
-      new Characteristic::Model("VSA-AC-A-R1");
-      new Characteristic::Name("Air Conditioner Remote");
-      new Characteristic::SerialNumber("AC-2022-07-000001");
-
-    new AirConditionerRemote();
+  // Setup devices shared by all AC units
+  bridge.begin();
+
+  if (UNITS_COUNT > 1) {
+    new SpanAccessory();
+      new Service::AccessoryInformation();
+        new Characteristic::Identify();
+        new Characteristic::FirmwareRevision("1.0.0");
+        new Characteristic::HardwareRevision("1.0.0");
+        new Characteristic::Manufacturer("VSA Industries");
+        new Characteristic::Model("VSA-AC-A-B1");
+        new Characteristic::Name("Air Conditioner Bridge");
+        new Characteristic::SerialNumber("AC-2022-07-B00001");
+  }
+
+  for (unsigned int unit = 0; unit < UNITS_COUNT; unit++) {
+    // Measure heap taken by the AC unit (w/ its HomeKit accessory)
+    uint32_t freeHeapBytes = ESP.getFreeHeap();
+
+    snprintf(unitsSerialNumbers[unit], UNITS_SERIAL_NUMBER_SIZE, UNITS_SERIAL_NUMBER_FORMAT, unit + 1);
+
+    new SpanAccessory();
+      new Service::AccessoryInformation();
+        new Characteristic::Identify();
+        new Characteristic::FirmwareRevision("1.0.0");
+        new Characteristic::HardwareRevision("1.0.0");
+        new Characteristic::Manufacturer("VSA Industries + Crisp X");
+        new Characteristic::Model("VSA-AC-A-R1");
+        new Characteristic::Name(UNITS_NAMES[unit]);
+        new Characteristic::SerialNumber(unitsSerialNumbers[unit]);
+
+      // Notice: all AC units share the same temperature sensor
+      AirConditionerRemote<AC_PROFILE> *remote = new AirConditionerRemote<AC_PROFILE>(unit, UNITS_IR_PINS[unit], &thermometer);
+
+      bridge.add(remote, freeHeapBytes - ESP.getFreeHeap());
+  }
+
+  // Poll HomeSpan from its own task (pinned to the Wi-Fi core)
+  homeSpan.autoPoll(HOMESPAN_TASK_STACK_SIZE, HOMESPAN_TASK_PRIORITY, HOMESPAN_TASK_CORE);
 }
 
 void loop() {
-  homeSpan.poll();
+  // Run device I/O (IR transmitter, journals, scheduled tasks) for all AC \
+  //   units, or idle until next due
+  bridge.runDevice();
 }
@@ -0,0 +1,365 @@
+// Air Conditioner (Remote)
+//
+// Air conditioner remote controller
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+
+const char *const JOURNAL_PARTITION_LABEL = "journal";
+
+const unsigned int JOURNAL_SECTOR_SIZE = 4096; // 4KB (flash erase unit)
+const unsigned int JOURNAL_REGION_SIZE = 16384; // 16KB (4 sectors per AC unit)
+const unsigned int JOURNAL_PARTITION_SIZE = 131072; // 128KB (as in partitions.csv)
+const unsigned int JOURNAL_RECORD_VALUES = 5;
+const unsigned int JOURNAL_OFFSET_NONE = 0xFFFFFFFF;
+
+const uint8_t JOURNAL_RECORD_MAGIC = 0x4A; // 'J'
+
+enum JOURNAL_RECORD_TYPES {
+  // Durable records (values are known to be applied)
+  JOURNAL_RECORD_TYPE_SNAPSHOT = 1,
+  JOURNAL_RECORD_TYPE_COMPLETION = 3,
+
+  // Write-ahead records (values are about to be applied)
+  JOURNAL_RECORD_TYPE_INTENT = 2
+};
+
+enum JOURNAL_RECOVERIES {
+  JOURNAL_RECOVERY_EMPTY        = 0, // No valid record (no values recovered)
+  JOURNAL_RECOVERY_DURABLE      = 1, // Latest record is durable (values recovered from it)
+  JOURNAL_RECOVERY_INTENT       = 2, // Latest record is an intent (values recovered from the durable record before it)
+  JOURNAL_RECOVERY_INTENTS_ONLY = 3  // Only intents (no values recovered)
+};
+
+struct JournalRecord {
+  uint8_t magic;
+  uint8_t type;
+  uint8_t values[JOURNAL_RECORD_VALUES];
+  uint8_t command;
+  uint32_t sequence;
+  uint32_t crc;
+};
+
+static_assert(sizeof(JournalRecord) == 16, "Journal records must be 16 bytes (aligned flash writes)");
+static_assert(JOURNAL_SECTOR_SIZE % sizeof(JournalRecord) == 0, "Journal records must not span flash sectors");
+static_assert(JOURNAL_REGION_SIZE % JOURNAL_SECTOR_SIZE == 0 && JOURNAL_REGION_SIZE >= (2 * JOURNAL_SECTOR_SIZE), "Journal regions must hold at least 2 sectors");
+static_assert(JOURNAL_PARTITION_SIZE % JOURNAL_REGION_SIZE == 0, "Journal partition must hold whole regions");
+
+const unsigned int JOURNAL_RECORDS_PER_SECTOR = JOURNAL_SECTOR_SIZE / sizeof(JournalRecord);
+const unsigned int JOURNAL_REGIONS_CAPACITY = JOURNAL_PARTITION_SIZE / JOURNAL_REGION_SIZE;
+
+struct Journal {
+  /**
+    [Journal]
+
+      - Records are full snapshots of the stored values, appended one after
+        the other across a rotating set of flash sectors (a sector is only
+        erased once all sectors have been filled, which levels wear)
+
+      - The latest valid durable record (highest sequence w/ a valid CRC)
+        is the one recovered at boot, so that older records never need to
+        be copied over when compacting: compacting is only about erasing
+        the sector ahead of the write cursor, before it is needed
+
+      - Intent records are written ahead of an action, and are followed by
+        a completion record once the action is done. At most one action is
+        in flight at a time, thus an intent is only ever pending if it is
+        the latest record (see the recovery decision table below).
+
+      - The CPU is held at its maximum frequency while committing, so that
+        flash writes hold back the device task for as short as possible
+
+      - The partition is split in fixed-size regions, one per AC unit, each
+        region holding an independent journal (offsets are relative to it)
+  **/
+
+  /**
+    [Journal Recovery]
+
+      - Recovery is decided from the latest valid record, and from the
+        latest valid durable record (torn records fail their CRC, thus they
+        are skipped as if they were never written):
+
+        | Latest record | Durable record | Decision     | Values          |
+        |---------------|----------------|--------------|-----------------|
+        | none          | none           | EMPTY        | not recovered   |
+        | durable       | itself         | DURABLE      | latest record   |
+        | intent        | before it      | INTENT       | durable record  |
+        | intent        | none           | INTENTS_ONLY | not recovered   |
+
+      - An INTENT decision means that the action was in flight at power
+        loss: the owner decides whether it happened (its command is kept
+        as 'pendingIntentCommand'), and should then close the intent w/ a
+        durable record
+  **/
+
+  const esp_partition_t *partition = NULL;
+
+  unsigned int regionOffset = 0,
+               regionSize = 0;
+
+  unsigned int sectorsCount = 0,
+               nextOffset = 0,
+               erasedOffset = JOURNAL_OFFSET_NONE;
+
+  uint32_t nextSequence = 0;
+
+  uint8_t pendingIntentCommand = 0;
+
+  // Statistics
+  unsigned int pendingIntentsCount = 0,
+               appendsCount = 0,
+               erasesCount = 0;
+
+  unsigned long lastCommitMicros = 0,
+                maximumCommitMicros = 0;
+
+  PowerLock powerLock;
+
+  bool begin(unsigned int region) {
+    powerLock.begin("journal");
+
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, JOURNAL_PARTITION_LABEL);
+
+    if (partition == NULL) {
+      LOG_AT(JOURNAL, 0, "[Storage:Journal] Error finding journal partition! Was the sketch flashed w/ its partitions.csv?\n");
+
+      return false;
+    }
+
+    // Notice: the first region spans the whole partition of single-unit \
+    //   builds, thus their journal is recovered as-is
+    if (partition->size < ((region + 1) * JOURNAL_REGION_SIZE)) {
+      LOG_AT(JOURNAL, 0, "[Storage:Journal] Error finding journal region #%u! Is the journal partition large enough? (%u bytes per AC unit)\n", region, JOURNAL_REGION_SIZE);
+
+      partition = NULL;
+
+      return false;
+    }
+
+    regionOffset = region * JOURNAL_REGION_SIZE;
+    regionSize = JOURNAL_REGION_SIZE;
+
+    sectorsCount = regionSize / JOURNAL_SECTOR_SIZE;
+
+    return true;
+  }
+
+  uint8_t recover(uint8_t values[]) {
+    JournalRecord record;
+
+    unsigned int latestOffset = JOURNAL_OFFSET_NONE,
+                 durableOffset = JOURNAL_OFFSET_NONE;
+
+    uint8_t latestType = 0,
+            latestCommand = 0;
+
+    uint32_t durableSequence = 0;
+
+    if (partition == NULL) {
+      return JOURNAL_RECOVERY_EMPTY;
+    }
+
+    // Scan all records for the latest valid one (+ latest durable one)
+    for (unsigned int offset = 0; offset < regionSize; offset += sizeof(JournalRecord)) {
+      if (readRecord(offset, record) == true) {
+        if (latestOffset == JOURNAL_OFFSET_NONE || record.sequence >= nextSequence) {
+          latestOffset = offset;
+          latestType = record.type;
+          latestCommand = record.command;
+          nextSequence = record.sequence + 1;
+        }
+
+        if (isRecordDurable(record) == true && (durableOffset == JOURNAL_OFFSET_NONE || record.sequence >= durableSequence)) {
+          durableOffset = offset;
+          durableSequence = record.sequence;
+
+          memcpy(values, record.values, JOURNAL_RECORD_VALUES);
+        }
+      }
+    }
+
+    // Journal is empty? (start from the first sector)
+    if (latestOffset == JOURNAL_OFFSET_NONE) {
+      nextOffset = 0;
+      nextSequence = 0;
+
+      LOG_AT(JOURNAL, 1, "[Storage:Journal] Journal is empty\n");
+
+      return JOURNAL_RECOVERY_EMPTY;
+    }
+
+    nextOffset = (latestOffset + sizeof(JournalRecord)) % regionSize;
+
+    // Notice: only the latest record can be a pending intent
+    pendingIntentsCount = (latestType == JOURNAL_RECORD_TYPE_INTENT) ? 1 : 0;
+    pendingIntentCommand = (latestType == JOURNAL_RECORD_TYPE_INTENT) ? latestCommand : 0;
+
+    // Journal holds no durable record? (only intents)
+    if (durableOffset == JOURNAL_OFFSET_NONE) {
+      LOG_AT(JOURNAL, 1, "[Storage:Journal] Journal holds no durable record\n");
+
+      return JOURNAL_RECOVERY_INTENTS_ONLY;
+    }
+
+    LOG_AT(JOURNAL, 1, "[Storage:Journal] Recovered record #%u at offset %u (%d pending intents)\n", durableSequence, durableOffset, pendingIntentsCount);
+
+    return (pendingIntentsCount > 0) ? JOURNAL_RECOVERY_INTENT : JOURNAL_RECOVERY_DURABLE;
+  }
+
+  void prepare(unsigned int recordsCount) {
+    if (partition == NULL) {
+      return;
+    }
+
+    // Erase sectors that the next records are about to enter, if needed \
+    //   (so that appending those records never waits on an erase)
+    for (unsigned int i = 0; i < recordsCount; i++) {
+      unsigned int offset = (nextOffset + i * sizeof(JournalRecord)) % regionSize;
+
+      if (offset % JOURNAL_SECTOR_SIZE == 0 && isSlotBlank(offset) == false) {
+        powerLock.acquire();
+        eraseSector(offset);
+        powerLock.release();
+
+        erasedOffset = offset;
+      }
+    }
+  }
+
+  bool append(uint8_t type, uint8_t command, const uint8_t values[]) {
+    powerLock.acquire();
+
+    bool isAppended = appendRecord(type, command, values);
+
+    powerLock.release();
+
+    return isAppended;
+  }
+
+  bool appendRecord(uint8_t type, uint8_t command, const uint8_t values[]) {
+    JournalRecord record;
+
+    unsigned long startMicros = micros();
+
+    if (partition == NULL) {
+      return false;
+    }
+
+    // Skip slots that cannot be written to (ie. interrupted writes)
+    while (isSlotBlank(nextOffset) == false) {
+      // Entering a sector? It needs to be erased first
+      if (nextOffset % JOURNAL_SECTOR_SIZE == 0) {
+        eraseSector(nextOffset);
+
+        break;
+      }
+
+      nextOffset = (nextOffset + sizeof(JournalRecord)) % regionSize;
+    }
+
+    record.magic = JOURNAL_RECORD_MAGIC;
+    record.type = type;
+    record.command = command;
+    record.sequence = nextSequence;
+
+    memcpy(record.values, values, JOURNAL_RECORD_VALUES);
+
+    record.crc = esp_rom_crc32_le(0, (const uint8_t *)&record, sizeof(JournalRecord) - sizeof(record.crc));
+
+    if (esp_partition_write(partition, regionOffset + nextOffset, &record, sizeof(JournalRecord)) != ESP_OK) {
+      LOG_AT(JOURNAL, 0, "[Storage:Journal] Error appending record #%u at offset %u!\n", nextSequence, nextOffset);
+
+      return false;
+    }
+
+    nextOffset = (nextOffset + sizeof(JournalRecord)) % regionSize;
+    nextSequence++;
+    appendsCount++;
+
+    // Measure commit latency
+    lastCommitMicros = micros() - startMicros;
+    maximumCommitMicros = max(maximumCommitMicros, lastCommitMicros);
+
+    return true;
+  }
+
+  void compact() {
+    if (partition == NULL) {
+      return;
+    }
+
+    unsigned int currentSectorOffset = nextOffset - (nextOffset % JOURNAL_SECTOR_SIZE),
+                 aheadSectorOffset = (currentSectorOffset + JOURNAL_SECTOR_SIZE) % regionSize;
+
+    // Erase the sector ahead of the write cursor? (only once the current \
+    //   sector holds a record, as the sector ahead might hold the latest one)
+    if (nextOffset != currentSectorOffset && erasedOffset != aheadSectorOffset) {
+      if (isSectorBlank(aheadSectorOffset) == false) {
+        powerLock.acquire();
+        eraseSector(aheadSectorOffset);
+        powerLock.release();
+      }
+
+      erasedOffset = aheadSectorOffset;
+    }
+  }
+
+  unsigned int estimateSectorWear() {
+    // Each sector gets erased once every full rotation
+    return nextSequence / (JOURNAL_RECORDS_PER_SECTOR * max(sectorsCount, 1u));
+  }
+
+  void eraseSector(unsigned int sectorOffset) {
+    esp_partition_erase_range(partition, regionOffset + sectorOffset, JOURNAL_SECTOR_SIZE);
+
+    erasesCount++;
+
+    LOG_AT(JOURNAL, 1, "[Storage:Journal] Erased sector at offset %u\n", sectorOffset);
+  }
+
+  bool readRecord(unsigned int offset, JournalRecord &record) {
+    if (esp_partition_read(partition, regionOffset + offset, &record, sizeof(JournalRecord)) != ESP_OK) {
+      return false;
+    }
+
+    // Check record integrity
+    if (record.magic != JOURNAL_RECORD_MAGIC) {
+      return false;
+    }
+
+    return record.crc == esp_rom_crc32_le(0, (const uint8_t *)&record, sizeof(JournalRecord) - sizeof(record.crc));
+  }
+
+  bool isRecordDurable(JournalRecord &record) {
+    return record.type == JOURNAL_RECORD_TYPE_SNAPSHOT || record.type == JOURNAL_RECORD_TYPE_COMPLETION;
+  }
+
+  bool isSlotBlank(unsigned int offset) {
+    uint32_t words[sizeof(JournalRecord) / sizeof(uint32_t)];
+
+    if (esp_partition_read(partition, regionOffset + offset, words, sizeof(words)) != ESP_OK) {
+      return false;
+    }
+
+    for (unsigned int i = 0; i < (sizeof(words) / sizeof(uint32_t)); i++) {
+      if (words[i] != 0xFFFFFFFF) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  bool isSectorBlank(unsigned int sectorOffset) {
+    for (unsigned int offset = sectorOffset; offset < (sectorOffset + JOURNAL_SECTOR_SIZE); offset += sizeof(JournalRecord)) {
+      if (isSlotBlank(offset) == false) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+};
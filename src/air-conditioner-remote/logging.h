@@ -0,0 +1,71 @@
+// Air Conditioner (Remote)
+//
+// Air conditioner remote controller
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+// Notice: uncomment to build the production profile, where only errors \
+//   get logged (all other log statements get compiled out)
+// #define LOG_PROFILE_PRODUCTION
+
+#ifdef LOG_PROFILE_PRODUCTION
+#define LOG_LEVEL_DEFAULT 0
+#else
+#define LOG_LEVEL_DEFAULT 2
+#endif
+
+// Per-subsystem log levels (maximum level that gets compiled in)
+// Notice: -1 compiles out all statements, including errors
+#ifndef LOG_LEVEL_SERVICE
+#define LOG_LEVEL_SERVICE LOG_LEVEL_DEFAULT // [Service:AirConditionerRemote] (init, update)
+#endif
+
+#ifndef LOG_LEVEL_SM
+#define LOG_LEVEL_SM LOG_LEVEL_DEFAULT // [Service:AirConditionerRemote] (sm)
+#endif
+
+#ifndef LOG_LEVEL_EMIT
+#define LOG_LEVEL_EMIT LOG_LEVEL_DEFAULT // [Service:AirConditionerRemote] (emit)
+#endif
+
+#ifndef LOG_LEVEL_POLL
+#define LOG_LEVEL_POLL LOG_LEVEL_DEFAULT // [Service:AirConditionerRemote] (poll)
+#endif
+
+#ifndef LOG_LEVEL_COMMIT
+#define LOG_LEVEL_COMMIT LOG_LEVEL_DEFAULT // [Service:AirConditionerRemote] (commit)
+#endif
+
+#ifndef LOG_LEVEL_CHECK
+#define LOG_LEVEL_CHECK LOG_LEVEL_DEFAULT // [Service:AirConditionerRemote] (check)
+#endif
+
+#ifndef LOG_LEVEL_SCHEDULER
+#define LOG_LEVEL_SCHEDULER LOG_LEVEL_DEFAULT // [Scheduler]
+#endif
+
+#ifndef LOG_LEVEL_JOURNAL
+#define LOG_LEVEL_JOURNAL LOG_LEVEL_DEFAULT // [Storage:Journal]
+#endif
+
+#ifndef LOG_LEVEL_THERMOMETER
+#define LOG_LEVEL_THERMOMETER LOG_LEVEL_DEFAULT // [Sensor:Thermometer]
+#endif
+
+#ifndef LOG_LEVEL_TRANSMITTER
+#define LOG_LEVEL_TRANSMITTER LOG_LEVEL_DEFAULT // [Transmitter:InfraRed]
+#endif
+
+// Is a log statement compiled in? (constant expression)
+#define LOG_ENABLED(SUBSYSTEM, LEVEL) (LOG_LEVEL_##SUBSYSTEM >= LEVEL)
+
+// Log a statement at a level (0, 1 or 2) for a subsystem
+// Notice: statements above the subsystem level are behind a constant false \
+//   condition, thus get compiled out along w/ their arguments (which never \
+//   get evaluated). Statements within the subsystem level are then still \
+//   filtered by the HomeSpan log level, at run time.
+// Important: statements that pass both levels still get formatted and \
+//   written to the UART inline (HomeSpan LOG0/1/2 call Serial.printf), thus \
+//   hot-path events must be recorded to the trace instead (see trace.h), \
+//   which defers formatting to '@t' (or to the host, w/ '@d')
+#define LOG_AT(SUBSYSTEM, LEVEL, ...) do { if (LOG_ENABLED(SUBSYSTEM, LEVEL)) { LOG##LEVEL(__VA_ARGS__); } } while (0)
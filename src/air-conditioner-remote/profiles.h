@@ -0,0 +1,141 @@
+// Air Conditioner (Remote)
+//
+// Air conditioner remote controller
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+enum VALUES_ACTIVE {
+  // Supported HK modes
+  ACTIVE_INACTIVE = 0,
+  ACTIVE_ACTIVE   = 1
+};
+
+enum VALUES_CURRENT_HEATER_COOLER_STATE {
+  // Supported HK modes
+  CURRENT_HEATER_COOLER_STATE_INACTIVE = 0,
+  CURRENT_HEATER_COOLER_STATE_IDLE     = 1,
+  CURRENT_HEATER_COOLER_STATE_HEATING  = 2,
+  CURRENT_HEATER_COOLER_STATE_COOLING  = 3
+};
+
+enum VALUES_TARGET_HEATER_COOLER_STATE {
+  // Supported HK modes
+  TARGET_HEATER_COOLER_STATE_AUTO = 0,
+  TARGET_HEATER_COOLER_STATE_HEAT = 1,
+  TARGET_HEATER_COOLER_STATE_COOL = 2,
+
+  // Unsupported HK modes
+  TARGET_HEATER_COOLER_STATE_UNMAPPED_1 = 3,
+  TARGET_HEATER_COOLER_STATE_UNMAPPED_2 = 4
+};
+
+enum VALUES_SWING_MODE {
+  // Supported HK modes
+  ACTIVE_SWING_MODE_DISABLED = 0,
+  ACTIVE_SWING_MODE_ENABLED  = 1
+};
+
+struct ProfileCrispX {
+  /**
+    [Profile: Crisp X]
+
+      - Portable AC unit (cool + heat), w/ a NEC IR remote controller
+  **/
+
+  // IR protocol (NEC address)
+  static constexpr unsigned int IR_ADDRESS = 0x81;
+
+  // IR commands (1 per remote controller button)
+  static constexpr unsigned int IR_COMMAND_SWITCH_POWER = 0x6B;
+  static constexpr unsigned int IR_COMMAND_SWITCH_MODE = 0x66;
+  static constexpr unsigned int IR_COMMAND_TOGGLE_FAN_SPEED = 0x64;
+  static constexpr unsigned int IR_COMMAND_TOGGLE_SWING = 0x67;
+  static constexpr unsigned int IR_COMMAND_TOGGLE_TIMER_MODE = 0x69;
+  static constexpr unsigned int IR_COMMAND_TEMPERATURE_INCREASE = 0x65;
+  static constexpr unsigned int IR_COMMAND_TEMPERATURE_DECREASE = 0x68;
+
+  // Mode cycle (order in which the mode button walks through modes)
+  typedef StateDirection<true,
+    TARGET_HEATER_COOLER_STATE_HEAT, // 'Heat' on the AC unit
+    TARGET_HEATER_COOLER_STATE_AUTO, // 'Cool Auto' on the AC unit
+    TARGET_HEATER_COOLER_STATE_COOL, // 'Cool' on the AC unit
+    TARGET_HEATER_COOLER_STATE_UNMAPPED_1, // 'Dry' on the AC unit
+    TARGET_HEATER_COOLER_STATE_UNMAPPED_2 // 'Fan' on the AC unit
+  > STATES_DIRECTION_TARGET_HEATER_COOLER_STATE;
+
+  // Temperature ranges (1 step per temperature button press)
+  static constexpr unsigned int RANGE_TEMPERATURE_COOL_MINIMUM = 18; // 18°C
+  static constexpr unsigned int RANGE_TEMPERATURE_COOL_MAXIMUM = 32; // 32°C
+  static constexpr unsigned int RANGE_TEMPERATURE_COOL_STEP = 1; // 1°C
+
+  static constexpr unsigned int RANGE_TEMPERATURE_HEAT_MINIMUM = 13; // 13°C
+  static constexpr unsigned int RANGE_TEMPERATURE_HEAT_MAXIMUM = 27; // 27°C
+  static constexpr unsigned int RANGE_TEMPERATURE_HEAT_STEP = 1; // 1°C
+
+  // Defaults (when no value was ever stored)
+  static constexpr unsigned int DEFAULT_TARGET_HEATER_COOLER_STATE = TARGET_HEATER_COOLER_STATE_COOL;
+  static constexpr unsigned int DEFAULT_THRESHOLD_TEMPERATURE = 18; // 18°C
+};
+
+// Notice: profiles of other AC units may live in their own header, which \
+//   gets included at build time (eg. w/ '-DAC_PROFILE_HEADER="profile.h"')
+#ifdef AC_PROFILE_HEADER
+#include AC_PROFILE_HEADER
+#endif
+
+// Notice: all AC units run w/ the same profile, which gets selected at \
+//   build time (eg. w/ '-DAC_PROFILE=ProfileCrispX')
+#ifndef AC_PROFILE
+#define AC_PROFILE ProfileCrispX
+#endif
+
+template <typename PROFILE>
+struct AirConditionerCodebook : PROFILE {
+  /**
+    [Codebook]
+
+      - Compiles a profile into the IR commands and transition tables that
+        the SM plans with: all tables are generated at compile time (they
+        live in flash, not in RAM), and lookups are plain table reads
+
+      - Temperature transition tables are generated from the profile ranges,
+        and the profile is checked at compile time against what the SM
+        relies upon (HK modes in the mode cycle, NEC command words, etc.)
+
+      - Profile values are only ever used by value (never by reference),
+        thus profiles do not need out-of-line definitions
+  **/
+
+  static_assert(stateIsRange(PROFILE::RANGE_TEMPERATURE_COOL_MINIMUM, PROFILE::RANGE_TEMPERATURE_COOL_MAXIMUM, PROFILE::RANGE_TEMPERATURE_COOL_STEP), "Profile cooling temperature range must be walkable by its step");
+  static_assert(stateIsRange(PROFILE::RANGE_TEMPERATURE_HEAT_MINIMUM, PROFILE::RANGE_TEMPERATURE_HEAT_MAXIMUM, PROFILE::RANGE_TEMPERATURE_HEAT_STEP), "Profile heating temperature range must be walkable by its step");
+
+  typedef typename PROFILE::STATES_DIRECTION_TARGET_HEATER_COOLER_STATE STATES_DIRECTION_TARGET_HEATER_COOLER_STATE;
+
+  // Notice: an invalid range is generated as a single state (as not to add \
+  //   template errors on top of the range check above)
+  typedef typename StateRangeOf<
+    PROFILE::RANGE_TEMPERATURE_COOL_MINIMUM,
+    stateIsRange(PROFILE::RANGE_TEMPERATURE_COOL_MINIMUM, PROFILE::RANGE_TEMPERATURE_COOL_MAXIMUM, PROFILE::RANGE_TEMPERATURE_COOL_STEP) ? PROFILE::RANGE_TEMPERATURE_COOL_MAXIMUM : PROFILE::RANGE_TEMPERATURE_COOL_MINIMUM,
+    PROFILE::RANGE_TEMPERATURE_COOL_STEP
+  >::Type STATES_COOLING_THRESHOLD_TEMPERATURE;
+
+  typedef typename StateRangeOf<
+    PROFILE::RANGE_TEMPERATURE_HEAT_MINIMUM,
+    stateIsRange(PROFILE::RANGE_TEMPERATURE_HEAT_MINIMUM, PROFILE::RANGE_TEMPERATURE_HEAT_MAXIMUM, PROFILE::RANGE_TEMPERATURE_HEAT_STEP) ? PROFILE::RANGE_TEMPERATURE_HEAT_MAXIMUM : PROFILE::RANGE_TEMPERATURE_HEAT_MINIMUM,
+    PROFILE::RANGE_TEMPERATURE_HEAT_STEP
+  >::Type STATES_HEATING_THRESHOLD_TEMPERATURE;
+
+  // NEC frames carry 8 bits addresses and commands
+  static_assert(PROFILE::IR_ADDRESS <= 0xFF, "Profile IR address must fit in 8 bits");
+  static_assert(PROFILE::IR_COMMAND_SWITCH_POWER <= 0xFF && PROFILE::IR_COMMAND_SWITCH_MODE <= 0xFF && PROFILE::IR_COMMAND_TOGGLE_FAN_SPEED <= 0xFF && PROFILE::IR_COMMAND_TOGGLE_SWING <= 0xFF && PROFILE::IR_COMMAND_TOGGLE_TIMER_MODE <= 0xFF && PROFILE::IR_COMMAND_TEMPERATURE_INCREASE <= 0xFF && PROFILE::IR_COMMAND_TEMPERATURE_DECREASE <= 0xFF, "Profile IR commands must fit in 8 bits");
+  static_assert(PROFILE::IR_COMMAND_TEMPERATURE_INCREASE != PROFILE::IR_COMMAND_TEMPERATURE_DECREASE, "Profile temperature commands must differ");
+
+  // The SM maps the supported HK modes onto the mode cycle
+  static_assert(STATES_DIRECTION_TARGET_HEATER_COOLER_STATE::contains(TARGET_HEATER_COOLER_STATE_AUTO), "Profile mode cycle must contain the auto mode");
+  static_assert(STATES_DIRECTION_TARGET_HEATER_COOLER_STATE::contains(TARGET_HEATER_COOLER_STATE_HEAT), "Profile mode cycle must contain the heat mode");
+  static_assert(STATES_DIRECTION_TARGET_HEATER_COOLER_STATE::contains(TARGET_HEATER_COOLER_STATE_COOL), "Profile mode cycle must contain the cool mode");
+
+  static_assert(STATES_DIRECTION_TARGET_HEATER_COOLER_STATE::contains(PROFILE::DEFAULT_TARGET_HEATER_COOLER_STATE), "Profile default target mode must be a known state");
+  static_assert(STATES_COOLING_THRESHOLD_TEMPERATURE::contains(PROFILE::DEFAULT_THRESHOLD_TEMPERATURE), "Profile default threshold temperature must be a known cooling state");
+  static_assert(STATES_HEATING_THRESHOLD_TEMPERATURE::contains(PROFILE::DEFAULT_THRESHOLD_TEMPERATURE), "Profile default threshold temperature must be a known heating state");
+};
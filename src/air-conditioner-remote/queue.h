@@ -0,0 +1,66 @@
+// Air Conditioner (Remote)
+//
+// Air conditioner remote controller
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#include <atomic>
+
+template <typename T, unsigned int N>
+struct Queue {
+  /**
+    [Queue]
+
+      - Hands messages from a single producer task to a single consumer
+        task (possibly running on the other core), w/o any lock: the
+        producer only ever moves the tail, and the consumer only ever moves
+        the head
+
+      - Pushing to a full queue fails right away (the message is dropped,
+        and counted), thus neither side ever blocks
+  **/
+
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "Queue capacity must be a power of 2");
+
+  T slots[N];
+
+  std::atomic<uint32_t> head{0},
+                        tail{0};
+
+  // Statistics (written by the producer only)
+  std::atomic<uint32_t> dropsCount{0};
+
+  bool push(const T &message) {
+    uint32_t tailIndex = tail.load(std::memory_order_relaxed);
+
+    // Queue is full? (drop message)
+    if ((tailIndex - head.load(std::memory_order_acquire)) >= N) {
+      dropsCount.fetch_add(1, std::memory_order_relaxed);
+
+      return false;
+    }
+
+    slots[tailIndex % N] = message;
+
+    // Publish message to consumer (slot is written before tail moves)
+    tail.store(tailIndex + 1, std::memory_order_release);
+
+    return true;
+  }
+
+  bool pop(T &message) {
+    uint32_t headIndex = head.load(std::memory_order_relaxed);
+
+    // Queue is empty?
+    if (headIndex == tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+
+    message = slots[headIndex % N];
+
+    // Release slot to producer (slot is read before head moves)
+    head.store(headIndex + 1, std::memory_order_release);
+
+    return true;
+  }
+};
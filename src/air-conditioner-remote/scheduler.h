@@ -0,0 +1,325 @@
+// Air Conditioner (Remote)
+//
+// Air conditioner remote controller
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#include "esp_timer.h"
+
+const unsigned int SCHEDULER_TASKS_CAPACITY = 8;
+const unsigned long SCHEDULER_DELAY_NEVER = 0xFFFFFFFF; // Task goes dormant
+const unsigned long SCHEDULER_DEADLINE_TOLERANCE_MILLISECONDS = 10; // 1/100 second
+
+const unsigned int SCHEDULER_HISTOGRAM_BUCKETS = 32; // Bucket N holds [2^N; 2^(N+1)[ (in the unit recorded)
+const unsigned int SCHEDULER_CALIBRATION_ROUNDS = 64;
+
+struct SchedulerHistogram {
+  // Notice: samples are kept in the unit they were recorded in (eg. µs for \
+  //   task run times and poll cadences), which the caller prints
+  uint32_t buckets[SCHEDULER_HISTOGRAM_BUCKETS];
+  uint32_t samplesCount;
+  uint32_t maximum;
+  uint64_t total;
+
+  inline void record(uint32_t sample) {
+    // Notice: bucket is the position of the highest bit set (log2)
+    buckets[(sample > 0) ? (31 - __builtin_clz(sample)) : 0]++;
+
+    samplesCount++;
+    total += sample;
+
+    if (sample > maximum) {
+      maximum = sample;
+    }
+  }
+
+  uint32_t percentile(unsigned int percent) {
+    uint32_t rank = ((uint64_t)samplesCount * percent + 99) / 100,
+             count = 0;
+
+    // Walk buckets up to the one holding the rank (report its upper bound)
+    for (unsigned int i = 0; i < SCHEDULER_HISTOGRAM_BUCKETS; i++) {
+      count += buckets[i];
+
+      if (count >= rank && count > 0) {
+        uint32_t upper = (i < 31) ? ((2u << i) - 1) : 0xFFFFFFFF;
+
+        return (upper < maximum) ? upper : maximum;
+      }
+    }
+
+    return 0;
+  }
+
+  uint32_t mean() {
+    return (samplesCount > 0) ? (total / samplesCount) : 0;
+  }
+
+  void printBuckets(const char *unit) {
+    // Dump non-empty buckets
+    for (unsigned int i = 0; i < SCHEDULER_HISTOGRAM_BUCKETS; i++) {
+      if (buckets[i] > 0) {
+        Serial.printf("    [%10u; %10u] %s = %u\n", (i > 0) ? (1u << i) : 0, (i < 31) ? ((2u << i) - 1) : 0xFFFFFFFF, unit, buckets[i]);
+      }
+    }
+  }
+};
+
+template <typename OWNER, unsigned int CAPACITY = SCHEDULER_TASKS_CAPACITY>
+struct Scheduler {
+  /**
+    [Scheduler]
+
+      - Tasks are member functions of their owner, that return the delay
+        until they should run again (or SCHEDULER_DELAY_NEVER to go dormant,
+        until woken up again). Tasks can belong to several owners of the
+        same type (eg. multiple services sharing a scheduler).
+
+      - A single task runs per loop pass, so that commands from HomeSpan get
+        applied in between tasks. When multiple tasks are due, the one w/ the
+        lowest priority number runs first (then, the one w/ the earliest
+        deadline)
+
+      - The earliest deadline is cached, so that a loop pass w/ no due task
+        only costs a single comparison, and so that the loop can idle until
+        then
+
+      - Task run times are measured w/ the high-resolution timer (in µs,
+        which holds when the CPU frequency scales during a task), and
+        recorded to a per-task histogram (log2 buckets, so recording is a
+        few cycles). The instrumentation overhead is measured w/ the CPU
+        cycle counter
+  **/
+
+  typedef unsigned long (OWNER::*Callback)();
+
+  struct Task {
+    const char *name;
+    OWNER *owner;
+    Callback callback;
+    unsigned int priority;
+    unsigned long budgetMicros;
+
+    bool isDormant;
+    unsigned long deadlineMillis;
+
+    // Statistics
+    unsigned int deadlineMissesCount,
+                 budgetOverrunsCount;
+
+    unsigned long maximumLatenessMillis,
+                  lastRunMicros;
+
+    SchedulerHistogram histogram;
+  };
+
+  Task tasks[CAPACITY];
+
+  unsigned int tasksCount = 0;
+
+  bool hasAwakeTasks = false;
+
+  unsigned long nextDeadlineMillis = 0;
+
+  uint32_t overheadCycles = 0;
+
+  void begin() {
+    calibrate();
+  }
+
+  void calibrate() {
+    SchedulerHistogram histogram = {};
+
+    // Measure the cost of measuring a task run (w/o any task)
+    uint32_t startCycles = ESP.getCycleCount();
+
+    for (unsigned int i = 0; i < SCHEDULER_CALIBRATION_ROUNDS; i++) {
+      int64_t runStartMicros = esp_timer_get_time();
+
+      histogram.record(esp_timer_get_time() - runStartMicros);
+    }
+
+    overheadCycles = (ESP.getCycleCount() - startCycles) / SCHEDULER_CALIBRATION_ROUNDS;
+
+    LOG_AT(SCHEDULER, 1, "[Scheduler] Instrumentation overhead is %u cycles per task run\n", overheadCycles);
+  }
+
+  unsigned int add(const char *name, unsigned int priority, OWNER *owner, Callback callback, unsigned long delayMillis, unsigned long budgetMicros) {
+    // Scheduler is full? This is not expected!
+    if (tasksCount >= CAPACITY) {
+      LOG_AT(SCHEDULER, 0, "[Scheduler] Error adding task '%s'! Scheduler is full.\n", name);
+
+      return CAPACITY;
+    }
+
+    Task &task = tasks[tasksCount];
+
+    task = Task();
+
+    task.name = name;
+    task.owner = owner;
+    task.callback = callback;
+    task.priority = priority;
+    task.budgetMicros = budgetMicros;
+
+    tasksCount++;
+
+    // Schedule first run
+    wake(tasksCount - 1, delayMillis);
+
+    return tasksCount - 1;
+  }
+
+  void wake(unsigned int id, unsigned long delayMillis) {
+    if (id >= tasksCount) {
+      return;
+    }
+
+    // Notice: waking up an awake task moves its deadline (ie. debounce)
+    schedule(tasks[id], millis(), delayMillis);
+
+    refreshNextDeadline();
+  }
+
+  void sleep(unsigned int id) {
+    if (id >= tasksCount) {
+      return;
+    }
+
+    tasks[id].isDormant = true;
+
+    refreshNextDeadline();
+  }
+
+  bool run() {
+    unsigned long nowMillis = millis();
+
+    // Nothing due yet? (fast path, for most loop passes)
+    if (hasAwakeTasks == false || isDue(nextDeadlineMillis, nowMillis) == false) {
+      return false;
+    }
+
+    // Pick the most urgent due task
+    Task *dueTask = NULL;
+
+    for (unsigned int i = 0; i < tasksCount; i++) {
+      Task &task = tasks[i];
+
+      if (task.isDormant == false && isDue(task.deadlineMillis, nowMillis) == true) {
+        if (dueTask == NULL || task.priority < dueTask->priority || (task.priority == dueTask->priority && isDue(dueTask->deadlineMillis, task.deadlineMillis) == false)) {
+          dueTask = &task;
+        }
+      }
+    }
+
+    if (dueTask == NULL) {
+      return false;
+    }
+
+    // Account for task lateness (ie. it was held back by other tasks)
+    unsigned long latenessMillis = nowMillis - dueTask->deadlineMillis;
+
+    if (latenessMillis > SCHEDULER_DEADLINE_TOLERANCE_MILLISECONDS) {
+      dueTask->deadlineMissesCount++;
+
+      LOG_AT(SCHEDULER, 2, "[Scheduler] Task '%s' missed its deadline by %lums\n", dueTask->name, latenessMillis);
+    }
+
+    dueTask->maximumLatenessMillis = max(dueTask->maximumLatenessMillis, latenessMillis);
+
+    // Run task
+    // Notice: the CPU cycle counter cannot be used here, as the CPU \
+    //   frequency changes while power locks are held (eg. during IR frames)
+    int64_t startMicros = esp_timer_get_time();
+
+    unsigned long delayMillis = (dueTask->owner->*(dueTask->callback))();
+
+    uint32_t runMicros = esp_timer_get_time() - startMicros;
+
+    dueTask->histogram.record(runMicros);
+    dueTask->lastRunMicros = runMicros;
+
+    // Account for task run time (ie. it held back other tasks + HomeSpan)
+    if (dueTask->lastRunMicros > dueTask->budgetMicros) {
+      dueTask->budgetOverrunsCount++;
+
+      LOG_AT(SCHEDULER, 2, "[Scheduler] Task '%s' overran its budget (%luµs > %luµs)\n", dueTask->name, dueTask->lastRunMicros, dueTask->budgetMicros);
+    }
+
+    // Schedule next run (relative to when the task was picked)
+    schedule(*dueTask, nowMillis, delayMillis);
+
+    refreshNextDeadline();
+
+    return true;
+  }
+
+  unsigned long millisUntilNextDeadline() {
+    unsigned long nowMillis = millis();
+
+    // All tasks dormant? (until woken up)
+    if (hasAwakeTasks == false) {
+      return SCHEDULER_DELAY_NEVER;
+    }
+
+    if (isDue(nextDeadlineMillis, nowMillis) == true) {
+      return 0;
+    }
+
+    return nextDeadlineMillis - nowMillis;
+  }
+
+  void schedule(Task &task, unsigned long nowMillis, unsigned long delayMillis) {
+    if (delayMillis == SCHEDULER_DELAY_NEVER) {
+      task.isDormant = true;
+    } else {
+      task.isDormant = false;
+      task.deadlineMillis = nowMillis + delayMillis;
+    }
+  }
+
+  void refreshNextDeadline() {
+    hasAwakeTasks = false;
+
+    for (unsigned int i = 0; i < tasksCount; i++) {
+      Task &task = tasks[i];
+
+      if (task.isDormant == false && (hasAwakeTasks == false || isDue(task.deadlineMillis, nextDeadlineMillis) == true)) {
+        nextDeadlineMillis = task.deadlineMillis;
+        hasAwakeTasks = true;
+      }
+    }
+  }
+
+  inline bool isDue(unsigned long deadlineMillis, unsigned long nowMillis) {
+    // Notice: this comparison holds when millis() wraps around
+    return (long)(nowMillis - deadlineMillis) >= 0;
+  }
+
+  void logSnapshot() {
+    for (unsigned int i = 0; i < tasksCount; i++) {
+      Task &task = tasks[i];
+
+      Serial.printf("  - Task '%s' = %d runs, %d deadline misses (max. %lums late), %d budget overruns (max. %uµs)\n", task.name, task.histogram.samplesCount, task.deadlineMissesCount, task.maximumLatenessMillis, task.budgetOverrunsCount, task.histogram.maximum);
+    }
+  }
+
+  void printStatistics() {
+    Serial.printf("\n*** Task Statistics ***\n\n");
+    Serial.printf("Instrumentation overhead: %u cycles per task run (at %uMHz)\n\n", overheadCycles, getCpuFrequencyMhz());
+
+    for (unsigned int i = 0; i < tasksCount; i++) {
+      Task &task = tasks[i];
+      SchedulerHistogram &histogram = task.histogram;
+
+      Serial.printf("Task '%s' (priority %d, budget %luµs):\n", task.name, task.priority, task.budgetMicros);
+      Serial.printf("  - Runs = %u (%d deadline misses, %d budget overruns)\n", histogram.samplesCount, task.deadlineMissesCount, task.budgetOverrunsCount);
+      Serial.printf("  - Run Time = mean %uµs, p50 %uµs, p90 %uµs, p99 %uµs, max %uµs\n", histogram.mean(), histogram.percentile(50), histogram.percentile(90), histogram.percentile(99), histogram.maximum);
+      Serial.printf("  - Maximum Lateness = %lums\n", task.maximumLatenessMillis);
+
+      histogram.printBuckets("µs");
+
+      Serial.printf("\n");
+    }
+  }
+};
@@ -4,122 +4,233 @@
 // Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
 // License: Mozilla Public License v2.0 (MPL v2.0)
 
-#include "IRremote.h"
-#include "DHT.h"
 #include "EEPROM.h"
 
-const int EEPROM_SIZE = 5;
-const int EEPROM_ADDRESS_SM_ACTIVE = 0;
-const int EEPROM_ADDRESS_SM_TARGET_HEATER_COOLER_STATE = 1;
-const int EEPROM_ADDRESS_SM_COOLING_THRESHOLD_TEMPERATURE = 2;
-const int EEPROM_ADDRESS_SM_HEATING_THRESHOLD_TEMPERATURE = 3;
-const int EEPROM_ADDRESS_SM_SWING_MODE = 4;
+#include "logging.h"
+#include "scheduler.h"
+#include "power.h"
+#include "states.h"
+#include "profiles.h"
+#include "transmitter.h"
+#include "journal.h"
+#include "thermometer.h"
+#include "publisher.h"
+#include "queue.h"
+#include "trace.h"
+
+// Notice: the storage layout is the same in the journal records and in \
+//   the legacy EEPROM (used to migrate values to the journal)
+const int STORAGE_SIZE = 5;
+const int STORAGE_INDEX_SM_ACTIVE = 0;
+const int STORAGE_INDEX_SM_TARGET_HEATER_COOLER_STATE = 1;
+const int STORAGE_INDEX_SM_COOLING_THRESHOLD_TEMPERATURE = 2;
+const int STORAGE_INDEX_SM_HEATING_THRESHOLD_TEMPERATURE = 3;
+const int STORAGE_INDEX_SM_SWING_MODE = 4;
+
+const uint8_t STORAGE_MASK_ALL = (1 << STORAGE_SIZE) - 1; // 1 bit per storage index
+
+static_assert(STORAGE_SIZE == JOURNAL_RECORD_VALUES, "Storage layout must fit in journal records");
 
 const int SENSOR_TEMPERATURE_PIN = 23;
-const int SENSOR_TEMPERATURE_DHT_TYPE = DHT11;
+const int SENSOR_TEMPERATURE_DHT_TYPE = DHT_TYPE_DHT11;
 
 const int IR_PIN_PWM = 17;
-const int IR_ADDRESS = 0x81;
-const int IR_COMMAND_SWITCH_POWER = 0x6B;
-const int IR_COMMAND_SWITCH_MODE = 0x66;
-const int IR_COMMAND_TOGGLE_FAN_SPEED = 0x64;
-const int IR_COMMAND_TOGGLE_SWING = 0x67;
-const int IR_COMMAND_TOGGLE_TIMER_MODE = 0x69;
-const int IR_COMMAND_TEMPERATURE_INCREASE = 0x65;
-const int IR_COMMAND_TEMPERATURE_DECREASE = 0x68;
 
 const int INITIALIZE_STEP_HOLD_MILLISECONDS = 500; // 1/2 second
 const int POLL_EVERY_MILLISECONDS = 30000; // 30 seconds
 const int COMMIT_EVERY_MILLISECONDS = 5000; // 5 seconds
 const int SM_CONVERGE_EVERY_MILLISECONDS = 100; // 1/10 second
 const int SM_WAKE_UP_EVERY_MILLISECONDS = 1000; // 1 second
+// Notice: the frame gap is the silence left after a frame before the next \
+//   one starts, which matches what the former blocking emitter guaranteed \
+//   (the state machine ticked every 100ms after each frame was sent), and \
+//   which the AC unit was always seen to decode reliably
+const int IR_FRAME_GAP_MILLISECONDS = 100; // 1/10 second (from the end of the previous frame)
+const int IR_FRAME_EVERY_MILLISECONDS = (NEC_FRAME_MICROSECONDS + 999) / 1000 + IR_FRAME_GAP_MILLISECONDS; // ~2/9 second (frame on air + gap)
+
+const unsigned int IR_PLAN_CAPACITY = 24;
+
+// Notice: a lower priority number runs first, when multiple tasks are due
+const unsigned int TASK_PRIORITY_EMIT = 0;
+const unsigned int TASK_PRIORITY_SM = 1;
+const unsigned int TASK_PRIORITY_COMMIT = 2;
+const unsigned int TASK_PRIORITY_POLL = 3;
+const unsigned int TASK_PRIORITY_CHECK = 4;
+
+const unsigned long TASK_BUDGET_EMIT_MICROSECONDS = 2000; // 2 milliseconds (journal write)
+const unsigned long TASK_BUDGET_SM_MICROSECONDS = 1000; // 1 millisecond
+const unsigned long TASK_BUDGET_COMMIT_MICROSECONDS = 60000; // 60 milliseconds (flash sector erase)
+const unsigned long TASK_BUDGET_POLL_MICROSECONDS = 150000; // 150 milliseconds (serial logging)
+const unsigned long TASK_BUDGET_CHECK_MICROSECONDS = 10000; // 10 milliseconds (plans from 1 start)
+
+const unsigned int CHECK_FAILURES_LOGGED = 8;
+
+const uint32_t HOMESPAN_TASK_STACK_SIZE = 8192;
+const uint32_t HOMESPAN_TASK_PRIORITY = 1;
+const uint32_t HOMESPAN_TASK_CORE = 0; // Runs along w/ the Wi-Fi stack (device I/O runs on the other core)
+
+const unsigned int SERVICE_COMMANDS_CAPACITY = 8;
+const unsigned int SERVICE_READINGS_CAPACITY = 8;
+
+// Notice: AC units share the device task, the scheduler and the IR \
+//   transmitter, while each unit has its own IR LED and journal region
+const unsigned int BRIDGE_UNITS_CAPACITY = IR_CHANNELS_CAPACITY;
+const unsigned int BRIDGE_TASKS_PER_UNIT = 5; // Emit, SM, commit, poll, check
+const unsigned int BRIDGE_TASKS_CAPACITY = BRIDGE_UNITS_CAPACITY * BRIDGE_TASKS_PER_UNIT;
+
+static_assert(BRIDGE_UNITS_CAPACITY <= JOURNAL_REGIONS_CAPACITY, "Journal partition must hold a region per bridged AC unit");
 
 const float RANGE_TEMPERATURE_CURRENT_MINIMUM = 0.0; // 0.0°C
 const float RANGE_TEMPERATURE_CURRENT_MAXIMUM = 99.0; // 99.0°C
 const unsigned int RANGE_TEMPERATURE_CURRENT_STEP = 1.0;
 
-const unsigned int RANGE_TEMPERATURE_COOL_MINIMUM = 18; // 18°C
-const unsigned int RANGE_TEMPERATURE_COOL_MAXIMUM = 32; // 32°C
-const unsigned int RANGE_TEMPERATURE_COOL_STEP = 1.0;
+const float PUBLISH_TEMPERATURE_CURRENT_DEADBAND = 0.5; // 0.5°C (half of a step)
+const unsigned long PUBLISH_TEMPERATURE_CURRENT_MINIMUM_INTERVAL_MILLISECONDS = 300000; // 5 minutes
+const unsigned long PUBLISH_TEMPERATURE_CURRENT_MAXIMUM_INTERVAL_MILLISECONDS = 1800000; // 30 minutes
 
-const unsigned int RANGE_TEMPERATURE_HEAT_MINIMUM = 13; // 13°C
-const unsigned int RANGE_TEMPERATURE_HEAT_MAXIMUM = 27; // 27°C
-const unsigned int RANGE_TEMPERATURE_HEAT_STEP = 1.0;
+typedef StateDirection<true,
+  ACTIVE_INACTIVE, // 'Off' on the AC unit
+  ACTIVE_ACTIVE // 'On' on the AC unit
+> STATES_DIRECTION_ACTIVE;
 
-enum VALUES_ACTIVE {
-  // Supported HK modes
-  ACTIVE_INACTIVE = 0,
-  ACTIVE_ACTIVE   = 1
-};
+typedef StateDirection<true,
+  ACTIVE_SWING_MODE_DISABLED,
+  ACTIVE_SWING_MODE_ENABLED
+> STATES_SWING_MODE;
 
-enum VALUES_CURRENT_HEATER_COOLER_STATE {
-  // Supported HK modes
-  CURRENT_HEATER_COOLER_STATE_INACTIVE = 0,
-  CURRENT_HEATER_COOLER_STATE_IDLE     = 1,
-  CURRENT_HEATER_COOLER_STATE_HEATING  = 2,
-  CURRENT_HEATER_COOLER_STATE_COOLING  = 3
-};
+const unsigned int DEFAULT_ACTIVE = ACTIVE_INACTIVE;
+const unsigned int DEFAULT_SWING_MODE = ACTIVE_SWING_MODE_ENABLED;
 
-enum VALUES_TARGET_HEATER_COOLER_STATE {
-  // Supported HK modes
-  TARGET_HEATER_COOLER_STATE_AUTO = 0,
-  TARGET_HEATER_COOLER_STATE_HEAT = 1,
-  TARGET_HEATER_COOLER_STATE_COOL = 2,
+static_assert(STATES_DIRECTION_ACTIVE::contains(DEFAULT_ACTIVE), "Default active must be a known state");
+static_assert(STATES_SWING_MODE::contains(DEFAULT_SWING_MODE), "Default swing mode must be a known state");
 
-  // Unsupported HK modes
-  TARGET_HEATER_COOLER_STATE_UNMAPPED_1 = 3,
-  TARGET_HEATER_COOLER_STATE_UNMAPPED_2 = 4
+struct InfraRedPlanStep {
+  int command; // IR command to emit
+  int index; // SM value progressed by this command (storage index)
+  unsigned int value; // SM value once the command is emitted
 };
 
-enum VALUES_SWING_MODE {
-  // Supported HK modes
-  ACTIVE_SWING_MODE_DISABLED = 0,
-  ACTIVE_SWING_MODE_ENABLED  = 1
+struct InfraRedPlan {
+  InfraRedPlanStep steps[IR_PLAN_CAPACITY];
+  unsigned int size = 0;
 };
 
-unsigned int STATES_DIRECTION_ACTIVE[] = {
-  ACTIVE_INACTIVE, // 'Off' on the AC unit
-  ACTIVE_ACTIVE // 'On' on the AC unit
+enum SERVICE_COMMAND_TYPES {
+  // From HomeSpan task, to device task
+  SERVICE_COMMAND_TYPE_UPDATE = 0, // HK values were updated
+  SERVICE_COMMAND_TYPE_CHECK  = 1  // Plans check was requested
 };
 
-unsigned int STATES_DIRECTION_TARGET_HEATER_COOLER_STATE[] = {
-  TARGET_HEATER_COOLER_STATE_HEAT, // 'Heat' on the AC unit
-  TARGET_HEATER_COOLER_STATE_AUTO, // 'Cool Auto' on the AC unit
-  TARGET_HEATER_COOLER_STATE_COOL, // 'Cool' on the AC unit
-  TARGET_HEATER_COOLER_STATE_UNMAPPED_1, // 'Dry' on the AC unit
-  TARGET_HEATER_COOLER_STATE_UNMAPPED_2 // 'Fan' on the AC unit
+enum SERVICE_READING_TYPES {
+  // From device task, to HomeSpan task
+  SERVICE_READING_TYPE_CURRENT_TEMPERATURE        = 0,
+  SERVICE_READING_TYPE_CURRENT_HEATER_COOLER_STATE = 1
 };
 
-unsigned int STATES_COOLING_THRESHOLD_TEMPERATURE[] = {
-  RANGE_TEMPERATURE_COOL_MINIMUM,
-    19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31,
-  RANGE_TEMPERATURE_COOL_MAXIMUM
+enum TRACE_EVENTS {
+  TRACE_EVENT_UPDATE       = 0,
+  TRACE_EVENT_POLL         = 1,
+  TRACE_EVENT_SM_PLANNED   = 2,
+  TRACE_EVENT_SM_CONVERGED = 3,
+  TRACE_EVENT_EMIT_COMMAND = 4,
+  TRACE_EVENT_EMIT_QUEUED  = 5,
+
+  TRACE_EVENTS_COUNT
 };
 
-unsigned int STATES_HEATING_THRESHOLD_TEMPERATURE[] = {
-  RANGE_TEMPERATURE_HEAT_MINIMUM,
-    14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26,
-  RANGE_TEMPERATURE_HEAT_MAXIMUM
+// Notice: each format takes 2 arguments (16 bits + 32 bits)
+const char *const TRACE_EVENT_FORMATS[TRACE_EVENTS_COUNT] = {
+  "(update) Requested, updated values 0x%02X",
+  "(poll) Current temperature: %u.%02u°C",
+  "(sm) Planned %u IR commands, ETA %ums",
+  "(sm) Converged w/ dirty values 0x%02X, %ums after update",
+  "(emit) Command 0x%02X (value=%u)",
+  "(emit) Queued %u IR commands in %ums"
 };
 
-unsigned int STATES_SWING_MODE[] = {
-  ACTIVE_SWING_MODE_DISABLED,
-  ACTIVE_SWING_MODE_ENABLED
+struct ServiceCommand {
+  uint8_t type;
+  uint8_t mask; // Updated HK values (if update, 1 bit per storage index)
+  uint8_t values[STORAGE_SIZE]; // Requested HK values (if update)
 };
 
-const unsigned int SIZE_DIRECTION_ACTIVE = 2;
-const unsigned int SIZE_DIRECTION_TARGET_HEATER_COOLER_STATE = 5;
-const unsigned int SIZE_DIRECTION_COOLING_THRESHOLD_TEMPERATURE = 15;
-const unsigned int SIZE_DIRECTION_HEATING_THRESHOLD_TEMPERATURE = 15;
-const unsigned int SIZE_DIRECTION_SWING_MODE = 2;
+struct ServiceReading {
+  uint8_t type;
+  float value;
+};
 
-const unsigned int DEFAULT_ACTIVE = ACTIVE_INACTIVE;
-const unsigned int DEFAULT_TARGET_HEATER_COOLER_STATE = TARGET_HEATER_COOLER_STATE_COOL;
-const unsigned int DEFAULT_THRESHOLD_TEMPERATURE = 18;
-const unsigned int DEFAULT_SWING_MODE = ACTIVE_SWING_MODE_ENABLED;
+template <typename PROFILE>
+struct AirConditionerUnit {
+  /**
+    [AC Unit Model]
+
+      - Models how the AC unit reacts to the IR commands it receives, so that
+        plans can be checked w/o an AC unit
 
-DHT dht(SENSOR_TEMPERATURE_PIN, SENSOR_TEMPERATURE_DHT_TYPE);
+      - Power and mode commands are always accepted, while temperature and
+        swing commands are only accepted once the unit is active, in a mode
+        that they apply to (these are the assumptions the SM is built upon)
+  **/
+
+  typedef AirConditionerCodebook<PROFILE> CODEBOOK;
+
+  typedef typename CODEBOOK::STATES_DIRECTION_TARGET_HEATER_COOLER_STATE STATES_DIRECTION_TARGET_HEATER_COOLER_STATE;
+  typedef typename CODEBOOK::STATES_COOLING_THRESHOLD_TEMPERATURE STATES_COOLING_THRESHOLD_TEMPERATURE;
+  typedef typename CODEBOOK::STATES_HEATING_THRESHOLD_TEMPERATURE STATES_HEATING_THRESHOLD_TEMPERATURE;
+
+  uint8_t values[STORAGE_SIZE];
+
+  bool receive(unsigned int command) {
+    unsigned int active = values[STORAGE_INDEX_SM_ACTIVE],
+                 mode = values[STORAGE_INDEX_SM_TARGET_HEATER_COOLER_STATE];
+
+    switch (command) {
+      case CODEBOOK::IR_COMMAND_SWITCH_POWER:
+        values[STORAGE_INDEX_SM_ACTIVE] = STATES_DIRECTION_ACTIVE::progress(active, 1);
+        return true;
+
+      case CODEBOOK::IR_COMMAND_SWITCH_MODE:
+        values[STORAGE_INDEX_SM_TARGET_HEATER_COOLER_STATE] = STATES_DIRECTION_TARGET_HEATER_COOLER_STATE::progress(mode, 1);
+        return true;
+
+      case CODEBOOK::IR_COMMAND_TEMPERATURE_INCREASE:
+      case CODEBOOK::IR_COMMAND_TEMPERATURE_DECREASE:
+        if (active == ACTIVE_ACTIVE && mode == TARGET_HEATER_COOLER_STATE_COOL) {
+          values[STORAGE_INDEX_SM_COOLING_THRESHOLD_TEMPERATURE] = STATES_COOLING_THRESHOLD_TEMPERATURE::progress(values[STORAGE_INDEX_SM_COOLING_THRESHOLD_TEMPERATURE], (command == CODEBOOK::IR_COMMAND_TEMPERATURE_INCREASE) ? 1 : -1);
+          return true;
+        }
+
+        if (active == ACTIVE_ACTIVE && mode == TARGET_HEATER_COOLER_STATE_HEAT) {
+          values[STORAGE_INDEX_SM_HEATING_THRESHOLD_TEMPERATURE] = STATES_HEATING_THRESHOLD_TEMPERATURE::progress(values[STORAGE_INDEX_SM_HEATING_THRESHOLD_TEMPERATURE], (command == CODEBOOK::IR_COMMAND_TEMPERATURE_INCREASE) ? 1 : -1);
+          return true;
+        }
+
+        return false;
+
+      case CODEBOOK::IR_COMMAND_TOGGLE_SWING:
+        if (active == ACTIVE_ACTIVE && mode > TARGET_HEATER_COOLER_STATE_AUTO) {
+          values[STORAGE_INDEX_SM_SWING_MODE] = STATES_SWING_MODE::progress(values[STORAGE_INDEX_SM_SWING_MODE], 1);
+          return true;
+        }
+
+        return false;
+    }
+
+    // Unknown command (ignored)
+    return false;
+  }
+};
+
+template <typename PROFILE>
+struct AirConditionerRemote;
+
+Thermometer thermometer;
+InfraRedTransmitter irTransmitter;
+Trace trace;
+Power power;
+Scheduler<AirConditionerRemote<AC_PROFILE>, BRIDGE_TASKS_CAPACITY> scheduler;
 
+template <typename PROFILE>
 struct AirConditionerRemote : Service::HeaterCooler {
   /**
     [HeaterCooler Characteristics]
@@ -157,12 +268,57 @@ struct AirConditionerRemote : Service::HeaterCooler {
         - 1 "Swing enabled"
   **/
 
-  unsigned int lastLoopPollMillis = 0,
-               lastLoopSMMillis = 0,
-               lastLoopCommitMillis = 0,
-               delayLoopSMMillis = SM_CONVERGE_EVERY_MILLISECONDS;
+  // AC unit profile, compiled to IR commands and transition tables
+  typedef AirConditionerCodebook<PROFILE> CODEBOOK;
+
+  typedef typename CODEBOOK::STATES_DIRECTION_TARGET_HEATER_COOLER_STATE STATES_DIRECTION_TARGET_HEATER_COOLER_STATE;
+  typedef typename CODEBOOK::STATES_COOLING_THRESHOLD_TEMPERATURE STATES_COOLING_THRESHOLD_TEMPERATURE;
+  typedef typename CODEBOOK::STATES_HEATING_THRESHOLD_TEMPERATURE STATES_HEATING_THRESHOLD_TEMPERATURE;
+
+  // AC unit devices (IR LED channel, journal region, temperature sensor)
+  unsigned int unitIndex,
+               irChannel;
+
+  Journal journal;
+
+  Thermometer *temperatureSensor;
+
+  unsigned int taskEmit,
+               taskPoll,
+               taskSM,
+               taskCommit,
+               taskCheck;
+
+  unsigned int lastUpdateMillis = 0,
+               planStartMillis = 0;
 
-  bool hasUncommitedEEPROMChanges = false;
+  bool hasUnconvergedUpdate = false;
+
+  // IR plan (ordered commands to emit so that the SM converges to HK values)
+  InfraRedPlan plan;
+
+  unsigned int planCursor = 0;
+
+  // IR commands in flight (queued to the IR transmitter, not yet sent)
+  InfraRedPlanStep inflightSteps[IR_QUEUE_CAPACITY];
+
+  unsigned int inflightHead = 0,
+               inflightSize = 0,
+               acknowledgedFramesCount = 0;
+
+  // Plans check (all start values are planned towards all target values)
+  unsigned int checkCursor = 0,
+               checkStartMillis = 0,
+               checkPairsCount = 0,
+               checkFailuresCount = 0,
+               checkFramesMaximum = 0;
+
+  unsigned long checkFramesTotal = 0;
+
+  unsigned int checkFramesCounts[IR_PLAN_CAPACITY + 1];
+
+  // Stored values (source of truth about the AC unit state, as sent)
+  uint8_t storedValues[STORAGE_SIZE];
 
   // HomeKit values (might be user-modified)
   SpanCharacteristic *hkActive,
@@ -173,6 +329,35 @@ struct AirConditionerRemote : Service::HeaterCooler {
                      *hkHeatingThresholdTemperature,
                      *hkSwingMode;
 
+  // HomeKit publishers (suppress insignificant notifications)
+  Publisher hkCurrentTemperaturePublisher;
+
+  // Requested values (HK values, as handed over to the device task)
+  uint8_t requestedValues[STORAGE_SIZE];
+
+  // Dirty values (requested values that the SM has not converged to yet)
+  uint8_t dirtyMask = 0;
+
+  // SM dormancy (the SM only wakes up on updates, and while converging)
+  bool isStateMachineDormant = false;
+
+  unsigned int stateMachineDormantMillis = 0,
+               stateMachineDormantCadenceMillis = 0;
+
+  unsigned long stateMachineTicksAvoidedCount = 0;
+
+  // Messages between the HomeSpan task and the device task
+  Queue<ServiceCommand, SERVICE_COMMANDS_CAPACITY> commands;
+  Queue<ServiceReading, SERVICE_READINGS_CAPACITY> readings;
+
+  // HomeSpan poll cadence (time between two service loop passes)
+  SchedulerHistogram pollCadenceHistogram = {};
+
+  unsigned long lastPollMicros = 0;
+
+  // HomeSpan update time (part of the HAP response time spent in update())
+  SchedulerHistogram updateHistogram = {};
+
   // State Machine internal values (source of truth about the AC unit state)
   unsigned int smActive,
                smTargetHeaterCoolerState,
@@ -180,11 +365,13 @@ struct AirConditionerRemote : Service::HeaterCooler {
                smHeatingThresholdTemperature,
                smSwingMode;
 
-  AirConditionerRemote() : Service::HeaterCooler() {
+  AirConditionerRemote(unsigned int unit, int irPin, Thermometer *sensor) : Service::HeaterCooler() {
+    unitIndex = unit;
+
     // Configure all dependencies
-    configureEEPROM();
-    configureInfraRed();
-    configureSensorTemperature();
+    configureStorage();
+    configureInfraRed(irPin);
+    configureSensorTemperature(sensor);
 
     // Hold for some time before everything gets configured
     delay(INITIALIZE_STEP_HOLD_MILLISECONDS);
@@ -200,105 +387,301 @@ struct AirConditionerRemote : Service::HeaterCooler {
 
     // Define the range of numbered characteristics
     hkCurrentTemperature->setRange(RANGE_TEMPERATURE_CURRENT_MINIMUM, RANGE_TEMPERATURE_CURRENT_MAXIMUM, RANGE_TEMPERATURE_CURRENT_STEP);
-    hkCoolingThresholdTemperature->setRange(RANGE_TEMPERATURE_COOL_MINIMUM, RANGE_TEMPERATURE_COOL_MAXIMUM, RANGE_TEMPERATURE_COOL_STEP);
-    hkHeatingThresholdTemperature->setRange(RANGE_TEMPERATURE_HEAT_MINIMUM, RANGE_TEMPERATURE_HEAT_MAXIMUM, RANGE_TEMPERATURE_HEAT_STEP);
+    hkCoolingThresholdTemperature->setRange(CODEBOOK::RANGE_TEMPERATURE_COOL_MINIMUM, CODEBOOK::RANGE_TEMPERATURE_COOL_MAXIMUM, CODEBOOK::RANGE_TEMPERATURE_COOL_STEP);
+    hkHeatingThresholdTemperature->setRange(CODEBOOK::RANGE_TEMPERATURE_HEAT_MINIMUM, CODEBOOK::RANGE_TEMPERATURE_HEAT_MAXIMUM, CODEBOOK::RANGE_TEMPERATURE_HEAT_STEP);
+
+    // Configure publishers of frequently polled characteristics
+    hkCurrentTemperaturePublisher.begin(hkCurrentTemperature, PUBLISH_TEMPERATURE_CURRENT_DEADBAND, PUBLISH_TEMPERATURE_CURRENT_MINIMUM_INTERVAL_MILLISECONDS, PUBLISH_TEMPERATURE_CURRENT_MAXIMUM_INTERVAL_MILLISECONDS);
 
     // Initialize the state machine values + HomeKit values (from initial \
     //   SM values)
     initializeStateMachineValues();
     initializeHomeKitValues();
 
+    // Schedule all tasks
+    configureScheduler();
+
     // Hold for some time before everything gets initialized
     delay(INITIALIZE_STEP_HOLD_MILLISECONDS);
   }
 
   void loop() {
+    // Notice: this runs on the HomeSpan task, which owns HK values, while \
+    //   the device task owns the IR transmitter, the journal and the \
+    //   scheduler. Both only talk through queues.
     // Warning: never block this main loop with a delay(), as this will cause \
     //   the accessory from being marked as 'not responding' on the Home app.
-    unsigned int nowMillis = millis();
+    unsigned long nowMicros = micros();
+
+    // Measure poll cadence (worst case is the HAP response time)
+    if (lastPollMicros > 0) {
+      pollCadenceHistogram.record(nowMicros - lastPollMicros);
+    }
 
-    // Run poll tasks?
-    if ((nowMillis - lastLoopPollMillis) >= POLL_EVERY_MILLISECONDS) {
-      LOG2("[Service:AirConditionerRemote] (poll) Tick in progress...\n");
+    lastPollMicros = nowMicros;
 
-      // Tick a poll task
-      tickTaskPoll();
+    // Apply readings from the device task to HK
+    ServiceReading reading;
 
-      LOG2("[Service:AirConditionerRemote] (poll) Tick done, next in %dms\n", POLL_EVERY_MILLISECONDS);
+    while (readings.pop(reading) == true) {
+      applyReading(reading);
+    }
+  }
 
-      // Mark last poll time
-      lastLoopPollMillis = nowMillis;
+  void applyCommands() {
+    // Notice: this runs on the device task (ie. the Arduino loop task, on \
+    //   the core that does not run HomeSpan)
+    ServiceCommand command;
 
-      // Bail out for this time (prevent sensors to collide w/ each other)
-      return;
+    // Apply commands from the HomeSpan task
+    while (commands.pop(command) == true) {
+      applyCommand(command);
     }
+  }
+
+  unsigned long runTaskEmit() {
+    // Plan fully streamed? (sleep until next plan)
+    if (planCursor >= plan.size) {
+      return SCHEDULER_DELAY_NEVER;
+    }
+
+    // IR queue is full? (retry once a frame is sent)
+    if (irTransmitter.available() == 0) {
+      return IR_FRAME_EVERY_MILLISECONDS;
+    }
+
+    LOG_AT(EMIT, 2, "[Service:AirConditionerRemote] (emit) Tick in progress...\n");
+
+    // Tick an emit task
+    // Notice: commands from a plan are queued to the IR transmitter, which \
+    //   emits them as a paced burst, spaced by the minimum gap that the AC \
+    //   unit accepts between two frames.
+    tickTaskEmit();
+
+    LOG_AT(EMIT, 2, "[Service:AirConditionerRemote] (emit) Tick done, %d IR frames queued\n", IR_QUEUE_CAPACITY - irTransmitter.available());
+
+    // Stream next planned command right away
+    return 0;
+  }
+
+  unsigned long runTaskPoll() {
+    LOG_AT(POLL, 2, "[Service:AirConditionerRemote] (poll) Tick in progress...\n");
+
+    // Tick a poll task
+    tickTaskPoll();
+
+    LOG_AT(POLL, 2, "[Service:AirConditionerRemote] (poll) Tick done, next in %dms\n", POLL_EVERY_MILLISECONDS);
 
-    // Tick state machine?
+    return POLL_EVERY_MILLISECONDS;
+  }
+
+  unsigned long runTaskSM() {
     // Notice: the SM is adaptative, meaning that it can wake up and enter \
     //   into a 'converging mode', and then go to sleep once it has converged \
     //   to the desired configured value. This effectively acts as a debounce, \
     //   as the user may change the value multiple times before settling on \
     //   the final desired value.
-    if ((nowMillis - lastLoopSMMillis) >= delayLoopSMMillis) {
-      LOG2("[Service:AirConditionerRemote] (sm) Tick in progress...\n");
+    LOG_AT(SM, 2, "[Service:AirConditionerRemote] (sm) Tick in progress...\n");
 
-      // Tick a state machine task
-      // Update next delay loop (still converging, or can go to sleep)
-      delayLoopSMMillis = (tickTaskSM() == true) ? SM_WAKE_UP_EVERY_MILLISECONDS : SM_CONVERGE_EVERY_MILLISECONDS;
+    // Tick a state machine task
+    bool isConverged = tickTaskSM();
 
-      LOG2("[Service:AirConditionerRemote] (sm) Tick done, next in %dms\n", delayLoopSMMillis);
+    // Go dormant (converged SM sleeps until next update, while converging SM \
+    //   sleeps until its plan is fully streamed by the emit task)
+    // Notice: the cadence is the one the SM would have ticked at if it \
+    //   polled, which is used to count ticks avoided
+    sleepStateMachine(isConverged == true ? SM_WAKE_UP_EVERY_MILLISECONDS : SM_CONVERGE_EVERY_MILLISECONDS);
 
-      // Mark last tick time
-      lastLoopSMMillis = nowMillis;
+    LOG_AT(SM, 2, "[Service:AirConditionerRemote] (sm) Tick done, now dormant (%s)\n", isConverged == true ? "converged" : "converging");
 
-      // Bail out for this time (prevent sensors to collide w/ each other)
-      return;
-    }
+    return SCHEDULER_DELAY_NEVER;
+  }
 
-    // Run commit tasks?
-    if ((nowMillis - lastLoopCommitMillis) >= COMMIT_EVERY_MILLISECONDS) {
-      LOG2("[Service:AirConditionerRemote] (commit) Tick in progress...\n");
+  unsigned long runTaskCheck() {
+    uint8_t startValues[STORAGE_SIZE];
 
-      // Tick a commit task
-      tickTaskCommit();
+    // Decode start values from cursor (one digit per SM value)
+    unsigned int cursor = checkCursor;
 
-      LOG2("[Service:AirConditionerRemote] (commit) Tick done, next in %dms\n", COMMIT_EVERY_MILLISECONDS);
+    startValues[STORAGE_INDEX_SM_ACTIVE] = STATES_DIRECTION_ACTIVE::at(cursor % STATES_DIRECTION_ACTIVE::SIZE);
+    cursor /= STATES_DIRECTION_ACTIVE::SIZE;
+    startValues[STORAGE_INDEX_SM_TARGET_HEATER_COOLER_STATE] = STATES_DIRECTION_TARGET_HEATER_COOLER_STATE::at(cursor % STATES_DIRECTION_TARGET_HEATER_COOLER_STATE::SIZE);
+    cursor /= STATES_DIRECTION_TARGET_HEATER_COOLER_STATE::SIZE;
+    startValues[STORAGE_INDEX_SM_COOLING_THRESHOLD_TEMPERATURE] = STATES_COOLING_THRESHOLD_TEMPERATURE::at(cursor % STATES_COOLING_THRESHOLD_TEMPERATURE::SIZE);
+    cursor /= STATES_COOLING_THRESHOLD_TEMPERATURE::SIZE;
+    startValues[STORAGE_INDEX_SM_HEATING_THRESHOLD_TEMPERATURE] = STATES_HEATING_THRESHOLD_TEMPERATURE::at(cursor % STATES_HEATING_THRESHOLD_TEMPERATURE::SIZE);
+    cursor /= STATES_HEATING_THRESHOLD_TEMPERATURE::SIZE;
+    startValues[STORAGE_INDEX_SM_SWING_MODE] = STATES_SWING_MODE::at(cursor % STATES_SWING_MODE::SIZE);
+    cursor /= STATES_SWING_MODE::SIZE;
 
-      // Mark last commit time
-      lastLoopCommitMillis = nowMillis;
+    // All start values checked? (cursor overflowed)
+    if (cursor > 0) {
+      printPlansCheckReport();
 
-      // Bail out for this time (prevent sensors to collide w/ each other)
-      return;
+      return SCHEDULER_DELAY_NEVER;
     }
+
+    // Check plans from those start values (one start per tick, as to \
+    //   never hold the main loop for long)
+    checkPlansFrom(startValues);
+
+    checkCursor++;
+
+    return 0;
+  }
+
+  unsigned long runTaskCommit() {
+    LOG_AT(COMMIT, 2, "[Service:AirConditionerRemote] (commit) Tick in progress...\n");
+
+    // Tick a commit task
+    tickTaskCommit();
+
+    LOG_AT(COMMIT, 2, "[Service:AirConditionerRemote] (commit) Tick done, next in %dms\n", COMMIT_EVERY_MILLISECONDS);
+
+    return COMMIT_EVERY_MILLISECONDS;
   }
 
   bool update() {
-    LOG2("[Service:AirConditionerRemote] (update) Requested...\n");
+    ServiceCommand command;
 
-    // Force the SM in a sleep mode, even if it was currently converging \
-    //   (debounce user interactions)
-    delayLoopSMMillis = SM_WAKE_UP_EVERY_MILLISECONDS;
+    unsigned long startMicros = micros();
+
+    LOG_AT(SERVICE, 2, "[Service:AirConditionerRemote] (update) Requested...\n");
 
-    // Force the SM to update later on
-    lastLoopSMMillis = millis();
+    // Hand updated values over to the device task (only those that changed \
+    //   are marked, so that the SM only converges them)
+    command.type = SERVICE_COMMAND_TYPE_UPDATE;
+    command.mask = snapshotUpdatedHomeKitValues();
 
-    LOG1("[Service:AirConditionerRemote] (update) Complete. SM will soon converge in %dms.\n", delayLoopSMMillis);
+    snapshotHomeKitValues(command.values);
+
+    if (commands.push(command) == false) {
+      LOG_AT(SERVICE, 0, "[Service:AirConditionerRemote] (update) Error handing update over to device task! Too many updates in flight.\n");
+
+      return false;
+    }
+
+    power.wake();
+
+    trace.record(TRACE_EVENT_UPDATE, command.mask);
+
+    updateHistogram.record(micros() - startMicros);
 
     // Show update as successful
     return true;
   }
 
+  void applyCommand(ServiceCommand &command) {
+    switch (command.type) {
+      case SERVICE_COMMAND_TYPE_UPDATE:
+        applyUpdate(command.mask, command.values);
+        break;
+
+      case SERVICE_COMMAND_TYPE_CHECK:
+        beginPlansCheck();
+        break;
+    }
+  }
+
+  void applyReading(ServiceReading &reading) {
+    switch (reading.type) {
+      case SERVICE_READING_TYPE_CURRENT_TEMPERATURE:
+        // Update temperature in HK (unless change is insignificant)
+        hkCurrentTemperaturePublisher.publish(reading.value);
+        break;
+
+      case SERVICE_READING_TYPE_CURRENT_HEATER_COOLER_STATE:
+        hkCurrentHeaterCoolerState->setVal((int)reading.value);
+        break;
+    }
+  }
+
+  void pushReading(int type, float value) {
+    ServiceReading reading;
+
+    reading.type = type;
+    reading.value = value;
+
+    if (readings.push(reading) == false) {
+      LOG_AT(SERVICE, 0, "[Service:AirConditionerRemote] Error handing reading over to HomeSpan task! Too many readings in flight.\n");
+    }
+  }
+
+  void applyUpdate(uint8_t mask, const uint8_t values[]) {
+    // Only take updated values (others are left as requested before)
+    for (unsigned int index = 0; index < STORAGE_SIZE; index++) {
+      if ((mask & (1 << index)) != 0) {
+        requestedValues[index] = values[index];
+      }
+    }
+
+    dirtyMask |= mask;
+
+    // Force the SM in a sleep mode, even if it was currently converging \
+    //   (debounce user interactions), and force it to update later on
+    wakeStateMachine(SM_WAKE_UP_EVERY_MILLISECONDS);
+
+    // Abort any plan being streamed (it will be re-planned from the commands \
+    //   that were already emitted)
+    plan.size = planCursor;
+
+    // Mark update time (used to measure convergence latency)
+    if (hasUnconvergedUpdate == false) {
+      lastUpdateMillis = millis();
+      hasUnconvergedUpdate = true;
+    }
+  }
+
   void initializeStateMachineValues() {
+    uint8_t values[STORAGE_SIZE];
+
+    // Recover values from the journal (or migrate them from the EEPROM)
+    uint8_t recovery = journal.recover(values);
+
+    bool isRecovered = (recovery == JOURNAL_RECOVERY_DURABLE || recovery == JOURNAL_RECOVERY_INTENT) ? true : false;
+
+    // Notice: only the first AC unit was ever stored in the EEPROM
+    if (isRecovered == false && unitIndex == 0) {
+      LOG_AT(SERVICE, 1, "[Service:AirConditionerRemote] (init) No journal record found, reading values from EEPROM...\n");
+
+      readLegacyEEPROM(values);
+    } else if (isRecovered == false) {
+      memset(values, 255, STORAGE_SIZE);
+    }
+
     // Load all values from the ROM (or use defaults)
-    smActive = readEEPROMOrDefault(EEPROM_ADDRESS_SM_ACTIVE, DEFAULT_ACTIVE);
-    smTargetHeaterCoolerState = readEEPROMOrDefault(EEPROM_ADDRESS_SM_TARGET_HEATER_COOLER_STATE, DEFAULT_TARGET_HEATER_COOLER_STATE);
-    smCoolingThresholdTemperature = readEEPROMOrDefault(EEPROM_ADDRESS_SM_COOLING_THRESHOLD_TEMPERATURE, DEFAULT_THRESHOLD_TEMPERATURE);
-    smHeatingThresholdTemperature = readEEPROMOrDefault(EEPROM_ADDRESS_SM_HEATING_THRESHOLD_TEMPERATURE, DEFAULT_THRESHOLD_TEMPERATURE);
-    smSwingMode = readEEPROMOrDefault(EEPROM_ADDRESS_SM_SWING_MODE, DEFAULT_SWING_MODE);
+    smActive = readStateOrDefault<STATES_DIRECTION_ACTIVE>(values, STORAGE_INDEX_SM_ACTIVE, DEFAULT_ACTIVE);
+    smTargetHeaterCoolerState = readStateOrDefault<STATES_DIRECTION_TARGET_HEATER_COOLER_STATE>(values, STORAGE_INDEX_SM_TARGET_HEATER_COOLER_STATE, CODEBOOK::DEFAULT_TARGET_HEATER_COOLER_STATE);
+    smCoolingThresholdTemperature = readStateOrDefault<STATES_COOLING_THRESHOLD_TEMPERATURE>(values, STORAGE_INDEX_SM_COOLING_THRESHOLD_TEMPERATURE, CODEBOOK::DEFAULT_THRESHOLD_TEMPERATURE);
+    smHeatingThresholdTemperature = readStateOrDefault<STATES_HEATING_THRESHOLD_TEMPERATURE>(values, STORAGE_INDEX_SM_HEATING_THRESHOLD_TEMPERATURE, CODEBOOK::DEFAULT_THRESHOLD_TEMPERATURE);
+    smSwingMode = readStateOrDefault<STATES_SWING_MODE>(values, STORAGE_INDEX_SM_SWING_MODE, DEFAULT_SWING_MODE);
+
+    snapshotStateMachineValues(storedValues);
+
+    // Command was in flight at power loss? (assume it was not received)
+    // Notice: the intent of an IR command is written right before its frame \
+    //   goes on air, and its completion right after the data part of the \
+    //   frame was sent (ie. when the AC unit decodes the command). If the \
+    //   power was lost in between, the frame was either not sent or cut \
+    //   short, which the AC unit rejects (NEC frames carry the inverse of \
+    //   their bytes). The only window where this is wrong is from the end \
+    //   of the data part, to when the completion is written (ie. up to one \
+    //   loop pass and one flash write, against the ~68ms data part).
+    if (recovery == JOURNAL_RECOVERY_INTENT) {
+      LOG_AT(SERVICE, 0, "[Service:AirConditionerRemote] (init) Discarded IR command 0x%02X in flight at power loss\n", journal.pendingIntentCommand);
+    }
+
+    // Journal has no base record, or a pending intent? (write a snapshot of \
+    //   loaded values, which closes the intent)
+    if (recovery != JOURNAL_RECOVERY_DURABLE) {
+      journal.append(JOURNAL_RECORD_TYPE_SNAPSHOT, 0, storedValues);
+    }
   }
 
   void initializeHomeKitValues() {
     forceHomeKitValuesFromStateMachine();
+
+    snapshotHomeKitValues(requestedValues);
   }
 
   void forceHomeKitValuesFromStateMachine() {
@@ -314,22 +697,16 @@ struct AirConditionerRemote : Service::HeaterCooler {
 
     hkCurrentHeaterCoolerState->setVal(currentMode);
 
-    LOG1("[Service:AirConditionerRemote] HomeKit values forced from SM:\n");
-    logSnapshotHKValues();
+    if (LOG_ENABLED(SERVICE, 1) && homeSpan.getLogLevel() >= 1) {
+      LOG1("[Service:AirConditionerRemote] HomeKit values forced from SM:\n");
+      logSnapshotHKValues();
+    }
   }
 
   void tickTaskCommit() {
-    // Should commit unsaved EEPROM changes?
-    if (hasUncommitedEEPROMChanges == true) {
-      hasUncommitedEEPROMChanges = false;
-
-      LOG2("[Service:AirConditionerRemote] (commit) Unsaved EEPROM changes, committing...\n");
-
-      // Proceed saving of EEPROM
-      EEPROM.commit();
-
-      LOG1("[Service:AirConditionerRemote] (commit) Saved EEPROM changes\n");
-    }
+    // Prepare the journal for next commits (records are written ahead of \
+    //   each IR command, so there is nothing else to commit here)
+    journal.compact();
   }
 
   void tickTaskPoll() {
@@ -337,185 +714,486 @@ struct AirConditionerRemote : Service::HeaterCooler {
     float currentTemperature = acquireTemperatureValue();
 
     if (currentTemperature >= RANGE_TEMPERATURE_CURRENT_MINIMUM && currentTemperature <= RANGE_TEMPERATURE_CURRENT_MAXIMUM) {
-      LOG1("[Service:AirConditionerRemote] (poll) Current temperature: %.2f°C\n", currentTemperature);
+      trace.record(TRACE_EVENT_POLL, (uint16_t)currentTemperature, (uint32_t)(currentTemperature * 100) % 100);
 
-      // Update temperature in HK
-      hkCurrentTemperature->setVal(currentTemperature);
+      // Update temperature in HK (from HomeSpan task)
+      pushReading(SERVICE_READING_TYPE_CURRENT_TEMPERATURE, currentTemperature);
     } else {
-      LOG0("[Service:AirConditionerRemote] (poll) Error acquiring temperature! Too high, too low or none. Is the sensor plugged on IO%d? (got value: %.2f)\n", SENSOR_TEMPERATURE_PIN, currentTemperature);
+      LOG_AT(POLL, 0, "[Service:AirConditionerRemote] (poll) Error acquiring temperature! Too high, too low or none. Is the sensor plugged on IO%d? (got value: %.2f)\n", (int)temperatureSensor->pin, currentTemperature);
     }
 
-    LOG1("[Service:AirConditionerRemote] (poll) Current HomeKit values are:\n");
-    logSnapshotHKValues();
-    LOG1("[Service:AirConditionerRemote] (poll) Current state machine values are:\n");
-    logSnapshotSMValues();
+    // Notice: current values are not logged on each poll anymore, as this \
+    //   blocks the loop once the UART buffer is full (type '@v' instead)
   }
 
   bool tickTaskSM() {
-    // High-priority tasks
+    // Plan still being streamed? (not converged yet)
+    if (planCursor < plan.size) {
+      return false;
+    }
 
-    // [HIGH] Priority #1: Converge active mode?
-    if (hkActive->getVal() != smActive) {
-      LOG1("[Service:AirConditionerRemote] (sm : high) Active +1 (hk=%d / sm=%d)\n", hkActive->getVal(), smActive);
+    // Plan all the IR commands required to converge at once
+    uint8_t currentValues[STORAGE_SIZE],
+            targetValues[STORAGE_SIZE];
+
+    snapshotStateMachineValues(currentValues);
 
-      // Update state
-      smActive = progressNextState(STATES_DIRECTION_ACTIVE, SIZE_DIRECTION_ACTIVE, smActive, 1, true);
+    memcpy(targetValues, requestedValues, STORAGE_SIZE);
 
-      // Save state
-      writeEEPROM(EEPROM_ADDRESS_SM_ACTIVE, smActive);
+    // Clear values that were converged to (ie. by the previous plan)
+    for (unsigned int index = 0; index < STORAGE_SIZE; index++) {
+      if (currentValues[index] == targetValues[index]) {
+        dirtyMask &= ~(1 << index);
+      }
+    }
 
-      // Send IR signal
-      emitInfraRedWord(IR_COMMAND_SWITCH_POWER);
+    // Notice: only dirty values get planned, as all others have converged
+    planConvergence(plan, currentValues, targetValues, dirtyMask);
 
-      return false;
+    planCursor = 0;
+
+    // Has converged? (nothing to do, or nothing that can be done yet)
+    if (plan.size == 0) {
+      if (hasUnconvergedUpdate == true) {
+        hasUnconvergedUpdate = false;
+
+        trace.record(TRACE_EVENT_SM_CONVERGED, dirtyMask, millis() - lastUpdateMillis);
+      }
+
+      return true;
     }
 
-    // [HIGH] Priority #2: Converge target mode?
-    if (hkTargetHeaterCoolerState->getVal() != smTargetHeaterCoolerState) {
-      LOG1("[Service:AirConditionerRemote] (sm : high) Mode +1 (hk=%d / sm=%d)\n", hkTargetHeaterCoolerState->getVal(), smTargetHeaterCoolerState);
+    // Start streaming plan
+    planStartMillis = millis();
 
-      // Update state
-      smTargetHeaterCoolerState = progressNextState(STATES_DIRECTION_TARGET_HEATER_COOLER_STATE, SIZE_DIRECTION_TARGET_HEATER_COOLER_STATE, smTargetHeaterCoolerState, 1, true);
+    trace.record(TRACE_EVENT_SM_PLANNED, plan.size, plan.size * IR_FRAME_EVERY_MILLISECONDS);
 
-      // Save state
-      writeEEPROM(EEPROM_ADDRESS_SM_TARGET_HEATER_COOLER_STATE, smTargetHeaterCoolerState);
+    // Wake up emit task (streams the plan)
+    scheduler.wake(taskEmit, 0);
 
-      // Send IR signal
-      emitInfraRedWord(IR_COMMAND_SWITCH_MODE);
+    return false;
+  }
 
-      // Force-update current mode in HK? (converged)
-      if (smTargetHeaterCoolerState == hkTargetHeaterCoolerState->getVal()) {
-        // Apply current mode
-        int currentMode = convertTargetModeToCurrentMode(smActive, smTargetHeaterCoolerState);
+  void tickTaskEmit() {
+    InfraRedPlanStep &step = plan.steps[planCursor];
 
-        hkCurrentHeaterCoolerState->setVal(currentMode);
-      }
+    planCursor++;
 
-      return false;
+    trace.record(TRACE_EVENT_EMIT_COMMAND, step.command, step.value);
+
+    // Send IR signal + update state
+    // Notice: the intent gets saved once the frame is about to go on air \
+    //   (see acknowledgeInfraRedFrames()), not when it gets queued
+    if (emitInfraRedStep(step) == true) {
+      applyStateMachineValue(step.index, step.value);
     }
 
-    if (smActive == ACTIVE_ACTIVE && smTargetHeaterCoolerState > TARGET_HEATER_COOLER_STATE_AUTO) {
-      // Medium-priority tasks
+    // Plan fully queued? (wake up SM, which checks for convergence)
+    if (planCursor == plan.size) {
+      trace.record(TRACE_EVENT_EMIT_QUEUED, plan.size, millis() - planStartMillis);
 
-      // [MEDIUM] Priority #1: Converge cooling temperature?
-      if (smTargetHeaterCoolerState == TARGET_HEATER_COOLER_STATE_COOL && hkCoolingThresholdTemperature->getVal() != smCoolingThresholdTemperature) {
-        LOG1("[Service:AirConditionerRemote] (sm : medium) Cool temperature +1 (hk=%d / sm=%d)\n", hkCoolingThresholdTemperature->getVal(), smCoolingThresholdTemperature);
+      wakeStateMachine(SM_CONVERGE_EVERY_MILLISECONDS);
+    }
+  }
 
-        // Update state
-        int coolingIncrement = smCoolingThresholdTemperature < hkCoolingThresholdTemperature->getVal() ? 1 : -1;
+  void wakeStateMachine(unsigned long delayMillis) {
+    // Count the ticks a polling SM would have run while dormant
+    if (isStateMachineDormant == true) {
+      stateMachineTicksAvoidedCount += (millis() - stateMachineDormantMillis) / stateMachineDormantCadenceMillis;
 
-        smCoolingThresholdTemperature = progressNextState(STATES_COOLING_THRESHOLD_TEMPERATURE, SIZE_DIRECTION_COOLING_THRESHOLD_TEMPERATURE, smCoolingThresholdTemperature, coolingIncrement, false);
+      isStateMachineDormant = false;
+    }
 
-        // Save state
-        writeEEPROM(EEPROM_ADDRESS_SM_COOLING_THRESHOLD_TEMPERATURE, smCoolingThresholdTemperature);
+    scheduler.wake(taskSM, delayMillis);
+  }
 
-        // Send IR signal
-        emitInfraRedWord(coolingIncrement > 0 ? IR_COMMAND_TEMPERATURE_INCREASE : IR_COMMAND_TEMPERATURE_DECREASE);
+  void sleepStateMachine(unsigned int cadenceMillis) {
+    isStateMachineDormant = true;
+    stateMachineDormantMillis = millis();
+    stateMachineDormantCadenceMillis = cadenceMillis;
+  }
 
-        return false;
-      }
+  unsigned long countStateMachineTicksAvoided() {
+    // Notice: ticks avoided are only accounted for on wake up, thus add up \
+    //   those of the ongoing dormancy (if any)
+    if (isStateMachineDormant == false) {
+      return stateMachineTicksAvoidedCount;
+    }
 
-      // [MEDIUM] Priority #2: Converge heating temperature?
-      if (smTargetHeaterCoolerState == TARGET_HEATER_COOLER_STATE_HEAT && hkHeatingThresholdTemperature->getVal() != smHeatingThresholdTemperature) {
-        LOG1("[Service:AirConditionerRemote] (sm : medium) Heat temperature +1 (hk=%d / sm=%d)\n", hkHeatingThresholdTemperature->getVal(), smHeatingThresholdTemperature);
+    return stateMachineTicksAvoidedCount + (millis() - stateMachineDormantMillis) / stateMachineDormantCadenceMillis;
+  }
 
-        // Update state
-        int heatingIncrement = smHeatingThresholdTemperature < hkHeatingThresholdTemperature->getVal() ? 1 : -1;
+  void planConvergence(InfraRedPlan &plan, const uint8_t currentValues[], const uint8_t targetValues[], uint8_t mask) {
+    // Reset plan
+    plan.size = 0;
 
-        smHeatingThresholdTemperature = progressNextState(STATES_HEATING_THRESHOLD_TEMPERATURE, SIZE_DIRECTION_HEATING_THRESHOLD_TEMPERATURE, smHeatingThresholdTemperature, heatingIncrement, false);
+    // Acquire target values (ie. from HK)
+    unsigned int targetActiveValue = targetValues[STORAGE_INDEX_SM_ACTIVE],
+                 targetHeaterCoolerStateValue = targetValues[STORAGE_INDEX_SM_TARGET_HEATER_COOLER_STATE];
 
-        // Save state
-        writeEEPROM(EEPROM_ADDRESS_SM_HEATING_THRESHOLD_TEMPERATURE, smHeatingThresholdTemperature);
+    // High-priority tasks
 
-        // Send IR signal
-        emitInfraRedWord(heatingIncrement > 0 ? IR_COMMAND_TEMPERATURE_INCREASE : IR_COMMAND_TEMPERATURE_DECREASE);
+    // [HIGH] Priority #1: Converge active mode?
+    if ((mask & (1 << STORAGE_INDEX_SM_ACTIVE)) != 0) {
+      planCircleSteps<STATES_DIRECTION_ACTIVE>(plan, STORAGE_INDEX_SM_ACTIVE, CODEBOOK::IR_COMMAND_SWITCH_POWER, currentValues, targetValues);
+    }
 
-        return false;
+    // [HIGH] Priority #2: Converge target mode?
+    if ((mask & (1 << STORAGE_INDEX_SM_TARGET_HEATER_COOLER_STATE)) != 0) {
+      planCircleSteps<STATES_DIRECTION_TARGET_HEATER_COOLER_STATE>(plan, STORAGE_INDEX_SM_TARGET_HEATER_COOLER_STATE, CODEBOOK::IR_COMMAND_SWITCH_MODE, currentValues, targetValues);
+    }
+
+    // Notice: the following tasks only apply once the AC unit has converged \
+    //   to its active mode and target mode (ie. after the steps above)
+    if (targetActiveValue == ACTIVE_ACTIVE && targetHeaterCoolerStateValue > TARGET_HEATER_COOLER_STATE_AUTO) {
+      // Medium-priority tasks
+
+      // [MEDIUM] Priority #1: Converge cooling temperature?
+      if (targetHeaterCoolerStateValue == TARGET_HEATER_COOLER_STATE_COOL && (mask & (1 << STORAGE_INDEX_SM_COOLING_THRESHOLD_TEMPERATURE)) != 0) {
+        planRangeSteps<STATES_COOLING_THRESHOLD_TEMPERATURE>(plan, STORAGE_INDEX_SM_COOLING_THRESHOLD_TEMPERATURE, currentValues, targetValues);
+      }
+
+      // [MEDIUM] Priority #2: Converge heating temperature?
+      if (targetHeaterCoolerStateValue == TARGET_HEATER_COOLER_STATE_HEAT && (mask & (1 << STORAGE_INDEX_SM_HEATING_THRESHOLD_TEMPERATURE)) != 0) {
+        planRangeSteps<STATES_HEATING_THRESHOLD_TEMPERATURE>(plan, STORAGE_INDEX_SM_HEATING_THRESHOLD_TEMPERATURE, currentValues, targetValues);
       }
 
       // Low-priority tasks
 
       // [LOW] Priority #1: Converge swing mode?
-      if (hkSwingMode->getVal() != smSwingMode) {
-        LOG1("[Service:AirConditionerRemote] (sm : low) Swing +1 (hk=%d / sm=%d)\n", hkSwingMode->getVal(), smSwingMode);
+      if ((mask & (1 << STORAGE_INDEX_SM_SWING_MODE)) != 0) {
+        planCircleSteps<STATES_SWING_MODE>(plan, STORAGE_INDEX_SM_SWING_MODE, CODEBOOK::IR_COMMAND_TOGGLE_SWING, currentValues, targetValues);
+      }
+    }
+  }
+
+  void checkPlansFrom(const uint8_t startValues[]) {
+    uint8_t targetValues[STORAGE_SIZE];
+
+    memcpy(targetValues, startValues, STORAGE_SIZE);
+
+    // Walk all target values that HK can request
+    // Notice: thresholds and swing mode are only walked when they apply to \
+    //   the target mode, as they are left untouched otherwise
+    for (unsigned int active = ACTIVE_INACTIVE; active <= ACTIVE_ACTIVE; active++) {
+      for (unsigned int mode = TARGET_HEATER_COOLER_STATE_AUTO; mode <= TARGET_HEATER_COOLER_STATE_COOL; mode++) {
+        targetValues[STORAGE_INDEX_SM_ACTIVE] = active;
+        targetValues[STORAGE_INDEX_SM_TARGET_HEATER_COOLER_STATE] = mode;
+
+        if (active == ACTIVE_ACTIVE && mode > TARGET_HEATER_COOLER_STATE_AUTO) {
+          int index = (mode == TARGET_HEATER_COOLER_STATE_COOL) ? STORAGE_INDEX_SM_COOLING_THRESHOLD_TEMPERATURE : STORAGE_INDEX_SM_HEATING_THRESHOLD_TEMPERATURE;
+
+          unsigned int minimum = (mode == TARGET_HEATER_COOLER_STATE_COOL) ? CODEBOOK::RANGE_TEMPERATURE_COOL_MINIMUM : CODEBOOK::RANGE_TEMPERATURE_HEAT_MINIMUM,
+                       maximum = (mode == TARGET_HEATER_COOLER_STATE_COOL) ? CODEBOOK::RANGE_TEMPERATURE_COOL_MAXIMUM : CODEBOOK::RANGE_TEMPERATURE_HEAT_MAXIMUM,
+                       step = (mode == TARGET_HEATER_COOLER_STATE_COOL) ? CODEBOOK::RANGE_TEMPERATURE_COOL_STEP : CODEBOOK::RANGE_TEMPERATURE_HEAT_STEP;
+
+          // Notice: HK only requests temperatures on the range step
+          for (unsigned int temperature = minimum; temperature <= maximum; temperature += step) {
+            for (unsigned int swingMode = ACTIVE_SWING_MODE_DISABLED; swingMode <= ACTIVE_SWING_MODE_ENABLED; swingMode++) {
+              targetValues[index] = temperature;
+              targetValues[STORAGE_INDEX_SM_SWING_MODE] = swingMode;
+
+              checkPlan(startValues, targetValues);
+            }
+          }
+
+          // Restore untouched values
+          targetValues[index] = startValues[index];
+          targetValues[STORAGE_INDEX_SM_SWING_MODE] = startValues[STORAGE_INDEX_SM_SWING_MODE];
+        } else {
+          checkPlan(startValues, targetValues);
+        }
+      }
+    }
+  }
 
-        // Update state
-        smSwingMode = progressNextState(STATES_SWING_MODE, SIZE_DIRECTION_SWING_MODE, smSwingMode, 1, true);
+  void checkPlan(const uint8_t startValues[], const uint8_t targetValues[]) {
+    InfraRedPlan checkedPlan;
+    AirConditionerUnit<PROFILE> unit;
 
-        // Save state
-        writeEEPROM(EEPROM_ADDRESS_SM_SWING_MODE, smSwingMode);
+    bool isConverged = true;
 
-        // Send IR signal
-        emitInfraRedWord(IR_COMMAND_TOGGLE_SWING);
+    memcpy(unit.values, startValues, STORAGE_SIZE);
 
-        return false;
+    // Emit planned commands to the AC unit model (the SM must track it)
+    planConvergence(checkedPlan, startValues, targetValues, STORAGE_MASK_ALL);
+
+    unsigned int framesCount = checkedPlan.size;
+
+    for (unsigned int i = 0; i < checkedPlan.size; i++) {
+      InfraRedPlanStep &step = checkedPlan.steps[i];
+
+      if (unit.receive(step.command) == false || unit.values[step.index] != step.value) {
+        isConverged = false;
       }
     }
 
-    // Has converged (nothing to do)
-    return true;
+    // Plan again from the AC unit model (nothing should be left to do, and \
+    //   the AC unit must show the target values)
+    planConvergence(checkedPlan, unit.values, targetValues, STORAGE_MASK_ALL);
+
+    if (checkedPlan.size > 0 || memcmp(unit.values, targetValues, STORAGE_SIZE) != 0) {
+      isConverged = false;
+    }
+
+    // Account for check results
+    checkPairsCount++;
+    checkFramesTotal += framesCount;
+    checkFramesMaximum = max(checkFramesMaximum, framesCount);
+    checkFramesCounts[min(framesCount, IR_PLAN_CAPACITY)]++;
+
+    if (isConverged == false) {
+      checkFailuresCount++;
+
+      if (checkFailuresCount <= CHECK_FAILURES_LOGGED) {
+        LOG_AT(CHECK, 0, "[Service:AirConditionerRemote] (check) Plan did not converge! From [%d, %d, %d, %d, %d] to [%d, %d, %d, %d, %d] (got: [%d, %d, %d, %d, %d])\n", startValues[0], startValues[1], startValues[2], startValues[3], startValues[4], targetValues[0], targetValues[1], targetValues[2], targetValues[3], targetValues[4], unit.values[0], unit.values[1], unit.values[2], unit.values[3], unit.values[4]);
+      }
+    }
   }
 
-  unsigned int progressNextState(unsigned int statesCircle[], unsigned int statesCircleSize, unsigned int currentState, int increment, bool circle) {
-    // Acquire index of current state in array
-    int currentStateIndex = -1;
+  void printPlansCheckReport() {
+    unsigned long framesMean = (checkPairsCount > 0) ? (checkFramesTotal * 1000 / checkPairsCount) : 0;
 
-    for (int i = 0; i < statesCircleSize; i++) {
-      // Position found?
-      if (currentState == statesCircle[i]) {
-        currentStateIndex = i;
+    Serial.printf("\n*** Plans Check ***\n\n");
+    Serial.printf("Checked %u start and target value pairs in %lums: %u did not converge (%s)\n\n", checkPairsCount, millis() - checkStartMillis, checkFailuresCount, (checkFailuresCount == 0) ? "PASS" : "FAIL");
+    Serial.printf("IR frames per plan: mean %lu.%03lu, max %u\n", framesMean / 1000, framesMean % 1000, checkFramesMaximum);
+    Serial.printf("Time to converge after update: mean %lums, max %ums\n\n", SM_WAKE_UP_EVERY_MILLISECONDS + (framesMean * IR_FRAME_EVERY_MILLISECONDS) / 1000, SM_WAKE_UP_EVERY_MILLISECONDS + checkFramesMaximum * IR_FRAME_EVERY_MILLISECONDS);
 
-        break;
+    // Dump IR frames per plan distribution
+    for (unsigned int i = 0; i <= IR_PLAN_CAPACITY; i++) {
+      if (checkFramesCounts[i] > 0) {
+        Serial.printf("  %2u frames = %u plans\n", i, checkFramesCounts[i]);
       }
     }
 
-    // State not found? This is not expected!
-    if (currentStateIndex < 0) {
-      LOG0("[Service:AirConditionerRemote] (error) State not found in circle! This is not expected?\n");
+    Serial.printf("\n");
+  }
 
-      // Fallback to first available value
-      return statesCircle[0];
+  template <typename STATES>
+  void planCircleSteps(InfraRedPlan &plan, int index, int command, const uint8_t currentValues[], const uint8_t targetValues[]) {
+    unsigned int currentState = currentValues[index],
+                 targetState = targetValues[index];
+
+    // Target state not known? Cannot converge to it
+    if (STATES::contains(targetState) == false) {
+      LOG_AT(SERVICE, 0, "[Service:AirConditionerRemote] (error) Target state %d not found in circle! This is not expected?\n", targetState);
+
+      return;
     }
 
-    // Acquire next state (index = n+1 or 0)
-    unsigned int nextStateIndex = currentStateIndex + increment;
+    // Walk the circle up to the target state (1 command per step)
+    unsigned int steps = (STATES::index(targetState) + STATES::SIZE - STATES::index(currentState)) % STATES::SIZE,
+                 nextState = currentState;
+
+    for (unsigned int i = 0; i < steps; i++) {
+      nextState = STATES::progress(nextState, 1);
+
+      appendPlanStep(plan, command, index, nextState);
+    }
+  }
+
+  template <typename STATES>
+  void planRangeSteps(InfraRedPlan &plan, int index, const uint8_t currentValues[], const uint8_t targetValues[]) {
+    unsigned int currentState = currentValues[index],
+                 targetState = targetValues[index];
+
+    // Target state not known? Cannot converge to it
+    if (STATES::contains(targetState) == false) {
+      LOG_AT(SERVICE, 0, "[Service:AirConditionerRemote] (error) Target state %d not found in range! This is not expected?\n", targetState);
 
-    if (nextStateIndex >= statesCircleSize) {
-      nextStateIndex = (circle == true) ? 0 : (statesCircleSize - 1);
-    } else if (nextStateIndex < 0) {
-      nextStateIndex = (circle == true) ? (statesCircleSize - 1) : 0;
+      return;
     }
 
-    return statesCircle[nextStateIndex];
+    // Walk the range up or down to the target state (1 command per step)
+    int steps = (int)STATES::index(targetState) - (int)STATES::index(currentState),
+        increment = steps > 0 ? 1 : -1;
+
+    unsigned int nextState = currentState;
+
+    for (int i = 0; i != steps; i += increment) {
+      nextState = STATES::progress(nextState, increment);
+
+      appendPlanStep(plan, increment > 0 ? CODEBOOK::IR_COMMAND_TEMPERATURE_INCREASE : CODEBOOK::IR_COMMAND_TEMPERATURE_DECREASE, index, nextState);
+    }
   }
 
-  void configureEEPROM() {
-    EEPROM.begin(sizeof(int) * EEPROM_SIZE);
+  void appendPlanStep(InfraRedPlan &plan, int command, int index, unsigned int value) {
+    // Plan is full? This is not expected!
+    if (plan.size >= IR_PLAN_CAPACITY) {
+      LOG_AT(SERVICE, 0, "[Service:AirConditionerRemote] (error) IR plan is full! This is not expected?\n");
+
+      return;
+    }
+
+    plan.steps[plan.size].command = command;
+    plan.steps[plan.size].index = index;
+    plan.steps[plan.size].value = value;
+
+    plan.size++;
   }
 
-  void configureSensorTemperature() {
-    dht.begin();
+  void applyStateMachineValue(int index, unsigned int value) {
+    switch (index) {
+      case STORAGE_INDEX_SM_ACTIVE:
+        smActive = value;
+        break;
+
+      case STORAGE_INDEX_SM_TARGET_HEATER_COOLER_STATE:
+        smTargetHeaterCoolerState = value;
+        break;
+
+      case STORAGE_INDEX_SM_COOLING_THRESHOLD_TEMPERATURE:
+        smCoolingThresholdTemperature = value;
+        break;
+
+      case STORAGE_INDEX_SM_HEATING_THRESHOLD_TEMPERATURE:
+        smHeatingThresholdTemperature = value;
+        break;
+
+      case STORAGE_INDEX_SM_SWING_MODE:
+        smSwingMode = value;
+        break;
+    }
+
+    // Force-update current mode in HK? (target mode converged)
+    if (index == STORAGE_INDEX_SM_TARGET_HEATER_COOLER_STATE && smTargetHeaterCoolerState == requestedValues[STORAGE_INDEX_SM_TARGET_HEATER_COOLER_STATE]) {
+      // Apply current mode (from HomeSpan task)
+      int currentMode = convertTargetModeToCurrentMode(smActive, smTargetHeaterCoolerState);
+
+      pushReading(SERVICE_READING_TYPE_CURRENT_HEATER_COOLER_STATE, currentMode);
+    }
   }
 
-  void configureInfraRed() {
-    IrSender.begin(IR_PIN_PWM);
+  void configureScheduler() {
+    // Notice: the scheduler is shared w/ other AC units (begun by the bridge)
+    taskEmit = scheduler.add("emit", TASK_PRIORITY_EMIT, this, &AirConditionerRemote::runTaskEmit, SCHEDULER_DELAY_NEVER, TASK_BUDGET_EMIT_MICROSECONDS);
+    taskSM = scheduler.add("sm", TASK_PRIORITY_SM, this, &AirConditionerRemote::runTaskSM, SM_CONVERGE_EVERY_MILLISECONDS, TASK_BUDGET_SM_MICROSECONDS);
+    taskCommit = scheduler.add("commit", TASK_PRIORITY_COMMIT, this, &AirConditionerRemote::runTaskCommit, COMMIT_EVERY_MILLISECONDS, TASK_BUDGET_COMMIT_MICROSECONDS);
+    taskPoll = scheduler.add("poll", TASK_PRIORITY_POLL, this, &AirConditionerRemote::runTaskPoll, POLL_EVERY_MILLISECONDS, TASK_BUDGET_POLL_MICROSECONDS);
+    taskCheck = scheduler.add("check", TASK_PRIORITY_CHECK, this, &AirConditionerRemote::runTaskCheck, SCHEDULER_DELAY_NEVER, TASK_BUDGET_CHECK_MICROSECONDS);
+  }
+
+  void printCurrentValues() {
+    Serial.printf("[Service:AirConditionerRemote] Current HomeKit values are (unit #%u):\n", unitIndex);
+    logSnapshotHKValues();
+    Serial.printf("[Service:AirConditionerRemote] Current state machine values are (unit #%u):\n", unitIndex);
+    logSnapshotSMValues();
+    Serial.printf("[Service:AirConditionerRemote] Current thermometer values are (unit #%u):\n", unitIndex);
+    logSnapshotThermometerValues();
+    Serial.printf("[Service:AirConditionerRemote] Current journal values are (unit #%u):\n", unitIndex);
+    logSnapshotJournalValues();
+  }
+
+  bool startPlansCheck() {
+    ServiceCommand command;
+
+    // Notice: user commands run on the HomeSpan task, thus the check gets \
+    //   started from the device task
+    command.type = SERVICE_COMMAND_TYPE_CHECK;
+
+    return commands.push(command);
+  }
+
+  void beginPlansCheck() {
+    // Reset check statistics
+    checkCursor = 0;
+    checkStartMillis = millis();
+    checkPairsCount = 0;
+    checkFailuresCount = 0;
+    checkFramesMaximum = 0;
+    checkFramesTotal = 0;
+
+    memset(checkFramesCounts, 0, sizeof(checkFramesCounts));
+
+    Serial.printf("\nChecking plans for all start and target values, in the background...\n\n");
+
+    scheduler.wake(taskCheck, 0);
+  }
+
+  void printRuntimeStatistics() {
+    SchedulerHistogram &histogram = pollCadenceHistogram;
+
+    Serial.printf("Unit #%u, HomeSpan task (core %d):\n", unitIndex, HOMESPAN_TASK_CORE);
+    Serial.printf("  - Polls = %u\n", histogram.samplesCount);
+    Serial.printf("  - Poll Cadence = mean %uµs, p50 %uµs, p90 %uµs, p99 %uµs, max %uµs\n", histogram.mean(), histogram.percentile(50), histogram.percentile(90), histogram.percentile(99), histogram.maximum);
+    histogram.printBuckets("µs");
+    Serial.printf("  - Update Time = mean %uµs, max %uµs (%u updates)\n", updateHistogram.mean(), updateHistogram.maximum, updateHistogram.samplesCount);
+    Serial.printf("  - Dropped Readings = %u\n", (unsigned int)readings.dropsCount);
+    Serial.printf("  - Dropped Commands = %u\n", (unsigned int)commands.dropsCount);
+    Serial.printf("  - Journal = %u boosts (%lums)\n", journal.powerLock.acquiresCount, journal.powerLock.heldMillis);
+  }
+
+  void configureStorage() {
+    // Notice: each AC unit journals to its own region of the partition
+    if (journal.begin(unitIndex) == false) {
+      LOG_AT(SERVICE, 0, "[Service:AirConditionerRemote] (init) Error configuring storage of AC unit #%u! Its values will not survive reboots (flash the sketch w/ its partitions.csv).\n", unitIndex);
+    }
+  }
+
+  void configureSensorTemperature(Thermometer *sensor) {
+    // Notice: temperature gets captured in the background, at poll rate \
+    //   (the sensor might be shared w/ other AC units, eg. in the same room)
+    temperatureSensor = sensor;
+  }
+
+  void configureInfraRed(int irPin) {
+    irChannel = irTransmitter.addChannel(irPin);
   }
 
   float acquireTemperatureValue() {
-    // Read temperature on DHT sensor
-    float temperature = dht.readTemperature();
+    ThermometerReading reading;
 
-    // Invalid temperature acquired?
-    if (isnan(temperature) == true) {
+    // Read latest temperature captured from DHT sensor (never blocks)
+    if (temperatureSensor->read(reading) == false) {
+      return -1.0;
+    }
+
+    // Outdated temperature acquired? (ie. latest captures failed)
+    if ((millis() - reading.capturedMillis) > (2 * POLL_EVERY_MILLISECONDS)) {
       return -1.0;
     }
 
     // Valid temperature acquired
-    return temperature;
+    return reading.temperature;
   }
 
-  void emitInfraRedWord(int word) {
-    IrSender.sendNEC(IR_ADDRESS, word, 1);
+  bool emitInfraRedStep(InfraRedPlanStep &step) {
+    // Queue IR frame (it will be sent in the background, once armed)
+    if (irTransmitter.enqueueNEC(irChannel, CODEBOOK::IR_ADDRESS, step.command, false) == false) {
+      LOG_AT(SERVICE, 0, "[Service:AirConditionerRemote] (error) IR queue is full! Dropped command 0x%02X\n", step.command);
+
+      return false;
+    }
+
+    // Track step until its IR frame is sent
+    inflightSteps[(inflightHead + inflightSize) % IR_QUEUE_CAPACITY] = step;
+    inflightSize++;
+
+    return true;
+  }
+
+  void acknowledgeInfraRedFrames() {
+    // Notice: IR frames are sent in the order they were queued, and a frame \
+    //   counts as sent once its data part was sent
+    while (acknowledgedFramesCount != irTransmitter.channels[irChannel].framesSent && inflightSize > 0) {
+      InfraRedPlanStep &step = inflightSteps[inflightHead];
+
+      inflightHead = (inflightHead + 1) % IR_QUEUE_CAPACITY;
+      inflightSize--;
+
+      acknowledgedFramesCount++;
+
+      // Save completion
+      writeCompletion(step);
+    }
+
+    // Next IR frame is ours, and about to go on air? (save intent, then \
+    //   let it go, thus a single intent is ever pending)
+    if (inflightSize > 0 && irTransmitter.isAwaitingArm(irChannel) == true) {
+      writeIntent(inflightSteps[inflightHead]);
+
+      irTransmitter.arm();
+    }
   }
 
   int convertTargetModeToCurrentMode(int active, int targetMode) {
@@ -534,41 +1212,344 @@ struct AirConditionerRemote : Service::HeaterCooler {
     return currentMode;
   }
 
-  unsigned int readEEPROMOrDefault(int address, unsigned int defaultValue) {
-    unsigned int savedValue = EEPROM.read(address);
+  void readLegacyEEPROM(uint8_t values[]) {
+    EEPROM.begin(sizeof(int) * STORAGE_SIZE);
+
+    for (int index = 0; index < STORAGE_SIZE; index++) {
+      values[index] = EEPROM.read(index);
+    }
 
-    // Value empty? (ie. EEPROM is empty)
+    EEPROM.end();
+  }
+
+  template <typename STATES>
+  unsigned int readStateOrDefault(uint8_t values[], int index, unsigned int defaultValue) {
+    unsigned int savedValue = values[index];
+
+    // Value empty? (ie. ROM is empty)
     if (savedValue == 255) {
       return defaultValue;
     }
 
-    // Value is set (ie. EEPROM has data)
+    // Value is not a known state? (ie. ROM is corrupted)
+    if (STATES::contains(savedValue) == false) {
+      LOG_AT(SERVICE, 0, "[Service:AirConditionerRemote] (error) Saved state %d at index %d is unknown! Using default.\n", savedValue, index);
+
+      return defaultValue;
+    }
+
+    // Value is a known state (ie. ROM has data)
     return savedValue;
   }
 
-  void writeEEPROM(int address, unsigned int value) {
-    // Force the SM to update later on + schedule commit
-    lastLoopCommitMillis = millis();
-    hasUncommitedEEPROMChanges = true;
+  void snapshotHomeKitValues(uint8_t values[]) {
+    // Notice: new values are the updated ones, if within an update (or \
+    //   the current ones otherwise)
+    values[STORAGE_INDEX_SM_ACTIVE] = hkActive->getNewVal();
+    values[STORAGE_INDEX_SM_TARGET_HEATER_COOLER_STATE] = hkTargetHeaterCoolerState->getNewVal();
+    values[STORAGE_INDEX_SM_COOLING_THRESHOLD_TEMPERATURE] = hkCoolingThresholdTemperature->getNewVal();
+    values[STORAGE_INDEX_SM_HEATING_THRESHOLD_TEMPERATURE] = hkHeatingThresholdTemperature->getNewVal();
+    values[STORAGE_INDEX_SM_SWING_MODE] = hkSwingMode->getNewVal();
+  }
+
+  uint8_t snapshotUpdatedHomeKitValues() {
+    uint8_t mask = 0;
 
-    // Write new value
-    EEPROM.write(address, value);
+    // Notice: this is to be called within an update only
+    if (hkActive->updated() == true) {
+      mask |= (1 << STORAGE_INDEX_SM_ACTIVE);
+    }
+
+    if (hkTargetHeaterCoolerState->updated() == true) {
+      mask |= (1 << STORAGE_INDEX_SM_TARGET_HEATER_COOLER_STATE);
+    }
+
+    if (hkCoolingThresholdTemperature->updated() == true) {
+      mask |= (1 << STORAGE_INDEX_SM_COOLING_THRESHOLD_TEMPERATURE);
+    }
+
+    if (hkHeatingThresholdTemperature->updated() == true) {
+      mask |= (1 << STORAGE_INDEX_SM_HEATING_THRESHOLD_TEMPERATURE);
+    }
+
+    if (hkSwingMode->updated() == true) {
+      mask |= (1 << STORAGE_INDEX_SM_SWING_MODE);
+    }
+
+    return mask;
+  }
+
+  void snapshotStateMachineValues(uint8_t values[]) {
+    values[STORAGE_INDEX_SM_ACTIVE] = smActive;
+    values[STORAGE_INDEX_SM_TARGET_HEATER_COOLER_STATE] = smTargetHeaterCoolerState;
+    values[STORAGE_INDEX_SM_COOLING_THRESHOLD_TEMPERATURE] = smCoolingThresholdTemperature;
+    values[STORAGE_INDEX_SM_HEATING_THRESHOLD_TEMPERATURE] = smHeatingThresholdTemperature;
+    values[STORAGE_INDEX_SM_SWING_MODE] = smSwingMode;
+  }
+
+  void writeIntent(InfraRedPlanStep &step) {
+    uint8_t values[STORAGE_SIZE];
+
+    // Intent values are the stored values once the step is applied (the \
+    //   SM values are ahead, as they include all queued steps)
+    memcpy(values, storedValues, STORAGE_SIZE);
+
+    values[step.index] = step.value;
+
+    // Notice: the completion must never wait on a sector erase, as the AC \
+    //   unit already has the command by then (erase ahead, if needed)
+    journal.prepare(2);
+    journal.append(JOURNAL_RECORD_TYPE_INTENT, step.command, values);
+
+    // Postpone commit tasks (do not compact while emitting)
+    scheduler.wake(taskCommit, COMMIT_EVERY_MILLISECONDS);
+  }
+
+  void writeCompletion(InfraRedPlanStep &step) {
+    storedValues[step.index] = step.value;
+
+    journal.append(JOURNAL_RECORD_TYPE_COMPLETION, step.command, storedValues);
+
+    // Postpone commit tasks (do not compact while emitting)
+    scheduler.wake(taskCommit, COMMIT_EVERY_MILLISECONDS);
   }
 
   void logSnapshotHKValues() {
-    LOG1("  - Active = %d\n", hkActive->getVal());
-    LOG1("  - Current Heater Cooler State = %d\n", hkCurrentHeaterCoolerState->getVal());
-    LOG1("  - Target Heater Cooler State = %d\n", hkTargetHeaterCoolerState->getVal());
-    LOG1("  - Cooling Threshold Temperature = %d°C\n", hkCoolingThresholdTemperature->getVal());
-    LOG1("  - Heating Threshold Temperature = %d°C\n", hkHeatingThresholdTemperature->getVal());
-    LOG1("  - Swing Mode = %d\n", hkSwingMode->getVal());
+    Serial.printf("  - Active = %d\n", hkActive->getVal());
+    Serial.printf("  - Current Heater Cooler State = %d\n", hkCurrentHeaterCoolerState->getVal());
+    Serial.printf("  - Target Heater Cooler State = %d\n", hkTargetHeaterCoolerState->getVal());
+    Serial.printf("  - Cooling Threshold Temperature = %d°C\n", hkCoolingThresholdTemperature->getVal());
+    Serial.printf("  - Heating Threshold Temperature = %d°C\n", hkHeatingThresholdTemperature->getVal());
+    Serial.printf("  - Swing Mode = %d\n", hkSwingMode->getVal());
+    Serial.printf("  - Current Temperature = %.1f°C (%d published, %d suppressed)\n", hkCurrentTemperaturePublisher.publishedValue, hkCurrentTemperaturePublisher.publishesCount, hkCurrentTemperaturePublisher.suppressionsCount);
   }
 
   void logSnapshotSMValues() {
-    LOG1("  - Active = %d\n", smActive);
-    LOG1("  - Target Heater Cooler State = %d\n", smTargetHeaterCoolerState);
-    LOG1("  - Cooling Threshold Temperature = %d°C\n", smCoolingThresholdTemperature);
-    LOG1("  - Heating Threshold Temperature = %d°C\n", smHeatingThresholdTemperature);
-    LOG1("  - Swing Mode = %d\n", smSwingMode);
+    Serial.printf("  - Active = %d\n", smActive);
+    Serial.printf("  - Target Heater Cooler State = %d\n", smTargetHeaterCoolerState);
+    Serial.printf("  - Cooling Threshold Temperature = %d°C\n", smCoolingThresholdTemperature);
+    Serial.printf("  - Heating Threshold Temperature = %d°C\n", smHeatingThresholdTemperature);
+    Serial.printf("  - Swing Mode = %d\n", smSwingMode);
+    Serial.printf("  - Dirty Values = 0x%02X\n", dirtyMask);
+    Serial.printf("  - Ticks Avoided = %lu (%s)\n", countStateMachineTicksAvoided(), isStateMachineDormant == true ? "dormant" : "awake");
+  }
+
+  void logSnapshotThermometerValues() {
+    ThermometerReading reading;
+
+    unsigned int capturesCount = temperatureSensor->capturesCount;
+
+    if (temperatureSensor->read(reading) == true) {
+      Serial.printf("  - Last Capture Duration = %luµs\n", reading.durationMicros);
+    }
+
+    Serial.printf("  - Captures = %d\n", capturesCount);
+    Serial.printf("  - Checksum Failures = %d (%.1f%%)\n", (unsigned int)temperatureSensor->checksumFailuresCount, (capturesCount > 0) ? (100.0 * temperatureSensor->checksumFailuresCount / capturesCount) : 0.0);
+    Serial.printf("  - Timeouts = %d\n", (unsigned int)temperatureSensor->timeoutsCount);
+    Serial.printf("  - Loop Time Saved = %dms\n", (unsigned int)temperatureSensor->capturesMillis);
+  }
+
+  void logSnapshotJournalValues() {
+    if (journal.partition == NULL) {
+      Serial.printf("  - Region = none (values are not saved)\n");
+    } else {
+      Serial.printf("  - Region = #%u (offset 0x%X, %u bytes)\n", unitIndex, journal.regionOffset, journal.regionSize);
+    }
+
+    Serial.printf("  - Appends = %d\n", journal.appendsCount);
+    Serial.printf("  - Erases = %d\n", journal.erasesCount);
+    Serial.printf("  - Sector Wear = %d cycles\n", journal.estimateSectorWear());
+    Serial.printf("  - Last Commit Latency = %luµs\n", journal.lastCommitMicros);
+    Serial.printf("  - Maximum Commit Latency = %luµs\n", journal.maximumCommitMicros);
+  }
+};
+
+struct AirConditionerBridge {
+  /**
+    [Bridge]
+
+      - Bridges multiple AC units (eg. one per room) to HomeKit from a single
+        controller, where each unit has its own IR LED, journal region and
+        state machine, while the device task, the scheduler, the thermometer
+        and the IR transmitter are shared
+
+      - The device task runs the most urgent task across all units, and IR
+        frames of all units go through the single transmitter queue, which
+        routes each frame to the IR LED of its unit, thus frames destined to
+        different units never overlap (the queue acts as the arbiter)
+  **/
+
+  AirConditionerRemote<AC_PROFILE> *units[BRIDGE_UNITS_CAPACITY];
+
+  // Heap taken by each AC unit (its state, its HomeKit accessory and \
+  //   characteristics), as measured by the sketch
+  uint32_t unitsHeapBytes[BRIDGE_UNITS_CAPACITY];
+
+  unsigned int unitsCount = 0;
+
+  int deviceCore = -1;
+
+  // Device task pass time (w/o idles), ie. the HomeSpan poll cadence if \
+  //   HomeSpan still ran on the same core (as before both were split)
+  SchedulerHistogram devicePassHistogram = {};
+
+  void begin() {
+    // Notice: the CPU runs at its minimum frequency, unless latency-critical \
+    //   work is in progress (IR frames, DHT capture, journal commit)
+    power.begin();
+
+    trace.begin(TRACE_EVENT_FORMATS, TRACE_EVENTS_COUNT);
+
+    irTransmitter.begin(IR_FRAME_GAP_MILLISECONDS);
+
+    scheduler.begin();
+
+    // Notice: temperature gets captured in the background, at poll rate
+    thermometer.begin(SENSOR_TEMPERATURE_PIN, SENSOR_TEMPERATURE_DHT_TYPE, POLL_EVERY_MILLISECONDS);
+
+    // Register trace command (type '@t' in the serial console)
+    new SpanUserCommand('t', "- print trace of latest events", printTrace, this);
+
+    // Register trace dump command (type '@d' in the serial console)
+    new SpanUserCommand('d', "- dump trace of latest events (hex, decoded on a host)", dumpTrace, this);
+
+    // Register current values command (type '@v' in the serial console)
+    new SpanUserCommand('v', "- print current values", printCurrentValues, this);
+
+    // Register task statistics command (type '@s' in the serial console)
+    new SpanUserCommand('s', "- print task statistics", printTaskStatistics, this);
+
+    // Register plans check command (type '@c' in the serial console)
+    new SpanUserCommand('c', "- check IR plans against a model of the AC unit", startPlansCheck, this);
+  }
+
+  void add(AirConditionerRemote<AC_PROFILE> *unit, uint32_t heapBytes = 0) {
+    if (unitsCount >= BRIDGE_UNITS_CAPACITY) {
+      LOG_AT(SERVICE, 0, "[Service:AirConditionerBridge] Error adding AC unit #%u! Cannot bridge more than %u units.\n", unitsCount, BRIDGE_UNITS_CAPACITY);
+
+      return;
+    }
+
+    unitsHeapBytes[unitsCount] = heapBytes;
+    units[unitsCount++] = unit;
+  }
+
+  void runDevice() {
+    // Notice: this runs on the device task (ie. the Arduino loop task, on \
+    //   the core that does not run HomeSpan)
+    deviceCore = xPortGetCoreID();
+
+    unsigned long startMicros = micros();
+
+    // Apply commands from the HomeSpan task
+    for (unsigned int index = 0; index < unitsCount; index++) {
+      units[index]->applyCommands();
+    }
+
+    // Clock out queued IR frames (never blocks)
+    irTransmitter.tick();
+
+    // Acknowledge IR frames that were fully sent
+    for (unsigned int index = 0; index < unitsCount; index++) {
+      units[index]->acknowledgeInfraRedFrames();
+    }
+
+    // Run the most urgent due task (if any, whichever unit it belongs to)
+    bool hasRun = scheduler.run();
+
+    devicePassHistogram.record(micros() - startMicros);
+
+    if (hasRun == true) {
+      return;
+    }
+
+    // Idle until the next task is due, or until woken up by the HomeSpan \
+    //   task (the chip light sleeps if the other core idles as well)
+    // Notice: while IR frames are queued, the transmitter gets ticked when \
+    //   the frame on air ends and when the next one can start
+    unsigned long idleMillis = min(scheduler.millisUntilNextDeadline(), irTransmitter.millisUntilNextTick());
+
+    power.idle(idleMillis);
+  }
+
+  static void printTaskStatistics(const char *buffer, void *context) {
+    AirConditionerBridge *bridge = (AirConditionerBridge *)context;
+
+    scheduler.printStatistics();
+    bridge->printRuntimeStatistics();
+  }
+
+  static void printTrace(const char *buffer, void *context) {
+    trace.print();
+  }
+
+  static void dumpTrace(const char *buffer, void *context) {
+    trace.dump();
+  }
+
+  static void printCurrentValues(const char *buffer, void *context) {
+    AirConditionerBridge *bridge = (AirConditionerBridge *)context;
+
+    Serial.printf("\n*** Current Values ***\n\n");
+
+    for (unsigned int index = 0; index < bridge->unitsCount; index++) {
+      bridge->units[index]->printCurrentValues();
+    }
+
+    Serial.printf("[Service:AirConditionerBridge] Current IR transmitter values are:\n");
+    bridge->logSnapshotTransmitterValues();
+    Serial.printf("[Service:AirConditionerBridge] Current scheduler values are:\n");
+    scheduler.logSnapshot();
+  }
+
+  static void startPlansCheck(const char *buffer, void *context) {
+    AirConditionerBridge *bridge = (AirConditionerBridge *)context;
+
+    // Notice: plans are the same for all units, thus the first unit checks \
+    //   them (against a model, thus nothing gets emitted)
+    if (bridge->unitsCount > 0 && bridge->units[0]->startPlansCheck() == true) {
+      power.wake();
+    }
+  }
+
+  void printRuntimeStatistics() {
+    Serial.printf("*** Runtime Statistics ***\n\n");
+
+    for (unsigned int index = 0; index < unitsCount; index++) {
+      units[index]->printRuntimeStatistics();
+    }
+
+    Serial.printf("Device task (core %d):\n", deviceCore);
+    Serial.printf("  - Passes = %u\n", devicePassHistogram.samplesCount);
+    Serial.printf("  - Pass Time = mean %uµs, p50 %uµs, p90 %uµs, p99 %uµs, max %uµs\n", devicePassHistogram.mean(), devicePassHistogram.percentile(50), devicePassHistogram.percentile(90), devicePassHistogram.percentile(99), devicePassHistogram.maximum);
+    Serial.printf("  - Idle = %lums (%u idles, %u woken up by HomeSpan)\n", power.idleMillis, power.idlesCount, power.wakesCount);
+    Serial.printf("  - Wake Latency = mean %uµs, p50 %uµs, p99 %uµs, max %uµs (%u wakes at deadline)\n", power.wakeLatencyHistogram.mean(), power.wakeLatencyHistogram.percentile(50), power.wakeLatencyHistogram.percentile(99), power.wakeLatencyHistogram.maximum, power.wakeLatencyHistogram.samplesCount);
+    Serial.printf("Power (%s, %s):\n", (power.isScaling == true) ? "frequency scaling" : "fixed frequency", (power.isLightSleeping == true) ? "light sleep" : "no light sleep");
+    Serial.printf("  - Uptime = %lums\n", millis());
+    Serial.printf("  - IR Transmitter = %u boosts (%lums)\n", irTransmitter.powerLock.acquiresCount, irTransmitter.powerLock.heldMillis);
+    Serial.printf("  - Thermometer = %u boosts (%lums)\n", thermometer.powerLock.acquiresCount, thermometer.powerLock.heldMillis);
+
+    Serial.printf("Memory footprint:\n");
+    Serial.printf("  - Per Unit = %u bytes of state (%u units bridged)\n", (unsigned int)sizeof(AirConditionerRemote<AC_PROFILE>), unitsCount);
+
+    for (unsigned int index = 0; index < unitsCount; index++) {
+      Serial.printf("  - Unit #%u = %u bytes of heap (state, HomeKit accessory and characteristics)\n", index, unitsHeapBytes[index]);
+    }
+
+    Serial.printf("  - Shared = %u bytes (scheduler %u, IR transmitter %u, thermometer %u, trace %u)\n\n", (unsigned int)(sizeof(scheduler) + sizeof(irTransmitter) + sizeof(thermometer) + sizeof(trace)), (unsigned int)sizeof(scheduler), (unsigned int)sizeof(irTransmitter), (unsigned int)sizeof(thermometer), (unsigned int)sizeof(trace));
+  }
+
+  void logSnapshotTransmitterValues() {
+    Serial.printf("  - Queue Depth = %d\n", IR_QUEUE_CAPACITY - irTransmitter.available());
+    Serial.printf("  - Frames Sent = %d\n", irTransmitter.framesSent);
+    Serial.printf("  - Frames Dropped = %d\n", irTransmitter.framesDropped);
+    Serial.printf("  - Last Latency = %luµs\n", irTransmitter.lastLatencyMicros);
+    Serial.printf("  - Maximum Latency = %luµs\n", irTransmitter.maximumLatencyMicros);
+
+    for (unsigned int index = 0; index < irTransmitter.channelsCount; index++) {
+      Serial.printf("  - Channel #%u = IO%d, %u frames sent\n", index, irTransmitter.channels[index].pin, irTransmitter.channels[index].framesSent);
+    }
   }
 };
+
+AirConditionerBridge bridge;
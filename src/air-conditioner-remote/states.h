@@ -0,0 +1,178 @@
+// Air Conditioner (Remote)
+//
+// Air conditioner remote controller
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+const unsigned int STATE_INDEX_NONE = 255;
+const unsigned int STATE_VALUE_MAXIMUM = 254;
+
+template <unsigned int... VALUES>
+struct StateValues {};
+
+template <unsigned int... SLOTS>
+struct StateSlots {};
+
+// Generates the list of slots [0; COUNT - 1] (one slot per possible value)
+template <unsigned int COUNT, unsigned int... SLOTS>
+struct StateSlotsOf : StateSlotsOf<COUNT - 1, COUNT - 1, SLOTS...> {};
+
+template <unsigned int... SLOTS>
+struct StateSlotsOf<0, SLOTS...> {
+  typedef StateSlots<SLOTS...> Type;
+};
+
+constexpr unsigned int stateGreater(unsigned int left, unsigned int right) {
+  return (left > right) ? left : right;
+}
+
+constexpr unsigned int stateMaximum(unsigned int value) {
+  return value;
+}
+
+template <typename... TAIL>
+constexpr unsigned int stateMaximum(unsigned int head, TAIL... tail) {
+  return stateGreater(head, stateMaximum(tail...));
+}
+
+constexpr unsigned int stateIndexOf(unsigned int, unsigned int) {
+  return STATE_INDEX_NONE;
+}
+
+template <typename... TAIL>
+constexpr unsigned int stateIndexOf(unsigned int value, unsigned int index, unsigned int head, TAIL... tail) {
+  return (value == head) ? index : stateIndexOf(value, index + 1, tail...);
+}
+
+constexpr unsigned int stateValueAt(unsigned int) {
+  return STATE_INDEX_NONE;
+}
+
+template <typename... TAIL>
+constexpr unsigned int stateValueAt(unsigned int index, unsigned int head, TAIL... tail) {
+  return (index == 0) ? head : stateValueAt(index - 1, tail...);
+}
+
+constexpr bool stateIsStepped(unsigned int, unsigned int) {
+  return true;
+}
+
+template <typename... TAIL>
+constexpr bool stateIsStepped(unsigned int step, unsigned int head, unsigned int next, TAIL... tail) {
+  return (next == head + step) && stateIsStepped(step, next, tail...);
+}
+
+constexpr bool stateIsRange(unsigned int first, unsigned int last, unsigned int step) {
+  return step > 0 && last >= first && (last - first) % step == 0;
+}
+
+constexpr unsigned int stateNextIndex(unsigned int index, unsigned int size, bool circle) {
+  return (index == STATE_INDEX_NONE) ? STATE_INDEX_NONE : ((index + 1 < size) ? (index + 1) : (circle ? 0 : (size - 1)));
+}
+
+constexpr unsigned int statePreviousIndex(unsigned int index, unsigned int size, bool circle) {
+  return (index == STATE_INDEX_NONE) ? STATE_INDEX_NONE : ((index > 0) ? (index - 1) : (circle ? (size - 1) : 0));
+}
+
+template <bool CIRCLE, typename SLOTS, typename VALUES>
+struct StateTable;
+
+template <bool CIRCLE, unsigned int... SLOTS, unsigned int... VALUES>
+struct StateTable<CIRCLE, StateSlots<SLOTS...>, StateValues<VALUES...>> {
+  /**
+    [State Table]
+
+      - All lookup tables are indexed by state value, and generated at
+        compile time (they live in flash, not in RAM)
+
+      - Slots that do not map to a state are marked with STATE_INDEX_NONE
+  **/
+
+  static constexpr unsigned int SIZE = sizeof...(VALUES);
+  static constexpr unsigned int SLOTS_SIZE = sizeof...(SLOTS);
+
+  // Index-to-value table
+  static constexpr unsigned char ORDERED[SIZE] = {
+    (unsigned char)VALUES...
+  };
+
+  // Value-to-index table
+  static constexpr unsigned char INDEXES[SLOTS_SIZE] = {
+    (unsigned char)stateIndexOf(SLOTS, 0, VALUES...)...
+  };
+
+  // Value-to-next-value table
+  static constexpr unsigned char NEXT[SLOTS_SIZE] = {
+    (unsigned char)stateValueAt(stateNextIndex(stateIndexOf(SLOTS, 0, VALUES...), SIZE, CIRCLE), VALUES...)...
+  };
+
+  // Value-to-previous-value table
+  static constexpr unsigned char PREVIOUS[SLOTS_SIZE] = {
+    (unsigned char)stateValueAt(statePreviousIndex(stateIndexOf(SLOTS, 0, VALUES...), SIZE, CIRCLE), VALUES...)...
+  };
+};
+
+template <bool CIRCLE, unsigned int... SLOTS, unsigned int... VALUES>
+constexpr unsigned char StateTable<CIRCLE, StateSlots<SLOTS...>, StateValues<VALUES...>>::ORDERED[];
+
+template <bool CIRCLE, unsigned int... SLOTS, unsigned int... VALUES>
+constexpr unsigned char StateTable<CIRCLE, StateSlots<SLOTS...>, StateValues<VALUES...>>::INDEXES[];
+
+template <bool CIRCLE, unsigned int... SLOTS, unsigned int... VALUES>
+constexpr unsigned char StateTable<CIRCLE, StateSlots<SLOTS...>, StateValues<VALUES...>>::NEXT[];
+
+template <bool CIRCLE, unsigned int... SLOTS, unsigned int... VALUES>
+constexpr unsigned char StateTable<CIRCLE, StateSlots<SLOTS...>, StateValues<VALUES...>>::PREVIOUS[];
+
+template <bool CIRCLE, unsigned int... VALUES>
+struct StateDirection : StateTable<CIRCLE, typename StateSlotsOf<stateMaximum(VALUES...) + 1>::Type, StateValues<VALUES...>> {
+  /**
+    [State Direction]
+
+      - CIRCLE = true: progressing past the last state wraps to the first
+        state (and vice-versa)
+
+      - CIRCLE = false: progressing is clamped to the first and last states
+  **/
+
+  typedef StateTable<CIRCLE, typename StateSlotsOf<stateMaximum(VALUES...) + 1>::Type, StateValues<VALUES...>> Table;
+
+  static constexpr unsigned int FIRST = stateValueAt(0, VALUES...);
+  static constexpr unsigned int LAST = stateValueAt(sizeof...(VALUES) - 1, VALUES...);
+
+  static_assert(sizeof...(VALUES) > 0, "State direction must have at least one state");
+  static_assert(stateMaximum(VALUES...) <= STATE_VALUE_MAXIMUM, "State values must fit in lookup tables");
+
+  static constexpr bool contains(unsigned int value) {
+    return value < Table::SLOTS_SIZE && Table::INDEXES[value] != STATE_INDEX_NONE;
+  }
+
+  static constexpr bool isStepped(unsigned int step) {
+    return stateIsStepped(step, VALUES...);
+  }
+
+  // Notice: the following lookups expect a value (or an index) that is part \
+  //   of the direction (values are checked once, when loaded from the ROM)
+  static inline unsigned int index(unsigned int value) {
+    return Table::INDEXES[value];
+  }
+
+  static inline unsigned int at(unsigned int index) {
+    return Table::ORDERED[index];
+  }
+
+  static inline unsigned int progress(unsigned int value, int increment) {
+    return (increment > 0) ? Table::NEXT[value] : Table::PREVIOUS[value];
+  }
+};
+
+// Generates the direction of a range [FIRST; LAST], walked by STEP (clamped)
+// Notice: the range must be valid (see stateIsRange()), otherwise the \
+//   generation never ends
+template <unsigned int FIRST, unsigned int LAST, unsigned int STEP, unsigned int... VALUES>
+struct StateRangeOf : StateRangeOf<FIRST, LAST - STEP, STEP, LAST, VALUES...> {};
+
+template <unsigned int FIRST, unsigned int STEP, unsigned int... VALUES>
+struct StateRangeOf<FIRST, FIRST, STEP, VALUES...> {
+  typedef StateDirection<false, FIRST, VALUES...> Type;
+};
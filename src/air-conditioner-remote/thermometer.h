@@ -0,0 +1,258 @@
+// Air Conditioner (Remote)
+//
+// Air conditioner remote controller
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#include <atomic>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/ringbuf.h"
+#include "driver/gpio.h"
+#include "driver/rmt.h"
+
+const int DHT_TYPE_DHT11 = 11;
+const int DHT_TYPE_DHT22 = 22;
+
+const rmt_channel_t DHT_RMT_CHANNEL = RMT_CHANNEL_2; // Default (1 RMT channel per thermometer)
+const unsigned int DHT_RMT_CLOCK_DIVIDER = 80; // 1 tick = 1µs (80MHz APB clock)
+const unsigned int DHT_RMT_IDLE_THRESHOLD = 200; // 200µs (end of transmission)
+const unsigned int DHT_RMT_FILTER_TICKS = 80; // 1µs (glitch filter, in APB cycles)
+const unsigned int DHT_RMT_BUFFER_SIZE = 1024;
+
+const unsigned int DHT_BITS = 40;
+const unsigned int DHT_BIT_ONE_THRESHOLD_MICROSECONDS = 48; // '0' = ~27µs / '1' = ~70µs
+const unsigned int DHT_START_LOW_MILLISECONDS = 20; // DHT11 requires at least 18ms
+const unsigned int DHT_RESPONSE_TIMEOUT_MILLISECONDS = 20;
+
+const uint32_t THERMOMETER_TASK_STACK_SIZE = 3072;
+const UBaseType_t THERMOMETER_TASK_PRIORITY = 1;
+const BaseType_t THERMOMETER_TASK_CORE = 0; // Along w/ the HomeSpan task (device I/O runs on the other core)
+
+struct ThermometerReading {
+  float temperature;
+  unsigned long capturedMillis;
+  unsigned long durationMicros;
+};
+
+struct Thermometer {
+  /**
+    [Thermometer]
+
+      - DHT readings are captured by a dedicated task, pinned to the core
+        that runs the HomeSpan task (not the device task). The capture task
+        blocks on the RMT ring buffer for most of a capture, thus it barely
+        takes from HomeSpan. Signal edges are timestamped by the RMT
+        peripheral, thus interrupts are never disabled while capturing.
+
+      - The CPU is held at its maximum frequency while capturing, as the RMT
+        peripheral stops timestamping edges in light sleep
+
+      - The latest reading is handed to the main loop through a single
+        producer, single consumer slot, guarded by a sequence number (odd
+        while the slot is being written). Reading the slot never blocks.
+  **/
+
+  gpio_num_t pin = GPIO_NUM_0;
+  rmt_channel_t channel = DHT_RMT_CHANNEL;
+  int type = DHT_TYPE_DHT11;
+  unsigned int periodMillis = 0;
+
+  RingbufHandle_t ringbuffer = NULL;
+
+  PowerLock powerLock;
+
+  // Latest reading slot (written by the capture task only)
+  ThermometerReading slot;
+
+  std::atomic<uint32_t> slotSequence{0};
+
+  // Statistics (written by the capture task only)
+  std::atomic<uint32_t> capturesCount{0},
+                        checksumFailuresCount{0},
+                        timeoutsCount{0};
+
+  std::atomic<uint32_t> capturesMillis{0};
+
+  bool begin(int dataPin, int dhtType, unsigned int period, rmt_channel_t rmtChannel = DHT_RMT_CHANNEL) {
+    pin = (gpio_num_t)dataPin;
+    type = dhtType;
+    periodMillis = period;
+    channel = rmtChannel;
+
+    // Configure RMT channel (captures data line edges)
+    rmt_config_t config = RMT_DEFAULT_CONFIG_RX(pin, channel);
+
+    config.clk_div = DHT_RMT_CLOCK_DIVIDER;
+    config.rx_config.idle_threshold = DHT_RMT_IDLE_THRESHOLD;
+    config.rx_config.filter_en = true;
+    config.rx_config.filter_ticks_thresh = DHT_RMT_FILTER_TICKS;
+
+    if (rmt_config(&config) != ESP_OK || rmt_driver_install(channel, DHT_RMT_BUFFER_SIZE, 0) != ESP_OK) {
+      LOG_AT(THERMOMETER, 0, "[Sensor:Thermometer] Error configuring RMT channel! Is IO%d usable?\n", dataPin);
+
+      return false;
+    }
+
+    rmt_get_ringbuf_handle(channel, &ringbuffer);
+
+    powerLock.begin("dht");
+
+    // Configure data line as open-drain (input stays routed to RMT)
+    gpio_set_direction(pin, GPIO_MODE_INPUT_OUTPUT_OD);
+    gpio_set_pull_mode(pin, GPIO_PULLUP_ONLY);
+    gpio_set_level(pin, 1);
+
+    // Start capture task
+    if (xTaskCreatePinnedToCore(runTask, "thermometer", THERMOMETER_TASK_STACK_SIZE, this, THERMOMETER_TASK_PRIORITY, NULL, THERMOMETER_TASK_CORE) != pdPASS) {
+      LOG_AT(THERMOMETER, 0, "[Sensor:Thermometer] Error starting capture task!\n");
+
+      return false;
+    }
+
+    return true;
+  }
+
+  bool read(ThermometerReading &reading) {
+    for (;;) {
+      uint32_t sequence = slotSequence.load(std::memory_order_acquire);
+
+      // No reading yet?
+      if (sequence == 0) {
+        return false;
+      }
+
+      // Slot being written? (retry)
+      if ((sequence & 1) == 1) {
+        continue;
+      }
+
+      reading = slot;
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+
+      // Slot unchanged while copied?
+      if (slotSequence.load(std::memory_order_relaxed) == sequence) {
+        return true;
+      }
+    }
+  }
+
+  static void runTask(void *context) {
+    Thermometer *thermometer = (Thermometer *)context;
+
+    TickType_t lastWakeTicks = xTaskGetTickCount();
+
+    for (;;) {
+      thermometer->powerLock.acquire();
+      thermometer->capture();
+      thermometer->powerLock.release();
+
+      vTaskDelayUntil(&lastWakeTicks, pdMS_TO_TICKS(thermometer->periodMillis));
+    }
+  }
+
+  void capture() {
+    unsigned long startMicros = micros();
+
+    ThermometerReading reading;
+
+    bool isCaptured = receive(reading);
+
+    // Notice: time that the main loop would have been blocked for, had it \
+    //   captured itself (timeouts and checksum failures included)
+    reading.durationMicros = micros() - startMicros;
+
+    capturesMillis += (reading.durationMicros + 500) / 1000;
+
+    if (isCaptured == false) {
+      return;
+    }
+
+    // Publish reading
+    slotSequence.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot = reading;
+
+    slotSequence.fetch_add(1, std::memory_order_release);
+  }
+
+  bool receive(ThermometerReading &reading) {
+    // Send start signal (hold data line low), then release data line
+    gpio_set_level(pin, 0);
+    vTaskDelay(pdMS_TO_TICKS(DHT_START_LOW_MILLISECONDS));
+    gpio_set_level(pin, 1);
+
+    // Capture response edges
+    size_t itemsSize = 0;
+
+    rmt_rx_start(channel, true);
+
+    rmt_item32_t *items = (rmt_item32_t *)xRingbufferReceive(ringbuffer, &itemsSize, pdMS_TO_TICKS(DHT_RESPONSE_TIMEOUT_MILLISECONDS));
+
+    rmt_rx_stop(channel);
+
+    capturesCount++;
+
+    // No response? (sensor not plugged)
+    if (items == NULL) {
+      timeoutsCount++;
+
+      return false;
+    }
+
+    bool isDecoded = decode(items, itemsSize / sizeof(rmt_item32_t), reading.temperature);
+
+    vRingbufferReturnItem(ringbuffer, items);
+
+    if (isDecoded == false) {
+      checksumFailuresCount++;
+
+      return false;
+    }
+
+    reading.capturedMillis = millis();
+
+    return true;
+  }
+
+  bool decode(rmt_item32_t *items, unsigned int itemsCount, float &temperature) {
+    uint8_t data[DHT_BITS / 8] = {};
+
+    // Not enough edges? (transmission got cut)
+    // Notice: the last item holds the end-of-transmission low level, and \
+    //   is preceded by one item per data bit (low level, then high level)
+    if (itemsCount < (DHT_BITS + 1)) {
+      return false;
+    }
+
+    rmt_item32_t *bits = items + (itemsCount - 1 - DHT_BITS);
+
+    for (unsigned int i = 0; i < DHT_BITS; i++) {
+      data[i / 8] = (data[i / 8] << 1) | ((bits[i].duration1 > DHT_BIT_ONE_THRESHOLD_MICROSECONDS) ? 1 : 0);
+    }
+
+    // Checksum mismatch?
+    if (data[4] != ((data[0] + data[1] + data[2] + data[3]) & 0xFF)) {
+      return false;
+    }
+
+    if (type == DHT_TYPE_DHT22) {
+      temperature = (((data[2] & 0x7F) << 8) | data[3]) * 0.1;
+
+      if ((data[2] & 0x80) != 0) {
+        temperature = -temperature;
+      }
+    } else {
+      temperature = data[2] + (data[3] & 0x0F) * 0.1;
+
+      if ((data[3] & 0x80) != 0) {
+        temperature = -temperature;
+      }
+    }
+
+    return true;
+  }
+};
@@ -0,0 +1,229 @@
+// Air Conditioner (Remote)
+//
+// Air conditioner remote controller
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#include <atomic>
+
+const unsigned int TRACE_CAPACITY = 256; // 256 records (4KB)
+const unsigned int TRACE_CALIBRATION_ROUNDS = 64;
+const unsigned int TRACE_LINE_SIZE_MAXIMUM = 128;
+const unsigned long TRACE_UART_BAUDS = 115200; // As the serial console
+const uint32_t TRACE_DUMP_MAGIC = 0x31435254; // "TRC1" (little-endian)
+const char *const TRACE_DUMP_DIGITS = "0123456789ABCDEF";
+
+struct TraceRecord {
+  uint32_t sequence; // Record number + 1 (0 while being written)
+  uint32_t micros;
+  uint16_t event;
+  uint16_t argument0;
+  uint32_t argument1;
+};
+
+struct TraceDumpHeader {
+  uint32_t magic;
+  uint32_t recordsCount; // Events recorded since boot
+  uint32_t dumpMicros;
+  uint32_t recordCycles;
+  uint32_t formatCycles;
+  uint16_t formatBytes;
+  uint16_t cpuFrequencyMhz;
+  uint16_t capacity; // Record slots that follow the header
+  uint16_t recordSize;
+  uint32_t uartBauds;
+};
+
+static_assert(sizeof(TraceRecord) == 16, "Trace records must be 16 bytes");
+static_assert(sizeof(TraceDumpHeader) == 32, "Trace dump headers must be 32 bytes");
+static_assert((TRACE_CAPACITY & (TRACE_CAPACITY - 1)) == 0, "Trace capacity must be a power of 2");
+
+struct Trace {
+  /**
+    [Trace]
+
+      - Events are recorded as fixed-size binary records (event number + 2
+        arguments) to a RAM ring buffer, overwriting the oldest records, so
+        that recording an event never formats text nor waits for the UART
+
+      - Records get formatted lazily, when dumped, from a format string per
+        event number (which takes both arguments)
+
+      - Any task can record events: each record slot is claimed w/ an atomic
+        increment, and its sequence number is written last, so that dumps
+        skip records that are being written (or that got overwritten)
+
+      - The cost of recording an event is measured w/ the CPU cycle counter
+        on begin, against formatting the same event as a log line would
+
+      - Records can also be dumped as is (hex, w/ a header that holds the
+        calibration figures), and decoded on a host (see test/host), so
+        that not even formatting happens on the device
+  **/
+
+  const char *const *formats = NULL;
+
+  unsigned int formatsCount = 0;
+
+  TraceRecord records[TRACE_CAPACITY];
+
+  std::atomic<uint32_t> recordsCount{0};
+
+  // Cost of recording an event, vs formatting it as a log line
+  uint32_t recordCycles = 0,
+           formatCycles = 0;
+
+  unsigned int formatBytes = 0;
+
+  void begin(const char *const eventFormats[], unsigned int eventsCount) {
+    formats = eventFormats;
+    formatsCount = eventsCount;
+
+    calibrate();
+
+    memset(records, 0, sizeof(records));
+
+    recordsCount.store(0, std::memory_order_release);
+  }
+
+  void calibrate() {
+    char line[TRACE_LINE_SIZE_MAXIMUM];
+
+    unsigned long bytesCount = 0;
+
+    // Notice: this runs before any task records events (records get \
+    //   cleared afterwards)
+    uint32_t startCycles = ESP.getCycleCount();
+
+    for (unsigned int i = 0; i < TRACE_CALIBRATION_ROUNDS; i++) {
+      record(i % formatsCount, i, i);
+    }
+
+    recordCycles = (ESP.getCycleCount() - startCycles) / TRACE_CALIBRATION_ROUNDS;
+
+    // Measure formatting the same events (w/o writing them to the UART)
+    startCycles = ESP.getCycleCount();
+
+    for (unsigned int i = 0; i < TRACE_CALIBRATION_ROUNDS; i++) {
+      bytesCount += snprintf(line, sizeof(line), formats[i % formatsCount], i, i);
+    }
+
+    formatCycles = (ESP.getCycleCount() - startCycles) / TRACE_CALIBRATION_ROUNDS;
+    formatBytes = bytesCount / TRACE_CALIBRATION_ROUNDS;
+  }
+
+  inline void record(uint16_t event, uint16_t argument0 = 0, uint32_t argument1 = 0) {
+    uint32_t number = recordsCount.fetch_add(1, std::memory_order_relaxed);
+
+    TraceRecord &slot = records[number % TRACE_CAPACITY];
+
+    // Mark record as being written (dumps skip it)
+    slot.sequence = 0;
+
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.micros = micros();
+    slot.event = event;
+    slot.argument0 = argument0;
+    slot.argument1 = argument1;
+
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.sequence = number + 1;
+  }
+
+  void print() {
+    uint32_t count = recordsCount.load(std::memory_order_acquire),
+             first = (count > TRACE_CAPACITY) ? (count - TRACE_CAPACITY) : 0,
+             skippedCount = 0;
+
+    Serial.printf("\n*** Trace ***\n\n");
+
+    // Walk records from the oldest one
+    for (uint32_t number = first; number < count; number++) {
+      TraceRecord &slot = records[number % TRACE_CAPACITY];
+      TraceRecord record = slot;
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+
+      // Record is being written, or was overwritten while copied? (skip it)
+      if (record.sequence != (number + 1) || slot.sequence != record.sequence) {
+        skippedCount++;
+
+        continue;
+      }
+
+      Serial.printf("  [%10.3fms] ", record.micros / 1000.0);
+
+      if (record.event < formatsCount) {
+        Serial.printf(formats[record.event], record.argument0, record.argument1);
+      } else {
+        Serial.printf("Unknown event #%u (%u, %u)", record.event, record.argument0, record.argument1);
+      }
+
+      Serial.printf("\n");
+    }
+
+    Serial.printf("\n%u events recorded (%u in buffer, %u skipped)\n", count, count - first - skippedCount, skippedCount);
+
+    // Notice: a log line also waits for the UART, once its buffer is full
+    Serial.printf("Record cost: %u cycles per event, vs %u cycles to format it as a log line (+%luµs on the UART for %u bytes) (at %uMHz)\n\n", recordCycles, formatCycles, formatBytes * 10 * 1000000ul / TRACE_UART_BAUDS, formatBytes, getCpuFrequencyMhz());
+  }
+
+  void dump() {
+    TraceDumpHeader header;
+
+    header.magic = TRACE_DUMP_MAGIC;
+    header.recordsCount = recordsCount.load(std::memory_order_acquire);
+    header.dumpMicros = micros();
+    header.recordCycles = recordCycles;
+    header.formatCycles = formatCycles;
+    header.formatBytes = formatBytes;
+    header.cpuFrequencyMhz = getCpuFrequencyMhz();
+    header.capacity = TRACE_CAPACITY;
+    header.recordSize = sizeof(TraceRecord);
+    header.uartBauds = TRACE_UART_BAUDS;
+
+    Serial.printf("\n*** Trace Dump ***\n\n");
+
+    dumpBytes('H', &header, sizeof(header));
+
+    // Notice: slots are dumped in ring order, the decoder orders records by \
+    //   sequence number (and skips those that got overwritten)
+    for (unsigned int i = 0; i < TRACE_CAPACITY; i++) {
+      TraceRecord &slot = records[i];
+      TraceRecord record = slot;
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+
+      // Record was being written while copied? (mark it as such)
+      if (slot.sequence != record.sequence) {
+        record.sequence = 0;
+      }
+
+      dumpBytes('R', &record, sizeof(record));
+    }
+
+    Serial.printf("\n%u events recorded, %u slots dumped (decode w/ test/host/tracedecode)\n\n", header.recordsCount, TRACE_CAPACITY);
+  }
+
+  void dumpBytes(char type, const void *bytes, unsigned int size) {
+    const uint8_t *data = (const uint8_t *)bytes;
+
+    char line[2 + 2 * sizeof(TraceDumpHeader) + 1];
+
+    unsigned int length = 0;
+
+    line[length++] = type;
+    line[length++] = ':';
+
+    for (unsigned int i = 0; i < size && length + 2 < sizeof(line); i++) {
+      line[length++] = TRACE_DUMP_DIGITS[data[i] >> 4];
+      line[length++] = TRACE_DUMP_DIGITS[data[i] & 0x0F];
+    }
+
+    line[length] = '\0';
+
+    Serial.printf("%s\n", line);
+  }
+};
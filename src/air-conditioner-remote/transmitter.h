@@ -0,0 +1,358 @@
+// Air Conditioner (Remote)
+//
+// Air conditioner remote controller
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#include "driver/rmt.h"
+
+const rmt_channel_t IR_RMT_CHANNEL = RMT_CHANNEL_0;
+const unsigned int IR_RMT_CLOCK_DIVIDER = 80; // 1 tick = 1µs (80MHz APB clock)
+const unsigned int IR_CARRIER_FREQUENCY = 38000; // 38kHz
+const unsigned int IR_CARRIER_DUTY_PERCENT = 33; // 1/3 duty cycle
+
+const unsigned int NEC_BITS = 32;
+const unsigned int NEC_HEADER_MARK_MICROSECONDS = 9000;
+const unsigned int NEC_HEADER_SPACE_MICROSECONDS = 4500;
+const unsigned int NEC_REPEAT_SPACE_MICROSECONDS = 2250;
+const unsigned int NEC_BIT_MARK_MICROSECONDS = 560;
+const unsigned int NEC_ONE_SPACE_MICROSECONDS = 1690;
+const unsigned int NEC_ZERO_SPACE_MICROSECONDS = 560;
+const unsigned int NEC_REPEAT_PERIOD_MICROSECONDS = 110000; // 110 milliseconds
+const unsigned int NEC_REPEAT_MICROSECONDS = NEC_HEADER_MARK_MICROSECONDS + NEC_REPEAT_SPACE_MICROSECONDS + NEC_BIT_MARK_MICROSECONDS; // ~12 milliseconds
+const unsigned int NEC_FRAME_MICROSECONDS = NEC_REPEAT_PERIOD_MICROSECONDS + NEC_REPEAT_MICROSECONDS; // ~122 milliseconds on air (data + repeat)
+
+const unsigned long IR_DELAY_NEVER = 0xFFFFFFFF; // Nothing queued
+
+// Notice: a frame holds a data part (the header, the 32 data bits and the \
+//   stop bit) and a repeat part (a single repeat, as the AC unit expects), \
+//   which are clocked out separately, the repeat starting once the repeat \
+//   period elapsed since the start of the frame
+const unsigned int IR_FRAME_ITEMS_CAPACITY = 1 + NEC_BITS + 1 + 2;
+const unsigned int IR_QUEUE_CAPACITY = 24;
+const unsigned int IR_CHANNELS_CAPACITY = 8; // 1 IR LED per AC unit
+
+enum IR_FRAME_STATES {
+  IR_FRAME_STATE_NONE   = 0, // No frame on air
+  IR_FRAME_STATE_DATA   = 1, // Data part on air
+  IR_FRAME_STATE_HOLD   = 2, // Data part sent, repeat part not due yet
+  IR_FRAME_STATE_REPEAT = 3  // Repeat part on air
+};
+
+struct InfraRedFrame {
+  rmt_item32_t items[IR_FRAME_ITEMS_CAPACITY];
+  unsigned int size,
+               dataSize; // Items of the data part (then, of the repeat part)
+  unsigned int channel;
+  unsigned long enqueuedMicros,
+                dataMicros;
+  bool isArmed;
+};
+
+struct InfraRedChannel {
+  int pin;
+
+  // Statistics (a frame counts as sent once its data part was sent)
+  unsigned int framesSent;
+};
+
+struct InfraRedTransmitter {
+  /**
+    [InfraRed Transmitter]
+
+      - Frames are pre-encoded to RMT items when enqueued, and then clocked
+        out by the RMT peripheral, one after the other, while the main loop
+        keeps running (the loop only ever checks for completion).
+
+      - A frame is only started once the previous frame was fully sent, and
+        then once the 'frame gap' has elapsed, which is the minimum silence
+        the AC unit requires in between two frames (timed from the end of
+        the previous frame, as frames are not all the same duration)
+
+      - A frame is accounted as sent to its channel as soon as its data part
+        was sent (ie. the AC unit has the command), rather than once its
+        repeat part was sent, so that the owner of the channel learns about
+        it as early as possible (eg. to journal that the command was sent)
+
+      - A frame can be enqueued unarmed, in which case it is held at the
+        head of the queue until its owner arms it, so that the owner gets a
+        chance to act right before the frame goes on air (eg. to journal an
+        intent), and not when the frame was enqueued
+
+      - The CPU is held at its maximum frequency while frames are queued, as
+        the RMT peripheral stops clocking out frames in light sleep.
+
+      - Frames from all channels (ie. AC units) share the queue and the RMT
+        channel, which gets routed to the IR LED of a frame's channel right
+        before it starts, thus frames never overlap (and keep the frame gap
+        between them, as an AC unit might see other IR LEDs).
+
+      - The transmitter tells when it next needs to be ticked (ie. when the
+        part on air ends, when the repeat is due, or when the frame gap
+        elapses), so that the loop can idle in between, rather than tick it
+        every millisecond.
+  **/
+
+  unsigned int frameGapMillis = 0;
+
+  // Channels (the RMT channel is routed to one of them at a time)
+  InfraRedChannel channels[IR_CHANNELS_CAPACITY];
+
+  unsigned int channelsCount = 0,
+               routedChannel = 0;
+
+  // Frames queue (ring buffer, head is the frame on air if any)
+  InfraRedFrame queue[IR_QUEUE_CAPACITY];
+
+  unsigned int queueHead = 0,
+               queueSize = 0;
+
+  uint8_t frameState = IR_FRAME_STATE_NONE;
+
+  // Notice: the frame end is kept in microseconds, as the gap would be cut \
+  //   short by up to 1ms if it was timed from a truncated millis() value
+  unsigned long frameStartMicros = 0,
+                lastFrameEndMicros = 0;
+
+  PowerLock powerLock;
+
+  // Statistics
+  unsigned int framesSent = 0,
+               framesDropped = 0;
+
+  unsigned long lastLatencyMicros = 0,
+                maximumLatencyMicros = 0;
+
+  void begin(unsigned int gap) {
+    frameGapMillis = gap;
+
+    powerLock.begin("ir");
+  }
+
+  unsigned int addChannel(int pin) {
+    // Transmitter is full? This is not expected!
+    if (channelsCount >= IR_CHANNELS_CAPACITY) {
+      LOG_AT(TRANSMITTER, 0, "[Transmitter:InfraRed] Error adding channel on IO%d! Transmitter is full.\n", pin);
+
+      return IR_CHANNELS_CAPACITY;
+    }
+
+    channels[channelsCount].pin = pin;
+    channels[channelsCount].framesSent = 0;
+
+    // First channel? (configure the RMT channel on its pin)
+    if (channelsCount == 0) {
+      configure(pin);
+    } else {
+      // Hold the IR LED off until the RMT channel gets routed to it
+      pinMode(pin, OUTPUT);
+      digitalWrite(pin, LOW);
+    }
+
+    channelsCount++;
+
+    return channelsCount - 1;
+  }
+
+  void configure(int pin) {
+    // Configure RMT channel (carrier is generated by the RMT peripheral)
+    rmt_config_t config = RMT_DEFAULT_CONFIG_TX((gpio_num_t)pin, IR_RMT_CHANNEL);
+
+    config.clk_div = IR_RMT_CLOCK_DIVIDER;
+    config.tx_config.carrier_en = true;
+    config.tx_config.carrier_freq_hz = IR_CARRIER_FREQUENCY;
+    config.tx_config.carrier_duty_percent = IR_CARRIER_DUTY_PERCENT;
+    config.tx_config.carrier_level = RMT_CARRIER_LEVEL_HIGH;
+    config.tx_config.idle_output_en = true;
+    config.tx_config.idle_level = RMT_IDLE_LEVEL_LOW;
+
+    if (rmt_config(&config) != ESP_OK || rmt_driver_install(IR_RMT_CHANNEL, 0, 0) != ESP_OK) {
+      LOG_AT(TRANSMITTER, 0, "[Transmitter:InfraRed] Error configuring RMT channel! Is IO%d usable?\n", pin);
+    }
+  }
+
+  void tick() {
+    // Frame part on air? Check if done (never waits)
+    if (frameState == IR_FRAME_STATE_DATA || frameState == IR_FRAME_STATE_REPEAT) {
+      if (rmt_wait_tx_done(IR_RMT_CHANNEL, 0) != ESP_OK) {
+        return;
+      }
+
+      if (frameState == IR_FRAME_STATE_DATA) {
+        // Data part sent (hold until the repeat is due)
+        frameState = IR_FRAME_STATE_HOLD;
+
+        channels[queue[queueHead].channel].framesSent++;
+      } else {
+        // Repeat part sent (frame is done)
+        frameState = IR_FRAME_STATE_NONE;
+        lastFrameEndMicros = micros();
+        framesSent++;
+
+        // Pop sent frame
+        queueHead = (queueHead + 1) % IR_QUEUE_CAPACITY;
+        queueSize--;
+
+        // All frames sent? (let the CPU scale down)
+        if (queueSize == 0) {
+          powerLock.release();
+        }
+      }
+    }
+
+    // Start repeat part? (once the repeat period elapsed since frame start)
+    if (frameState == IR_FRAME_STATE_HOLD) {
+      if ((micros() - frameStartMicros) < NEC_REPEAT_PERIOD_MICROSECONDS) {
+        return;
+      }
+
+      InfraRedFrame &frame = queue[queueHead];
+
+      rmt_write_items(IR_RMT_CHANNEL, frame.items + frame.dataSize, frame.size - frame.dataSize, false);
+
+      frameState = IR_FRAME_STATE_REPEAT;
+
+      return;
+    }
+
+    // Start next frame? (once armed, if the AC unit is ready to receive it)
+    if (frameState == IR_FRAME_STATE_NONE && queueSize > 0 && queue[queueHead].isArmed == true && (micros() - lastFrameEndMicros) >= (frameGapMillis * 1000)) {
+      InfraRedFrame &frame = queue[queueHead];
+
+      // Frame goes to another IR LED? (route the RMT channel to it)
+      if (frame.channel != routedChannel) {
+        route(frame.channel);
+      }
+
+      frameStartMicros = micros();
+
+      // Measure enqueue-to-air latency
+      lastLatencyMicros = frameStartMicros - frame.enqueuedMicros;
+      maximumLatencyMicros = max(maximumLatencyMicros, lastLatencyMicros);
+
+      rmt_write_items(IR_RMT_CHANNEL, frame.items, frame.dataSize, false);
+
+      frameState = IR_FRAME_STATE_DATA;
+    }
+  }
+
+  void route(unsigned int channel) {
+    // Hold the previous IR LED off (it gets detached from the RMT channel)
+    pinMode(channels[routedChannel].pin, OUTPUT);
+    digitalWrite(channels[routedChannel].pin, LOW);
+
+    rmt_set_gpio(IR_RMT_CHANNEL, RMT_MODE_TX, (gpio_num_t)channels[channel].pin, false);
+
+    routedChannel = channel;
+  }
+
+  bool enqueueNEC(unsigned int channel, unsigned int address, unsigned int command, bool isArmed = true) {
+    // Queue is full? Drop frame
+    if (queueSize >= IR_QUEUE_CAPACITY) {
+      framesDropped++;
+
+      return false;
+    }
+
+    InfraRedFrame &frame = queue[(queueHead + queueSize) % IR_QUEUE_CAPACITY];
+
+    encodeNEC(frame, address, command);
+
+    frame.channel = channel;
+    frame.enqueuedMicros = micros();
+    frame.isArmed = isArmed;
+
+    queueSize++;
+
+    powerLock.acquire();
+
+    return true;
+  }
+
+  unsigned int available() {
+    return IR_QUEUE_CAPACITY - queueSize;
+  }
+
+  bool isAwaitingArm(unsigned int channel) {
+    return frameState == IR_FRAME_STATE_NONE && queueSize > 0 && queue[queueHead].channel == channel && queue[queueHead].isArmed == false;
+  }
+
+  void arm() {
+    // Notice: only the frame at the head of the queue is ever armed
+    if (queueSize > 0) {
+      queue[queueHead].isArmed = true;
+    }
+  }
+
+  unsigned long millisUntilNextTick() {
+    // Nothing queued, or next frame not armed yet? (until its owner acts)
+    if (queueSize == 0 || (frameState == IR_FRAME_STATE_NONE && queue[queueHead].isArmed == false)) {
+      return IR_DELAY_NEVER;
+    }
+
+    // Frame gap not elapsed yet? (rounded up, as to never tick too early)
+    if (frameState == IR_FRAME_STATE_NONE) {
+      unsigned long silenceMicros = micros() - lastFrameEndMicros,
+                    gapMicros = frameGapMillis * 1000;
+
+      return (silenceMicros < gapMicros) ? ((gapMicros - silenceMicros + 999) / 1000) : 0;
+    }
+
+    // Frame part due to end (or repeat due to start)
+    unsigned long elapsedMicros = micros() - frameStartMicros,
+                  dueMicros = NEC_REPEAT_PERIOD_MICROSECONDS;
+
+    if (frameState == IR_FRAME_STATE_DATA) {
+      dueMicros = queue[queueHead].dataMicros;
+    } else if (frameState == IR_FRAME_STATE_REPEAT) {
+      dueMicros = NEC_FRAME_MICROSECONDS;
+    }
+
+    if (elapsedMicros < dueMicros) {
+      return (dueMicros - elapsedMicros + 999) / 1000;
+    }
+
+    // Notice: a part on air can end past the millisecond it was due (check \
+    //   every millisecond), while a due repeat starts right away
+    return (frameState == IR_FRAME_STATE_HOLD) ? 0 : 1;
+  }
+
+  void encodeNEC(InfraRedFrame &frame, unsigned int address, unsigned int command) {
+    // Build NEC data word (8-bit address and command, followed by their \
+    //   inverse, sent LSB first)
+    unsigned long data = (address & 0xFF) | ((~address & 0xFF) << 8) | ((command & 0xFF) << 16) | ((unsigned long)(~command & 0xFF) << 24);
+
+    frame.size = 0;
+    frame.dataMicros = 0;
+
+    // Header
+    frame.dataMicros += appendItem(frame, NEC_HEADER_MARK_MICROSECONDS, NEC_HEADER_SPACE_MICROSECONDS);
+
+    // Data bits
+    for (unsigned int i = 0; i < NEC_BITS; i++) {
+      frame.dataMicros += appendItem(frame, NEC_BIT_MARK_MICROSECONDS, ((data >> i) & 1) ? NEC_ONE_SPACE_MICROSECONDS : NEC_ZERO_SPACE_MICROSECONDS);
+    }
+
+    // Stop bit (ends the data part)
+    frame.dataMicros += appendItem(frame, NEC_BIT_MARK_MICROSECONDS, 0);
+    frame.dataSize = frame.size;
+
+    // Repeat (ends the repeat part)
+    appendItem(frame, NEC_HEADER_MARK_MICROSECONDS, NEC_REPEAT_SPACE_MICROSECONDS);
+    appendItem(frame, NEC_BIT_MARK_MICROSECONDS, 0);
+  }
+
+  unsigned long appendItem(InfraRedFrame &frame, unsigned long markMicros, unsigned long spaceMicros) {
+    rmt_item32_t &item = frame.items[frame.size];
+
+    // Notice: a zero space ends the transmission (RMT end marker)
+    item.level0 = 1;
+    item.duration0 = markMicros;
+    item.level1 = 0;
+    item.duration1 = spaceMicros;
+
+    frame.size++;
+
+    return markMicros + spaceMicros;
+  }
+};
@@ -0,0 +1,135 @@
+// Sprinkler Tank (Water Level)
+//
+// Water level reporting for sprinkler tank
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+const float DRAIN_ESTIMATOR_MEMORY_HOURS = 24.0; // 1 day (older samples fade out)
+const unsigned int DRAIN_ESTIMATOR_REFILL_LEVEL = 5; // 5% (above previous level)
+const float DRAIN_ESTIMATOR_RATE_MINIMUM = 0.05; // 0.05% per hour (slower is flat)
+
+struct DrainEstimator {
+  /**
+    [Drain Estimator]
+
+      - Fits a line over (time, level) samples w/ recursive least squares,
+        where older samples are exponentially forgotten, so that the drain
+        rate follows the latest usage of the tank
+
+      - Only the weighted sums of the fit are kept, and times are relative to
+        the latest sample (ie. the latest sample is at time zero), thus each
+        update is O(1) and sums stay small
+
+      - A level rising well above the previous level is a refill, after which
+        the fit restarts from scratch (the level never rises otherwise)
+  **/
+
+  // Weighted sums (times are in hours, relative to the latest sample)
+  float weights = 0.0,
+        times = 0.0,
+        levels = 0.0,
+        timesSquared = 0.0,
+        timesLevels = 0.0;
+
+  uint32_t lastMinute = 0;
+
+  unsigned int lastLevel = 0;
+
+  unsigned int samplesCount = 0;
+
+  // Statistics
+  unsigned int refillsCount = 0;
+
+  void update(uint32_t minute, unsigned int level) {
+    float hours = (float)(minute - lastMinute) / 60.0;
+
+    // Level is well above previous level? (tank was refilled, restart fit)
+    // Notice: the previous level is compared against, rather than the \
+    //   forecast level, as drain bursts (ie. watering) would otherwise get \
+    //   extrapolated past their end
+    if (samplesCount > 0 && level > (lastLevel + DRAIN_ESTIMATOR_REFILL_LEVEL)) {
+      LOG_AT(ESTIMATOR, 1, "[Estimator:Drain] Refill detected (%d%%, previous level was %d%%)\n", level, lastLevel);
+
+      reset();
+
+      refillsCount++;
+    }
+
+    if (samplesCount > 0) {
+      // Shift previous samples back in time (latest sample is at time zero)
+      timesSquared += hours * (hours * weights - 2 * times);
+      timesLevels -= hours * levels;
+      times -= hours * weights;
+
+      // Fade out previous samples
+      float decay = expf(-hours / DRAIN_ESTIMATOR_MEMORY_HOURS);
+
+      weights *= decay;
+      times *= decay;
+      levels *= decay;
+      timesSquared *= decay;
+      timesLevels *= decay;
+    }
+
+    // Append latest sample (at time zero)
+    weights += 1.0;
+    levels += level;
+
+    lastMinute = minute;
+    lastLevel = level;
+    samplesCount++;
+  }
+
+  void reset() {
+    weights = 0.0;
+    times = 0.0;
+    levels = 0.0;
+    timesSquared = 0.0;
+    timesLevels = 0.0;
+
+    samplesCount = 0;
+  }
+
+  bool hasRate() {
+    // Notice: requires 2 samples at distinct times
+    return samplesCount >= 2 && (weights * timesSquared - times * times) > 0.0;
+  }
+
+  float rate() {
+    // Slope of fit, in % per hour (negative while draining)
+    if (hasRate() == false) {
+      return 0.0;
+    }
+
+    return (weights * timesLevels - times * levels) / (weights * timesSquared - times * times);
+  }
+
+  float forecastLevel(float hours) {
+    if (samplesCount == 0) {
+      return 0.0;
+    }
+
+    // Intercept of fit is the smoothed level at time zero (latest sample)
+    float drainRate = rate(),
+          level = (levels - drainRate * times) / weights;
+
+    return level + drainRate * hours;
+  }
+
+  float hoursToLevel(float targetLevel) {
+    float drainRate = rate(),
+          level = forecastLevel(0.0);
+
+    // Already there?
+    if (level <= targetLevel) {
+      return 0.0;
+    }
+
+    // Not draining? (never gets there)
+    if (drainRate > -DRAIN_ESTIMATOR_RATE_MINIMUM) {
+      return INFINITY;
+    }
+
+    return (level - targetLevel) / -drainRate;
+  }
+};
@@ -0,0 +1,89 @@
+// Sprinkler Tank (Water Level)
+//
+// Water level reporting for sprinkler tank
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+enum CIRCUIT_STATES {
+  CIRCUIT_STATE_CLOSED    = 0, // Healthy (probe normally)
+  CIRCUIT_STATE_OPEN      = 1, // Faulted (do not probe until retry)
+  CIRCUIT_STATE_HALF_OPEN = 2  // Retrying (a single failure re-opens)
+};
+
+struct CircuitBreaker {
+  /**
+    [Circuit Breaker]
+
+      - The circuit opens after a number of consecutive failures, after
+        which retries are spaced by a delay that doubles on each failed
+        retry (up to a maximum delay)
+
+      - The circuit closes again on the first success, and both
+        recordFailure() and recordSuccess() tell whether the circuit just
+        changed state (so that faults are only reported on changes)
+  **/
+
+  unsigned int failuresThreshold = 1;
+
+  unsigned long backoffMinimumMillis = 0,
+                backoffMaximumMillis = 0,
+                backoffMillis = 0;
+
+  unsigned int state = CIRCUIT_STATE_CLOSED,
+               consecutiveFailuresCount = 0;
+
+  // Statistics
+  unsigned int failuresCount = 0,
+               opensCount = 0;
+
+  void begin(unsigned int threshold, unsigned long backoffMinimum, unsigned long backoffMaximum) {
+    failuresThreshold = threshold;
+    backoffMinimumMillis = backoffMinimum;
+    backoffMaximumMillis = backoffMaximum;
+    backoffMillis = backoffMinimum;
+  }
+
+  bool recordSuccess() {
+    bool wasClosed = (state == CIRCUIT_STATE_CLOSED);
+
+    state = CIRCUIT_STATE_CLOSED;
+    consecutiveFailuresCount = 0;
+    backoffMillis = backoffMinimumMillis;
+
+    // Retry succeeded? (circuit closes again)
+    return wasClosed == false;
+  }
+
+  bool recordFailure() {
+    failuresCount++;
+    consecutiveFailuresCount++;
+
+    // Retry failed? (re-open, wait longer)
+    if (state == CIRCUIT_STATE_HALF_OPEN) {
+      state = CIRCUIT_STATE_OPEN;
+      backoffMillis = min(backoffMillis * 2, backoffMaximumMillis);
+      opensCount++;
+
+      return true;
+    }
+
+    // Too many consecutive failures? (open)
+    if (state == CIRCUIT_STATE_CLOSED && consecutiveFailuresCount >= failuresThreshold) {
+      state = CIRCUIT_STATE_OPEN;
+      backoffMillis = backoffMinimumMillis;
+      opensCount++;
+
+      return true;
+    }
+
+    return false;
+  }
+
+  unsigned long retry() {
+    // Notice: this is to be called once the circuit is open, it returns the \
+    //   delay to wait for before retrying
+    state = CIRCUIT_STATE_HALF_OPEN;
+
+    return backoffMillis;
+  }
+};
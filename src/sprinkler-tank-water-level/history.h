@@ -0,0 +1,369 @@
+// Sprinkler Tank (Water Level)
+//
+// Water level reporting for sprinkler tank
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+
+const char *const HISTORY_PARTITION_LABEL = "history";
+
+const unsigned int HISTORY_SECTOR_SIZE = 4096; // 4KB (flash erase unit)
+const unsigned int HISTORY_BLOCK_SIZE = 128;
+const unsigned int HISTORY_BATCH_CAPACITY = 24; // 24 samples (flash gets written once per batch)
+const unsigned int HISTORY_VARINT_SIZE_MAXIMUM = 5;
+const unsigned int HISTORY_OFFSET_NONE = 0xFFFFFFFF;
+
+const uint8_t HISTORY_BLOCK_MAGIC = 0x48; // 'H'
+
+struct HistorySample {
+  uint32_t minute; // Device time (uptime minutes, accumulated across boots)
+  uint8_t level;
+};
+
+struct HistoryBlockHeader {
+  uint8_t magic;
+  uint8_t count; // Samples in block
+  uint8_t size; // Payload bytes in block
+  uint8_t level; // First sample level
+  uint32_t minute; // First sample minute
+  uint32_t sequence;
+  uint32_t crc;
+};
+
+static_assert(sizeof(HistoryBlockHeader) == 16, "History block headers must be 16 bytes (aligned flash writes)");
+static_assert(HISTORY_SECTOR_SIZE % HISTORY_BLOCK_SIZE == 0, "History blocks must not span flash sectors");
+
+const unsigned int HISTORY_BLOCK_PAYLOAD_SIZE = HISTORY_BLOCK_SIZE - sizeof(HistoryBlockHeader);
+
+// Notice: each sample past the first one takes at least 2 bytes (minute \
+//   delta + level delta)
+const unsigned int HISTORY_BLOCK_SAMPLES_MAXIMUM = 1 + (HISTORY_BLOCK_PAYLOAD_SIZE / 2);
+
+struct HistoryBlock {
+  HistoryBlockHeader header;
+  uint8_t payload[HISTORY_BLOCK_PAYLOAD_SIZE];
+};
+
+struct History {
+  /**
+    [History]
+
+      - Samples are first kept in a RAM batch, which gets spilled to flash
+        once full, so that flash is only written once every few polls (the
+        RAM batch is lost on power loss)
+
+      - Spilled samples are encoded as a block: the first sample is stored
+        as-is in the block header, and each next sample is stored as its
+        minute delta + its level delta (zig-zag), as variable-length integers
+        (1 byte each, most of the time)
+
+      - Blocks are appended one after the other across a rotating set of
+        flash sectors, the oldest sector getting erased once all sectors
+        have been filled
+  **/
+
+  const esp_partition_t *partition = NULL;
+
+  unsigned int nextOffset = 0;
+
+  uint32_t nextSequence = 0,
+           baseMinute = 0;
+
+  HistorySample batch[HISTORY_BATCH_CAPACITY];
+
+  unsigned int batchSize = 0;
+
+  // Statistics
+  unsigned int spillsCount = 0,
+               erasesCount = 0;
+
+  unsigned long spilledSamplesCount = 0,
+                spilledBytesCount = 0;
+
+  bool begin() {
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, HISTORY_PARTITION_LABEL);
+
+    if (partition == NULL || partition->size < (2 * HISTORY_SECTOR_SIZE)) {
+      LOG_AT(HISTORY, 0, "[Storage:History] Error finding history partition! Was the sketch flashed w/ its partitions.csv?\n");
+
+      partition = NULL;
+
+      return false;
+    }
+
+    recover();
+
+    return true;
+  }
+
+  void recover() {
+    HistoryBlock block;
+    HistorySample samples[HISTORY_BLOCK_SAMPLES_MAXIMUM];
+
+    unsigned int latestOffset = HISTORY_OFFSET_NONE;
+
+    // Scan all blocks for the latest valid one
+    for (unsigned int offset = 0; offset < partition->size; offset += HISTORY_BLOCK_SIZE) {
+      if (readBlock(offset, block) == true && (latestOffset == HISTORY_OFFSET_NONE || block.header.sequence >= nextSequence)) {
+        latestOffset = offset;
+        nextSequence = block.header.sequence + 1;
+      }
+    }
+
+    // History is empty? (start from the first sector)
+    if (latestOffset == HISTORY_OFFSET_NONE) {
+      LOG_AT(HISTORY, 1, "[Storage:History] History is empty\n");
+
+      return;
+    }
+
+    nextOffset = (latestOffset + HISTORY_BLOCK_SIZE) % partition->size;
+
+    // Resume device time from the latest sample
+    readBlock(latestOffset, block);
+
+    unsigned int count = decode(block, samples);
+
+    baseMinute = samples[count - 1].minute + 1;
+
+    LOG_AT(HISTORY, 1, "[Storage:History] Recovered block #%u at offset %u (device time resumes at minute %u)\n", block.header.sequence, latestOffset, baseMinute);
+  }
+
+  uint32_t currentMinute() {
+    return baseMinute + (uint32_t)(esp_timer_get_time() / 60000000);
+  }
+
+  void record(uint8_t level) {
+    HistorySample &sample = batch[batchSize];
+
+    sample.minute = currentMinute();
+    sample.level = level;
+
+    batchSize++;
+
+    // Batch is full? Spill it to flash
+    if (batchSize >= HISTORY_BATCH_CAPACITY) {
+      spill();
+    }
+  }
+
+  void spill() {
+    HistoryBlock block;
+
+    if (partition == NULL) {
+      batchSize = 0;
+
+      return;
+    }
+
+    // Notice: a batch gets spilled over multiple blocks if it does not fit \
+    //   in a single block (ie. large deltas)
+    while (batchSize > 0) {
+      unsigned int count = encode(block, batch, batchSize);
+
+      if (writeBlock(block) == false) {
+        break;
+      }
+
+      spillsCount++;
+      spilledSamplesCount += count;
+      spilledBytesCount += sizeof(HistoryBlockHeader) + block.header.size;
+
+      // Pop spilled samples from batch
+      memmove(batch, batch + count, (batchSize - count) * sizeof(HistorySample));
+
+      batchSize -= count;
+    }
+
+    // Drop batch? (flash write failed)
+    batchSize = 0;
+  }
+
+  void print(uint32_t fromMinute) {
+    HistoryBlock block;
+    HistorySample samples[HISTORY_BLOCK_SAMPLES_MAXIMUM];
+
+    uint32_t nowMinute = currentMinute();
+
+    Serial.printf("\n*** Water Level History ***\n\n");
+
+    // Walk blocks from the oldest one (ie. the one after the write cursor)
+    if (partition != NULL) {
+      for (unsigned int i = 0; i < (partition->size / HISTORY_BLOCK_SIZE); i++) {
+        unsigned int offset = (nextOffset + i * HISTORY_BLOCK_SIZE) % partition->size;
+
+        if (readBlock(offset, block) == true) {
+          unsigned int count = decode(block, samples);
+
+          for (unsigned int j = 0; j < count; j++) {
+            printSample(samples[j], fromMinute, nowMinute);
+          }
+        }
+      }
+    }
+
+    // Walk samples not spilled yet
+    for (unsigned int i = 0; i < batchSize; i++) {
+      printSample(batch[i], fromMinute, nowMinute);
+    }
+
+    Serial.printf("\n%lu samples in %u blocks (%lu bytes, %.2f bytes per sample), %u samples in RAM\n\n", spilledSamplesCount, spillsCount, spilledBytesCount, (spilledSamplesCount > 0) ? ((float)spilledBytesCount / spilledSamplesCount) : 0.0, batchSize);
+  }
+
+  void printSample(HistorySample &sample, uint32_t fromMinute, uint32_t nowMinute) {
+    if (sample.minute >= fromMinute) {
+      Serial.printf("  %6u minutes ago = %d%%\n", nowMinute - sample.minute, sample.level);
+    }
+  }
+
+  unsigned int encode(HistoryBlock &block, HistorySample samples[], unsigned int count) {
+    uint8_t buffer[2 * HISTORY_VARINT_SIZE_MAXIMUM];
+
+    unsigned int encodedCount = 1;
+
+    block.header.magic = HISTORY_BLOCK_MAGIC;
+    block.header.minute = samples[0].minute;
+    block.header.level = samples[0].level;
+    block.header.size = 0;
+
+    for (unsigned int i = 1; i < count && encodedCount < HISTORY_BLOCK_SAMPLES_MAXIMUM; i++) {
+      int levelDelta = (int)samples[i].level - (int)samples[i - 1].level;
+
+      // Encode deltas (zig-zag maps signed level deltas to small unsigned)
+      unsigned int size = encodeVarint(buffer, samples[i].minute - samples[i - 1].minute);
+
+      size += encodeVarint(buffer + size, (levelDelta >= 0) ? (2 * levelDelta) : (-2 * levelDelta - 1));
+
+      // Block is full?
+      if ((block.header.size + size) > HISTORY_BLOCK_PAYLOAD_SIZE) {
+        break;
+      }
+
+      memcpy(block.payload + block.header.size, buffer, size);
+
+      block.header.size += size;
+      encodedCount++;
+    }
+
+    block.header.count = encodedCount;
+
+    // Clear unused payload (keeps flash bits erased)
+    memset(block.payload + block.header.size, 0xFF, HISTORY_BLOCK_PAYLOAD_SIZE - block.header.size);
+
+    return encodedCount;
+  }
+
+  unsigned int decode(HistoryBlock &block, HistorySample samples[]) {
+    unsigned int position = 0;
+
+    samples[0].minute = block.header.minute;
+    samples[0].level = block.header.level;
+
+    for (unsigned int i = 1; i < block.header.count; i++) {
+      uint32_t minuteDelta = decodeVarint(block.payload, position),
+               levelDelta = decodeVarint(block.payload, position);
+
+      samples[i].minute = samples[i - 1].minute + minuteDelta;
+      samples[i].level = samples[i - 1].level + (int)((levelDelta % 2 == 0) ? (levelDelta / 2) : -((levelDelta + 1) / 2));
+    }
+
+    return block.header.count;
+  }
+
+  unsigned int encodeVarint(uint8_t buffer[], uint32_t value) {
+    unsigned int size = 0;
+
+    // 7 bits per byte, high bit set if more bytes follow
+    do {
+      buffer[size] = (value & 0x7F) | ((value > 0x7F) ? 0x80 : 0x00);
+      value >>= 7;
+      size++;
+    } while (value > 0);
+
+    return size;
+  }
+
+  uint32_t decodeVarint(uint8_t buffer[], unsigned int &position) {
+    uint32_t value = 0;
+
+    for (unsigned int shift = 0; position < HISTORY_BLOCK_PAYLOAD_SIZE && shift < (7 * HISTORY_VARINT_SIZE_MAXIMUM); shift += 7) {
+      uint8_t byte = buffer[position++];
+
+      value |= (uint32_t)(byte & 0x7F) << shift;
+
+      if ((byte & 0x80) == 0) {
+        break;
+      }
+    }
+
+    return value;
+  }
+
+  bool writeBlock(HistoryBlock &block) {
+    block.header.sequence = nextSequence;
+    block.header.crc = 0;
+    block.header.crc = esp_rom_crc32_le(0, (const uint8_t *)&block, sizeof(HistoryBlockHeader) + block.header.size);
+
+    // Skip blocks that cannot be written to (ie. interrupted writes)
+    while (isBlockBlank(nextOffset) == false) {
+      // Entering a sector? It needs to be erased first (drops oldest blocks)
+      if (nextOffset % HISTORY_SECTOR_SIZE == 0) {
+        esp_partition_erase_range(partition, nextOffset, HISTORY_SECTOR_SIZE);
+
+        erasesCount++;
+
+        break;
+      }
+
+      nextOffset = (nextOffset + HISTORY_BLOCK_SIZE) % partition->size;
+    }
+
+    if (esp_partition_write(partition, nextOffset, &block, HISTORY_BLOCK_SIZE) != ESP_OK) {
+      LOG_AT(HISTORY, 0, "[Storage:History] Error writing block #%u at offset %u!\n", nextSequence, nextOffset);
+
+      return false;
+    }
+
+    nextOffset = (nextOffset + HISTORY_BLOCK_SIZE) % partition->size;
+    nextSequence++;
+
+    return true;
+  }
+
+  bool readBlock(unsigned int offset, HistoryBlock &block) {
+    if (esp_partition_read(partition, offset, &block, HISTORY_BLOCK_SIZE) != ESP_OK) {
+      return false;
+    }
+
+    // Check block integrity
+    if (block.header.magic != HISTORY_BLOCK_MAGIC || block.header.count == 0 || block.header.size > HISTORY_BLOCK_PAYLOAD_SIZE) {
+      return false;
+    }
+
+    uint32_t crc = block.header.crc;
+
+    block.header.crc = 0;
+
+    return crc == esp_rom_crc32_le(0, (const uint8_t *)&block, sizeof(HistoryBlockHeader) + block.header.size);
+  }
+
+  bool isBlockBlank(unsigned int offset) {
+    uint32_t words[sizeof(HistoryBlockHeader) / sizeof(uint32_t)];
+
+    // Notice: blocks are written at once, checking the header is enough
+    if (esp_partition_read(partition, offset, words, sizeof(words)) != ESP_OK) {
+      return false;
+    }
+
+    for (unsigned int i = 0; i < (sizeof(words) / sizeof(uint32_t)); i++) {
+      if (words[i] != 0xFFFFFFFF) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+};
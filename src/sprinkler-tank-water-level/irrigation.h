@@ -0,0 +1,49 @@
+// Sprinkler Tank (Water Level)
+//
+// Water level reporting for sprinkler tank
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+
+struct IrrigationSystem : Service::IrrigationSystem {
+  /**
+    [IrrigationSystem Characteristics]
+
+      - Active
+        - 0 = "Inactive"
+        - 1 = "Active" (ie. the garden is being watered)
+
+      - InUse
+        - 0 = "Not in use"
+        - 1 = "In use"
+
+      - StatusFault
+        - 0 = "No fault"
+        - 1 = "General fault" (ie. the water level sensor is faulted)
+  **/
+
+  SpanCharacteristic *active;
+  SpanCharacteristic *inUse;
+  SpanCharacteristic *statusFault;
+
+  IrrigationSystem() : Service::IrrigationSystem() {
+    // Notice: HomeKit can only write Active, as InUse is read and notify \
+    //   only, thus irrigation gets started or stopped through Active, while \
+    //   InUse follows it (the water level is polled faster while in use)
+    active = new Characteristic::Active(0);
+
+    new Characteristic::ProgramMode();
+
+    inUse = new Characteristic::InUse(0);
+    statusFault = new Characteristic::StatusFault(0);
+  }
+
+  bool update() {
+    // Irrigation started or stopped? (keep InUse in sync)
+    if (active->updated() == true && active->getNewVal() != inUse->getVal()) {
+      inUse->setVal(active->getNewVal());
+    }
+
+    return true;
+  }
+};
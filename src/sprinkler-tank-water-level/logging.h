@@ -0,0 +1,47 @@
+// Sprinkler Tank (Water Level)
+//
+// Water level reporting for sprinkler tank
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+// Notice: uncomment to build the production profile, where only errors \
+//   get logged (all other log statements get compiled out)
+// #define LOG_PROFILE_PRODUCTION
+
+#ifdef LOG_PROFILE_PRODUCTION
+#define LOG_LEVEL_DEFAULT 0
+#else
+#define LOG_LEVEL_DEFAULT 2
+#endif
+
+// Per-subsystem log levels (maximum level that gets compiled in)
+// Notice: -1 compiles out all statements, including errors
+#ifndef LOG_LEVEL_SENSOR
+#define LOG_LEVEL_SENSOR LOG_LEVEL_DEFAULT // [Sensor:WaterTankLevel]
+#endif
+
+#ifndef LOG_LEVEL_HISTORY
+#define LOG_LEVEL_HISTORY LOG_LEVEL_DEFAULT // [Storage:History]
+#endif
+
+#ifndef LOG_LEVEL_ESTIMATOR
+#define LOG_LEVEL_ESTIMATOR LOG_LEVEL_DEFAULT // [Estimator:Drain]
+#endif
+
+#ifndef LOG_LEVEL_SCHEDULER
+#define LOG_LEVEL_SCHEDULER LOG_LEVEL_DEFAULT // [Scheduler]
+#endif
+
+// Is a log statement compiled in? (constant expression)
+#define LOG_ENABLED(SUBSYSTEM, LEVEL) (LOG_LEVEL_##SUBSYSTEM >= LEVEL)
+
+// Log a statement at a level (0, 1 or 2) for a subsystem
+// Notice: statements above the subsystem level are behind a constant false \
+//   condition, thus get compiled out along w/ their arguments (which never \
+//   get evaluated). Statements within the subsystem level are then still \
+//   filtered by the HomeSpan log level, at run time.
+// Important: statements that pass both levels still get formatted and \
+//   written to the UART inline (HomeSpan LOG0/1/2 call Serial.printf), thus \
+//   hot-path events must be recorded to the trace instead (see trace.h), \
+//   which defers formatting to '@t' (or to the host, w/ '@d')
+#define LOG_AT(SUBSYSTEM, LEVEL, ...) do { if (LOG_ENABLED(SUBSYSTEM, LEVEL)) { LOG##LEVEL(__VA_ARGS__); } } while (0)
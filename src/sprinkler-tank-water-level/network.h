@@ -0,0 +1,130 @@
+// Sprinkler Tank (Water Level)
+//
+// Water level reporting for sprinkler tank
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+constexpr unsigned int networkLog2Ceil(unsigned int size, unsigned int log2 = 0) {
+  return ((1u << log2) >= size) ? log2 : networkLog2Ceil(size, log2 + 1);
+}
+
+template <typename T>
+inline void networkExchange(T values[], unsigned int i, unsigned int j) {
+  T left = values[i],
+    right = values[j];
+
+  // Notice: both selects compile to conditional moves (no branch)
+  values[i] = (right < left) ? right : left;
+  values[j] = (right < left) ? left : right;
+}
+
+// Pass: compare-exchange all (I, I + D) pairs where (I & P) == R
+template <typename T, unsigned int N, unsigned int P, unsigned int R, unsigned int D, unsigned int I, bool DONE = (I + D >= N)>
+struct NetworkPass {
+  static inline void apply(T values[]) {
+    if ((I & P) == R) {
+      networkExchange(values, I, I + D);
+    }
+
+    NetworkPass<T, N, P, R, D, I + 1>::apply(values);
+  }
+};
+
+template <typename T, unsigned int N, unsigned int P, unsigned int R, unsigned int D, unsigned int I>
+struct NetworkPass<T, N, P, R, D, I, true> {
+  static inline void apply(T[]) {}
+};
+
+// Round: passes for Q = 2^(T - 1), then halving until Q = P
+template <typename T, unsigned int N, unsigned int P, unsigned int Q, unsigned int R, unsigned int D, bool LAST = (Q == P)>
+struct NetworkRound {
+  static inline void apply(T values[]) {
+    NetworkPass<T, N, P, R, D, 0>::apply(values);
+    NetworkRound<T, N, P, Q / 2, P, Q - P>::apply(values);
+  }
+};
+
+template <typename T, unsigned int N, unsigned int P, unsigned int Q, unsigned int R, unsigned int D>
+struct NetworkRound<T, N, P, Q, R, D, true> {
+  static inline void apply(T values[]) {
+    NetworkPass<T, N, P, R, D, 0>::apply(values);
+  }
+};
+
+// Stage: rounds for P = 2^(T - 1), then halving until P = 0
+template <typename T, unsigned int N, unsigned int P>
+struct NetworkStage {
+  static inline void apply(T values[]) {
+    NetworkRound<T, N, P, (1u << (networkLog2Ceil(N) - 1)), 0, P>::apply(values);
+    NetworkStage<T, N, P / 2>::apply(values);
+  }
+};
+
+template <typename T, unsigned int N>
+struct NetworkStage<T, N, 0> {
+  static inline void apply(T[]) {}
+};
+
+template <typename T, unsigned int N>
+struct SortingNetwork {
+  /**
+    [Sorting Network]
+
+      - Sorts N values w/ a fixed sequence of compare-exchanges, generated at
+        compile time from Batcher's merge exchange (Knuth, TAOCP 5.2.2M),
+        which works for any N (not only powers of 2)
+
+      - The sequence is fully unrolled: there is no recursion, no loop and no
+        data-dependent branch at run time
+  **/
+
+  static_assert(N >= 2, "Sorting network must sort at least 2 values");
+
+  static inline void sort(T values[]) {
+    NetworkStage<T, N, (1u << (networkLog2Ceil(N) - 1))>::apply(values);
+  }
+
+  static inline T median(T values[]) {
+    sort(values);
+
+    // Notice: the median of an even count is the mean of both middle values
+    return ((N % 2) == 1) ? values[N / 2] : ((values[(N / 2) - 1] + values[N / 2]) / 2);
+  }
+
+  template <unsigned int TRIM>
+  static inline T trimmedMean(T values[]) {
+    static_assert((2 * TRIM) < N, "Trimmed mean must keep at least 1 value");
+
+    sort(values);
+
+    // Average values, w/o the TRIM lowest and TRIM highest ones (outliers)
+    T sum = 0;
+
+    for (unsigned int i = TRIM; i < (N - TRIM); i++) {
+      sum += values[i];
+    }
+
+    return sum / (N - (2 * TRIM));
+  }
+};
+
+template <typename T, unsigned int N>
+struct SortingNetworks {
+  /**
+    [Sorting Networks]
+
+      - Dispatches a run-time count of values (up to N) to the sorting
+        network generated for that count
+  **/
+
+  static inline T median(T values[], unsigned int count) {
+    return (count >= N) ? SortingNetwork<T, N>::median(values) : SortingNetworks<T, N - 1>::median(values, count);
+  }
+};
+
+template <typename T>
+struct SortingNetworks<T, 1> {
+  static inline T median(T values[], unsigned int) {
+    return values[0];
+  }
+};
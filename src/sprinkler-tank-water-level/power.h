@@ -0,0 +1,173 @@
+// Sprinkler Tank (Water Level)
+//
+// Water level reporting for sprinkler tank
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#include "WiFi.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_pm.h"
+
+// Notice: the minimum frequency keeps the APB clock at 80MHz, which RMT \
+//   channels and the UART are clocked from
+const int POWER_CPU_FREQUENCY_MAXIMUM = 160; // 160MHz (latency-critical work)
+const int POWER_CPU_FREQUENCY_MINIMUM = 80; // 80MHz (idle)
+
+const unsigned long POWER_IDLE_MAXIMUM_MILLISECONDS = 1000; // 1 second
+
+struct PowerLock {
+  /**
+    [Power Lock]
+
+      - Holds the CPU at its maximum frequency (and the chip out of light
+        sleep) while latency-critical work is in progress. Each subsystem
+        owns its lock, and only ever acquires and releases it from a single
+        task.
+
+      - Acquiring a held lock (or releasing a free lock) does nothing, so
+        that it can be driven from a state (eg. 'frames are queued')
+  **/
+
+  esp_pm_lock_handle_t handle = NULL;
+
+  bool isHeld = false;
+
+  unsigned long acquiredMicros = 0;
+
+  // Statistics
+  unsigned int acquiresCount = 0;
+
+  unsigned long heldMillis = 0;
+
+  void begin(const char *name) {
+    // Notice: fails if the core was built w/o power management (the lock \
+    //   then only counts acquires)
+    if (esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, name, &handle) != ESP_OK) {
+      handle = NULL;
+    }
+  }
+
+  void acquire() {
+    if (isHeld == true) {
+      return;
+    }
+
+    if (handle != NULL) {
+      esp_pm_lock_acquire(handle);
+    }
+
+    isHeld = true;
+    acquiredMicros = micros();
+    acquiresCount++;
+  }
+
+  void release() {
+    if (isHeld == false) {
+      return;
+    }
+
+    if (handle != NULL) {
+      esp_pm_lock_release(handle);
+    }
+
+    isHeld = false;
+    heldMillis += (micros() - acquiredMicros + 500) / 1000;
+  }
+};
+
+struct Power {
+  /**
+    [Power]
+
+      - The CPU clock scales between a minimum frequency (when idle) and a
+        maximum frequency (while any power lock is held), and the chip
+        enters automatic light sleep when both cores are idle, while Wi-Fi
+        modem sleep keeps the station associated in between beacons
+
+      - The device task idles until its next task deadline, or until the
+        HomeSpan task wakes it up (ie. a command was handed over), instead
+        of spinning through the loop
+
+      - If the core was built w/o power management (or w/o tickless idle),
+        the CPU falls back to a fixed minimum frequency (or the chip never
+        light sleeps), and idling still lets the idle tasks run
+  **/
+
+  TaskHandle_t deviceTask = NULL;
+
+  bool isScaling = false,
+       isLightSleeping = false;
+
+  // Statistics (written by the device task only)
+  unsigned int idlesCount = 0,
+               wakesCount = 0;
+
+  unsigned long idleMillis = 0;
+
+  // Wake latency (time past the deadline, once reached, in µs)
+  SchedulerHistogram wakeLatencyHistogram = {};
+
+  void begin() {
+    // Notice: this runs on the device task (ie. the Arduino loop task, which \
+    //   runs setup() first)
+    deviceTask = xTaskGetCurrentTaskHandle();
+
+    esp_pm_config_esp32_t config;
+
+    config.max_freq_mhz = POWER_CPU_FREQUENCY_MAXIMUM;
+    config.min_freq_mhz = POWER_CPU_FREQUENCY_MINIMUM;
+    config.light_sleep_enable = true;
+
+    if (esp_pm_configure(&config) == ESP_OK) {
+      isScaling = true;
+      isLightSleeping = true;
+    } else {
+      // Light sleep not supported? (retry w/ frequency scaling only)
+      config.light_sleep_enable = false;
+
+      if (esp_pm_configure(&config) == ESP_OK) {
+        isScaling = true;
+      } else {
+        setCpuFrequencyMhz(POWER_CPU_FREQUENCY_MINIMUM);
+      }
+    }
+
+    // Notice: applied once the Wi-Fi station starts (HomeSpan starts it)
+    WiFi.setSleep(WIFI_PS_MIN_MODEM);
+  }
+
+  void idle(unsigned long delayMillis) {
+    delayMillis = min(delayMillis, POWER_IDLE_MAXIMUM_MILLISECONDS);
+
+    if (delayMillis == 0) {
+      return;
+    }
+
+    unsigned long startMicros = micros();
+
+    // Notice: a wake up that happened while the device task was busy is \
+    //   kept pending, thus it ends the next idle right away
+    bool isWoken = (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(delayMillis)) > 0) ? true : false;
+
+    unsigned long elapsedMicros = micros() - startMicros;
+
+    idlesCount++;
+    idleMillis += (elapsedMicros + 500) / 1000;
+
+    // Measure wake latency (time past the deadline, once reached)
+    if (isWoken == true) {
+      wakesCount++;
+    } else {
+      wakeLatencyHistogram.record((elapsedMicros > (delayMillis * 1000)) ? (elapsedMicros - delayMillis * 1000) : 0);
+    }
+  }
+
+  void wake() {
+    // Notice: this runs on the HomeSpan task
+    if (deviceTask != NULL) {
+      xTaskNotifyGive(deviceTask);
+    }
+  }
+};
@@ -0,0 +1,105 @@
+// Sprinkler Tank (Water Level)
+//
+// Water level reporting for sprinkler tank
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+const unsigned long PUBLISHER_INTERVAL_NONE = 0;
+
+struct Publisher {
+  /**
+    [Publisher]
+
+      - Publishes values to a HomeKit characteristic, where each publish
+        sends an event notification to all paired controllers, thus values
+        are only published when they changed by more than a deadband
+
+      - Changes get published at most once per minimum interval, while
+        changes within the deadband still get published once the maximum
+        interval elapsed (so that small drifts eventually show)
+  **/
+
+  SpanCharacteristic *characteristic = NULL;
+
+  float deadband = 0.0;
+
+  unsigned long minimumIntervalMillis = PUBLISHER_INTERVAL_NONE,
+                maximumIntervalMillis = PUBLISHER_INTERVAL_NONE;
+
+  bool hasPublished = false;
+
+  float publishedValue = 0.0;
+
+  unsigned long publishedMillis = 0;
+
+  // Statistics
+  unsigned int publishesCount = 0,
+               suppressionsCount = 0;
+
+  void begin(SpanCharacteristic *target, float deadbandValue, unsigned long minimumInterval, unsigned long maximumInterval) {
+    characteristic = target;
+    deadband = deadbandValue;
+    minimumIntervalMillis = minimumInterval;
+    maximumIntervalMillis = maximumInterval;
+  }
+
+  bool publish(float value) {
+    unsigned long elapsedMillis = millis() - publishedMillis;
+
+    float change = fabsf(value - publishedValue);
+
+    // Publish? (first value, significant change, or drift past maximum \
+    //   interval)
+    bool isPublished = hasPublished == false ||
+                         (change > deadband && elapsedMillis >= minimumIntervalMillis) ||
+                         (change > 0.0 && maximumIntervalMillis != PUBLISHER_INTERVAL_NONE && elapsedMillis >= maximumIntervalMillis);
+
+    if (isPublished == false) {
+      // Notice: only count actual changes as suppressed notifications
+      if (change > 0.0) {
+        suppressionsCount++;
+      }
+
+      return false;
+    }
+
+    characteristic->setVal(value);
+
+    hasPublished = true;
+    publishedValue = value;
+    publishedMillis = millis();
+    publishesCount++;
+
+    return true;
+  }
+};
+
+struct Hysteresis {
+  /**
+    [Hysteresis]
+
+      - Raises a flag once a value falls to a set level, and only lowers it
+        once the value rises back to a (higher) clear level, so that the
+        flag does not flap when the value hovers around a single threshold
+  **/
+
+  float setLevel = 0.0,
+        clearLevel = 0.0;
+
+  bool isRaised = false;
+
+  void begin(float setLevelValue, float clearLevelValue) {
+    setLevel = setLevelValue;
+    clearLevel = clearLevelValue;
+  }
+
+  bool update(float value) {
+    if (value <= setLevel) {
+      isRaised = true;
+    } else if (value >= clearLevel) {
+      isRaised = false;
+    }
+
+    return isRaised;
+  }
+};
@@ -4,26 +4,155 @@
 // Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
 // License: Mozilla Public License v2.0 (MPL v2.0)
 
-const int POLL_EVERY_MILLISECONDS = 600000; // 10 minutes
+#include "logging.h"
+#include "scheduler.h"
+#include "power.h"
+#include "ultrasonic.h"
+#include "network.h"
+#include "health.h"
+#include "irrigation.h"
+#include "history.h"
+#include "estimator.h"
+#include "publisher.h"
+#include "queue.h"
+#include "trace.h"
+
+const unsigned long POLL_EVERY_MILLISECONDS = 600000; // 10 minutes (initial, and reference schedule)
+const unsigned long POLL_EVERY_MILLISECONDS_MINIMUM = 60000; // 1 minute (irrigating, or draining fast)
+const unsigned long POLL_EVERY_MILLISECONDS_MAXIMUM = 3600000; // 1 hour (flat level)
+
+const unsigned int POLL_LEVEL_STEP = 2; // 2% (level is moving, above noise)
 
 const float WATER_TANK_SENSOR_OFFSET_DISTANCE = 1.0; // 1.0 centimeters
 const float WATER_TANK_FILL_EMPTY_DISTANCE = 28.0; // 28.0 centimeters
 
-const unsigned int WATER_LEVEL_PROBE_DELAY = 10; // 1/100 second
-const unsigned int WATER_LEVEL_PROBE_SAMPLES = 10;
+const unsigned int WATER_LEVEL_PROBE_DELAY = 10; // 1/100 second (echo must be back by then)
+const unsigned int WATER_LEVEL_PROBE_SAMPLES = 10; // Maximum samples per probe
+const unsigned int WATER_LEVEL_PROBE_SAMPLES_MINIMUM = 3;
+const unsigned int WATER_LEVEL_PROBE_TOLERANCE = 5; // 0.5% (half of a reported level step, in permille)
+
+// Notice: an echo cannot take longer than a round trip to the bottom of an \
+//   empty tank (w/ some margin), any longer echo is a fault
+const unsigned long WATER_LEVEL_ECHO_TIMEOUT_MICROSECONDS = (WATER_TANK_SENSOR_OFFSET_DISTANCE + WATER_TANK_FILL_EMPTY_DISTANCE) * 2 * 29.1 * 1.25;
+
+// Notice: echo durations are converted to a level in permille w/ integer \
+//   arithmetic (Q16 fixed-point), as follows: \
+//   emptied = (echo / (2 x 29.1) - offset) / empty x 1000 \
+//           = echo x SCALE - OFFSET
+const uint32_t WATER_LEVEL_ECHO_SCALE_Q16 = (65536.0 * 1000.0) / (2 * 29.1 * WATER_TANK_FILL_EMPTY_DISTANCE) + 0.5;
+const uint32_t WATER_LEVEL_ECHO_OFFSET_Q16 = (65536.0 * 1000.0 * WATER_TANK_SENSOR_OFFSET_DISTANCE) / WATER_TANK_FILL_EMPTY_DISTANCE + 0.5;
+
+const unsigned int WATER_LEVEL_LOW = 20; // 20% (low level gets raised)
+const unsigned int WATER_LEVEL_LOW_CLEAR = 25; // 25% (low level gets cleared)
+const float WATER_LEVEL_LOW_FORECAST_HOURS = 24.0; // 1 day (low level gets reported ahead)
+
+const float PUBLISH_WATER_LEVEL_DEADBAND = 1.0; // 1% (sensor noise)
+const unsigned long PUBLISH_WATER_LEVEL_MINIMUM_INTERVAL_MILLISECONDS = 300000; // 5 minutes
+const unsigned long PUBLISH_WATER_LEVEL_MAXIMUM_INTERVAL_MILLISECONDS = 21600000; // 6 hours
+
+const unsigned int WATER_LEVEL_FAILURES_THRESHOLD = 3;
+const unsigned long WATER_LEVEL_BACKOFF_MINIMUM_MILLISECONDS = 30000; // 30 seconds
+const unsigned long WATER_LEVEL_BACKOFF_MAXIMUM_MILLISECONDS = 3600000; // 1 hour
 
 const int WATER_LEVEL_SENSOR_PIN_TRIGGER = 22; // Yellow cable
 const int WATER_LEVEL_SENSOR_PIN_ECHO = 21; // Blue cable
 
+const unsigned int TASK_PRIORITY_PROBE = 0;
+
+const unsigned long TASK_BUDGET_PROBE_MICROSECONDS = 2000; // 2 milliseconds (1 sample)
+
+const uint32_t HOMESPAN_TASK_STACK_SIZE = 8192;
+const uint32_t HOMESPAN_TASK_PRIORITY = 1;
+const uint32_t HOMESPAN_TASK_CORE = 0; // Runs along w/ the Wi-Fi stack (device I/O runs on the other core)
+
+const unsigned int SENSOR_COMMANDS_CAPACITY = 4;
+const unsigned int SENSOR_READINGS_CAPACITY = 8;
+
+const unsigned int HISTORY_PRINT_HOURS_DEFAULT = 24; // 1 day
+
+enum SENSOR_COMMAND_TYPES {
+  // From HomeSpan task, to device task
+  SENSOR_COMMAND_TYPE_IN_USE  = 0, // Irrigation started or stopped
+  SENSOR_COMMAND_TYPE_HISTORY = 1  // History print was requested (in hours)
+};
+
+enum SENSOR_READING_TYPES {
+  // From device task, to HomeSpan task
+  SENSOR_READING_TYPE_LEVEL     = 0,
+  SENSOR_READING_TYPE_LOW_LEVEL = 1,
+  SENSOR_READING_TYPE_FAULT     = 2
+};
+
+enum TRACE_EVENTS {
+  TRACE_EVENT_PROBE_STARTED       = 0,
+  TRACE_EVENT_SAMPLE_CAPTURED     = 1,
+  TRACE_EVENT_SAMPLE_NO_ECHO      = 2,
+  TRACE_EVENT_SAMPLE_OUT_OF_RANGE = 3,
+  TRACE_EVENT_LEVEL_UPDATED       = 4,
+  TRACE_EVENT_PROBE_DONE          = 5,
+
+  TRACE_EVENTS_COUNT
+};
+
+// Notice: each format takes 2 arguments (16 bits + 32 bits)
+const char *const TRACE_EVENT_FORMATS[TRACE_EVENTS_COUNT] = {
+  "Probe started",
+  "Water level sample captured = %u permille (%uµs)",
+  "Water level sample #%u failed! No echo.",
+  "Water level sample #%u failed! Echo out of range (%uµs).",
+  "Water level updated = %u%% (%u samples)",
+  "Probe done (low level = %u), next in %ums"
+};
+
+struct SensorCommand {
+  uint8_t type;
+  int value;
+};
+
+struct SensorReading {
+  uint8_t type;
+  int value;
+};
+
 struct WaterTankLevelSensor : Service::BatteryService {
-  bool valuesInitialized;
+  Scheduler<WaterTankLevelSensor> scheduler;
+  unsigned int taskProbe;
+  UltrasonicRanger ranger;
+  Power power;
+  PowerLock probePowerLock;
+  unsigned int samples[WATER_LEVEL_PROBE_SAMPLES]; // Permille levels
+  unsigned int nextSampleIndex;
+  unsigned int sampleAttemptsCount;
+  bool isSampling;
+  CircuitBreaker health;
+  Trace trace;
+  History history;
+  DrainEstimator drain;
+  unsigned long pollEveryMillis;
+  int lastPollLevel;
+  Publisher waterLevelPublisher;
+  Publisher statusLowBatteryPublisher;
+  Hysteresis lowLevel;
+  unsigned int probesCount;
+  unsigned long probesSamplesCount;
   SpanCharacteristic *waterLevel;
   SpanCharacteristic *statusLowBattery;
+  SpanCharacteristic *statusFault;
+  SpanCharacteristic *inUse;
+  bool wasInUse;
+  bool isInUse;
+  Queue<SensorCommand, SENSOR_COMMANDS_CAPACITY> commands;
+  Queue<SensorReading, SENSOR_READINGS_CAPACITY> readings;
+  SchedulerHistogram pollCadenceHistogram;
+  SchedulerHistogram devicePassHistogram;
+  unsigned long lastPollMicros;
+  int deviceCore;
+
+  WaterTankLevelSensor(SpanCharacteristic *irrigationStatusFault, SpanCharacteristic *irrigationInUse) : Service::BatteryService() {
+    // Configure power management (the CPU runs at its minimum frequency, \
+    //   unless a probe is in progress)
+    power.begin();
 
-  WaterTankLevelSensor() : Service::BatteryService() {
-    // Mark values as not initialized
-    valuesInitialized = false;
-    
     // Configure water level characteristics
     new Characteristic::ChargingState(0);
 
@@ -32,140 +161,478 @@ struct WaterTankLevelSensor : Service::BatteryService {
 
     statusLowBattery = new Characteristic::StatusLowBattery(0);
 
-    // Configure water level sensor pins
-    pinMode(WATER_LEVEL_SENSOR_PIN_TRIGGER, OUTPUT);
-    pinMode(WATER_LEVEL_SENSOR_PIN_ECHO, INPUT);
+    // Configure water level publishers (suppress insignificant notifications)
+    waterLevelPublisher.begin(waterLevel, PUBLISH_WATER_LEVEL_DEADBAND, PUBLISH_WATER_LEVEL_MINIMUM_INTERVAL_MILLISECONDS, PUBLISH_WATER_LEVEL_MAXIMUM_INTERVAL_MILLISECONDS);
+    statusLowBatteryPublisher.begin(statusLowBattery, 0.0, PUBLISHER_INTERVAL_NONE, PUBLISHER_INTERVAL_NONE);
+
+    lowLevel.begin(WATER_LEVEL_LOW, WATER_LEVEL_LOW_CLEAR);
+
+    // Notice: the battery service has no fault characteristic, thus the \
+    //   sensor health is reported on the irrigation system
+    statusFault = irrigationStatusFault;
+
+    // Notice: the water level is polled faster while irrigating
+    inUse = irrigationInUse;
+    wasInUse = false;
+    isInUse = false;
+
+    // Configure water level sensor (echo gets captured w/ an interrupt)
+    ranger.begin(WATER_LEVEL_SENSOR_PIN_TRIGGER, WATER_LEVEL_SENSOR_PIN_ECHO);
+
+    // Notice: echoes are timed from an interrupt handler, thus the chip must \
+    //   not light sleep while a probe is in progress
+    probePowerLock.begin("probe");
+
+    nextSampleIndex = 0;
+    sampleAttemptsCount = 0;
+    isSampling = false;
+    probesCount = 0;
+    probesSamplesCount = 0;
+    pollEveryMillis = POLL_EVERY_MILLISECONDS;
+    lastPollLevel = -1;
+    lastPollMicros = 0;
+    deviceCore = -1;
+
+    memset(&pollCadenceHistogram, 0, sizeof(pollCadenceHistogram));
+    memset(&devicePassHistogram, 0, sizeof(devicePassHistogram));
+
+    // Configure sensor health (probing backs off once faulted)
+    health.begin(WATER_LEVEL_FAILURES_THRESHOLD, WATER_LEVEL_BACKOFF_MINIMUM_MILLISECONDS, WATER_LEVEL_BACKOFF_MAXIMUM_MILLISECONDS);
+
+    // Configure trace of latest events
+    trace.begin(TRACE_EVENT_FORMATS, TRACE_EVENTS_COUNT);
+
+    // Configure water level history (recovers device time from flash)
+    history.begin();
+
+    // Schedule probe task (first probe runs right away)
+    scheduler.begin();
+
+    taskProbe = scheduler.add("probe", TASK_PRIORITY_PROBE, this, &WaterTankLevelSensor::runTaskProbe, 0, TASK_BUDGET_PROBE_MICROSECONDS);
+
+    // Register task statistics command (type '@s' in the serial console)
+    new SpanUserCommand('s', "- print task statistics", printTaskStatistics, this);
+
+    // Register water level history command (type '@h' in the serial console)
+    new SpanUserCommand('h', "<hours> - print water level history", printHistory, this);
+
+    // Register trace command (type '@t' in the serial console)
+    new SpanUserCommand('t', "- print trace of latest events", printTrace, this);
+
+    // Register trace dump command (type '@d' in the serial console)
+    new SpanUserCommand('d', "- dump trace of latest events (hex, decoded on a host)", dumpTrace, this);
+
+    // Register current values command (type '@v' in the serial console)
+    new SpanUserCommand('v', "- print current values", printCurrentValues, this);
+  }
+
+  static void printTrace(const char *buffer, void *context) {
+    ((WaterTankLevelSensor *)context)->trace.print();
+  }
+
+  static void dumpTrace(const char *buffer, void *context) {
+    ((WaterTankLevelSensor *)context)->trace.dump();
+  }
+
+  static void printCurrentValues(const char *buffer, void *context) {
+    WaterTankLevelSensor *sensor = (WaterTankLevelSensor *)context;
+
+    Serial.printf("\n*** Current Values ***\n\n");
+
+    Serial.printf("[Sensor:WaterTankLevel] Current water level values are:\n");
+    sensor->logSnapshotValues();
+    Serial.printf("[Sensor:WaterTankLevel] Current scheduler values are:\n");
+    sensor->scheduler.logSnapshot();
+  }
+
+  static void printTaskStatistics(const char *buffer, void *context) {
+    WaterTankLevelSensor *sensor = (WaterTankLevelSensor *)context;
+
+    sensor->scheduler.printStatistics();
+    sensor->printRuntimeStatistics();
+  }
+
+  void printRuntimeStatistics() {
+    SchedulerHistogram &histogram = pollCadenceHistogram;
+
+    Serial.printf("*** Runtime Statistics ***\n\n");
+    Serial.printf("HomeSpan task (core %d):\n", HOMESPAN_TASK_CORE);
+    Serial.printf("  - Polls = %u\n", histogram.samplesCount);
+    Serial.printf("  - Poll Cadence = mean %uµs, p50 %uµs, p90 %uµs, p99 %uµs, max %uµs\n", histogram.mean(), histogram.percentile(50), histogram.percentile(90), histogram.percentile(99), histogram.maximum);
+    histogram.printBuckets("µs");
+    Serial.printf("  - Dropped Readings = %u\n", (unsigned int)readings.dropsCount);
+    Serial.printf("Device task (core %d):\n", deviceCore);
+    Serial.printf("  - Passes = %u\n", devicePassHistogram.samplesCount);
+    Serial.printf("  - Pass Time = mean %uµs, p50 %uµs, p90 %uµs, p99 %uµs, max %uµs\n", devicePassHistogram.mean(), devicePassHistogram.percentile(50), devicePassHistogram.percentile(90), devicePassHistogram.percentile(99), devicePassHistogram.maximum);
+    Serial.printf("  - Dropped Commands = %u\n", (unsigned int)commands.dropsCount);
+    Serial.printf("  - Idle = %lums (%u idles, %u woken up by HomeSpan)\n", power.idleMillis, power.idlesCount, power.wakesCount);
+    Serial.printf("  - Wake Latency = mean %uµs, p50 %uµs, p99 %uµs, max %uµs (%u wakes at deadline)\n", power.wakeLatencyHistogram.mean(), power.wakeLatencyHistogram.percentile(50), power.wakeLatencyHistogram.percentile(99), power.wakeLatencyHistogram.maximum, power.wakeLatencyHistogram.samplesCount);
+    Serial.printf("Power (%s, %s):\n", (power.isScaling == true) ? "frequency scaling" : "fixed frequency", (power.isLightSleeping == true) ? "light sleep" : "no light sleep");
+    Serial.printf("  - Uptime = %lums\n", millis());
+    Serial.printf("  - Probes = %u boosts (%lums)\n\n", probePowerLock.acquiresCount, probePowerLock.heldMillis);
+  }
+
+  static void printHistory(const char *buffer, void *context) {
+    SensorCommand command;
+
+    // Notice: user commands run on the HomeSpan task, thus the history gets \
+    //   printed from the device task (which owns the history)
+    command.type = SENSOR_COMMAND_TYPE_HISTORY;
+    command.value = atoi(buffer + 1);
+
+    WaterTankLevelSensor *sensor = (WaterTankLevelSensor *)context;
+
+    if (sensor->commands.push(command) == true) {
+      sensor->power.wake();
+    }
   }
 
   void loop() {
-    // Wait until next poll is possible
+    // Notice: this runs on the HomeSpan task, which owns HK values, while \
+    //   the device task owns the sensor, the history and the scheduler. \
+    //   Both only talk through queues.
     // Warning: never block this main loop with a delay(), as this will cause \
     //   the accessory from being marked as 'not responding' on the Home app.
-    if (valuesInitialized == false || waterLevel->timeVal() > POLL_EVERY_MILLISECONDS){
-      LOG1("[Sensor:WaterTankLevel] Loop tick in progress...\n");
-  
-      // Check current water level
-      pollAndUpdate();
-  
-      LOG1("[Sensor:WaterTankLevel] Loop tick done, next in %dms\n", POLL_EVERY_MILLISECONDS);
+    unsigned long nowMicros = micros();
+
+    // Measure poll cadence (worst case is the HAP response time)
+    if (lastPollMicros > 0) {
+      pollCadenceHistogram.record(nowMicros - lastPollMicros);
+    }
+
+    lastPollMicros = nowMicros;
+
+    // Irrigation started or stopped? (hand it over to the device task)
+    // Notice: InUse follows the Active characteristic, which HomeKit writes
+    bool isInUseNow = (inUse->getVal() == 1) ? true : false;
+
+    if (isInUseNow != wasInUse) {
+      SensorCommand command;
+
+      command.type = SENSOR_COMMAND_TYPE_IN_USE;
+      command.value = isInUseNow ? 1 : 0;
+
+      // Notice: retried on next loop if the queue is full
+      if (commands.push(command) == true) {
+        wasInUse = isInUseNow;
+
+        power.wake();
+      }
+    }
+
+    // Apply readings from the device task to HK
+    SensorReading reading;
+
+    while (readings.pop(reading) == true) {
+      applyReading(reading);
+    }
+  }
+
+  void runDevice() {
+    // Notice: this runs on the device task (ie. the Arduino loop task, on \
+    //   the core that does not run HomeSpan)
+    SensorCommand command;
+
+    deviceCore = xPortGetCoreID();
+
+    unsigned long startMicros = micros();
 
-      // Mark values as initialized (used for the first pass only)
-      valuesInitialized = true;
+    // Apply commands from the HomeSpan task
+    while (commands.pop(command) == true) {
+      applyCommand(command);
+    }
+
+    // Run probe task once due
+    bool hasRun = scheduler.run();
+
+    // Measure pass time (w/o idles), ie. the HomeSpan poll cadence if \
+    //   HomeSpan still ran on the same core (as before both were split)
+    devicePassHistogram.record(micros() - startMicros);
+
+    if (hasRun == true) {
+      return;
+    }
+
+    // Idle until the next probe tick is due, or until woken up by the \
+    //   HomeSpan task (the chip light sleeps if the other core idles as well)
+    power.idle(scheduler.millisUntilNextDeadline());
+  }
+
+  void applyCommand(SensorCommand &command) {
+    switch (command.type) {
+      case SENSOR_COMMAND_TYPE_IN_USE:
+        // Irrigation just started? Probe right away (unless already probing)
+        if (command.value == 1 && isInUse == false && isSampling == false) {
+          pollEveryMillis = POLL_EVERY_MILLISECONDS_MINIMUM;
+
+          scheduler.wake(taskProbe, 0);
+        }
+
+        isInUse = (command.value == 1) ? true : false;
+        break;
+
+      case SENSOR_COMMAND_TYPE_HISTORY:
+        printHistoryHours((command.value > 0) ? command.value : HISTORY_PRINT_HOURS_DEFAULT);
+        break;
+    }
+  }
+
+  void applyReading(SensorReading &reading) {
+    switch (reading.type) {
+      case SENSOR_READING_TYPE_LEVEL:
+        waterLevelPublisher.publish(reading.value);
+        break;
+
+      case SENSOR_READING_TYPE_LOW_LEVEL:
+        statusLowBatteryPublisher.publish(reading.value);
+        break;
+
+      case SENSOR_READING_TYPE_FAULT:
+        if (statusFault->getVal() != reading.value) {
+          statusFault->setVal(reading.value);
+        }
+        break;
+    }
+  }
+
+  void pushReading(int type, int value) {
+    SensorReading reading;
+
+    reading.type = type;
+    reading.value = value;
+
+    if (readings.push(reading) == false) {
+      LOG_AT(SENSOR, 0, "[Sensor:WaterTankLevel] Error handing reading over to HomeSpan task! Too many readings in flight.\n");
     }
   }
 
+  void printHistoryHours(unsigned int hours) {
+    // Acquire time range (in hours, from now)
+    uint32_t nowMinute = history.currentMinute(),
+             rangeMinutes = (uint32_t)hours * 60;
+
+    history.print((nowMinute > rangeMinutes) ? (nowMinute - rangeMinutes) : 0);
+  }
+
+  unsigned long runTaskProbe() {
+    // Collect the sample that was triggered on the previous tick?
+    if (isSampling == true) {
+      sampleAttemptsCount++;
+
+      if (acquireWaterLevelSample(sampleAttemptsCount, samples[nextSampleIndex]) == true) {
+        nextSampleIndex++;
+
+        // Sensor recovered from a fault? (clear it)
+        if (health.recordSuccess() == true) {
+          pushReading(SENSOR_READING_TYPE_FAULT, 0);
+        }
+      } else if (health.recordFailure() == true) {
+        // Too many failures, stop probing (sensor is faulted)
+        return faultProbe();
+      }
+    } else {
+      trace.record(TRACE_EVENT_PROBE_STARTED);
+
+      probePowerLock.acquire();
+
+      isSampling = true;
+    }
+
+    // Trigger next sample? (collected on next tick)
+    // Notice: samples are acquired one per tick, as not to block the main \
+    //   loop while waiting for echoes. Sampling stops early once acquired \
+    //   samples agree w/ each other.
+    if (sampleAttemptsCount < WATER_LEVEL_PROBE_SAMPLES && isWaterLevelSettled() == false) {
+      ranger.trigger();
+
+      return WATER_LEVEL_PROBE_DELAY;
+    }
+
+    // All samples acquired, check current water level
+    if (nextSampleIndex > 0) {
+      pollAndUpdate();
+    }
+
+    nextSampleIndex = 0;
+    sampleAttemptsCount = 0;
+    isSampling = false;
+
+    probePowerLock.release();
+
+    trace.record(TRACE_EVENT_PROBE_DONE, lowLevel.isRaised ? 1 : 0, pollEveryMillis);
+
+    return pollEveryMillis;
+  }
+
+  unsigned long faultProbe() {
+    unsigned long retryDelayMillis = health.retry();
+
+    // Mark sensor as faulted (level is not updated anymore)
+    pushReading(SENSOR_READING_TYPE_FAULT, 1);
+
+    nextSampleIndex = 0;
+    sampleAttemptsCount = 0;
+    isSampling = false;
+
+    probePowerLock.release();
+
+    LOG_AT(SENSOR, 0, "[Sensor:WaterTankLevel] Water level sensor faulted after %d failed samples! Is the sensor connected? Retrying in %lums\n", health.consecutiveFailuresCount, retryDelayMillis);
+
+    return retryDelayMillis;
+  }
+
   void pollAndUpdate() {
     unsigned int tickWaterLevel = probeWaterLevel();
-    bool isLowLevel = tickWaterLevel <= 20 ? true : false;
 
-    waterLevel->setVal(tickWaterLevel);
-    statusLowBattery->setVal(isLowLevel ? 1 : 0);
+    // Update drain rate estimate (used to forecast low water level)
+    drain.update(history.currentMinute(), tickWaterLevel);
+
+    // Notice: the low level is reported as soon as the level is forecast to \
+    //   reach it soon, so that the tank can be refilled ahead of time. It \
+    //   only gets cleared once the level rose past a higher level, as not \
+    //   to flap around the low level.
+    bool isLowLevel = lowLevel.update(min((float)tickWaterLevel, drain.forecastLevel(WATER_LEVEL_LOW_FORECAST_HOURS)));
+
+    // Update HK values (from HomeSpan task, unless changes are insignificant)
+    pushReading(SENSOR_READING_TYPE_LEVEL, tickWaterLevel);
+    pushReading(SENSOR_READING_TYPE_LOW_LEVEL, isLowLevel ? 1 : 0);
+
+    // Adapt poll interval to how fast the level moves
+    adaptPollInterval(tickWaterLevel);
+
+    // Append to history (flash only gets written once per batch)
+    history.record(tickWaterLevel);
 
-    LOG1("[Sensor:WaterTankLevel] Water level updated:\n");
-    LOG1("  - Level = %d%%\n", tickWaterLevel);
-    if (isLowLevel) {
-      LOG1("  - (!) Low water level\n");
+    probesCount++;
+    probesSamplesCount += nextSampleIndex;
+
+    trace.record(TRACE_EVENT_LEVEL_UPDATED, tickWaterLevel, nextSampleIndex);
+  }
+
+  void logSnapshotValues() {
+    Serial.printf("  - Level = %d%%\n", lastPollLevel);
+    Serial.printf("  - Samples = %lu (mean: %.1f per probe, maximum: %d)\n", probesSamplesCount, (probesCount > 0) ? ((float)probesSamplesCount / probesCount) : 0.0, WATER_LEVEL_PROBE_SAMPLES);
+    Serial.printf("  - Failed Samples = %d (sensor faulted %d times)\n", health.failuresCount, health.opensCount);
+    Serial.printf("  - Drain Rate = %.2f%% per hour (%d refills)\n", -drain.rate(), drain.refillsCount);
+    Serial.printf("  - Time To Low Level = %.1f hours\n", drain.hoursToLevel(WATER_LEVEL_LOW));
+    Serial.printf("  - Time To Empty = %.1f hours\n", drain.hoursToLevel(0.0));
+    Serial.printf("  - Poll Interval = %lus (%.1f probes saved per day)\n", pollEveryMillis / 1000, probesSavedPerDay());
+    Serial.printf("  - Notifications = %d published, %d suppressed\n", waterLevelPublisher.publishesCount + statusLowBatteryPublisher.publishesCount, waterLevelPublisher.suppressionsCount + statusLowBatteryPublisher.suppressionsCount);
+    if (lowLevel.isRaised == true) {
+      Serial.printf("  - (!) Low water level\n");
     }
   }
 
-  unsigned int probeWaterLevel() {
-    // Acquire multiple measurement samples
-    unsigned int nextSampleIndex = 0;
-    float samples[WATER_LEVEL_PROBE_SAMPLES] = {};
+  void adaptPollInterval(unsigned int tickWaterLevel) {
+    // Notice: irrigating polls at the fastest rate, a moving level halves \
+    //   the interval, while a flat level doubles it (up to the time the \
+    //   estimated drain rate takes to move the level by a step)
+    if (isInUse == true) {
+      pollEveryMillis = POLL_EVERY_MILLISECONDS_MINIMUM;
+    } else if (lastPollLevel >= 0 && abs((int)tickWaterLevel - lastPollLevel) >= POLL_LEVEL_STEP) {
+      pollEveryMillis = max(pollEveryMillis / 2, POLL_EVERY_MILLISECONDS_MINIMUM);
+    } else {
+      unsigned long pollCeilingMillis = POLL_EVERY_MILLISECONDS_MAXIMUM;
+      float drainRate = drain.rate();
+
+      if (drainRate < -DRAIN_ESTIMATOR_RATE_MINIMUM) {
+        pollCeilingMillis = min(pollCeilingMillis, (unsigned long)(POLL_LEVEL_STEP * 3600000.0 / -drainRate));
+      }
 
-    while (nextSampleIndex < WATER_LEVEL_PROBE_SAMPLES) {
-      // Probe sample
-      samples[nextSampleIndex] = probeWaterLevelSample(nextSampleIndex + 1);
+      pollEveryMillis = max(min(pollEveryMillis * 2, pollCeilingMillis), POLL_EVERY_MILLISECONDS_MINIMUM);
+    }
+
+    lastPollLevel = tickWaterLevel;
+  }
 
-      // Increment next sample index
-      nextSampleIndex++;
+  float probesSavedPerDay() {
+    // Compare against the reference schedule (fixed interval)
+    float days = millis() / 86400000.0,
+          referenceProbesCount = millis() / (float)POLL_EVERY_MILLISECONDS;
 
-      // Hold on to probe next sample
-      // Warning: make sure this delay is kept very short, as not to block \
-      //   the main loop.
-      delay(WATER_LEVEL_PROBE_DELAY);
+    if (days <= 0.0) {
+      return 0.0;
     }
 
-    // Sort samples (required for the median value)
-    floatQuickSort(samples, 0, WATER_LEVEL_PROBE_SAMPLES - 1);
+    return (referenceProbesCount - probesCount) / days;
+  }
 
+  unsigned int probeWaterLevel() {
     // Acquire the median value (this makes sure outliers are not considered)
-    float tickWaterLevelMedian = samples[(WATER_LEVEL_PROBE_SAMPLES / 2) - 1];
+    // Notice: samples are sorted w/ a sorting network, unrolled at compile \
+    //   time for each possible number of samples
+    unsigned int tickWaterLevelMedian = SortingNetworks<unsigned int, WATER_LEVEL_PROBE_SAMPLES>::median(samples, nextSampleIndex);
 
-    // Round up water level to an integer
-    unsigned int tickWaterLevel = round(tickWaterLevelMedian);
+    // Round up water level to a percentage
+    unsigned int tickWaterLevel = (tickWaterLevelMedian + 5) / 10;
 
     return tickWaterLevel;
   }
 
-  float probeWaterLevelSample(unsigned int sampleIndex) {
-    // Wake up the sensor (ie. trigger)
-    digitalWrite(WATER_LEVEL_SENSOR_PIN_TRIGGER, LOW);
-    delayMicroseconds(5);
-    digitalWrite(WATER_LEVEL_SENSOR_PIN_TRIGGER, HIGH);
-    delayMicroseconds(10);
-    digitalWrite(WATER_LEVEL_SENSOR_PIN_TRIGGER, LOW);
-
-    pinMode(WATER_LEVEL_SENSOR_PIN_ECHO, INPUT);
+  bool isWaterLevelSettled() {
+    unsigned int sortedSamples[WATER_LEVEL_PROBE_SAMPLES],
+                 deviations[WATER_LEVEL_PROBE_SAMPLES];
 
-    // Acquire echo duration
-    unsigned long durationSample = pulseIn(WATER_LEVEL_SENSOR_PIN_ECHO, HIGH);
-
-    // Duration is zero? Report fault
-    if (durationSample == 0) {
-      LOG0("[Sensor:WaterTankLevel] Water level sample failed! Is the sensor connected?\n");
-      
-      return 0.0;
+    // Not enough samples yet? (cannot tell)
+    if (nextSampleIndex < WATER_LEVEL_PROBE_SAMPLES_MINIMUM) {
+      return false;
     }
 
-    // Convert the time to echo into a distance
-    float distanceSample = ((float)durationSample / 2) / 29.1;
+    // Acquire median + median absolute deviation (MAD) of samples
+    memcpy(sortedSamples, samples, nextSampleIndex * sizeof(unsigned int));
 
-    // Apply sensor offset from water at 100% level
-    distanceSample -= WATER_TANK_SENSOR_OFFSET_DISTANCE;
+    unsigned int median = SortingNetworks<unsigned int, WATER_LEVEL_PROBE_SAMPLES>::median(sortedSamples, nextSampleIndex);
 
-    // Compute water level percentage
-    // Important: restrict between [0.0; 100.0]
-    float levelPercentSample = 100.0 - max(0.0, min((distanceSample / WATER_TANK_FILL_EMPTY_DISTANCE) * 100.0, 100.0));
+    for (unsigned int i = 0; i < nextSampleIndex; i++) {
+      deviations[i] = (samples[i] > median) ? (samples[i] - median) : (median - samples[i]);
+    }
 
-    LOG1("[Sensor:WaterTankLevel] Water level sample #%d captured = %.2f%% (%dµs <-> %.2fcm)\n", sampleIndex, levelPercentSample, durationSample, distanceSample);
+    uint64_t deviation = SortingNetworks<unsigned int, WATER_LEVEL_PROBE_SAMPLES>::median(deviations, nextSampleIndex);
 
-    return levelPercentSample;
+    // Estimate the confidence interval of the median (95%)
+    // Notice: 1.4826 x MAD estimates the standard deviation of samples, and \
+    //   1.2533 x that / sqrt(N) estimates the standard error of their median, \
+    //   thus the half interval is 3.642 x MAD / sqrt(N), compared squared \
+    //   (w/ a x1000 factor) so that no square root is needed
+    return (deviation * deviation * 13264) <= ((uint64_t)WATER_LEVEL_PROBE_TOLERANCE * WATER_LEVEL_PROBE_TOLERANCE * nextSampleIndex * 1000);
   }
 
-  void floatQuickSort(float values[], int left, int right) {
-    // Initial values
-    float tmp;
-    float pivot = values[(left + right) / 2];
-    int i = left, j = right;
+  bool acquireWaterLevelSample(unsigned int sampleIndex, unsigned int &levelPermilleSample) {
+    // Acquire echo duration (captured since the sensor was triggered)
+    unsigned long durationSample = ranger.echoMicros();
 
-    // Proceed partition
-    while (i <= j) {
-      while (values[i] < pivot) {
-        i++;
-      }
-      
-      while (values[j] > pivot) {
-        j--;
-      }
-      
-      if (i <= j) {
-        tmp = values[i];
-        values[i] = values[j];
-        values[j] = tmp;
-        
-        i++;
-        j--;
-      }
-    };
+    // Duration is zero? Report failure (no echo, or echo came back too late)
+    if (durationSample == 0) {
+      trace.record(TRACE_EVENT_SAMPLE_NO_ECHO, sampleIndex);
 
-    // Recurse
-    if (left < j) {
-      floatQuickSort(values, left, j);
+      return false;
     }
 
-    if (i < right) {
-      floatQuickSort(values, i, right);
+    // Duration is out of range? Report failure (echo from past the tank)
+    if (durationSample > WATER_LEVEL_ECHO_TIMEOUT_MICROSECONDS) {
+      trace.record(TRACE_EVENT_SAMPLE_OUT_OF_RANGE, sampleIndex, durationSample);
+
+      return false;
     }
+
+    // Convert the time to echo into a water level permille
+    levelPermilleSample = convertEchoToLevelPermille(durationSample);
+
+    trace.record(TRACE_EVENT_SAMPLE_CAPTURED, levelPermilleSample, durationSample);
+
+    return true;
+  }
+
+  unsigned int convertEchoToLevelPermille(unsigned long durationSample) {
+    // Compute how much of the tank is empty (Q16 permille, w/ sensor offset \
+    //   from water at 100% level)
+    // Important: restrict between [0; 1000]
+    // Notice: durations are bounded by the echo timeout, thus this fits in \
+    //   32 bits
+    int32_t emptiedPermilleQ16 = (int32_t)(durationSample * WATER_LEVEL_ECHO_SCALE_Q16) - (int32_t)WATER_LEVEL_ECHO_OFFSET_Q16;
+
+    int32_t emptiedPermille = (max(emptiedPermilleQ16, (int32_t)0) + 32768) >> 16;
+
+    return 1000 - min(emptiedPermille, (int32_t)1000);
   }
 };
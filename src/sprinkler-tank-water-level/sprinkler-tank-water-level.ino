@@ -7,12 +7,14 @@
 #include "HomeSpan.h"
 #include "sensors.h"
 
+WaterTankLevelSensor *waterTankLevelSensor;
+
 void setup() {
   // 115,200 bauds (for serial console)
   Serial.begin(115200);
 
-  // Force CPU to a lower power frequency
-  setCpuFrequencyMhz(80);
+  // Notice: the CPU frequency gets scaled by the service (ie. power \
+  //   management), as to only run fast while latency-critical work is done
 
   // Setup HomeSpan accessory
   homeSpan.begin(Category::Sprinklers, "Sprinkler Tank", "vsa-industries", "VSA-WT");
@@ -33,14 +35,15 @@ void setup() {
       new Characteristic::Name("Sprinkler Tank Water Level");
       new Characteristic::SerialNumber("WT-2022-07-000001");
       
-    new Service::IrrigationSystem();
-      new Characteristic::Active(1);
-      new Characteristic::ProgramMode();
-      new Characteristic::InUse();
-    
-    new WaterTankLevelSensor();
+    IrrigationSystem *irrigationSystem = new IrrigationSystem();
+
+    waterTankLevelSensor = new WaterTankLevelSensor(irrigationSystem->statusFault, irrigationSystem->inUse);
+
+  // Poll HomeSpan from its own task (pinned to the Wi-Fi core)
+  homeSpan.autoPoll(HOMESPAN_TASK_STACK_SIZE, HOMESPAN_TASK_PRIORITY, HOMESPAN_TASK_CORE);
 }
 
 void loop() {
-  homeSpan.poll();
+  // Run device I/O (ultrasonic sensor, history, scheduled tasks), or idle until next due
+  waterTankLevelSensor->runDevice();
 }
@@ -0,0 +1,93 @@
+// Sprinkler Tank (Water Level)
+//
+// Water level reporting for sprinkler tank
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+const unsigned int ULTRASONIC_TRIGGER_SETTLE_MICROSECONDS = 5;
+const unsigned int ULTRASONIC_TRIGGER_PULSE_MICROSECONDS = 10;
+
+struct UltrasonicRanger {
+  /**
+    [Ultrasonic Ranger]
+
+      - The echo pulse is timed by an interrupt handler, which timestamps the
+        rising and falling edges of the ECHO line, so that the main loop only
+        ever triggers a measurement, and later collects its result
+
+      - Edges are only accepted once a measurement was triggered (a rising
+        edge, then a falling edge), so that a late echo from a previous
+        measurement cannot be mistaken for the current one
+  **/
+
+  int triggerPin = -1,
+      echoPin = -1;
+
+  // Echo edges (written by the interrupt handler only, once armed)
+  volatile bool isArmed = false,
+                hasEchoRise = false,
+                hasEchoFall = false;
+
+  volatile unsigned long echoRiseMicros = 0,
+                         echoFallMicros = 0;
+
+  void begin(int triggerPinNumber, int echoPinNumber) {
+    triggerPin = triggerPinNumber;
+    echoPin = echoPinNumber;
+
+    pinMode(triggerPin, OUTPUT);
+    pinMode(echoPin, INPUT);
+
+    digitalWrite(triggerPin, LOW);
+
+    attachInterruptArg(digitalPinToInterrupt(echoPin), onEchoEdge, this, CHANGE);
+  }
+
+  void trigger() {
+    // Arm echo capture (edges before this point get ignored)
+    hasEchoRise = false;
+    hasEchoFall = false;
+    isArmed = true;
+
+    // Wake up the sensor (ie. trigger)
+    digitalWrite(triggerPin, LOW);
+    delayMicroseconds(ULTRASONIC_TRIGGER_SETTLE_MICROSECONDS);
+    digitalWrite(triggerPin, HIGH);
+    delayMicroseconds(ULTRASONIC_TRIGGER_PULSE_MICROSECONDS);
+    digitalWrite(triggerPin, LOW);
+  }
+
+  bool isEchoComplete() {
+    return hasEchoFall == true;
+  }
+
+  unsigned long echoMicros() {
+    // Echo not complete? (no echo, or echo still in flight)
+    if (hasEchoFall == false) {
+      return 0;
+    }
+
+    return echoFallMicros - echoRiseMicros;
+  }
+
+  static void IRAM_ATTR onEchoEdge(void *context) {
+    UltrasonicRanger *ranger = (UltrasonicRanger *)context;
+
+    unsigned long nowMicros = micros();
+
+    if (ranger->isArmed == false) {
+      return;
+    }
+
+    if (digitalRead(ranger->echoPin) == HIGH) {
+      // Echo starts
+      ranger->echoRiseMicros = nowMicros;
+      ranger->hasEchoRise = true;
+    } else if (ranger->hasEchoRise == true) {
+      // Echo ends (disarm until next trigger)
+      ranger->echoFallMicros = nowMicros;
+      ranger->hasEchoFall = true;
+      ranger->isArmed = false;
+    }
+  }
+};
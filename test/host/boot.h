@@ -0,0 +1,63 @@
+// Host Tests
+//
+// Host-side tests for both projects (Linux, w/o an ESP32 board)
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#pragma once
+
+#include "host.h"
+
+/**
+  [Boot]
+
+    - Boots the AC sketch as its setup() would, w/ a single AC unit on the
+      default IR LED, and runs its device task on the virtual clock
+
+    - A reboot reconstructs all globals, while flash partitions are kept
+      (they are only reset by hostReset())
+**/
+
+static AirConditionerRemote<AC_PROFILE> *bootUnit = NULL;
+
+inline void bootSketch() {
+  // Notice: the unit of the previous boot is gone w/ the device memory
+  delete bootUnit;
+
+  hostRenew(thermometer);
+  hostRenew(irTransmitter);
+  hostRenew(trace);
+  hostRenew(power);
+  hostRenew(scheduler);
+  hostRenew(bridge);
+
+  bridge.begin();
+
+  uint32_t freeHeapBytes = ESP.getFreeHeap();
+
+  bootUnit = new AirConditionerRemote<AC_PROFILE>(0, IR_PIN_PWM, &thermometer);
+
+  bridge.add(bootUnit, freeHeapBytes - ESP.getFreeHeap());
+}
+
+inline void bootRunUntil(uint64_t untilMicros) {
+  // Notice: idles end early at that point in time (as if woken up)
+  hostIdleLimitMicros = untilMicros;
+
+  while (hostMicros < untilMicros) {
+    bridge.runDevice();
+  }
+
+  hostIdleLimitMicros = HOST_TIME_NEVER;
+}
+
+inline bool bootUpdate(const uint8_t values[]) {
+  // Request all values from HomeKit (storage layout)
+  return hostUpdate(bootUnit, {
+    {bootUnit->hkActive, (float)values[STORAGE_INDEX_SM_ACTIVE]},
+    {bootUnit->hkTargetHeaterCoolerState, (float)values[STORAGE_INDEX_SM_TARGET_HEATER_COOLER_STATE]},
+    {bootUnit->hkCoolingThresholdTemperature, (float)values[STORAGE_INDEX_SM_COOLING_THRESHOLD_TEMPERATURE]},
+    {bootUnit->hkHeatingThresholdTemperature, (float)values[STORAGE_INDEX_SM_HEATING_THRESHOLD_TEMPERATURE]},
+    {bootUnit->hkSwingMode, (float)values[STORAGE_INDEX_SM_SWING_MODE]}
+  });
+}
@@ -0,0 +1,55 @@
+// Host Tests
+//
+// Host-side tests for both projects (Linux, w/o an ESP32 board)
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#pragma once
+
+#include <cstdio>
+
+#include "host.h"
+
+/**
+  [Harness]
+
+    - Each test file is its own program, which runs its tests in order and
+      exits w/ a non-zero status if any check failed
+
+    - Checks never abort a test, so that a run reports all failures
+**/
+
+static unsigned int harnessChecksCount = 0,
+                    harnessFailuresCount = 0;
+
+#define CHECK(CONDITION) do { \
+    harnessChecksCount++; \
+    if ((CONDITION) == false) { \
+      harnessFailuresCount++; \
+      printf("  FAIL %s:%d: %s\n", __FILE__, __LINE__, #CONDITION); \
+    } \
+  } while (0)
+
+#define CHECK_EQUAL(EXPECTED, ACTUAL) do { \
+    harnessChecksCount++; \
+    long long harnessExpected = (long long)(EXPECTED), harnessActual = (long long)(ACTUAL); \
+    if (harnessExpected != harnessActual) { \
+      harnessFailuresCount++; \
+      printf("  FAIL %s:%d: %s == %s (expected %lld, got %lld)\n", __FILE__, __LINE__, #EXPECTED, #ACTUAL, harnessExpected, harnessActual); \
+    } \
+  } while (0)
+
+#define TEST(NAME) static void NAME()
+
+#define RUN(NAME) do { \
+    unsigned int harnessFailuresBefore = harnessFailuresCount; \
+    hostReset(); \
+    NAME(); \
+    printf("%s %s\n", (harnessFailuresCount == harnessFailuresBefore) ? "ok  " : "FAIL", #NAME); \
+  } while (0)
+
+inline int harnessReport(const char *suite) {
+  printf("%s: %u checks, %u failures\n", suite, harnessChecksCount, harnessFailuresCount);
+
+  return (harnessFailuresCount > 0) ? 1 : 0;
+}
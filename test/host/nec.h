@@ -0,0 +1,102 @@
+// Host Tests
+//
+// Host-side tests for both projects (Linux, w/o an ESP32 board)
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#pragma once
+
+#include "host.h"
+
+const unsigned int NEC_DECODE_TOLERANCE_PERCENT = 25; // IR receivers are sloppy
+
+struct NecReception {
+  bool isData,
+       isRepeat;
+
+  unsigned int address,
+               command;
+
+  // Notice: when the receiver has the data word (ie. after the stop mark)
+  uint64_t dataEndMicros;
+};
+
+inline bool necMatches(unsigned int actualMicros, unsigned int expectedMicros) {
+  unsigned int toleranceMicros = expectedMicros * NEC_DECODE_TOLERANCE_PERCENT / 100;
+
+  return actualMicros + toleranceMicros >= expectedMicros && actualMicros <= expectedMicros + toleranceMicros;
+}
+
+inline NecReception necDecode(const HostTransmission &transmission) {
+  /**
+    [NEC Decoder]
+
+      - Decodes a transmission as an IR receiver would (w/ tolerance on
+        durations), starting from its first mark: either a data frame
+        (header, 32 bits LSB first, stop mark) or a repeat (short header)
+
+      - A data frame is only accepted if both inverse bytes match, and
+        anything after its stop mark is ignored (eg. a trailing repeat)
+  **/
+
+  NecReception reception = {};
+
+  const std::vector<rmt_item32_t> &items = transmission.items;
+
+  if (items.empty() == true || items[0].level0 != 1 || necMatches(items[0].duration0, NEC_HEADER_MARK_MICROSECONDS) == false) {
+    return reception;
+  }
+
+  // Repeat? (short header space, then stop mark)
+  if (necMatches(items[0].duration1, NEC_REPEAT_SPACE_MICROSECONDS) == true) {
+    reception.isRepeat = true;
+
+    return reception;
+  }
+
+  if (necMatches(items[0].duration1, NEC_HEADER_SPACE_MICROSECONDS) == false || items.size() < NEC_BITS + 2) {
+    return reception;
+  }
+
+  uint64_t elapsedMicros = items[0].duration0 + items[0].duration1;
+  uint32_t data = 0;
+
+  for (unsigned int i = 0; i < NEC_BITS; i++) {
+    const rmt_item32_t &item = items[1 + i];
+
+    if (item.level0 != 1 || necMatches(item.duration0, NEC_BIT_MARK_MICROSECONDS) == false) {
+      return reception;
+    }
+
+    if (necMatches(item.duration1, NEC_ONE_SPACE_MICROSECONDS) == true) {
+      data |= (uint32_t)1 << i;
+    } else if (necMatches(item.duration1, NEC_ZERO_SPACE_MICROSECONDS) == false) {
+      return reception;
+    }
+
+    elapsedMicros += item.duration0 + item.duration1;
+  }
+
+  // Stop mark
+  const rmt_item32_t &stop = items[1 + NEC_BITS];
+
+  if (stop.level0 != 1 || necMatches(stop.duration0, NEC_BIT_MARK_MICROSECONDS) == false) {
+    return reception;
+  }
+
+  unsigned int address = data & 0xFF,
+               addressInverse = (data >> 8) & 0xFF,
+               command = (data >> 16) & 0xFF,
+               commandInverse = (data >> 24) & 0xFF;
+
+  if ((address ^ addressInverse) != 0xFF || (command ^ commandInverse) != 0xFF) {
+    return reception;
+  }
+
+  reception.isData = true;
+  reception.address = address;
+  reception.command = command;
+  reception.dataEndMicros = transmission.startMicros + elapsedMicros + stop.duration0;
+
+  return reception;
+}
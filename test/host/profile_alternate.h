@@ -0,0 +1,47 @@
+// Host Tests
+//
+// Host-side tests for both projects (Linux, w/o an ESP32 board)
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+struct ProfileTestAlternate {
+  /**
+    [Profile: Test Alternate]
+
+      - Made-up AC unit (host tests only), which differs from the Crisp X
+        wherever a profile can: IR words, a shorter mode cycle in another
+        order, temperature ranges walked by 2°C, and other defaults
+  **/
+
+  // IR protocol (NEC address)
+  static constexpr unsigned int IR_ADDRESS = 0x10;
+
+  // IR commands (1 per remote controller button)
+  static constexpr unsigned int IR_COMMAND_SWITCH_POWER = 0x01;
+  static constexpr unsigned int IR_COMMAND_SWITCH_MODE = 0x02;
+  static constexpr unsigned int IR_COMMAND_TOGGLE_FAN_SPEED = 0x03;
+  static constexpr unsigned int IR_COMMAND_TOGGLE_SWING = 0x04;
+  static constexpr unsigned int IR_COMMAND_TOGGLE_TIMER_MODE = 0x05;
+  static constexpr unsigned int IR_COMMAND_TEMPERATURE_INCREASE = 0x06;
+  static constexpr unsigned int IR_COMMAND_TEMPERATURE_DECREASE = 0x07;
+
+  // Mode cycle (order in which the mode button walks through modes)
+  typedef StateDirection<true,
+    TARGET_HEATER_COOLER_STATE_COOL,
+    TARGET_HEATER_COOLER_STATE_HEAT,
+    TARGET_HEATER_COOLER_STATE_AUTO
+  > STATES_DIRECTION_TARGET_HEATER_COOLER_STATE;
+
+  // Temperature ranges (1 step per temperature button press)
+  static constexpr unsigned int RANGE_TEMPERATURE_COOL_MINIMUM = 16; // 16°C
+  static constexpr unsigned int RANGE_TEMPERATURE_COOL_MAXIMUM = 30; // 30°C
+  static constexpr unsigned int RANGE_TEMPERATURE_COOL_STEP = 2; // 2°C
+
+  static constexpr unsigned int RANGE_TEMPERATURE_HEAT_MINIMUM = 10; // 10°C
+  static constexpr unsigned int RANGE_TEMPERATURE_HEAT_MAXIMUM = 26; // 26°C
+  static constexpr unsigned int RANGE_TEMPERATURE_HEAT_STEP = 2; // 2°C
+
+  // Defaults (when no value was ever stored)
+  static constexpr unsigned int DEFAULT_TARGET_HEATER_COOLER_STATE = TARGET_HEATER_COOLER_STATE_HEAT;
+  static constexpr unsigned int DEFAULT_THRESHOLD_TEMPERATURE = 20; // 20°C
+};
@@ -0,0 +1,62 @@
+// Host Tests
+//
+// Host-side tests for both projects (Linux, w/o an ESP32 board)
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+using std::min;
+using std::max;
+
+#define HIGH 1
+#define LOW 0
+
+#define INPUT 1
+#define OUTPUT 2
+#define INPUT_PULLUP 3
+
+#define RISING 1
+#define FALLING 2
+#define CHANGE 3
+
+#define IRAM_ATTR
+
+// Time (virtual clock, see host.h)
+unsigned long millis();
+unsigned long micros();
+
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+// GPIO (levels are kept per pin, interrupts are raised by tests)
+void pinMode(int pin, int mode);
+void digitalWrite(int pin, int level);
+int digitalRead(int pin);
+int digitalPinToInterrupt(int pin);
+void attachInterruptArg(int interrupt, void (*handler)(void *), void *argument, int mode);
+void detachInterrupt(int interrupt);
+
+// CPU
+bool setCpuFrequencyMhz(uint32_t frequencyMhz);
+uint32_t getCpuFrequencyMhz();
+
+struct HardwareSerial {
+  void begin(unsigned long baud);
+  int printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+struct EspClass {
+  uint32_t getCycleCount();
+  uint32_t getFreeHeap();
+};
+
+extern HardwareSerial Serial;
+extern EspClass ESP;
@@ -0,0 +1,24 @@
+// Host Tests
+//
+// Host-side tests for both projects (Linux, w/o an ESP32 board)
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+struct EEPROMClass {
+  uint8_t bytes[64];
+
+  EEPROMClass();
+
+  bool begin(size_t size);
+  uint8_t read(int address);
+  void write(int address, uint8_t value);
+  bool commit();
+  void end();
+};
+
+extern EEPROMClass EEPROM;
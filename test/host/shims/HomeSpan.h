@@ -0,0 +1,152 @@
+// Host Tests
+//
+// Host-side tests for both projects (Linux, w/o an ESP32 board)
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#pragma once
+
+#include "Arduino.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// Notice: only the HomeSpan API used by the sketches is provided, \
+//   characteristics hold their value as a float (HK values are small)
+
+enum class Category {
+  AirConditioners,
+  Bridges,
+  Sprinklers
+};
+
+struct SpanCharacteristic {
+  float value = 0.0,
+        newValue = 0.0;
+
+  bool isUpdated = false;
+
+  unsigned long updatedMillis = 0;
+
+  // Event notifications sent to paired controllers (1 per notifying setVal())
+  unsigned int notificationsCount = 0;
+
+  SpanCharacteristic(float initialValue = 0.0) : value(initialValue), newValue(initialValue) {}
+
+  template <typename T = int>
+  T getVal() {
+    return (T)value;
+  }
+
+  template <typename T = int>
+  T getNewVal() {
+    return (T)newValue;
+  }
+
+  template <typename T>
+  void setVal(T nextValue, bool notify = true) {
+    value = (float)nextValue;
+    newValue = value;
+    updatedMillis = millis();
+
+    if (notify == true) {
+      notificationsCount++;
+    }
+  }
+
+  bool updated() {
+    return isUpdated;
+  }
+
+  unsigned long timeVal() {
+    return millis() - updatedMillis;
+  }
+
+  SpanCharacteristic *setRange(float minimum, float maximum, float step = 0.0) {
+    return this;
+  }
+};
+
+struct SpanService {
+  virtual ~SpanService() {}
+
+  virtual bool update() {
+    return true;
+  }
+
+  virtual void loop() {}
+};
+
+struct SpanAccessory {
+  SpanAccessory(uint32_t aid = 0) {}
+};
+
+struct SpanUserCommand {
+  SpanUserCommand(char character, const char *description, void (*callback)(const char *, void *), void *context);
+};
+
+namespace Service {
+  struct AccessoryInformation : SpanService {};
+  struct BatteryService : SpanService {};
+  struct HeaterCooler : SpanService {};
+  struct IrrigationSystem : SpanService {};
+}
+
+namespace Characteristic {
+#define HOST_CHARACTERISTIC(NAME) \
+  struct NAME : SpanCharacteristic { \
+    NAME() : SpanCharacteristic() {} \
+    NAME(int initialValue) : SpanCharacteristic(initialValue) {} \
+    NAME(float initialValue) : SpanCharacteristic(initialValue) {} \
+    NAME(double initialValue) : SpanCharacteristic(initialValue) {} \
+    NAME(const char *text) : SpanCharacteristic() {} \
+  };
+
+  HOST_CHARACTERISTIC(Active)
+  HOST_CHARACTERISTIC(BatteryLevel)
+  HOST_CHARACTERISTIC(ChargingState)
+  HOST_CHARACTERISTIC(CoolingThresholdTemperature)
+  HOST_CHARACTERISTIC(CurrentHeaterCoolerState)
+  HOST_CHARACTERISTIC(CurrentTemperature)
+  HOST_CHARACTERISTIC(FirmwareRevision)
+  HOST_CHARACTERISTIC(HardwareRevision)
+  HOST_CHARACTERISTIC(HeatingThresholdTemperature)
+  HOST_CHARACTERISTIC(Identify)
+  HOST_CHARACTERISTIC(InUse)
+  HOST_CHARACTERISTIC(Manufacturer)
+  HOST_CHARACTERISTIC(Model)
+  HOST_CHARACTERISTIC(Name)
+  HOST_CHARACTERISTIC(ProgramMode)
+  HOST_CHARACTERISTIC(SerialNumber)
+  HOST_CHARACTERISTIC(StatusFault)
+  HOST_CHARACTERISTIC(StatusLowBattery)
+  HOST_CHARACTERISTIC(SwingMode)
+  HOST_CHARACTERISTIC(TargetHeaterCoolerState)
+
+#undef HOST_CHARACTERISTIC
+}
+
+struct HomeSpanClass {
+  int logLevel = 0;
+
+  void begin(Category category, const char *name, const char *hostName, const char *modelName) {}
+
+  void setLogLevel(int level) {
+    logLevel = level;
+  }
+
+  int getLogLevel() {
+    return logLevel;
+  }
+
+  void setQRID(const char *id) {}
+  void setPairingCode(const char *code) {}
+  void poll() {}
+  void autoPoll(uint32_t stackSize = 8192, uint32_t priority = 1, uint32_t core = 0) {}
+};
+
+extern HomeSpanClass homeSpan;
+
+#define LOG0(...) do { Serial.printf(__VA_ARGS__); } while (0)
+#define LOG1(...) do { if (homeSpan.getLogLevel() > 0) { Serial.printf(__VA_ARGS__); } } while (0)
+#define LOG2(...) do { if (homeSpan.getLogLevel() > 1) { Serial.printf(__VA_ARGS__); } } while (0)
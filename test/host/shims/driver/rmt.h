@@ -0,0 +1,100 @@
+// Host Tests
+//
+// Host-side tests for both projects (Linux, w/o an ESP32 board)
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#include "esp_err.h"
+#include "driver/gpio.h"
+#include "freertos/ringbuf.h"
+
+// Notice: this is a mock of the RMT driver, where written items are \
+//   recorded as transmissions (see host.h) instead of being clocked out
+typedef enum {
+  RMT_CHANNEL_0,
+  RMT_CHANNEL_1,
+  RMT_CHANNEL_2,
+  RMT_CHANNEL_3,
+  RMT_CHANNEL_4,
+  RMT_CHANNEL_5,
+  RMT_CHANNEL_6,
+  RMT_CHANNEL_7,
+  RMT_CHANNEL_MAX
+} rmt_channel_t;
+
+typedef enum {
+  RMT_MODE_TX,
+  RMT_MODE_RX
+} rmt_mode_t;
+
+typedef enum {
+  RMT_CARRIER_LEVEL_LOW,
+  RMT_CARRIER_LEVEL_HIGH
+} rmt_carrier_level_t;
+
+typedef enum {
+  RMT_IDLE_LEVEL_LOW,
+  RMT_IDLE_LEVEL_HIGH
+} rmt_idle_level_t;
+
+typedef struct {
+  union {
+    struct {
+      uint32_t duration0 : 15;
+      uint32_t level0 : 1;
+      uint32_t duration1 : 15;
+      uint32_t level1 : 1;
+    };
+
+    uint32_t val;
+  };
+} rmt_item32_t;
+
+typedef struct {
+  uint32_t carrier_freq_hz;
+  rmt_carrier_level_t carrier_level;
+  rmt_idle_level_t idle_level;
+  uint8_t carrier_duty_percent;
+  bool carrier_en;
+  bool loop_en;
+  bool idle_output_en;
+} rmt_tx_config_t;
+
+typedef struct {
+  uint16_t idle_threshold;
+  uint8_t filter_ticks_thresh;
+  bool filter_en;
+} rmt_rx_config_t;
+
+typedef struct {
+  rmt_mode_t rmt_mode;
+  rmt_channel_t channel;
+  gpio_num_t gpio_num;
+  uint8_t clk_div;
+  uint8_t mem_block_num;
+  uint32_t flags;
+
+  union {
+    rmt_tx_config_t tx_config;
+    rmt_rx_config_t rx_config;
+  };
+} rmt_config_t;
+
+rmt_config_t RMT_DEFAULT_CONFIG_TX(gpio_num_t pin, rmt_channel_t channel);
+rmt_config_t RMT_DEFAULT_CONFIG_RX(gpio_num_t pin, rmt_channel_t channel);
+
+esp_err_t rmt_config(const rmt_config_t *config);
+esp_err_t rmt_driver_install(rmt_channel_t channel, size_t rxBufferSize, int interruptFlags);
+esp_err_t rmt_set_gpio(rmt_channel_t channel, rmt_mode_t mode, gpio_num_t pin, bool invertSignal);
+
+esp_err_t rmt_write_items(rmt_channel_t channel, const rmt_item32_t *items, int itemsCount, bool waitTxDone);
+esp_err_t rmt_wait_tx_done(rmt_channel_t channel, TickType_t ticks);
+
+esp_err_t rmt_rx_start(rmt_channel_t channel, bool resetMemory);
+esp_err_t rmt_rx_stop(rmt_channel_t channel);
+esp_err_t rmt_get_ringbuf_handle(rmt_channel_t channel, RingbufHandle_t *ringbuffer);
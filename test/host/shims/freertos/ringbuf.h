@@ -0,0 +1,14 @@
+// Host Tests
+//
+// Host-side tests for both projects (Linux, w/o an ESP32 board)
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+typedef void *RingbufHandle_t;
+
+void *xRingbufferReceive(RingbufHandle_t ringbuffer, size_t *size, TickType_t ticks);
+void vRingbufferReturnItem(RingbufHandle_t ringbuffer, void *item);
@@ -0,0 +1,26 @@
+// Host Tests
+//
+// Host-side tests for both projects (Linux, w/o an ESP32 board)
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void *);
+
+// Notice: tasks are never started (there is a single host thread), tests \
+//   drive the device task and the HomeSpan task by hand
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stackSize, void *parameters, UBaseType_t priority, TaskHandle_t *handle, BaseType_t core);
+TaskHandle_t xTaskGetCurrentTaskHandle();
+BaseType_t xPortGetCoreID();
+
+void vTaskDelay(TickType_t ticks);
+void vTaskDelayUntil(TickType_t *lastWakeTicks, TickType_t ticks);
+TickType_t xTaskGetTickCount();
+
+// Notice: taking a notification that is not pending advances the virtual \
+//   clock by the timeout (ie. the task idled until then)
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
@@ -0,0 +1,150 @@
+// Host Tests
+//
+// Host-side tests for both projects (Linux, w/o an ESP32 board)
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#pragma once
+
+#include <new>
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include <utility>
+#include <initializer_list>
+
+#include "HomeSpan.h"
+#include "driver/rmt.h"
+#include "esp_partition.h"
+
+/**
+  [Host]
+
+    - Time is virtual: it only moves forward when the code under test waits
+      (delays, idles, flash writes and erases), or when a test advances it,
+      and the CPU cycle counter follows it at the current CPU frequency
+
+    - The RMT peripheral is mocked: written items are recorded as
+      transmissions (1 tick = 1µs, as configured by the sketches), which
+      take their on-air time to complete
+
+    - Flash partitions are RAM images w/ NOR semantics (writes can only
+      clear bits, erases set them), and a power cut can be scheduled at any
+      point in time, after which every write and erase fails (a write or
+      erase that spans the cut gets torn)
+**/
+
+const uint32_t HOST_CPU_FREQUENCY_DEFAULT = 240; // 240MHz (Arduino core default)
+const uint32_t HOST_HEAP_SIZE = 320 * 1024; // 320KB (ESP32 DRAM, roughly)
+
+const uint64_t HOST_FLASH_WRITE_MICROSECONDS = 200; // 16-byte record, w/ cache disabled
+const uint64_t HOST_FLASH_ERASE_SECTOR_MICROSECONDS = 45000; // 4KB sector, typical
+const uint32_t HOST_FLASH_SECTOR_SIZE = 4096;
+
+const uint64_t HOST_TIME_NEVER = 0xFFFFFFFFFFFFFFFFull;
+
+struct HostTransmission {
+  uint64_t startMicros,
+           endMicros;
+
+  int channel,
+      pin;
+
+  std::vector<rmt_item32_t> items;
+};
+
+// Time
+extern uint64_t hostMicros,
+                hostCycles;
+
+// Notice: an idle ends early (as if woken up) when it would run past this \
+//   point in time, which lets tests interleave HomeSpan updates w/ idles
+extern uint64_t hostIdleLimitMicros,
+                hostWakeLatencyMicros;
+
+void hostAdvanceMicros(uint64_t micros);
+
+// Power
+extern bool hostPowerManagementSupported;
+
+extern unsigned int hostPowerLocksHeld;
+
+extern uint64_t hostPowerCutMicros;
+
+bool hostIsPowerLost();
+
+// Tasks
+extern unsigned int hostTaskNotifications,
+                    hostTasksCreated;
+
+// Serial (output is captured, and optionally echoed to stdout)
+extern std::string hostSerialOutput;
+extern bool hostSerialEcho;
+
+// User commands (ie. the HomeSpan CLI)
+bool hostRunCommand(const char *line);
+
+// GPIO (raises the pin interrupt, if any, on a matching edge)
+void hostSetPinLevel(int pin, int level);
+
+// Notice: scheduled levels get set as time moves past them (in time order), \
+//   thus interrupt handlers see the time of the edge, as they would on a \
+//   board (eg. the echo of an ultrasonic sensor)
+void hostSchedulePinLevel(int pin, int level, uint64_t atMicros);
+
+// Called on each digitalWrite() (eg. a simulated sensor watching its pins)
+extern std::function<void(int, int)> hostPinWriteHook;
+
+// Flash
+const esp_partition_t *hostFlashCreate(const char *label, uint32_t size);
+std::vector<uint8_t> &hostFlashImage(const char *label);
+
+extern unsigned int hostFlashWritesCount,
+                    hostFlashErasesCount;
+
+// RMT
+extern std::vector<HostTransmission> hostTransmissions;
+extern unsigned int hostTransmissionOverlaps;
+
+// Notice: each RX capture receives the next queued reception (after its \
+//   duration), or times out if none is queued (eg. a sensor not plugged)
+struct HostReception {
+  uint64_t durationMicros;
+
+  std::vector<rmt_item32_t> items;
+};
+
+extern std::deque<HostReception> hostReceptions;
+
+// Heap (tracked through the global allocator)
+extern uint64_t hostHeapAllocated;
+
+// Resets all of the above (does not reset objects under test)
+void hostReset();
+
+template <typename T>
+void hostRenew(T &object) {
+  // Notice: reconstructs a global object in place (eg. a reboot)
+  object.~T();
+  new (&object) T();
+}
+
+inline bool hostUpdate(SpanService *service, std::initializer_list<std::pair<SpanCharacteristic *, float>> changes) {
+  // Hand values over to the service (as HomeSpan does on a HAP write)
+  for (const std::pair<SpanCharacteristic *, float> &change : changes) {
+    change.first->newValue = change.second;
+    change.first->isUpdated = true;
+  }
+
+  bool isAccepted = service->update();
+
+  for (const std::pair<SpanCharacteristic *, float> &change : changes) {
+    change.first->value = (isAccepted == true) ? change.first->newValue : change.first->value;
+    change.first->newValue = change.first->value;
+    change.first->isUpdated = false;
+  }
+
+  return isAccepted;
+}
@@ -0,0 +1,188 @@
+// Host Tests
+//
+// Host-side tests for both projects (Linux, w/o an ESP32 board)
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#pragma once
+
+#include "host.h"
+#include "nec.h"
+
+// Notice: the simulated AC unit is written from the Crisp X manual, and \
+//   does not use the AC unit model nor the codebook of the sketch (it would \
+//   otherwise share their mistakes)
+const unsigned int SIMULATOR_ADDRESS = 0x81;
+
+const unsigned int SIMULATOR_COMMAND_POWER = 0x6B;
+const unsigned int SIMULATOR_COMMAND_MODE = 0x66;
+const unsigned int SIMULATOR_COMMAND_SWING = 0x67;
+const unsigned int SIMULATOR_COMMAND_TEMPERATURE_UP = 0x65;
+const unsigned int SIMULATOR_COMMAND_TEMPERATURE_DOWN = 0x68;
+
+// Modes, in the order the mode button cycles through them (as HK values, \
+//   'Dry' and 'Fan' have none, thus they use the storage values of the SM)
+const unsigned int SIMULATOR_MODES_COUNT = 5;
+const unsigned int SIMULATOR_MODES[SIMULATOR_MODES_COUNT] = {
+  1, // Heat
+  0, // Cool Auto
+  2, // Cool
+  3, // Dry
+  4  // Fan
+};
+
+const unsigned int SIMULATOR_COOL_MINIMUM = 18,
+                   SIMULATOR_COOL_MAXIMUM = 32,
+                   SIMULATOR_HEAT_MINIMUM = 13,
+                   SIMULATOR_HEAT_MAXIMUM = 27;
+
+// Notice: the silence the AC unit was always seen to decode reliably after
+const uint64_t SIMULATOR_SILENCE_MINIMUM_MICROSECONDS = 100000;
+
+struct SimulatedAirConditioner {
+  /**
+    [Simulated AC Unit]
+
+      - Receives the transmissions of its IR LED (ie. its pin), decodes
+        them as NEC frames, and tracks the true state of the AC unit: what a
+        user would see on the AC unit display
+
+      - A frame is applied once its data word was received (ie. at the end
+        of its stop mark), unless power was cut before that (the IR LED
+        went dark), or unless it followed the previous transmission w/o
+        enough silence (the receiver cannot tell frames apart)
+
+      - Values use the storage layout of the sketch: active, mode, cooling
+        temperature, heating temperature, swing mode
+  **/
+
+  int pin = -1;
+
+  uint8_t values[5];
+
+  size_t transmissionsCursor = 0;
+
+  uint64_t lastTransmissionEndMicros = 0;
+
+  bool hasTransmission = false;
+
+  // Statistics
+  unsigned int framesApplied = 0,
+               framesIgnored = 0,
+               framesRejected = 0,
+               framesCut = 0;
+
+  void begin(int receiverPin) {
+    pin = receiverPin;
+
+    // Factory state (matches the SM defaults, ie. what the AC unit shows \
+    //   on first power up)
+    values[0] = 0;
+    values[1] = 2;
+    values[2] = 18;
+    values[3] = 18;
+    values[4] = 1;
+
+    transmissionsCursor = 0;
+    hasTransmission = false;
+    framesApplied = 0;
+    framesIgnored = 0;
+    framesRejected = 0;
+    framesCut = 0;
+  }
+
+  void receive(uint64_t powerCutMicros = HOST_TIME_NEVER) {
+    // Walk transmissions since last receive (all pins, only ours are seen)
+    for (; transmissionsCursor < hostTransmissions.size(); transmissionsCursor++) {
+      const HostTransmission &transmission = hostTransmissions[transmissionsCursor];
+
+      if (transmission.pin != pin) {
+        continue;
+      }
+
+      NecReception reception = necDecode(transmission);
+
+      uint64_t silenceMicros = transmission.startMicros - lastTransmissionEndMicros;
+
+      bool hasSilence = (hasTransmission == false || silenceMicros >= SIMULATOR_SILENCE_MINIMUM_MICROSECONDS) ? true : false;
+
+      hasTransmission = true;
+      lastTransmissionEndMicros = transmission.endMicros;
+
+      if (reception.isData == false) {
+        continue;
+      }
+
+      if (reception.dataEndMicros > powerCutMicros) {
+        framesCut++;
+      } else if (hasSilence == false) {
+        framesRejected++;
+      } else if (reception.address != SIMULATOR_ADDRESS) {
+        framesIgnored++;
+      } else {
+        apply(reception.command);
+
+        framesApplied++;
+      }
+    }
+  }
+
+  void rewind() {
+    // Notice: host transmissions were cleared (ie. the controller rebooted), \
+    //   while the AC unit kept its state (it is powered on its own)
+    transmissionsCursor = 0;
+    hasTransmission = false;
+  }
+
+  unsigned int modeIndex() {
+    for (unsigned int i = 0; i < SIMULATOR_MODES_COUNT; i++) {
+      if (SIMULATOR_MODES[i] == values[1]) {
+        return i;
+      }
+    }
+
+    return 0;
+  }
+
+  void apply(unsigned int command) {
+    bool isOn = (values[0] == 1) ? true : false;
+
+    switch (command) {
+      case SIMULATOR_COMMAND_POWER:
+        values[0] = (isOn == true) ? 0 : 1;
+        break;
+
+      case SIMULATOR_COMMAND_MODE:
+        values[1] = SIMULATOR_MODES[(modeIndex() + 1) % SIMULATOR_MODES_COUNT];
+        break;
+
+      case SIMULATOR_COMMAND_TEMPERATURE_UP:
+      case SIMULATOR_COMMAND_TEMPERATURE_DOWN:
+        // Notice: the display shows the threshold of the current mode, and \
+        //   the buttons do nothing while off, or in other modes
+        if (isOn == true && values[1] == 2) {
+          values[2] = stepTemperature(values[2], command, SIMULATOR_COOL_MINIMUM, SIMULATOR_COOL_MAXIMUM);
+        } else if (isOn == true && values[1] == 1) {
+          values[3] = stepTemperature(values[3], command, SIMULATOR_HEAT_MINIMUM, SIMULATOR_HEAT_MAXIMUM);
+        }
+
+        break;
+
+      case SIMULATOR_COMMAND_SWING:
+        // Notice: swing is locked in the auto mode (the AC unit decides)
+        if (isOn == true && values[1] != 0) {
+          values[4] = (values[4] == 1) ? 0 : 1;
+        }
+
+        break;
+    }
+  }
+
+  uint8_t stepTemperature(uint8_t temperature, unsigned int command, unsigned int minimum, unsigned int maximum) {
+    if (command == SIMULATOR_COMMAND_TEMPERATURE_UP) {
+      return (temperature < maximum) ? (temperature + 1) : maximum;
+    }
+
+    return (temperature > minimum) ? (temperature - 1) : minimum;
+  }
+};
@@ -0,0 +1,117 @@
+// Host Tests
+//
+// Host-side tests for both projects (Linux, w/o an ESP32 board)
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#pragma once
+
+#include <random>
+
+#include "host.h"
+
+// Notice: the simulated tank is written from the tank dimensions and the \
+//   HC-SR04 datasheet, and does not use the conversion of the sketch (it \
+//   would otherwise share its mistakes)
+const float TANK_SENSOR_OFFSET_CENTIMETERS = 1.0; // Sensor is 1cm above a full tank
+const float TANK_EMPTY_DISTANCE_CENTIMETERS = 28.0; // 28cm from full to empty
+const float TANK_ECHO_MICROSECONDS_PER_CENTIMETER = 58.2; // Round trip (datasheet: distance = echo / 58)
+
+// Notice: the sensor sends its 8-cycle 40kHz burst once triggered, and only \
+//   raises ECHO once the burst is out
+const uint64_t TANK_BURST_MICROSECONDS = 200;
+
+struct SimulatedTank {
+  /**
+    [Simulated Tank]
+
+      - Watches the TRIGGER pin of its sensor, and answers each trigger (ie.
+        a falling edge after a pulse) w/ an echo pulse on the ECHO pin, as
+        long as the round trip to the water surface takes
+
+      - Echoes are noisy (gaussian, w/ a seeded generator, so that runs are
+        repeatable), and can get lost (no echo pulse at all, eg. a ripple
+        that deflects the burst)
+  **/
+
+  int triggerPin = -1,
+      echoPin = -1;
+
+  // True level (0.0 is empty, 1.0 is full)
+  float level = 0.5;
+
+  // Echo noise (standard deviation, in µs) and ratio of lost echoes
+  float noiseMicros = 0.0,
+        dropoutRatio = 0.0;
+
+  unsigned int triggersCount = 0,
+               echoesCount = 0,
+               dropoutsCount = 0;
+
+  int lastTriggerLevel = LOW;
+
+  std::mt19937 random32;
+
+  void begin(int triggerPinNumber, int echoPinNumber, unsigned int seed = 42) {
+    triggerPin = triggerPinNumber;
+    echoPin = echoPinNumber;
+
+    random32.seed(seed);
+
+    hostPinWriteHook = [this](int pin, int pinLevel) {
+      onPinWrite(pin, pinLevel);
+    };
+  }
+
+  float echoMicros() {
+    // Round trip to the water surface (w/o noise)
+    float distance = TANK_SENSOR_OFFSET_CENTIMETERS + (1.0 - level) * TANK_EMPTY_DISTANCE_CENTIMETERS;
+
+    return distance * TANK_ECHO_MICROSECONDS_PER_CENTIMETER;
+  }
+
+  unsigned long sampleEchoMicros() {
+    // Round trip to the water surface (w/ noise)
+    std::normal_distribution<float> noise(0.0, noiseMicros);
+
+    float sample = echoMicros() + ((noiseMicros > 0.0) ? noise(random32) : 0.0);
+
+    return (sample < 1.0) ? 1 : (unsigned long)(sample + 0.5);
+  }
+
+  bool sampleDropout() {
+    std::uniform_real_distribution<float> uniform(0.0, 1.0);
+
+    return dropoutRatio > 0.0 && uniform(random32) < dropoutRatio;
+  }
+
+  void onPinWrite(int pin, int pinLevel) {
+    if (pin != triggerPin) {
+      return;
+    }
+
+    bool isTriggered = (lastTriggerLevel == HIGH && pinLevel == LOW);
+
+    lastTriggerLevel = pinLevel;
+
+    if (isTriggered == false) {
+      return;
+    }
+
+    triggersCount++;
+
+    // Echo lost? (ECHO stays low)
+    if (sampleDropout() == true) {
+      dropoutsCount++;
+
+      return;
+    }
+
+    uint64_t riseMicros = hostMicros + TANK_BURST_MICROSECONDS;
+
+    hostSchedulePinLevel(echoPin, HIGH, riseMicros);
+    hostSchedulePinLevel(echoPin, LOW, riseMicros + sampleEchoMicros());
+
+    echoesCount++;
+  }
+};
@@ -0,0 +1,216 @@
+// Host Tests
+//
+// Host-side tests for both projects (Linux, w/o an ESP32 board)
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#include "services.h"
+
+#include "boot.h"
+#include "harness.h"
+#include "simulator.h"
+
+const unsigned int BRIDGE_TEST_UNITS_COUNT = 8;
+const uint64_t BRIDGE_TEST_BOOT_MICROSECONDS = 10000000; // 10 seconds
+const uint64_t BRIDGE_TEST_CONVERGE_MICROSECONDS = 60000000; // 1 minute
+const uint64_t BRIDGE_TEST_STEP_MICROSECONDS = 10000; // 10 milliseconds
+
+// Notice: 1 IR LED per AC unit (the first one is the default IR LED)
+const int BRIDGE_TEST_IR_PINS[BRIDGE_TEST_UNITS_COUNT] = {IR_PIN_PWM, 4, 5, 16, 18, 19, 21, 22};
+
+static AirConditionerRemote<AC_PROFILE> *units[BRIDGE_TEST_UNITS_COUNT];
+
+static SimulatedAirConditioner simulators[BRIDGE_TEST_UNITS_COUNT];
+
+static void bootBridge(unsigned int unitsCount) {
+  // Notice: as the sketch setup() does for UNITS_COUNT units
+  hostRenew(thermometer);
+  hostRenew(irTransmitter);
+  hostRenew(trace);
+  hostRenew(power);
+  hostRenew(scheduler);
+  hostRenew(bridge);
+
+  bridge.begin();
+
+  for (unsigned int unit = 0; unit < unitsCount; unit++) {
+    uint32_t freeHeapBytes = ESP.getFreeHeap();
+
+    units[unit] = new AirConditionerRemote<AC_PROFILE>(unit, BRIDGE_TEST_IR_PINS[unit], &thermometer);
+
+    bridge.add(units[unit], freeHeapBytes - ESP.getFreeHeap());
+  }
+}
+
+static void targetValuesOf(unsigned int unit, uint8_t values[]) {
+  // Cool at a different temperature for each unit, w/ swing on every other unit
+  values[STORAGE_INDEX_SM_ACTIVE] = 1;
+  values[STORAGE_INDEX_SM_TARGET_HEATER_COOLER_STATE] = 2;
+  values[STORAGE_INDEX_SM_COOLING_THRESHOLD_TEMPERATURE] = 19 + unit;
+  values[STORAGE_INDEX_SM_HEATING_THRESHOLD_TEMPERATURE] = 18;
+  values[STORAGE_INDEX_SM_SWING_MODE] = unit % 2;
+}
+
+static bool updateUnit(unsigned int unit) {
+  uint8_t values[STORAGE_SIZE];
+
+  targetValuesOf(unit, values);
+
+  return hostUpdate(units[unit], {
+    {units[unit]->hkActive, (float)values[STORAGE_INDEX_SM_ACTIVE]},
+    {units[unit]->hkTargetHeaterCoolerState, (float)values[STORAGE_INDEX_SM_TARGET_HEATER_COOLER_STATE]},
+    {units[unit]->hkCoolingThresholdTemperature, (float)values[STORAGE_INDEX_SM_COOLING_THRESHOLD_TEMPERATURE]},
+    {units[unit]->hkHeatingThresholdTemperature, (float)values[STORAGE_INDEX_SM_HEATING_THRESHOLD_TEMPERATURE]},
+    {units[unit]->hkSwingMode, (float)values[STORAGE_INDEX_SM_SWING_MODE]}
+  });
+}
+
+static unsigned int countConvergedUnits() {
+  unsigned int convergedCount = 0;
+
+  for (unsigned int unit = 0; unit < BRIDGE_TEST_UNITS_COUNT; unit++) {
+    uint8_t values[STORAGE_SIZE];
+
+    targetValuesOf(unit, values);
+
+    simulators[unit].receive();
+
+    if (memcmp(simulators[unit].values, values, STORAGE_SIZE) == 0) {
+      convergedCount++;
+    }
+  }
+
+  return convergedCount;
+}
+
+TEST(testConvergesEightUnitsConcurrently) {
+  hostFlashCreate(JOURNAL_PARTITION_LABEL, JOURNAL_PARTITION_SIZE);
+
+  for (unsigned int unit = 0; unit < BRIDGE_TEST_UNITS_COUNT; unit++) {
+    simulators[unit].begin(BRIDGE_TEST_IR_PINS[unit]);
+  }
+
+  bootBridge(BRIDGE_TEST_UNITS_COUNT);
+  bootRunUntil(BRIDGE_TEST_BOOT_MICROSECONDS);
+
+  // Notice: all units get updated at once (eg. a HomeKit scene)
+  for (unsigned int unit = 0; unit < BRIDGE_TEST_UNITS_COUNT; unit++) {
+    CHECK(updateUnit(unit) == true);
+  }
+
+  uint64_t updateMicros = hostMicros;
+
+  while (countConvergedUnits() < BRIDGE_TEST_UNITS_COUNT && hostMicros < updateMicros + BRIDGE_TEST_CONVERGE_MICROSECONDS) {
+    bootRunUntil(hostMicros + BRIDGE_TEST_STEP_MICROSECONDS);
+  }
+
+  uint64_t convergeMicros = hostMicros - updateMicros;
+
+  CHECK_EQUAL(BRIDGE_TEST_UNITS_COUNT, countConvergedUnits());
+
+  // Frames of all units went through the single queue, thus never overlap
+  unsigned int framesCount = 0,
+               overlapsCount = 0,
+               rejectedCount = 0;
+
+  for (unsigned int i = 0; i < hostTransmissions.size(); i++) {
+    if (i > 0 && hostTransmissions[i].startMicros < hostTransmissions[i - 1].endMicros) {
+      overlapsCount++;
+    }
+  }
+
+  for (unsigned int unit = 0; unit < BRIDGE_TEST_UNITS_COUNT; unit++) {
+    framesCount += simulators[unit].framesApplied;
+    rejectedCount += simulators[unit].framesRejected;
+  }
+
+  printf("     %u units updated at once: all converged after %.2fs (%u frames, %u transmissions, %u overlaps)\n", BRIDGE_TEST_UNITS_COUNT, convergeMicros / 1000000.0, framesCount, (unsigned int)hostTransmissions.size(), overlapsCount);
+
+  CHECK_EQUAL(0, overlapsCount);
+  CHECK_EQUAL(0, rejectedCount);
+  CHECK_EQUAL(0, irTransmitter.framesDropped);
+
+  // Each unit journals to its own region (and recovers its own values)
+  bootRunUntil(hostMicros + BRIDGE_TEST_CONVERGE_MICROSECONDS);
+
+  std::vector<uint8_t> image = hostFlashImage(JOURNAL_PARTITION_LABEL);
+
+  hostReset();
+  hostFlashCreate(JOURNAL_PARTITION_LABEL, JOURNAL_PARTITION_SIZE);
+  hostFlashImage(JOURNAL_PARTITION_LABEL) = image;
+
+  bootBridge(BRIDGE_TEST_UNITS_COUNT);
+
+  unsigned int recoveredCount = 0;
+
+  for (unsigned int unit = 0; unit < BRIDGE_TEST_UNITS_COUNT; unit++) {
+    uint8_t values[STORAGE_SIZE],
+            recoveredValues[STORAGE_SIZE];
+
+    targetValuesOf(unit, values);
+
+    units[unit]->snapshotStateMachineValues(recoveredValues);
+
+    CHECK_EQUAL(unit * JOURNAL_REGION_SIZE, units[unit]->journal.regionOffset);
+
+    if (memcmp(recoveredValues, values, STORAGE_SIZE) == 0) {
+      recoveredCount++;
+    }
+  }
+
+  CHECK_EQUAL(BRIDGE_TEST_UNITS_COUNT, recoveredCount);
+}
+
+TEST(testPrintsFootprintPerUnit) {
+  hostFlashCreate(JOURNAL_PARTITION_LABEL, JOURNAL_PARTITION_SIZE);
+
+  uint32_t freeHeapBytes = ESP.getFreeHeap();
+
+  bootBridge(BRIDGE_TEST_UNITS_COUNT);
+
+  uint32_t unitsHeapBytes = 0;
+
+  for (unsigned int unit = 0; unit < BRIDGE_TEST_UNITS_COUNT; unit++) {
+    CHECK(bridge.unitsHeapBytes[unit] >= sizeof(AirConditionerRemote<AC_PROFILE>));
+
+    unitsHeapBytes += bridge.unitsHeapBytes[unit];
+  }
+
+  printf("     footprint: %u bytes of state per unit, %u bytes of heap per unit (host), %u bytes shared (static)\n", (unsigned int)sizeof(AirConditionerRemote<AC_PROFILE>), unitsHeapBytes / BRIDGE_TEST_UNITS_COUNT, (unsigned int)(sizeof(scheduler) + sizeof(irTransmitter) + sizeof(thermometer) + sizeof(trace)));
+
+  // Notice: units are all alike, thus take the same heap (the rest of \
+  //   the heap went to the bridge, ie. its serial console commands)
+  CHECK(freeHeapBytes - ESP.getFreeHeap() > unitsHeapBytes);
+  CHECK_EQUAL(bridge.unitsHeapBytes[0], bridge.unitsHeapBytes[BRIDGE_TEST_UNITS_COUNT - 1]);
+
+  CHECK(hostRunCommand("s") == true);
+
+  char line[96];
+
+  snprintf(line, sizeof(line), "  - Unit #%u = %u bytes of heap", BRIDGE_TEST_UNITS_COUNT - 1, bridge.unitsHeapBytes[BRIDGE_TEST_UNITS_COUNT - 1]);
+
+  CHECK(hostSerialOutput.find(line) != std::string::npos);
+}
+
+TEST(testReportsUnitsWithoutRegion) {
+  // Notice: a board flashed w/ the former partition table (1 region)
+  hostFlashCreate(JOURNAL_PARTITION_LABEL, JOURNAL_REGION_SIZE);
+
+  bootBridge(2);
+
+  CHECK(units[0]->journal.partition != NULL);
+  CHECK(units[1]->journal.partition == NULL);
+  CHECK(hostSerialOutput.find("Error configuring storage of AC unit #1!") != std::string::npos);
+
+  CHECK(hostRunCommand("v") == true);
+
+  CHECK(hostSerialOutput.find("  - Region = none (values are not saved)") != std::string::npos);
+}
+
+int main() {
+  RUN(testConvergesEightUnitsConcurrently);
+  RUN(testPrintsFootprintPerUnit);
+  RUN(testReportsUnitsWithoutRegion);
+
+  return harnessReport("bridge");
+}
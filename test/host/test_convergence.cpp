@@ -0,0 +1,247 @@
+// Host Tests
+//
+// Host-side tests for both projects (Linux, w/o an ESP32 board)
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "services.h"
+
+#include "boot.h"
+#include "harness.h"
+#include "simulator.h"
+
+/**
+  [Convergence Benchmark]
+
+    - Every start value of the SM (active × mode × cool threshold × heat
+      threshold × swing) is planned towards every target value that
+      HomeKit can request (as the '@c' plans check walks them), but through
+      the whole sketch: the device task emits IR frames, which a simulated
+      AC unit decodes, on the virtual clock
+
+    - A pair converges once the AC unit shows the target values, and the
+      SM agrees w/ the AC unit; any other outcome fails the benchmark
+
+    - Reports distributions of IR frames sent, scheduler ticks and virtual
+      time to converge (from the HomeKit update to the AC unit showing the
+      target values); pairs are strided by default (1 in every 37 pairs,
+      which 'make test' runs), while 'make bench' runs them all
+**/
+
+typedef AirConditionerRemote<AC_PROFILE> UNIT;
+
+const uint64_t CONVERGENCE_UPDATE_MICROSECONDS = 1000000; // 1 second after boot
+const uint64_t CONVERGENCE_TIMEOUT_MICROSECONDS = 60000000; // 1 minute
+const unsigned int CONVERGENCE_FAILURES_LOGGED = 5;
+const unsigned int CONVERGENCE_STRIDE_DEFAULT = 37; // ~7,800 pairs (all pairs take ~10 seconds)
+
+struct ConvergenceResult {
+  bool isConverged;
+
+  unsigned int framesCount,
+               ticksCount;
+
+  uint64_t convergeMicros;
+};
+
+static SimulatedAirConditioner simulator;
+
+static unsigned int countSchedulerTicks() {
+  unsigned int ticksCount = 0;
+
+  for (unsigned int i = 0; i < scheduler.tasksCount; i++) {
+    ticksCount += scheduler.tasks[i].histogram.samplesCount;
+  }
+
+  return ticksCount;
+}
+
+static bool isSettled() {
+  // Notice: the SM has converged, and all of its IR frames were sent
+  return bootUnit->hasUnconvergedUpdate == false && irTransmitter.queueSize == 0 && bootUnit->planCursor >= bootUnit->plan.size;
+}
+
+static ConvergenceResult convergePair(const uint8_t startValues[], const uint8_t targetValues[]) {
+  ConvergenceResult result = {};
+
+  hostReset();
+
+  // Seed the journal w/ start values (as if they were reached before boot)
+  hostFlashCreate(JOURNAL_PARTITION_LABEL, JOURNAL_REGION_SIZE);
+
+  Journal seed;
+
+  seed.begin(0);
+  seed.append(JOURNAL_RECORD_TYPE_SNAPSHOT, 0, startValues);
+
+  simulator.begin(IR_PIN_PWM);
+
+  memcpy(simulator.values, startValues, STORAGE_SIZE);
+
+  bootSketch();
+  bootRunUntil(CONVERGENCE_UPDATE_MICROSECONDS);
+
+  unsigned int ticksBefore = countSchedulerTicks();
+
+  bootUpdate(targetValues);
+
+  // Run the device task until settled (or until it should have)
+  do {
+    bridge.runDevice();
+  } while (isSettled() == false && hostMicros < CONVERGENCE_UPDATE_MICROSECONDS + CONVERGENCE_TIMEOUT_MICROSECONDS);
+
+  simulator.receive();
+
+  uint8_t values[STORAGE_SIZE];
+
+  bootUnit->snapshotStateMachineValues(values);
+
+  result.isConverged = (isSettled() == true && simulator.framesRejected == 0 && memcmp(simulator.values, targetValues, STORAGE_SIZE) == 0 && memcmp(values, simulator.values, STORAGE_SIZE) == 0) ? true : false;
+  result.framesCount = simulator.framesApplied + simulator.framesRejected + simulator.framesIgnored;
+  result.ticksCount = countSchedulerTicks() - ticksBefore;
+
+  // AC unit shows target values once the last frame was decoded
+  for (const HostTransmission &transmission : hostTransmissions) {
+    NecReception reception = necDecode(transmission);
+
+    if (reception.isData == true) {
+      result.convergeMicros = reception.dataEndMicros - CONVERGENCE_UPDATE_MICROSECONDS;
+    }
+  }
+
+  return result;
+}
+
+template <typename T>
+static void printDistribution(const char *name, const char *unit, std::vector<T> &samples) {
+  if (samples.empty() == true) {
+    return;
+  }
+
+  std::sort(samples.begin(), samples.end());
+
+  double total = 0;
+
+  for (T sample : samples) {
+    total += sample;
+  }
+
+  printf("     %s: mean %.1f%s, p50 %llu%s, p90 %llu%s, p99 %llu%s, max %llu%s\n", name, total / samples.size(), unit, (unsigned long long)samples[samples.size() / 2], unit, (unsigned long long)samples[samples.size() * 90 / 100], unit, (unsigned long long)samples[samples.size() * 99 / 100], unit, (unsigned long long)samples.back(), unit);
+}
+
+static unsigned int convergenceStride = CONVERGENCE_STRIDE_DEFAULT;
+
+TEST(testConvergesFromAllStartsToAllTargets) {
+  std::vector<unsigned int> frames,
+                            ticks;
+
+  std::vector<uint64_t> convergeMillis;
+
+  unsigned int framesCounts[IR_PLAN_CAPACITY + 1] = {};
+
+  unsigned int pairsCount = 0,
+               failuresCount = 0;
+
+  // Walk start values (one digit per SM value, as the '@c' plans check)
+  unsigned int startsCount = STATES_DIRECTION_ACTIVE::SIZE * UNIT::STATES_DIRECTION_TARGET_HEATER_COOLER_STATE::SIZE * UNIT::STATES_COOLING_THRESHOLD_TEMPERATURE::SIZE * UNIT::STATES_HEATING_THRESHOLD_TEMPERATURE::SIZE * STATES_SWING_MODE::SIZE;
+
+  for (unsigned int start = 0; start < startsCount; start++) {
+    uint8_t startValues[STORAGE_SIZE],
+            targetValues[STORAGE_SIZE];
+
+    unsigned int cursor = start;
+
+    startValues[STORAGE_INDEX_SM_ACTIVE] = STATES_DIRECTION_ACTIVE::at(cursor % STATES_DIRECTION_ACTIVE::SIZE);
+    cursor /= STATES_DIRECTION_ACTIVE::SIZE;
+    startValues[STORAGE_INDEX_SM_TARGET_HEATER_COOLER_STATE] = UNIT::STATES_DIRECTION_TARGET_HEATER_COOLER_STATE::at(cursor % UNIT::STATES_DIRECTION_TARGET_HEATER_COOLER_STATE::SIZE);
+    cursor /= UNIT::STATES_DIRECTION_TARGET_HEATER_COOLER_STATE::SIZE;
+    startValues[STORAGE_INDEX_SM_COOLING_THRESHOLD_TEMPERATURE] = UNIT::STATES_COOLING_THRESHOLD_TEMPERATURE::at(cursor % UNIT::STATES_COOLING_THRESHOLD_TEMPERATURE::SIZE);
+    cursor /= UNIT::STATES_COOLING_THRESHOLD_TEMPERATURE::SIZE;
+    startValues[STORAGE_INDEX_SM_HEATING_THRESHOLD_TEMPERATURE] = UNIT::STATES_HEATING_THRESHOLD_TEMPERATURE::at(cursor % UNIT::STATES_HEATING_THRESHOLD_TEMPERATURE::SIZE);
+    cursor /= UNIT::STATES_HEATING_THRESHOLD_TEMPERATURE::SIZE;
+    startValues[STORAGE_INDEX_SM_SWING_MODE] = STATES_SWING_MODE::at(cursor % STATES_SWING_MODE::SIZE);
+
+    // Walk target values that HomeKit can request (thresholds and swing \
+    //   mode only apply to the heat and cool modes)
+    std::vector<std::vector<uint8_t>> targets;
+
+    for (unsigned int active = ACTIVE_INACTIVE; active <= ACTIVE_ACTIVE; active++) {
+      for (unsigned int mode = TARGET_HEATER_COOLER_STATE_AUTO; mode <= TARGET_HEATER_COOLER_STATE_COOL; mode++) {
+        memcpy(targetValues, startValues, STORAGE_SIZE);
+
+        targetValues[STORAGE_INDEX_SM_ACTIVE] = active;
+        targetValues[STORAGE_INDEX_SM_TARGET_HEATER_COOLER_STATE] = mode;
+
+        if (active == ACTIVE_ACTIVE && mode > TARGET_HEATER_COOLER_STATE_AUTO) {
+          int index = (mode == TARGET_HEATER_COOLER_STATE_COOL) ? STORAGE_INDEX_SM_COOLING_THRESHOLD_TEMPERATURE : STORAGE_INDEX_SM_HEATING_THRESHOLD_TEMPERATURE;
+
+          unsigned int minimum = (mode == TARGET_HEATER_COOLER_STATE_COOL) ? UNIT::CODEBOOK::RANGE_TEMPERATURE_COOL_MINIMUM : UNIT::CODEBOOK::RANGE_TEMPERATURE_HEAT_MINIMUM,
+                       maximum = (mode == TARGET_HEATER_COOLER_STATE_COOL) ? UNIT::CODEBOOK::RANGE_TEMPERATURE_COOL_MAXIMUM : UNIT::CODEBOOK::RANGE_TEMPERATURE_HEAT_MAXIMUM;
+
+          for (unsigned int temperature = minimum; temperature <= maximum; temperature++) {
+            for (unsigned int swingMode = ACTIVE_SWING_MODE_DISABLED; swingMode <= ACTIVE_SWING_MODE_ENABLED; swingMode++) {
+              targetValues[index] = temperature;
+              targetValues[STORAGE_INDEX_SM_SWING_MODE] = swingMode;
+
+              targets.push_back(std::vector<uint8_t>(targetValues, targetValues + STORAGE_SIZE));
+            }
+          }
+        } else {
+          targets.push_back(std::vector<uint8_t>(targetValues, targetValues + STORAGE_SIZE));
+        }
+      }
+    }
+
+    for (const std::vector<uint8_t> &target : targets) {
+      pairsCount++;
+
+      if ((pairsCount - 1) % convergenceStride != 0) {
+        continue;
+      }
+
+      ConvergenceResult result = convergePair(startValues, target.data());
+
+      if (result.isConverged == false) {
+        failuresCount++;
+
+        if (failuresCount <= CONVERGENCE_FAILURES_LOGGED) {
+          printf("     did not converge from [%d, %d, %d, %d, %d] to [%d, %d, %d, %d, %d] (got: [%d, %d, %d, %d, %d])\n", startValues[0], startValues[1], startValues[2], startValues[3], startValues[4], target[0], target[1], target[2], target[3], target[4], simulator.values[0], simulator.values[1], simulator.values[2], simulator.values[3], simulator.values[4]);
+        }
+      }
+
+      frames.push_back(result.framesCount);
+      ticks.push_back(result.ticksCount);
+      convergeMillis.push_back(result.convergeMicros / 1000);
+
+      framesCounts[min(result.framesCount, IR_PLAN_CAPACITY)]++;
+    }
+  }
+
+  printf("     %u of %u start and target value pairs run (1 in %u), %u did not converge\n", (unsigned int)frames.size(), pairsCount, convergenceStride, failuresCount);
+
+  printDistribution("IR frames", "", frames);
+  printDistribution("Scheduler ticks", "", ticks);
+  printDistribution("Time to converge", "ms", convergeMillis);
+
+  for (unsigned int i = 0; i <= IR_PLAN_CAPACITY; i++) {
+    if (framesCounts[i] > 0) {
+      printf("       %2u frames = %u pairs\n", i, framesCounts[i]);
+    }
+  }
+
+  CHECK(frames.empty() == false);
+  CHECK_EQUAL(0, failuresCount);
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1) {
+    convergenceStride = max(atoi(argv[1]), 1);
+  }
+
+  RUN(testConvergesFromAllStartsToAllTargets);
+
+  return harnessReport("convergence");
+}
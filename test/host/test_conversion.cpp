@@ -0,0 +1,106 @@
+// Host Tests
+//
+// Host-side tests for both projects (Linux, w/o an ESP32 board)
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#include <chrono>
+#include <cmath>
+
+#include "sensors.h"
+
+#include "harness.h"
+
+const unsigned int CONVERSION_BENCHMARK_ROUNDS = 100;
+
+static float referenceLevelPercent(unsigned long durationSample) {
+  // Float conversion (as the former acquireWaterLevelSample())
+  float distanceSample = ((float)durationSample / 2) / 29.1;
+
+  distanceSample -= WATER_TANK_SENSOR_OFFSET_DISTANCE;
+
+  return 100.0 - max(0.0, min((distanceSample / WATER_TANK_FILL_EMPTY_DISTANCE) * 100.0, 100.0));
+}
+
+static unsigned int referenceLevelPermille(unsigned long durationSample) {
+  return (unsigned int)lroundf(referenceLevelPercent(durationSample) * 10.0);
+}
+
+static WaterTankLevelSensor *bootSensor() {
+  SpanCharacteristic *inUse = new Characteristic::InUse();
+  SpanCharacteristic *statusFault = new Characteristic::StatusFault(0);
+
+  return new WaterTankLevelSensor(statusFault, inUse);
+}
+
+TEST(testMatchesFloatConversion) {
+  WaterTankLevelSensor *sensor = bootSensor();
+
+  unsigned int mismatchesCount = 0;
+
+  // Notice: any echo past the timeout is rejected before it gets converted
+  for (unsigned long durationSample = 0; durationSample <= WATER_LEVEL_ECHO_TIMEOUT_MICROSECONDS; durationSample++) {
+    if (sensor->convertEchoToLevelPermille(durationSample) != referenceLevelPermille(durationSample)) {
+      mismatchesCount++;
+
+      printf("     mismatch at %luµs: %u permille (float: %u permille)\n", durationSample, sensor->convertEchoToLevelPermille(durationSample), referenceLevelPermille(durationSample));
+    }
+  }
+
+  CHECK_EQUAL(0, mismatchesCount);
+}
+
+TEST(testClampsToTankRange) {
+  WaterTankLevelSensor *sensor = bootSensor();
+
+  // Echo from above the water at 100% level (eg. the sensor offset)
+  CHECK_EQUAL(1000, sensor->convertEchoToLevelPermille(0));
+  CHECK_EQUAL(1000, sensor->convertEchoToLevelPermille(58));
+
+  // Echo from the bottom of the tank, or past it (up to the timeout)
+  CHECK_EQUAL(0, sensor->convertEchoToLevelPermille((WATER_TANK_SENSOR_OFFSET_DISTANCE + WATER_TANK_FILL_EMPTY_DISTANCE) * 2 * 29.1 + 1));
+  CHECK_EQUAL(0, sensor->convertEchoToLevelPermille(WATER_LEVEL_ECHO_TIMEOUT_MICROSECONDS));
+}
+
+TEST(testBenchmarksFixedPointAgainstFloat) {
+  WaterTankLevelSensor *sensor = bootSensor();
+
+  // Convert every echo in range, many times over (the volatile sink keeps \
+  //   conversions from being optimized out)
+  volatile unsigned int sink = 0;
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  for (unsigned int round = 0; round < CONVERSION_BENCHMARK_ROUNDS; round++) {
+    for (unsigned long durationSample = 0; durationSample <= WATER_LEVEL_ECHO_TIMEOUT_MICROSECONDS; durationSample++) {
+      sink = sink + (unsigned int)referenceLevelPercent(durationSample);
+    }
+  }
+
+  std::chrono::steady_clock::time_point middle = std::chrono::steady_clock::now();
+
+  for (unsigned int round = 0; round < CONVERSION_BENCHMARK_ROUNDS; round++) {
+    for (unsigned long durationSample = 0; durationSample <= WATER_LEVEL_ECHO_TIMEOUT_MICROSECONDS; durationSample++) {
+      sink = sink + sensor->convertEchoToLevelPermille(durationSample);
+    }
+  }
+
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+  unsigned long conversionsCount = CONVERSION_BENCHMARK_ROUNDS * (WATER_LEVEL_ECHO_TIMEOUT_MICROSECONDS + 1);
+
+  double floatNanos = std::chrono::duration<double, std::nano>(middle - start).count() / conversionsCount,
+         fixedNanos = std::chrono::duration<double, std::nano>(end - middle).count() / conversionsCount;
+
+  printf("     echo conversion: float %.2fns, Q16 fixed-point %.2fns (host, %lu conversions)\n", floatNanos, fixedNanos, conversionsCount);
+
+  CHECK(sink > 0);
+}
+
+int main() {
+  RUN(testMatchesFloatConversion);
+  RUN(testClampsToTankRange);
+  RUN(testBenchmarksFixedPointAgainstFloat);
+
+  return harnessReport("conversion");
+}
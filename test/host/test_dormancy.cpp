@@ -0,0 +1,120 @@
+// Host Tests
+//
+// Host-side tests for both projects (Linux, w/o an ESP32 board)
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#include "services.h"
+
+#include "boot.h"
+#include "harness.h"
+#include "simulator.h"
+
+const uint64_t DORMANCY_CONVERGE_MICROSECONDS = 10000000; // 10 seconds
+const uint64_t DORMANCY_IDLE_MICROSECONDS = 3600000000; // 1 hour
+
+// Cool at 18°C (w/o swing), then the same w/ swing
+const uint8_t DORMANCY_VALUES[STORAGE_SIZE] = {1, 2, 18, 18, 0};
+const uint8_t DORMANCY_SWING_VALUES[STORAGE_SIZE] = {1, 2, 18, 18, 1};
+
+static SimulatedAirConditioner simulator;
+
+static unsigned int countRuns(unsigned int task) {
+  return scheduler.tasks[task].histogram.samplesCount;
+}
+
+static void convergeTo(const uint8_t values[]) {
+  hostFlashCreate(JOURNAL_PARTITION_LABEL, JOURNAL_REGION_SIZE);
+
+  simulator.begin(IR_PIN_PWM);
+
+  bootSketch();
+  bootRunUntil(DORMANCY_CONVERGE_MICROSECONDS);
+
+  CHECK(bootUpdate(values) == true);
+
+  bootRunUntil(2 * DORMANCY_CONVERGE_MICROSECONDS);
+
+  simulator.receive();
+
+  CHECK(memcmp(simulator.values, values, STORAGE_SIZE) == 0);
+  CHECK_EQUAL(0, bootUnit->dirtyMask);
+}
+
+TEST(testSleepsOnceConverged) {
+  convergeTo(DORMANCY_VALUES);
+
+  unsigned int smRunsCount = countRuns(bootUnit->taskSM),
+               passesCount = bridge.devicePassHistogram.samplesCount;
+
+  CHECK(bootUnit->isStateMachineDormant == true);
+
+  // Idle for an hour, w/o any update
+  bootRunUntil(2 * DORMANCY_CONVERGE_MICROSECONDS + DORMANCY_IDLE_MICROSECONDS);
+
+  unsigned int idleSmRunsCount = countRuns(bootUnit->taskSM) - smRunsCount,
+               idlePassesCount = bridge.devicePassHistogram.samplesCount - passesCount,
+               idlePollRunsCount = countRuns(bootUnit->taskPoll);
+
+  unsigned long ticksAvoidedCount = bootUnit->countStateMachineTicksAvoided();
+
+  printf("     1 hour converged: %u SM runs, %u device passes (%u poll runs since boot), %lu SM ticks avoided\n", idleSmRunsCount, idlePassesCount, idlePollRunsCount, ticksAvoidedCount);
+
+  // Notice: a polling SM would have ticked once per second
+  CHECK_EQUAL(0, idleSmRunsCount);
+  CHECK(ticksAvoidedCount >= DORMANCY_IDLE_MICROSECONDS / 1000 / SM_WAKE_UP_EVERY_MILLISECONDS);
+
+  // Ticks avoided show in the current values (w/o waking the SM up)
+  CHECK(hostRunCommand("v") == true);
+
+  char line[64];
+
+  snprintf(line, sizeof(line), "  - Ticks Avoided = %lu (dormant)", ticksAvoidedCount);
+
+  CHECK(hostSerialOutput.find(line) != std::string::npos);
+}
+
+TEST(testPlansUpdatedDimensionOnly) {
+  convergeTo(DORMANCY_VALUES);
+
+  unsigned int framesAppliedCount = simulator.framesApplied;
+
+  // Turn swing on (the only characteristic HomeKit wrote)
+  CHECK(hostUpdate(bootUnit, {{bootUnit->hkSwingMode, 1.0}}) == true);
+
+  bootRunUntil(hostMicros + 1000);
+
+  CHECK_EQUAL(1 << STORAGE_INDEX_SM_SWING_MODE, bootUnit->dirtyMask);
+
+  bootRunUntil(hostMicros + DORMANCY_CONVERGE_MICROSECONDS);
+
+  simulator.receive();
+
+  CHECK_EQUAL(1, simulator.framesApplied - framesAppliedCount);
+  CHECK(memcmp(simulator.values, DORMANCY_SWING_VALUES, STORAGE_SIZE) == 0);
+  CHECK_EQUAL(0, bootUnit->dirtyMask);
+  CHECK(bootUnit->isStateMachineDormant == true);
+
+  // Notice: dimensions that are not dirty do not get planned, even if \
+  //   their target differs (they were not requested)
+  uint8_t currentValues[STORAGE_SIZE] = {0, 1, 18, 13, 0},
+          targetValues[STORAGE_SIZE] = {1, 2, 25, 20, 1};
+
+  InfraRedPlan plan;
+
+  bootUnit->planConvergence(plan, currentValues, targetValues, 1 << STORAGE_INDEX_SM_SWING_MODE);
+
+  CHECK_EQUAL(1, plan.size);
+  CHECK_EQUAL(STORAGE_INDEX_SM_SWING_MODE, plan.steps[0].index);
+
+  bootUnit->planConvergence(plan, currentValues, targetValues, STORAGE_MASK_ALL);
+
+  CHECK(plan.size > 1);
+}
+
+int main() {
+  RUN(testSleepsOnceConverged);
+  RUN(testPlansUpdatedDimensionOnly);
+
+  return harnessReport("dormancy");
+}
@@ -0,0 +1,187 @@
+// Host Tests
+//
+// Host-side tests for both projects (Linux, w/o an ESP32 board)
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#include <cmath>
+#include <random>
+
+#include "sensors.h"
+
+#include "harness.h"
+#include "tank.h"
+
+const unsigned int ESTIMATOR_POLL_MINUTES = 10; // Reference schedule
+const unsigned int ESTIMATOR_DRAIN_HOURS = 48;
+const float ESTIMATOR_DRAIN_RATE = -1.0; // 1% per hour
+const unsigned int ESTIMATOR_HISTORY_SIZE = 0x8000;
+
+static float absolute(float value) {
+  return (value < 0.0) ? -value : value;
+}
+
+static void drain(DrainEstimator &estimator, uint32_t &minute, float &level, float rate, unsigned int hours, std::mt19937 *random32 = NULL) {
+  // Feed levels as the sensor reports them (rounded to a percent, w/ \
+  //   optional noise of ±1%)
+  std::uniform_int_distribution<int> noise(-1, 1);
+
+  for (unsigned int i = 0; i < hours * 60 / ESTIMATOR_POLL_MINUTES; i++) {
+    minute += ESTIMATOR_POLL_MINUTES;
+    level += rate * ESTIMATOR_POLL_MINUTES / 60.0;
+
+    int reportedLevel = (int)roundf(level) + ((random32 != NULL) ? noise(*random32) : 0);
+
+    estimator.update(minute, max(reportedLevel, 0));
+  }
+}
+
+TEST(testFitsSteadyDrain) {
+  DrainEstimator estimator;
+
+  uint32_t minute = 0;
+  float level = 90.0;
+
+  drain(estimator, minute, level, ESTIMATOR_DRAIN_RATE, ESTIMATOR_DRAIN_HOURS);
+
+  printf("     steady 1%%/h drain over %uh: rate %.3f%%/h, level %.2f%% (true %.2f%%), %.1fh to low level (true %.1fh)\n", ESTIMATOR_DRAIN_HOURS, estimator.rate(), estimator.forecastLevel(0.0), level, estimator.hoursToLevel(WATER_LEVEL_LOW), level - WATER_LEVEL_LOW);
+
+  CHECK(absolute(estimator.rate() - ESTIMATOR_DRAIN_RATE) < 0.02);
+  CHECK(absolute(estimator.forecastLevel(0.0) - level) < 0.5);
+  CHECK(absolute(estimator.forecastLevel(10.0) - (level - 10.0)) < 0.5);
+  CHECK(absolute(estimator.hoursToLevel(WATER_LEVEL_LOW) - (level - WATER_LEVEL_LOW)) < 1.0);
+  CHECK_EQUAL(0, estimator.refillsCount);
+}
+
+TEST(testFitsNoisyDrain) {
+  DrainEstimator estimator;
+
+  std::mt19937 random32(42);
+
+  uint32_t minute = 0;
+  float level = 90.0;
+
+  drain(estimator, minute, level, ESTIMATOR_DRAIN_RATE, ESTIMATOR_DRAIN_HOURS, &random32);
+
+  printf("     noisy (±1%%) 1%%/h drain over %uh: rate %.3f%%/h, level %.2f%% (true %.2f%%)\n", ESTIMATOR_DRAIN_HOURS, estimator.rate(), estimator.forecastLevel(0.0), level);
+
+  // Notice: noise of ±1% must not be taken for refills (nor break the fit)
+  CHECK(absolute(estimator.rate() - ESTIMATOR_DRAIN_RATE) < 0.1);
+  CHECK(absolute(estimator.forecastLevel(0.0) - level) < 1.0);
+  CHECK_EQUAL(0, estimator.refillsCount);
+}
+
+TEST(testRestartsOnRefill) {
+  DrainEstimator estimator;
+
+  uint32_t minute = 0;
+  float level = 60.0;
+
+  drain(estimator, minute, level, ESTIMATOR_DRAIN_RATE, 24);
+
+  // Refill to 95%, then drain twice as fast
+  level = 95.0;
+  minute += ESTIMATOR_POLL_MINUTES;
+
+  estimator.update(minute, level);
+
+  CHECK_EQUAL(1, estimator.refillsCount);
+  CHECK_EQUAL(1, estimator.samplesCount);
+  CHECK(estimator.hasRate() == false);
+  CHECK(absolute(estimator.forecastLevel(0.0) - level) < 0.01);
+
+  drain(estimator, minute, level, 2 * ESTIMATOR_DRAIN_RATE, 6);
+
+  printf("     refill from 36%% to 95%%, then 2%%/h: rate %.3f%%/h after 6h (%u refills)\n", estimator.rate(), estimator.refillsCount);
+
+  // Notice: the fit restarted, thus the former drain rate is forgotten
+  CHECK(absolute(estimator.rate() - 2 * ESTIMATOR_DRAIN_RATE) < 0.05);
+
+  // A rise within the refill level is not a refill
+  minute += ESTIMATOR_POLL_MINUTES;
+
+  estimator.update(minute, (unsigned int)roundf(level) + DRAIN_ESTIMATOR_REFILL_LEVEL);
+
+  CHECK_EQUAL(1, estimator.refillsCount);
+}
+
+TEST(testForgetsDrainBursts) {
+  DrainEstimator estimator;
+
+  uint32_t minute = 0;
+  float level = 90.0;
+
+  // Watering drains 10% in 1 hour, then the level stays flat
+  drain(estimator, minute, level, -10.0, 1);
+
+  float burstRate = estimator.rate();
+
+  drain(estimator, minute, level, 0.0, 24);
+
+  float flatRate = estimator.rate();
+
+  drain(estimator, minute, level, 0.0, 48);
+
+  printf("     10%% burst in 1h: rate %.2f%%/h, %.3f%%/h 24h later, %.3f%%/h 72h later\n", burstRate, flatRate, estimator.rate());
+
+  CHECK(burstRate < -5.0);
+  CHECK(flatRate > burstRate / 5);
+  CHECK(estimator.rate() > -DRAIN_ESTIMATOR_RATE_MINIMUM);
+  CHECK(std::isinf(estimator.hoursToLevel(WATER_LEVEL_LOW)) == true);
+}
+
+TEST(testRaisesLowLevelAhead) {
+  // Drain a simulated tank at 1% per hour, and watch the low level as \
+  //   HomeKit sees it (the sensor adapts its poll interval)
+  hostFlashCreate(HISTORY_PARTITION_LABEL, ESTIMATOR_HISTORY_SIZE);
+
+  SimulatedTank tank;
+
+  tank.begin(WATER_LEVEL_SENSOR_PIN_TRIGGER, WATER_LEVEL_SENSOR_PIN_ECHO);
+  tank.noiseMicros = 2.0;
+
+  SpanCharacteristic *inUse = new Characteristic::InUse();
+  SpanCharacteristic *statusFault = new Characteristic::StatusFault(0);
+
+  WaterTankLevelSensor *sensor = new WaterTankLevelSensor(statusFault, inUse);
+
+  const float startLevel = 0.80;
+
+  float raisedLevel = -1.0;
+
+  uint64_t raisedMicros = 0;
+
+  while (tank.level > 0.10) {
+    tank.level = startLevel + (ESTIMATOR_DRAIN_RATE / 100.0) * (hostMicros / 3600000000.0);
+
+    sensor->runDevice();
+    sensor->loop();
+
+    if (raisedLevel < 0.0 && sensor->statusLowBattery->getVal() == 1) {
+      raisedLevel = tank.level * 100.0;
+      raisedMicros = hostMicros;
+    }
+  }
+
+  float hoursAhead = (raisedLevel - WATER_LEVEL_LOW) / -ESTIMATOR_DRAIN_RATE;
+
+  printf("     low level raised at %.1f%% after %.1fh (%.1fh before the %u%% low level, %u probes, %d refills)\n", raisedLevel, raisedMicros / 3600000000.0, hoursAhead, WATER_LEVEL_LOW, sensor->probesCount, sensor->drain.refillsCount);
+
+  // Notice: the level is forecast a day ahead, less the time it takes the \
+  //   fit to settle on the drain rate (the flag must rise well before 20%)
+  CHECK(raisedLevel > WATER_LEVEL_LOW);
+  CHECK(hoursAhead > WATER_LEVEL_LOW_FORECAST_HOURS * 0.75);
+  CHECK(hoursAhead < WATER_LEVEL_LOW_FORECAST_HOURS + 2.0);
+  CHECK_EQUAL(0, sensor->drain.refillsCount);
+  CHECK(sensor->lowLevel.isRaised == true);
+}
+
+int main() {
+  RUN(testFitsSteadyDrain);
+  RUN(testFitsNoisyDrain);
+  RUN(testRestartsOnRefill);
+  RUN(testForgetsDrainBursts);
+  RUN(testRaisesLowLevelAhead);
+
+  return harnessReport("estimator");
+}
@@ -0,0 +1,214 @@
+// Host Tests
+//
+// Host-side tests for both projects (Linux, w/o an ESP32 board)
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#include "sensors.h"
+
+#include "harness.h"
+#include "tank.h"
+
+const uint64_t HEALTH_SECOND_MICROSECONDS = 1000000;
+const uint64_t HEALTH_MINUTE_MICROSECONDS = 60000000;
+const unsigned int HEALTH_HISTORY_SIZE = 0x8000;
+
+const float HEALTH_LEVEL = 0.63;
+const unsigned int HEALTH_LEVEL_PERCENT = 63;
+
+// Notice: the loop must never block for long, even w/ the sensor unplugged
+const unsigned int HEALTH_PASS_MICROSECONDS_MAXIMUM = 1000; // 1 millisecond
+
+static SimulatedTank tank;
+
+static WaterTankLevelSensor *sensor;
+
+static unsigned int faultReadingsCount = 0;
+
+static void bootSensor(bool isPlugged) {
+  hostFlashCreate(HISTORY_PARTITION_LABEL, HEALTH_HISTORY_SIZE);
+
+  tank.~SimulatedTank();
+  new (&tank) SimulatedTank();
+
+  tank.begin(WATER_LEVEL_SENSOR_PIN_TRIGGER, WATER_LEVEL_SENSOR_PIN_ECHO);
+  tank.level = HEALTH_LEVEL;
+
+  // Notice: an unplugged sensor never answers (ECHO stays low)
+  tank.dropoutRatio = (isPlugged == true) ? 0.0 : 1.0;
+
+  SpanCharacteristic *inUse = new Characteristic::InUse();
+  SpanCharacteristic *statusFault = new Characteristic::StatusFault(0);
+
+  sensor = new WaterTankLevelSensor(statusFault, inUse);
+
+  faultReadingsCount = 0;
+}
+
+static void runSensorUntil(uint64_t untilMicros) {
+  // Run the device task, then hand readings over to HK every second (as \
+  //   the HomeSpan task would, while counting fault readings)
+  while (hostMicros < untilMicros) {
+    hostIdleLimitMicros = min(hostMicros + HEALTH_SECOND_MICROSECONDS, untilMicros);
+
+    while (hostMicros < hostIdleLimitMicros) {
+      sensor->runDevice();
+    }
+
+    SensorReading reading;
+
+    while (sensor->readings.pop(reading) == true) {
+      if (reading.type == SENSOR_READING_TYPE_FAULT) {
+        faultReadingsCount++;
+      }
+
+      sensor->applyReading(reading);
+    }
+  }
+
+  hostIdleLimitMicros = HOST_TIME_NEVER;
+}
+
+TEST(testDoublesBackoffUpToMaximum) {
+  CircuitBreaker health;
+
+  health.begin(WATER_LEVEL_FAILURES_THRESHOLD, WATER_LEVEL_BACKOFF_MINIMUM_MILLISECONDS, WATER_LEVEL_BACKOFF_MAXIMUM_MILLISECONDS);
+
+  // Notice: the circuit only opens once enough failures happened in a row
+  for (unsigned int i = 1; i < WATER_LEVEL_FAILURES_THRESHOLD; i++) {
+    CHECK(health.recordFailure() == false);
+  }
+
+  CHECK(health.recordFailure() == true);
+  CHECK_EQUAL(CIRCUIT_STATE_OPEN, health.state);
+
+  // Each failed retry doubles the delay, until it reaches the maximum
+  unsigned long expectedMillis = WATER_LEVEL_BACKOFF_MINIMUM_MILLISECONDS;
+  unsigned int retriesCount = 0;
+
+  while (expectedMillis < WATER_LEVEL_BACKOFF_MAXIMUM_MILLISECONDS) {
+    CHECK_EQUAL(expectedMillis, health.retry());
+    CHECK(health.recordFailure() == true);
+
+    expectedMillis *= 2;
+    retriesCount++;
+  }
+
+  CHECK_EQUAL(WATER_LEVEL_BACKOFF_MAXIMUM_MILLISECONDS, health.retry());
+  CHECK(health.recordFailure() == true);
+  CHECK_EQUAL(WATER_LEVEL_BACKOFF_MAXIMUM_MILLISECONDS, health.retry());
+
+  printf("     backoff: %lus doubled %u times, then capped at %lus\n", WATER_LEVEL_BACKOFF_MINIMUM_MILLISECONDS / 1000, retriesCount, WATER_LEVEL_BACKOFF_MAXIMUM_MILLISECONDS / 1000);
+
+  CHECK_EQUAL(retriesCount + 2, health.opensCount);
+
+  // A success resets the delay (a later fault starts over)
+  CHECK(health.recordSuccess() == true);
+  CHECK_EQUAL(WATER_LEVEL_BACKOFF_MINIMUM_MILLISECONDS, health.backoffMillis);
+}
+
+TEST(testReopensOnFailedRetry) {
+  CircuitBreaker health;
+
+  health.begin(WATER_LEVEL_FAILURES_THRESHOLD, WATER_LEVEL_BACKOFF_MINIMUM_MILLISECONDS, WATER_LEVEL_BACKOFF_MAXIMUM_MILLISECONDS);
+
+  for (unsigned int i = 0; i < WATER_LEVEL_FAILURES_THRESHOLD; i++) {
+    health.recordFailure();
+  }
+
+  health.retry();
+
+  CHECK_EQUAL(CIRCUIT_STATE_HALF_OPEN, health.state);
+
+  // Notice: a single failure re-opens a half-open circuit (no threshold)
+  CHECK(health.recordFailure() == true);
+  CHECK_EQUAL(CIRCUIT_STATE_OPEN, health.state);
+  CHECK_EQUAL(2, health.opensCount);
+  CHECK_EQUAL(WATER_LEVEL_BACKOFF_MINIMUM_MILLISECONDS * 2, health.backoffMillis);
+
+  // A successful retry closes it, further successes do not change it
+  health.retry();
+
+  CHECK(health.recordSuccess() == true);
+  CHECK_EQUAL(CIRCUIT_STATE_CLOSED, health.state);
+  CHECK(health.recordSuccess() == false);
+
+  // A closed circuit needs enough failures in a row again
+  CHECK(health.recordFailure() == false);
+  CHECK_EQUAL(CIRCUIT_STATE_CLOSED, health.state);
+}
+
+TEST(testRaisesThenClearsStatusFault) {
+  bootSensor(false);
+
+  // Unplugged sensor (the level is not published, the fault is raised)
+  runSensorUntil(HEALTH_MINUTE_MICROSECONDS);
+
+  CHECK_EQUAL(1, sensor->statusFault->getVal());
+  CHECK_EQUAL(100, sensor->waterLevel->getVal());
+  CHECK_EQUAL(0, sensor->probesCount);
+  CHECK(sensor->health.opensCount >= 2);
+
+  // Sensor plugged back (cleared on the next retry)
+  tank.dropoutRatio = 0.0;
+
+  runSensorUntil(hostMicros + sensor->health.backoffMillis * 1000 + HEALTH_SECOND_MICROSECONDS);
+
+  CHECK_EQUAL(0, sensor->statusFault->getVal());
+  CHECK_EQUAL(HEALTH_LEVEL_PERCENT, sensor->waterLevel->getVal());
+  CHECK_EQUAL(CIRCUIT_STATE_CLOSED, sensor->health.state);
+
+  // Notice: 1 fault reading per opening, and 1 once cleared
+  CHECK_EQUAL(sensor->health.opensCount + 1, faultReadingsCount);
+}
+
+TEST(testReportsFaultOnlyOnChanges) {
+  bootSensor(true);
+
+  // Healthy sensor (probes never hand a fault reading over)
+  runSensorUntil(6 * 60 * HEALTH_MINUTE_MICROSECONDS);
+
+  CHECK(sensor->probesCount > 5);
+  CHECK_EQUAL(0, faultReadingsCount);
+  CHECK_EQUAL(0, sensor->statusFault->getVal());
+
+  // Lost echoes (only the rare failures in a row open the circuit, each \
+  //   opening is reported once, as is the recovery)
+  unsigned long probesCount = sensor->probesCount;
+
+  tank.dropoutRatio = 0.2;
+
+  runSensorUntil(hostMicros + 24 * 60 * HEALTH_MINUTE_MICROSECONDS);
+
+  CHECK(sensor->health.failuresCount > sensor->health.opensCount * WATER_LEVEL_FAILURES_THRESHOLD);
+  CHECK(faultReadingsCount <= 2 * sensor->health.opensCount);
+  CHECK(faultReadingsCount < sensor->probesCount - probesCount);
+}
+
+TEST(testBoundsLoopBlockingWhenUnplugged) {
+  bootSensor(false);
+
+  // Unplugged for 3 hours (the backoff reaches its maximum)
+  runSensorUntil(3 * 60 * HEALTH_MINUTE_MICROSECONDS);
+
+  SchedulerHistogram &histogram = sensor->devicePassHistogram;
+
+  printf("     unplugged for 3h: %u passes, pass time mean %uµs, max %uµs (host clock), %u faults, %u triggers, backoff %lus\n", histogram.samplesCount, histogram.mean(), histogram.maximum, sensor->health.opensCount, tank.triggersCount, sensor->health.backoffMillis / 1000);
+
+  CHECK(histogram.maximum < HEALTH_PASS_MICROSECONDS_MAXIMUM);
+  CHECK_EQUAL(WATER_LEVEL_BACKOFF_MAXIMUM_MILLISECONDS, sensor->health.backoffMillis);
+  CHECK_EQUAL(1, sensor->statusFault->getVal());
+
+  // Notice: retries are backed off, and each retry triggers the sensor once
+  CHECK_EQUAL(WATER_LEVEL_FAILURES_THRESHOLD + sensor->health.opensCount - 1, tank.triggersCount);
+}
+
+int main() {
+  RUN(testDoublesBackoffUpToMaximum);
+  RUN(testReopensOnFailedRetry);
+  RUN(testRaisesThenClearsStatusFault);
+  RUN(testReportsFaultOnlyOnChanges);
+  RUN(testBoundsLoopBlockingWhenUnplugged);
+
+  return harnessReport("health");
+}
@@ -0,0 +1,248 @@
+// Host Tests
+//
+// Host-side tests for both projects (Linux, w/o an ESP32 board)
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#include <chrono>
+
+#include "sensors.h"
+
+#include "harness.h"
+
+const unsigned int HISTORY_TEST_PARTITION_SIZE = 0x8000; // As in partitions.csv
+const uint64_t HISTORY_TEST_POLL_MICROSECONDS = 600000000; // 10 minutes (reference schedule)
+const unsigned int HISTORY_TEST_BENCHMARK_SAMPLES = 1000000;
+
+// Notice: a level that drains by 1% every 3 polls, then gets refilled
+static uint8_t levelAt(unsigned int poll) {
+  return 100 - (poll / 3) % 80;
+}
+
+static History history;
+
+static void powerOn() {
+  hostFlashCreate(HISTORY_PARTITION_LABEL, HISTORY_TEST_PARTITION_SIZE);
+
+  hostRenew(history);
+
+  CHECK(history.begin() == true);
+}
+
+static void reboot() {
+  // Notice: the high-resolution timer restarts from zero on boot
+  std::vector<uint8_t> image = hostFlashImage(HISTORY_PARTITION_LABEL);
+
+  hostReset();
+  hostFlashCreate(HISTORY_PARTITION_LABEL, HISTORY_TEST_PARTITION_SIZE);
+  hostFlashImage(HISTORY_PARTITION_LABEL) = image;
+
+  hostRenew(history);
+
+  CHECK(history.begin() == true);
+}
+
+static std::vector<HistorySample> readAllSamples() {
+  // Walk blocks from the oldest one (as print() does)
+  std::vector<HistorySample> samples;
+
+  HistoryBlock block;
+  HistorySample blockSamples[HISTORY_BLOCK_SAMPLES_MAXIMUM];
+
+  for (unsigned int i = 0; i < (history.partition->size / HISTORY_BLOCK_SIZE); i++) {
+    unsigned int offset = (history.nextOffset + i * HISTORY_BLOCK_SIZE) % history.partition->size;
+
+    if (history.readBlock(offset, block) == true) {
+      unsigned int count = history.decode(block, blockSamples);
+
+      samples.insert(samples.end(), blockSamples, blockSamples + count);
+    }
+  }
+
+  return samples;
+}
+
+TEST(testEncodesVarintEdges) {
+  // Values at each size boundary (7 bits per byte)
+  const uint32_t values[] = {0, 1, 0x7F, 0x80, 0x3FFF, 0x4000, 0x1FFFFF, 0x200000, 0xFFFFFFF, 0x10000000, 0xFFFFFFFF};
+  const unsigned int sizes[] = {1, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5};
+
+  for (unsigned int i = 0; i < (sizeof(values) / sizeof(uint32_t)); i++) {
+    uint8_t buffer[HISTORY_BLOCK_PAYLOAD_SIZE];
+
+    memset(buffer, 0xFF, sizeof(buffer));
+
+    unsigned int size = history.encodeVarint(buffer, values[i]),
+                 position = 0;
+
+    CHECK_EQUAL(sizes[i], size);
+    CHECK(size <= HISTORY_VARINT_SIZE_MAXIMUM);
+    CHECK_EQUAL(values[i], history.decodeVarint(buffer, position));
+    CHECK_EQUAL(size, position);
+  }
+}
+
+TEST(testEncodesLevelDeltas) {
+  HistoryBlock block;
+  HistorySample samples[2],
+                decoded[HISTORY_BLOCK_SAMPLES_MAXIMUM];
+
+  // Every level delta a percentage can take, w/ a 10 minutes delta
+  for (int delta = -100; delta <= 100; delta++) {
+    samples[0].minute = 1000;
+    samples[0].level = (delta < 0) ? 100 : 0;
+    samples[1].minute = 1010;
+    samples[1].level = samples[0].level + delta;
+
+    CHECK_EQUAL(2, history.encode(block, samples, 2));
+    CHECK_EQUAL(2, history.decode(block, decoded));
+
+    CHECK_EQUAL(samples[1].minute, decoded[1].minute);
+    CHECK_EQUAL(samples[1].level, decoded[1].level);
+
+    // Notice: zig-zag fits deltas within ±63 in a single byte
+    unsigned int expectedSize = 1 + ((delta >= -64 && delta <= 63) ? 1 : 2);
+
+    CHECK_EQUAL(expectedSize, block.header.size);
+  }
+}
+
+TEST(testSpillsOncePerBatch) {
+  powerOn();
+
+  const unsigned int pollsCount = 10 * HISTORY_BATCH_CAPACITY + 5;
+
+  for (unsigned int poll = 0; poll < pollsCount; poll++) {
+    hostAdvanceMicros(HISTORY_TEST_POLL_MICROSECONDS);
+
+    history.record(levelAt(poll));
+  }
+
+  float writesPerPoll = (float)hostFlashWritesCount / pollsCount,
+        bytesPerSample = (float)history.spilledBytesCount / history.spilledSamplesCount;
+
+  printf("     %u polls: %u flash writes (%.3f per poll), %.2f bytes per sample (%u bytes in RAM)\n", pollsCount, hostFlashWritesCount, writesPerPoll, bytesPerSample, (unsigned int)sizeof(HistorySample));
+
+  // Notice: a batch of levels that move by a few % every 10 minutes fits \
+  //   in a single block
+  CHECK_EQUAL(10, hostFlashWritesCount);
+  CHECK_EQUAL(10, history.spillsCount);
+  CHECK_EQUAL(10 * HISTORY_BATCH_CAPACITY, history.spilledSamplesCount);
+  CHECK_EQUAL(5, history.batchSize);
+  CHECK(bytesPerSample < 3.0);
+}
+
+TEST(testRecoversSpilledSamplesAfterReboot) {
+  powerOn();
+
+  std::vector<HistorySample> recorded;
+
+  const unsigned int pollsCount = 4 * HISTORY_BATCH_CAPACITY + 7;
+
+  for (unsigned int poll = 0; poll < pollsCount; poll++) {
+    hostAdvanceMicros(HISTORY_TEST_POLL_MICROSECONDS);
+
+    HistorySample sample;
+
+    sample.minute = history.currentMinute();
+    sample.level = levelAt(poll);
+
+    history.record(sample.level);
+
+    recorded.push_back(sample);
+  }
+
+  uint32_t lastSpilledMinute = recorded[4 * HISTORY_BATCH_CAPACITY - 1].minute;
+
+  reboot();
+
+  // Notice: samples still in the RAM batch are lost w/ power
+  std::vector<HistorySample> recovered = readAllSamples();
+
+  CHECK_EQUAL(4 * HISTORY_BATCH_CAPACITY, recovered.size());
+
+  unsigned int mismatchesCount = 0;
+
+  for (unsigned int i = 0; i < recovered.size(); i++) {
+    if (recovered[i].minute != recorded[i].minute || recovered[i].level != recorded[i].level) {
+      mismatchesCount++;
+    }
+  }
+
+  CHECK_EQUAL(0, mismatchesCount);
+
+  // Device time resumes right after the latest spilled sample
+  CHECK_EQUAL(lastSpilledMinute + 1, history.currentMinute());
+  CHECK_EQUAL(4, history.nextSequence);
+
+  // Samples recorded after the reboot follow those recovered
+  hostAdvanceMicros(HISTORY_TEST_POLL_MICROSECONDS);
+
+  for (unsigned int i = 0; i < HISTORY_BATCH_CAPACITY; i++) {
+    history.record(50);
+  }
+
+  recovered = readAllSamples();
+
+  CHECK_EQUAL(5 * HISTORY_BATCH_CAPACITY, recovered.size());
+  CHECK(recovered[4 * HISTORY_BATCH_CAPACITY].minute > lastSpilledMinute);
+}
+
+TEST(testWrapsAroundSectors) {
+  powerOn();
+
+  // Fill the partition 3 times over (in blocks), then reboot
+  const unsigned int blocksCount = 3 * (HISTORY_TEST_PARTITION_SIZE / HISTORY_BLOCK_SIZE);
+
+  for (unsigned int poll = 0; poll < blocksCount * HISTORY_BATCH_CAPACITY; poll++) {
+    hostAdvanceMicros(HISTORY_TEST_POLL_MICROSECONDS);
+
+    history.record(levelAt(poll));
+  }
+
+  unsigned int erasesCount = history.erasesCount;
+  uint32_t lastMinute = history.currentMinute();
+
+  reboot();
+
+  std::vector<HistorySample> recovered = readAllSamples();
+
+  printf("     %u blocks over a %uKB partition: %u sector erases, %u samples kept (%.1f days at 10 minutes)\n", blocksCount, HISTORY_TEST_PARTITION_SIZE / 1024, erasesCount, (unsigned int)recovered.size(), recovered.size() / 144.0);
+
+  // Notice: sectors only get erased once written to again (ie. 2 passes \
+  //   out of 3), dropping the oldest blocks a sector at a time
+  CHECK_EQUAL(2 * (HISTORY_TEST_PARTITION_SIZE / HISTORY_SECTOR_SIZE), erasesCount);
+  CHECK_EQUAL(blocksCount, history.nextSequence);
+  CHECK(recovered.size() >= (HISTORY_TEST_PARTITION_SIZE - HISTORY_SECTOR_SIZE) / HISTORY_BLOCK_SIZE * HISTORY_BATCH_CAPACITY);
+  CHECK(std::is_sorted(recovered.begin(), recovered.end(), [](const HistorySample &a, const HistorySample &b) { return a.minute < b.minute; }) == true);
+  CHECK_EQUAL(lastMinute + 1, history.currentMinute());
+}
+
+TEST(testBenchmarksAppends) {
+  powerOn();
+
+  // Notice: time only advances on flash writes and erases (virtual), while \
+  //   encoding is measured on the host
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  for (unsigned int poll = 0; poll < HISTORY_TEST_BENCHMARK_SAMPLES; poll++) {
+    history.record(levelAt(poll));
+  }
+
+  double appendNanos = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / HISTORY_TEST_BENCHMARK_SAMPLES;
+
+  printf("     append: %.2fns per sample (host, %u samples), flash busy %.1fµs per sample (%u writes, %u erases)\n", appendNanos, HISTORY_TEST_BENCHMARK_SAMPLES, (double)hostMicros / HISTORY_TEST_BENCHMARK_SAMPLES, hostFlashWritesCount, hostFlashErasesCount);
+
+  CHECK_EQUAL(HISTORY_TEST_BENCHMARK_SAMPLES, history.spilledSamplesCount + history.batchSize);
+}
+
+int main() {
+  RUN(testEncodesVarintEdges);
+  RUN(testEncodesLevelDeltas);
+  RUN(testSpillsOncePerBatch);
+  RUN(testRecoversSpilledSamplesAfterReboot);
+  RUN(testWrapsAroundSectors);
+  RUN(testBenchmarksAppends);
+
+  return harnessReport("history");
+}
@@ -0,0 +1,200 @@
+// Host Tests
+//
+// Host-side tests for both projects (Linux, w/o an ESP32 board)
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#include "services.h"
+
+#include "harness.h"
+
+static Journal journal;
+
+static const uint8_t VALUES_FIRST[JOURNAL_RECORD_VALUES] = {1, 2, 20, 18, 0},
+                     VALUES_SECOND[JOURNAL_RECORD_VALUES] = {1, 1, 20, 24, 0};
+
+static void beginJournal() {
+  hostRenew(journal);
+
+  CHECK(journal.begin(0) == true);
+}
+
+static void rebootJournal() {
+  // Notice: the flash image survives, the journal state does not
+  hostPowerCutMicros = HOST_TIME_NEVER;
+
+  beginJournal();
+}
+
+static bool valuesEqual(const uint8_t left[], const uint8_t right[]) {
+  return memcmp(left, right, JOURNAL_RECORD_VALUES) == 0;
+}
+
+TEST(testRecoversNothingFromEmptyJournal) {
+  hostFlashCreate(JOURNAL_PARTITION_LABEL, JOURNAL_REGION_SIZE);
+
+  beginJournal();
+
+  uint8_t values[JOURNAL_RECORD_VALUES] = {};
+
+  CHECK_EQUAL(JOURNAL_RECOVERY_EMPTY, journal.recover(values));
+  CHECK_EQUAL(0, journal.pendingIntentsCount);
+}
+
+TEST(testRecoversLatestDurableRecord) {
+  hostFlashCreate(JOURNAL_PARTITION_LABEL, JOURNAL_REGION_SIZE);
+
+  beginJournal();
+
+  journal.append(JOURNAL_RECORD_TYPE_SNAPSHOT, 0, VALUES_FIRST);
+  journal.append(JOURNAL_RECORD_TYPE_INTENT, 0x66, VALUES_SECOND);
+  journal.append(JOURNAL_RECORD_TYPE_COMPLETION, 0x66, VALUES_SECOND);
+
+  rebootJournal();
+
+  uint8_t values[JOURNAL_RECORD_VALUES] = {};
+
+  CHECK_EQUAL(JOURNAL_RECOVERY_DURABLE, journal.recover(values));
+  CHECK(valuesEqual(values, VALUES_SECOND) == true);
+  CHECK_EQUAL(0, journal.pendingIntentsCount);
+  CHECK_EQUAL(3, journal.nextSequence);
+}
+
+TEST(testRecoversDurableRecordBeforePendingIntent) {
+  hostFlashCreate(JOURNAL_PARTITION_LABEL, JOURNAL_REGION_SIZE);
+
+  beginJournal();
+
+  journal.append(JOURNAL_RECORD_TYPE_SNAPSHOT, 0, VALUES_FIRST);
+  journal.append(JOURNAL_RECORD_TYPE_INTENT, 0x66, VALUES_SECOND);
+
+  rebootJournal();
+
+  uint8_t values[JOURNAL_RECORD_VALUES] = {};
+
+  CHECK_EQUAL(JOURNAL_RECOVERY_INTENT, journal.recover(values));
+  CHECK(valuesEqual(values, VALUES_FIRST) == true);
+  CHECK_EQUAL(1, journal.pendingIntentsCount);
+  CHECK_EQUAL(0x66, journal.pendingIntentCommand);
+}
+
+TEST(testClosesPendingIntentWithDurableRecord) {
+  hostFlashCreate(JOURNAL_PARTITION_LABEL, JOURNAL_REGION_SIZE);
+
+  beginJournal();
+
+  journal.append(JOURNAL_RECORD_TYPE_SNAPSHOT, 0, VALUES_FIRST);
+  journal.append(JOURNAL_RECORD_TYPE_INTENT, 0x66, VALUES_SECOND);
+
+  rebootJournal();
+
+  uint8_t values[JOURNAL_RECORD_VALUES] = {};
+
+  journal.recover(values);
+  journal.append(JOURNAL_RECORD_TYPE_SNAPSHOT, 0, values);
+
+  // Notice: an older intent is never mistaken for a pending one
+  rebootJournal();
+
+  CHECK_EQUAL(JOURNAL_RECOVERY_DURABLE, journal.recover(values));
+  CHECK(valuesEqual(values, VALUES_FIRST) == true);
+  CHECK_EQUAL(0, journal.pendingIntentsCount);
+}
+
+TEST(testRecoversNothingFromIntentsOnly) {
+  hostFlashCreate(JOURNAL_PARTITION_LABEL, JOURNAL_REGION_SIZE);
+
+  beginJournal();
+
+  journal.append(JOURNAL_RECORD_TYPE_INTENT, 0x6B, VALUES_FIRST);
+
+  rebootJournal();
+
+  uint8_t values[JOURNAL_RECORD_VALUES] = {};
+
+  CHECK_EQUAL(JOURNAL_RECOVERY_INTENTS_ONLY, journal.recover(values));
+  CHECK_EQUAL(1, journal.pendingIntentsCount);
+  CHECK_EQUAL(0x6B, journal.pendingIntentCommand);
+}
+
+TEST(testIgnoresTornRecords) {
+  hostFlashCreate(JOURNAL_PARTITION_LABEL, JOURNAL_REGION_SIZE);
+
+  beginJournal();
+
+  journal.append(JOURNAL_RECORD_TYPE_SNAPSHOT, 0, VALUES_FIRST);
+  journal.append(JOURNAL_RECORD_TYPE_INTENT, 0x66, VALUES_SECOND);
+
+  // Cut power halfway through writing the completion
+  hostPowerCutMicros = hostMicros + HOST_FLASH_WRITE_MICROSECONDS / 2;
+
+  CHECK(journal.append(JOURNAL_RECORD_TYPE_COMPLETION, 0x66, VALUES_SECOND) == false);
+
+  rebootJournal();
+
+  uint8_t values[JOURNAL_RECORD_VALUES] = {};
+
+  // Notice: decided as if the completion was never written
+  CHECK_EQUAL(JOURNAL_RECOVERY_INTENT, journal.recover(values));
+  CHECK(valuesEqual(values, VALUES_FIRST) == true);
+
+  // Next record skips the torn slot
+  journal.append(JOURNAL_RECORD_TYPE_SNAPSHOT, 0, values);
+
+  rebootJournal();
+
+  CHECK_EQUAL(JOURNAL_RECOVERY_DURABLE, journal.recover(values));
+  CHECK(valuesEqual(values, VALUES_FIRST) == true);
+}
+
+TEST(testPreparesSectorsAheadOfAppends) {
+  hostFlashCreate(JOURNAL_PARTITION_LABEL, JOURNAL_REGION_SIZE);
+
+  beginJournal();
+
+  // Fill the whole region, so that the next record wraps to a used sector
+  for (unsigned int i = 0; i < JOURNAL_REGION_SIZE / sizeof(JournalRecord); i++) {
+    journal.append(JOURNAL_RECORD_TYPE_SNAPSHOT, 0, VALUES_FIRST);
+  }
+
+  CHECK_EQUAL(0, journal.nextOffset);
+  CHECK_EQUAL(0, journal.erasesCount);
+
+  // Notice: the intent and its completion never wait on an erase, once \
+  //   prepared for (which is when the erase happens)
+  journal.prepare(2);
+
+  CHECK_EQUAL(1, journal.erasesCount);
+
+  uint64_t startMicros = hostMicros;
+
+  journal.append(JOURNAL_RECORD_TYPE_INTENT, 0x66, VALUES_SECOND);
+  journal.append(JOURNAL_RECORD_TYPE_COMPLETION, 0x66, VALUES_SECOND);
+
+  CHECK_EQUAL(1, journal.erasesCount);
+  CHECK_EQUAL(2 * HOST_FLASH_WRITE_MICROSECONDS, hostMicros - startMicros);
+
+  // Preparing again is a no-op (sector is in use)
+  journal.prepare(2);
+
+  CHECK_EQUAL(1, journal.erasesCount);
+
+  rebootJournal();
+
+  uint8_t values[JOURNAL_RECORD_VALUES] = {};
+
+  CHECK_EQUAL(JOURNAL_RECOVERY_DURABLE, journal.recover(values));
+  CHECK(valuesEqual(values, VALUES_SECOND) == true);
+}
+
+int main() {
+  RUN(testRecoversNothingFromEmptyJournal);
+  RUN(testRecoversLatestDurableRecord);
+  RUN(testRecoversDurableRecordBeforePendingIntent);
+  RUN(testClosesPendingIntentWithDurableRecord);
+  RUN(testRecoversNothingFromIntentsOnly);
+  RUN(testIgnoresTornRecords);
+  RUN(testPreparesSectorsAheadOfAppends);
+
+  return harnessReport("journal");
+}
@@ -0,0 +1,156 @@
+// Host Tests
+//
+// Host-side tests for both projects (Linux, w/o an ESP32 board)
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#include <chrono>
+
+#include "services.h"
+
+#include "boot.h"
+#include "harness.h"
+#include "simulator.h"
+
+/**
+  [Core Layout]
+
+    - Before HomeSpan and device I/O were split across cores, homeSpan.poll()
+      ran in between device task passes on the same loop: the poll cadence
+      was then the device pass time, and a HAP request that came in while a
+      pass ran waited for the whole pass (worst case: the longest pass)
+
+    - After the split, the HomeSpan task only runs the service loop() and
+      update(), which never wait on device I/O (they only touch queues)
+
+    - Both are measured over a minute of virtual time, w/ HomeKit updates
+      that emit full IR plans, temperature polls and journal commits (on a
+      journal that already wrapped, thus sectors get erased). Virtual time
+      only advances on blocking device I/O (flash, RMT, DHT, idles), thus
+      CPU time of the HomeSpan side is measured on the host
+**/
+
+const uint64_t LAYOUT_RUN_MICROSECONDS = 60000000; // 1 minute
+const uint64_t LAYOUT_UPDATE_EVERY_MICROSECONDS = 10000000; // 10 seconds
+const unsigned int LAYOUT_LOOP_PASSES = 100000;
+
+// Notice: HomeKit marks an accessory as 'not responding' past a few seconds, \
+//   while anything past 100ms already shows in the Home app
+const uint64_t LAYOUT_HAP_RESPONSE_MAXIMUM_MICROSECONDS = 100000;
+
+// Cool at 18°C, then heat at 27°C (w/ swing), then power off, in turns
+const uint8_t LAYOUT_VALUES[][STORAGE_SIZE] = {
+  {1, 2, 18, 18, 0},
+  {1, 1, 18, 27, 1},
+  {0, 1, 18, 27, 1}
+};
+
+static SimulatedAirConditioner simulator;
+
+TEST(testHomeSpanNeverWaitsOnDeviceTask) {
+  hostFlashCreate(JOURNAL_PARTITION_LABEL, JOURNAL_REGION_SIZE);
+
+  // Fill the whole region (as after weeks of use)
+  Journal seed;
+
+  seed.begin(0);
+
+  for (unsigned int i = 0; i < JOURNAL_REGION_SIZE / sizeof(JournalRecord); i++) {
+    seed.append(JOURNAL_RECORD_TYPE_SNAPSHOT, 0, LAYOUT_VALUES[2]);
+  }
+
+  simulator.begin(IR_PIN_PWM);
+
+  memcpy(simulator.values, LAYOUT_VALUES[2], STORAGE_SIZE);
+
+  bootSketch();
+
+  unsigned int updatesCount = 0;
+
+  uint64_t updateBlockedMicros = 0;
+
+  for (uint64_t updateMicros = LAYOUT_UPDATE_EVERY_MICROSECONDS; updateMicros < LAYOUT_RUN_MICROSECONDS; updateMicros += LAYOUT_UPDATE_EVERY_MICROSECONDS) {
+    bootRunUntil(updateMicros);
+
+    // Notice: the HAP side of an update (update() + a service loop pass) \
+    //   must not advance the virtual clock, ie. not block on device I/O
+    uint64_t startMicros = hostMicros;
+
+    CHECK(bootUpdate(LAYOUT_VALUES[updatesCount % 3]) == true);
+
+    bootUnit->loop();
+
+    updateBlockedMicros = max(updateBlockedMicros, hostMicros - startMicros);
+
+    updatesCount++;
+  }
+
+  bootRunUntil(LAYOUT_RUN_MICROSECONDS);
+
+  simulator.receive();
+
+  SchedulerHistogram &passes = bridge.devicePassHistogram;
+
+  printf("     before (shared core): poll cadence mean %uµs, p50 %uµs, p99 %uµs, max %uµs (%u passes)\n", passes.mean(), passes.percentile(50), passes.percentile(99), passes.maximum, passes.samplesCount);
+  printf("     before (shared core): worst-case HAP response >= %uµs (longest device pass)\n", passes.maximum);
+  printf("     after (split cores): HAP side blocked %lluµs on device I/O (%u updates, %u IR frames applied)\n", (unsigned long long)updateBlockedMicros, updatesCount, simulator.framesApplied);
+
+  CHECK(passes.samplesCount > 0);
+  CHECK_EQUAL(0, updateBlockedMicros);
+  CHECK(passes.maximum < LAYOUT_HAP_RESPONSE_MAXIMUM_MICROSECONDS);
+  CHECK_EQUAL(0, simulator.framesRejected);
+  CHECK_EQUAL(0, bootUnit->commands.dropsCount);
+}
+
+TEST(testBenchmarksHomeSpanSide) {
+  hostFlashCreate(JOURNAL_PARTITION_LABEL, JOURNAL_REGION_SIZE);
+
+  bootSketch();
+
+  // Measure update() + a service loop pass (the HomeSpan side of a HAP \
+  //   write), draining commands in between as the device task would
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  double updateNanos = 0;
+
+  for (unsigned int i = 0; i < LAYOUT_LOOP_PASSES; i++) {
+    std::chrono::steady_clock::time_point updateStart = std::chrono::steady_clock::now();
+
+    bootUpdate(LAYOUT_VALUES[i % 3]);
+
+    bootUnit->loop();
+
+    updateNanos += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - updateStart).count();
+
+    ServiceCommand command;
+
+    while (bootUnit->commands.pop(command) == true);
+  }
+
+  double totalNanos = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+  printf("     after (split cores): update() + loop() %.0fns per HAP write (host, %u writes, %.0fms total)\n", updateNanos / LAYOUT_LOOP_PASSES, LAYOUT_LOOP_PASSES, totalNanos / 1000000);
+
+  CHECK_EQUAL(LAYOUT_LOOP_PASSES, bootUnit->updateHistogram.samplesCount);
+  CHECK_EQUAL(0, bootUnit->commands.dropsCount);
+}
+
+TEST(testPrintsLayoutStatistics) {
+  hostFlashCreate(JOURNAL_PARTITION_LABEL, JOURNAL_REGION_SIZE);
+
+  bootSketch();
+  bootRunUntil(1000000);
+
+  CHECK(hostRunCommand("s") == true);
+
+  CHECK(hostSerialOutput.find("  - Pass Time = mean") != std::string::npos);
+  CHECK(hostSerialOutput.find("  - Update Time = mean") != std::string::npos);
+}
+
+int main() {
+  RUN(testHomeSpanNeverWaitsOnDeviceTask);
+  RUN(testBenchmarksHomeSpanSide);
+  RUN(testPrintsLayoutStatistics);
+
+  return harnessReport("layout");
+}
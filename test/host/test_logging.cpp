@@ -0,0 +1,106 @@
+// Host Tests
+//
+// Host-side tests for both projects (Linux, w/o an ESP32 board)
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#include <chrono>
+
+#include "services.h"
+
+#include "harness.h"
+
+// Subsystems as built w/ the default and production profiles
+#define LOG_LEVEL_BENCH_DEFAULT 2
+#define LOG_LEVEL_BENCH_PRODUCTION 0
+
+const unsigned int LOGGING_BENCHMARK_STATEMENTS = 10000000;
+
+static unsigned int argumentsCount = 0;
+
+static int countArgument(int value) {
+  argumentsCount++;
+
+  return value;
+}
+
+// Notice: stands for the code around a log statement, which forces the \
+//   run-time log level and arguments to be read again on each statement
+static inline void barrier() {
+  asm volatile("" ::: "memory");
+}
+
+TEST(testCompilesOutDisabledStatements) {
+  argumentsCount = 0;
+
+  homeSpan.setLogLevel(2);
+
+  LOG_AT(BENCH_PRODUCTION, 2, "[Bench] (sm) Tick done (%d)\n", countArgument(1));
+  LOG_AT(BENCH_PRODUCTION, 1, "[Bench] (sm) Planned (%d)\n", countArgument(2));
+
+  // Notice: arguments of compiled out statements never get evaluated
+  CHECK_EQUAL(0, argumentsCount);
+  CHECK(hostSerialOutput.empty() == true);
+
+  LOG_AT(BENCH_PRODUCTION, 0, "[Bench] (sm) Error (%d)\n", countArgument(3));
+
+  CHECK_EQUAL(1, argumentsCount);
+  CHECK(hostSerialOutput == "[Bench] (sm) Error (3)\n");
+}
+
+TEST(testFiltersEnabledStatementsAtRunTime) {
+  argumentsCount = 0;
+
+  homeSpan.setLogLevel(1);
+
+  LOG_AT(BENCH_DEFAULT, 2, "[Bench] (sm) Tick done (%d)\n", countArgument(1));
+  LOG_AT(BENCH_DEFAULT, 1, "[Bench] (sm) Planned (%d)\n", countArgument(2));
+
+  CHECK(hostSerialOutput == "[Bench] (sm) Planned (2)\n");
+
+  // Notice: statements compiled in but filtered at run time skip their \
+  //   arguments (HomeSpan checks the level first)
+  CHECK_EQUAL(1, argumentsCount);
+  CHECK(LOG_ENABLED(SM, 2) == (LOG_LEVEL_DEFAULT >= 2));
+}
+
+TEST(testBenchmarksDisabledStatements) {
+  homeSpan.setLogLevel(0);
+
+  Characteristic::Active active(1);
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  // Former path: compiled in, skipped at run time (log level 0)
+  for (unsigned int i = 0; i < LOGGING_BENCHMARK_STATEMENTS; i++) {
+    LOG_AT(BENCH_DEFAULT, 2, "[Bench] (sm) Tick done, active %d (%s)\n", active.getVal(), (i % 2 == 0) ? "converged" : "converging");
+
+    barrier();
+  }
+
+  std::chrono::steady_clock::time_point skipped = std::chrono::steady_clock::now();
+
+  // Production path: compiled out
+  for (unsigned int i = 0; i < LOGGING_BENCHMARK_STATEMENTS; i++) {
+    LOG_AT(BENCH_PRODUCTION, 2, "[Bench] (sm) Tick done, active %d (%s)\n", active.getVal(), (i % 2 == 0) ? "converged" : "converging");
+
+    barrier();
+  }
+
+  std::chrono::steady_clock::time_point compiledOut = std::chrono::steady_clock::now();
+
+  double skippedNanos = std::chrono::duration<double, std::nano>(skipped - start).count() / LOGGING_BENCHMARK_STATEMENTS,
+         compiledOutNanos = std::chrono::duration<double, std::nano>(compiledOut - skipped).count() / LOGGING_BENCHMARK_STATEMENTS;
+
+  printf("     disabled statement: %.2fns skipped at run time, %.2fns compiled out (host, %u statements)\n", skippedNanos, compiledOutNanos, LOGGING_BENCHMARK_STATEMENTS);
+
+  CHECK(hostSerialOutput.empty() == true);
+}
+
+int main() {
+  RUN(testCompilesOutDisabledStatements);
+  RUN(testFiltersEnabledStatementsAtRunTime);
+  RUN(testBenchmarksDisabledStatements);
+
+  return harnessReport("logging");
+}
@@ -0,0 +1,223 @@
+// Host Tests
+//
+// Host-side tests for both projects (Linux, w/o an ESP32 board)
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+#include "sensors.h"
+
+#include "harness.h"
+
+typedef SortingNetworks<unsigned int, WATER_LEVEL_PROBE_SAMPLES> NETWORKS;
+
+const unsigned int NETWORK_RANDOM_ROUNDS = 20000;
+const unsigned int NETWORK_BENCHMARK_ROUNDS = 1000000;
+
+static std::mt19937 random32(42);
+
+static void referenceQuickSort(float values[], int left, int right) {
+  // Recursive quicksort (as the former floatQuickSort())
+  float tmp;
+  float pivot = values[(left + right) / 2];
+  int i = left, j = right;
+
+  while (i <= j) {
+    while (values[i] < pivot) {
+      i++;
+    }
+
+    while (values[j] > pivot) {
+      j--;
+    }
+
+    if (i <= j) {
+      tmp = values[i];
+      values[i] = values[j];
+      values[j] = tmp;
+
+      i++;
+      j--;
+    }
+  }
+
+  if (left < j) {
+    referenceQuickSort(values, left, j);
+  }
+
+  if (i < right) {
+    referenceQuickSort(values, i, right);
+  }
+}
+
+static unsigned int referenceMedian(std::vector<unsigned int> values) {
+  // Select middle value(s) w/ the standard library (mean of both if even)
+  size_t middle = values.size() / 2;
+
+  std::nth_element(values.begin(), values.begin() + middle, values.end());
+
+  unsigned int upper = values[middle];
+
+  if (values.size() % 2 == 1) {
+    return upper;
+  }
+
+  unsigned int lower = *std::max_element(values.begin(), values.begin() + middle);
+
+  return (lower + upper) / 2;
+}
+
+template <unsigned int N>
+static void checkSortsAllZeroOnePermutations() {
+  // Notice: a network that sorts all 2^N sequences of 0s and 1s sorts any \
+  //   sequence (zero-one principle, Knuth, TAOCP 5.3.4)
+  for (unsigned int bits = 0; bits < (1u << N); bits++) {
+    unsigned int values[N];
+
+    for (unsigned int i = 0; i < N; i++) {
+      values[i] = (bits >> i) & 1;
+    }
+
+    SortingNetwork<unsigned int, N>::sort(values);
+
+    CHECK(std::is_sorted(values, values + N) == true);
+  }
+}
+
+TEST(testSortsAnyCount) {
+  checkSortsAllZeroOnePermutations<2>();
+  checkSortsAllZeroOnePermutations<3>();
+  checkSortsAllZeroOnePermutations<4>();
+  checkSortsAllZeroOnePermutations<5>();
+  checkSortsAllZeroOnePermutations<6>();
+  checkSortsAllZeroOnePermutations<7>();
+  checkSortsAllZeroOnePermutations<8>();
+  checkSortsAllZeroOnePermutations<9>();
+  checkSortsAllZeroOnePermutations<10>();
+  checkSortsAllZeroOnePermutations<16>();
+}
+
+TEST(testMedianMatchesNthElement) {
+  unsigned int mismatchesCount = 0;
+
+  // Random permille samples (narrow ranges, as to get duplicates), for each \
+  //   count that a probe can end w/
+  for (unsigned int round = 0; round < NETWORK_RANDOM_ROUNDS; round++) {
+    unsigned int count = 1 + round % WATER_LEVEL_PROBE_SAMPLES,
+                 range = (round % 3 == 0) ? 4 : 1001;
+
+    unsigned int values[WATER_LEVEL_PROBE_SAMPLES];
+
+    for (unsigned int i = 0; i < count; i++) {
+      values[i] = random32() % range;
+    }
+
+    unsigned int expected = referenceMedian(std::vector<unsigned int>(values, values + count));
+
+    if (NETWORKS::median(values, count) != expected) {
+      mismatchesCount++;
+    }
+  }
+
+  CHECK_EQUAL(0, mismatchesCount);
+}
+
+TEST(testMedianOfEvenCountIsMiddleMean) {
+  // Notice: the former median took the lower middle value of 10 samples
+  unsigned int values[10] = {900, 100, 800, 200, 700, 300, 600, 400, 500, 1000};
+
+  CHECK_EQUAL(550, NETWORKS::median(values, 10));
+
+  unsigned int odd[3] = {30, 10, 20};
+
+  CHECK_EQUAL(20, NETWORKS::median(odd, 3));
+}
+
+TEST(testTrimmedMeanDropsOutliers) {
+  for (unsigned int round = 0; round < NETWORK_RANDOM_ROUNDS; round++) {
+    unsigned int values[10];
+
+    for (unsigned int i = 0; i < 10; i++) {
+      values[i] = random32() % 1001;
+    }
+
+    std::vector<unsigned int> sorted(values, values + 10);
+
+    std::sort(sorted.begin(), sorted.end());
+
+    unsigned int sum = 0;
+
+    for (unsigned int i = 2; i < 8; i++) {
+      sum += sorted[i];
+    }
+
+    unsigned int trimmedMean = SortingNetwork<unsigned int, 10>::trimmedMean<2>(values);
+
+    CHECK_EQUAL(sum / 6, trimmedMean);
+  }
+}
+
+TEST(testBenchmarksNetworkAgainstQuickSort) {
+  std::vector<std::vector<unsigned int>> inputs(1024, std::vector<unsigned int>(WATER_LEVEL_PROBE_SAMPLES));
+
+  for (std::vector<unsigned int> &input : inputs) {
+    for (unsigned int &value : input) {
+      value = 400 + random32() % 20;
+    }
+  }
+
+  // Former path (float quicksort, lower middle value)
+  float floats[WATER_LEVEL_PROBE_SAMPLES];
+  float floatChecksum = 0;
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  for (unsigned int round = 0; round < NETWORK_BENCHMARK_ROUNDS; round++) {
+    std::vector<unsigned int> &input = inputs[round % inputs.size()];
+
+    for (unsigned int i = 0; i < WATER_LEVEL_PROBE_SAMPLES; i++) {
+      floats[i] = input[i];
+    }
+
+    referenceQuickSort(floats, 0, WATER_LEVEL_PROBE_SAMPLES - 1);
+
+    floatChecksum += floats[(WATER_LEVEL_PROBE_SAMPLES / 2) - 1];
+  }
+
+  std::chrono::steady_clock::time_point middle = std::chrono::steady_clock::now();
+
+  // Current path (sorting network, middle mean)
+  unsigned int values[WATER_LEVEL_PROBE_SAMPLES];
+  unsigned long checksum = 0;
+
+  for (unsigned int round = 0; round < NETWORK_BENCHMARK_ROUNDS; round++) {
+    std::vector<unsigned int> &input = inputs[round % inputs.size()];
+
+    memcpy(values, input.data(), sizeof(values));
+
+    checksum += NETWORKS::median(values, WATER_LEVEL_PROBE_SAMPLES);
+  }
+
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+  double quickSortNanos = std::chrono::duration<double, std::nano>(middle - start).count() / NETWORK_BENCHMARK_ROUNDS,
+         networkNanos = std::chrono::duration<double, std::nano>(end - middle).count() / NETWORK_BENCHMARK_ROUNDS;
+
+  printf("     median of %u samples: quicksort %.2fns, sorting network %.2fns (host, %u rounds)\n", WATER_LEVEL_PROBE_SAMPLES, quickSortNanos, networkNanos, NETWORK_BENCHMARK_ROUNDS);
+
+  CHECK(floatChecksum > 0);
+  CHECK(checksum > 0);
+}
+
+int main() {
+  RUN(testSortsAnyCount);
+  RUN(testMedianMatchesNthElement);
+  RUN(testMedianOfEvenCountIsMiddleMean);
+  RUN(testTrimmedMeanDropsOutliers);
+  RUN(testBenchmarksNetworkAgainstQuickSort);
+
+  return harnessReport("network");
+}
@@ -0,0 +1,278 @@
+// Host Tests
+//
+// Host-side tests for both projects (Linux, w/o an ESP32 board)
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#include <cmath>
+
+#include "sensors.h"
+
+#include "harness.h"
+#include "tank.h"
+
+/**
+  [Simulated Week]
+
+    - The tank leaks (or evaporates) slowly all day long, and the
+      irrigation system waters the garden every morning for 30 minutes,
+      which drains the tank fast, while HomeKit activates the irrigation
+      system (which then marks itself as in use)
+
+    - The tank gets refilled (from noon, over 30 minutes) once it went
+      below a third
+
+    - Every minute, the level the sensor last reported is compared to the
+      true level of the tank, as is the level a fixed 10 minutes schedule
+      would have last reported
+**/
+
+const uint64_t POLLING_MINUTE_MICROSECONDS = 60000000;
+const unsigned int POLLING_WEEK_MINUTES = 7 * 24 * 60;
+const unsigned int POLLING_HISTORY_SIZE = 0x8000;
+
+const float POLLING_START_LEVEL = 90.0; // %
+const float POLLING_LEAK_RATE = 0.1; // % per hour
+const float POLLING_IRRIGATION_RATE = 20.0; // % per hour
+const unsigned int POLLING_IRRIGATION_START_MINUTE = 6 * 60; // 06:00
+const unsigned int POLLING_IRRIGATION_MINUTES = 30;
+const float POLLING_REFILL_BELOW_LEVEL = 33.0; // %
+const float POLLING_REFILL_RATE = 120.0; // % per hour
+const unsigned int POLLING_REFILL_START_MINUTE = 12 * 60; // 12:00
+const unsigned int POLLING_REFILL_MINUTES = 30;
+
+struct PollingStaleness {
+  float totalError = 0.0,
+        maximumError = 0.0,
+        maximumIrrigatingError = 0.0,
+        maximumRefillingError = 0.0;
+
+  void record(float error, bool isIrrigating, bool isRefilling) {
+    error = fabsf(error);
+
+    totalError += error;
+
+    if (isIrrigating == true) {
+      maximumIrrigatingError = max(maximumIrrigatingError, error);
+    } else if (isRefilling == true) {
+      maximumRefillingError = max(maximumRefillingError, error);
+    } else {
+      maximumError = max(maximumError, error);
+    }
+  }
+};
+
+TEST(testAdaptsPollingOverAWeek) {
+  hostFlashCreate(HISTORY_PARTITION_LABEL, POLLING_HISTORY_SIZE);
+
+  SimulatedTank tank;
+
+  tank.begin(WATER_LEVEL_SENSOR_PIN_TRIGGER, WATER_LEVEL_SENSOR_PIN_ECHO);
+  tank.noiseMicros = 2.0;
+
+  IrrigationSystem *irrigationSystem = new IrrigationSystem();
+
+  WaterTankLevelSensor *sensor = new WaterTankLevelSensor(irrigationSystem->statusFault, irrigationSystem->inUse);
+
+  PollingStaleness adaptive,
+                   fixed;
+
+  float level = POLLING_START_LEVEL,
+        fixedLevel = POLLING_START_LEVEL,
+        refillFromLevel = 0.0;
+
+  unsigned int fixedProbesCount = 0,
+               irrigatingProbesCount = 0,
+               refillsCount = 0,
+               refillStartMinute = 0,
+               refillSeenMinutes = 0;
+
+  bool isRefilling = false;
+
+  uint64_t lastProbeMinute = 0,
+           maximumProbeAgeMinutes = 0;
+
+  unsigned long lastProbesCount = 0;
+
+  for (unsigned int minute = 0; minute < POLLING_WEEK_MINUTES; minute++) {
+    unsigned int minuteOfDay = minute % (24 * 60);
+
+    bool isIrrigating = (minuteOfDay >= POLLING_IRRIGATION_START_MINUTE && minuteOfDay < POLLING_IRRIGATION_START_MINUTE + POLLING_IRRIGATION_MINUTES);
+
+    // Start a refill? (until the reported level caught up w/ it)
+    if (minuteOfDay == POLLING_REFILL_START_MINUTE && level < POLLING_REFILL_BELOW_LEVEL) {
+      isRefilling = true;
+      refillFromLevel = level;
+      refillStartMinute = minute;
+
+      refillsCount++;
+    }
+
+    bool isFilling = (isRefilling == true && minute < refillStartMinute + POLLING_REFILL_MINUTES);
+
+    // Move the true level
+    level -= (POLLING_LEAK_RATE + (isIrrigating ? POLLING_IRRIGATION_RATE : 0.0) - (isFilling ? POLLING_REFILL_RATE : 0.0)) / 60.0;
+
+    tank.level = level / 100.0;
+
+    // HomeKit activates the irrigation system while watering (a HAP write, \
+    //   seen by the HomeSpan task)
+    if (isIrrigating != (irrigationSystem->active->getVal() == 1)) {
+      CHECK(hostUpdate(irrigationSystem, {{irrigationSystem->active, isIrrigating ? 1.0f : 0.0f}}) == true);
+    }
+
+    sensor->loop();
+
+    // Run the device task for a minute (idles end early, as if woken up)
+    hostIdleLimitMicros = (uint64_t)(minute + 1) * POLLING_MINUTE_MICROSECONDS;
+
+    while (hostMicros < hostIdleLimitMicros) {
+      sensor->runDevice();
+    }
+
+    sensor->loop();
+
+    // Fixed schedule (reads the true level every 10 minutes)
+    if (minute % (POLL_EVERY_MILLISECONDS / 60000) == 0) {
+      fixedLevel = roundf(level);
+
+      fixedProbesCount++;
+    }
+
+    // Compare what either schedule last reported against the true level
+    if (sensor->probesCount > lastProbesCount) {
+      lastProbesCount = sensor->probesCount;
+      lastProbeMinute = minute;
+
+      irrigatingProbesCount += isIrrigating ? 1 : 0;
+    }
+
+    maximumProbeAgeMinutes = max(maximumProbeAgeMinutes, (uint64_t)minute - lastProbeMinute);
+
+    adaptive.record(sensor->lastPollLevel - level, isIrrigating, isRefilling);
+    fixed.record(fixedLevel - level, isIrrigating, isRefilling);
+
+    // Refill seen, and the reported level caught up w/ it?
+    if (isRefilling == true && isFilling == false && fabsf(sensor->lastPollLevel - level) <= POLL_LEVEL_STEP) {
+      isRefilling = false;
+      refillSeenMinutes = max(refillSeenMinutes, minute - refillStartMinute);
+    }
+  }
+
+  hostIdleLimitMicros = HOST_TIME_NEVER;
+
+  printf("     probes over a week: adaptive %u (%u while irrigating), fixed %u (%.1f probes saved per day, %u refills)\n", sensor->probesCount, irrigatingProbesCount, fixedProbesCount, sensor->probesSavedPerDay(), refillsCount);
+  printf("     staleness: adaptive mean %.2f%%, max %.2f%% (%.2f%% while irrigating, %.2f%% while refilling), oldest reading %llu minutes\n", adaptive.totalError / POLLING_WEEK_MINUTES, adaptive.maximumError, adaptive.maximumIrrigatingError, adaptive.maximumRefillingError, (unsigned long long)maximumProbeAgeMinutes);
+  printf("     staleness: fixed mean %.2f%%, max %.2f%% (%.2f%% while irrigating, %.2f%% while refilling), oldest reading %lu minutes\n", fixed.totalError / POLLING_WEEK_MINUTES, fixed.maximumError, fixed.maximumIrrigatingError, fixed.maximumRefillingError, POLL_EVERY_MILLISECONDS / 60000 - 1);
+  printf("     refill (from %.1f%%, over %u minutes) caught up w/ after %u minutes\n", refillFromLevel, POLLING_REFILL_MINUTES, refillSeenMinutes);
+
+  CHECK_EQUAL(7 * 24 * 6, fixedProbesCount);
+  CHECK(refillsCount > 0);
+
+  // Notice: fewer probes overall, though more while irrigating
+  CHECK(sensor->probesCount < fixedProbesCount / 2);
+  CHECK(irrigatingProbesCount > 7 * POLLING_IRRIGATION_MINUTES / 10);
+  CHECK(maximumProbeAgeMinutes <= POLL_EVERY_MILLISECONDS_MAXIMUM / 60000);
+
+  // The level is fresher than w/ the fixed schedule while irrigating, and \
+  //   within a poll step otherwise
+  CHECK(adaptive.maximumIrrigatingError < fixed.maximumIrrigatingError);
+  CHECK(adaptive.maximumError < POLL_LEVEL_STEP);
+
+  // Notice: a refill is only seen on the next probe (up to the longest \
+  //   interval when the level was flat), the fit then catches up fast
+  CHECK(refillSeenMinutes > 0);
+  CHECK(refillSeenMinutes <= POLLING_REFILL_MINUTES + POLL_EVERY_MILLISECONDS_MAXIMUM / 60000);
+}
+
+TEST(testPollsFasterOnceActivated) {
+  hostFlashCreate(HISTORY_PARTITION_LABEL, POLLING_HISTORY_SIZE);
+
+  SimulatedTank tank;
+
+  tank.begin(WATER_LEVEL_SENSOR_PIN_TRIGGER, WATER_LEVEL_SENSOR_PIN_ECHO);
+
+  IrrigationSystem *irrigationSystem = new IrrigationSystem();
+
+  WaterTankLevelSensor *sensor = new WaterTankLevelSensor(irrigationSystem->statusFault, irrigationSystem->inUse);
+
+  // Flat level (interval backs off)
+  hostIdleLimitMicros = 2 * POLLING_MINUTE_MICROSECONDS * 60;
+
+  while (hostMicros < hostIdleLimitMicros) {
+    sensor->runDevice();
+  }
+
+  unsigned int probesCount = sensor->probesCount;
+
+  CHECK(sensor->pollEveryMillis > POLL_EVERY_MILLISECONDS);
+  CHECK_EQUAL(0, irrigationSystem->inUse->getVal());
+
+  // HomeKit activates the irrigation system (InUse follows, and a probe \
+  //   runs right away)
+  CHECK(hostUpdate(irrigationSystem, {{irrigationSystem->active, 1.0f}}) == true);
+  CHECK_EQUAL(1, irrigationSystem->inUse->getVal());
+
+  sensor->loop();
+
+  hostIdleLimitMicros = hostMicros + POLLING_MINUTE_MICROSECONDS / 2;
+
+  while (hostMicros < hostIdleLimitMicros) {
+    sensor->runDevice();
+  }
+
+  CHECK_EQUAL(probesCount + 1, sensor->probesCount);
+  CHECK_EQUAL(POLL_EVERY_MILLISECONDS_MINIMUM, sensor->pollEveryMillis);
+
+  // Then deactivates it (InUse follows, polling backs off again)
+  CHECK(hostUpdate(irrigationSystem, {{irrigationSystem->active, 0.0f}}) == true);
+  CHECK_EQUAL(0, irrigationSystem->inUse->getVal());
+
+  sensor->loop();
+
+  hostIdleLimitMicros = hostMicros + 10 * POLLING_MINUTE_MICROSECONDS;
+
+  while (hostMicros < hostIdleLimitMicros) {
+    sensor->runDevice();
+  }
+
+  hostIdleLimitMicros = HOST_TIME_NEVER;
+
+  CHECK(sensor->isInUse == false);
+  CHECK(sensor->pollEveryMillis > POLL_EVERY_MILLISECONDS_MINIMUM);
+}
+
+TEST(testPrintsPollInterval) {
+  hostFlashCreate(HISTORY_PARTITION_LABEL, POLLING_HISTORY_SIZE);
+
+  SimulatedTank tank;
+
+  tank.begin(WATER_LEVEL_SENSOR_PIN_TRIGGER, WATER_LEVEL_SENSOR_PIN_ECHO);
+
+  SpanCharacteristic *inUse = new Characteristic::InUse();
+  SpanCharacteristic *statusFault = new Characteristic::StatusFault(0);
+
+  WaterTankLevelSensor *sensor = new WaterTankLevelSensor(statusFault, inUse);
+
+  // Flat level (interval doubles on each probe)
+  hostIdleLimitMicros = 4 * POLLING_MINUTE_MICROSECONDS * 60;
+
+  while (hostMicros < hostIdleLimitMicros) {
+    sensor->runDevice();
+  }
+
+  hostIdleLimitMicros = HOST_TIME_NEVER;
+
+  CHECK(hostRunCommand("v") == true);
+
+  CHECK(hostSerialOutput.find("  - Poll Interval = 3600s") != std::string::npos);
+  CHECK(hostSerialOutput.find("probes saved per day") != std::string::npos);
+}
+
+int main() {
+  RUN(testAdaptsPollingOverAWeek);
+  RUN(testPollsFasterOnceActivated);
+  RUN(testPrintsPollInterval);
+
+  return harnessReport("polling");
+}
@@ -0,0 +1,169 @@
+// Host Tests
+//
+// Host-side tests for both projects (Linux, w/o an ESP32 board)
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#include "services.h"
+
+#include "boot.h"
+#include "harness.h"
+#include "simulator.h"
+
+const uint64_t POWER_RUN_MICROSECONDS = 60000000; // 1 minute
+const uint64_t POWER_UPDATE_EVERY_MICROSECONDS = 10000000; // 10 seconds
+
+// Notice: time the chip takes to get out of light sleep (assumed, as the \
+//   PLL and the flash clock restart)
+const uint64_t POWER_LIGHT_SLEEP_WAKE_MICROSECONDS = 1000; // 1 millisecond
+
+const uint8_t POWER_VALUES[][STORAGE_SIZE] = {
+  {1, 2, 18, 18, 0},
+  {1, 1, 18, 27, 1},
+  {0, 1, 18, 27, 1}
+};
+
+struct Boost {
+  PowerLock powerLock;
+
+  unsigned long runMicros = 1000;
+
+  unsigned long runBoosted() {
+    // Latency-critical work (eg. a DHT capture), at the maximum frequency
+    powerLock.acquire();
+
+    hostAdvanceMicros(runMicros);
+
+    powerLock.release();
+
+    return 100;
+  }
+};
+
+static Scheduler<Boost> boostScheduler;
+
+static Boost boost;
+
+static SimulatedAirConditioner simulator;
+
+static void countSchedulerMisses(unsigned int &deadlineMissesCount, unsigned int &budgetOverrunsCount) {
+  deadlineMissesCount = 0;
+  budgetOverrunsCount = 0;
+
+  for (unsigned int i = 0; i < scheduler.tasksCount; i++) {
+    deadlineMissesCount += scheduler.tasks[i].deadlineMissesCount;
+    budgetOverrunsCount += scheduler.tasks[i].budgetOverrunsCount;
+  }
+}
+
+TEST(testMeasuresRunTimesWhileScaling) {
+  hostRenew(power);
+  hostRenew(boostScheduler);
+  hostRenew(boost);
+
+  power.begin();
+
+  CHECK(power.isScaling == true);
+
+  boost.powerLock.begin("boost");
+
+  boostScheduler.begin();
+  boostScheduler.add("boost", 1, &boost, &Boost::runBoosted, 0, 1500);
+
+  uint64_t startCycles = hostCycles;
+
+  boostScheduler.run();
+
+  // Notice: cycles counted at the maximum frequency, converted at the \
+  //   minimum frequency, would double the run time (a false overrun)
+  uint64_t convertedMicros = (hostCycles - startCycles) / POWER_CPU_FREQUENCY_MINIMUM;
+
+  printf("     1000µs task at %dMHz: measured %luµs (cycles converted at %dMHz: %lluµs)\n", POWER_CPU_FREQUENCY_MAXIMUM, boostScheduler.tasks[0].lastRunMicros, POWER_CPU_FREQUENCY_MINIMUM, (unsigned long long)convertedMicros);
+
+  CHECK_EQUAL(2000, convertedMicros);
+  CHECK_EQUAL(1000, boostScheduler.tasks[0].lastRunMicros);
+  CHECK_EQUAL(0, boostScheduler.tasks[0].budgetOverrunsCount);
+}
+
+TEST(testMeasuresWakeLatencyAndHapResponse) {
+  hostWakeLatencyMicros = POWER_LIGHT_SLEEP_WAKE_MICROSECONDS;
+
+  hostFlashCreate(JOURNAL_PARTITION_LABEL, JOURNAL_REGION_SIZE);
+
+  simulator.begin(IR_PIN_PWM);
+
+  bootSketch();
+
+  CHECK(power.isLightSleeping == true);
+
+  // Notice: the first SM tick is held back by the initialization hold of \
+  //   the unit at boot (not counted)
+  unsigned int bootDeadlineMissesCount,
+               bootBudgetOverrunsCount;
+
+  bootRunUntil(POWER_UPDATE_EVERY_MICROSECONDS);
+
+  countSchedulerMisses(bootDeadlineMissesCount, bootBudgetOverrunsCount);
+
+  uint64_t updateBlockedMicros = 0,
+           firstFrameMaximumMicros = 0;
+
+  unsigned int updatesCount = 0;
+
+  for (uint64_t updateMicros = POWER_UPDATE_EVERY_MICROSECONDS; updateMicros < POWER_RUN_MICROSECONDS; updateMicros += POWER_UPDATE_EVERY_MICROSECONDS) {
+    bootRunUntil(updateMicros);
+
+    size_t transmissionsBefore = hostTransmissions.size();
+
+    // HAP side of an update (returns once handed over to the device task)
+    uint64_t startMicros = hostMicros;
+
+    CHECK(bootUpdate(POWER_VALUES[updatesCount % 3]) == true);
+
+    updateBlockedMicros = max(updateBlockedMicros, hostMicros - startMicros);
+
+    bootRunUntil(updateMicros + POWER_UPDATE_EVERY_MICROSECONDS / 2);
+
+    // Time until the first IR frame is on air (what the user notices)
+    if (hostTransmissions.size() > transmissionsBefore) {
+      firstFrameMaximumMicros = max(firstFrameMaximumMicros, hostTransmissions[transmissionsBefore].startMicros - startMicros);
+    }
+
+    updatesCount++;
+  }
+
+  bootRunUntil(POWER_RUN_MICROSECONDS);
+
+  simulator.receive();
+
+  SchedulerHistogram &wakes = power.wakeLatencyHistogram;
+
+  unsigned int deadlineMissesCount,
+               budgetOverrunsCount;
+
+  countSchedulerMisses(deadlineMissesCount, budgetOverrunsCount);
+
+  deadlineMissesCount -= bootDeadlineMissesCount;
+  budgetOverrunsCount -= bootBudgetOverrunsCount;
+
+  printf("     wake latency: mean %uµs, p50 %uµs, p99 %uµs, max %uµs (%u wakes at deadline, %u by HomeSpan)\n", wakes.mean(), wakes.percentile(50), wakes.percentile(99), wakes.maximum, wakes.samplesCount, power.wakesCount);
+  printf("     HAP response: update() blocked %lluµs, first IR frame on air %lluµs after the update (max, %u updates, w/ a %dms SM debounce)\n", (unsigned long long)updateBlockedMicros, (unsigned long long)firstFrameMaximumMicros, updatesCount, SM_WAKE_UP_EVERY_MILLISECONDS);
+  printf("     %u deadline misses, %u budget overruns after boot (%u IR frames applied)\n", deadlineMissesCount, budgetOverrunsCount, simulator.framesApplied);
+
+  CHECK(wakes.samplesCount > 0);
+  CHECK_EQUAL(POWER_LIGHT_SLEEP_WAKE_MICROSECONDS, wakes.maximum);
+  CHECK(power.wakesCount >= updatesCount);
+  CHECK_EQUAL(0, updateBlockedMicros);
+  CHECK(firstFrameMaximumMicros > 0);
+  CHECK(firstFrameMaximumMicros < (SM_WAKE_UP_EVERY_MILLISECONDS + SCHEDULER_DEADLINE_TOLERANCE_MILLISECONDS) * 1000);
+  CHECK_EQUAL(0, deadlineMissesCount);
+  CHECK_EQUAL(0, budgetOverrunsCount);
+  CHECK_EQUAL(0, simulator.framesRejected);
+}
+
+int main() {
+  RUN(testMeasuresRunTimesWhileScaling);
+  RUN(testMeasuresWakeLatencyAndHapResponse);
+
+  return harnessReport("power");
+}
@@ -0,0 +1,225 @@
+// Host Tests
+//
+// Host-side tests for both projects (Linux, w/o an ESP32 board)
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#include "services.h"
+
+#include "boot.h"
+#include "harness.h"
+#include "nec.h"
+
+/**
+  [Profile Plans]
+
+    - Runs against the profile the sketch was built w/ (AC_PROFILE), thus
+      'make test' builds it twice: w/ the Crisp X profile, and w/ a
+      test-only profile (see profile_alternate.h)
+
+    - Every start value of the SM is planned towards every target value
+      that HomeKit can request, and plans are replayed on the AC unit model
+      of the profile: each command must be accepted and reach the value it
+      was planned for, and the AC unit must end up on the target values
+**/
+
+#define PROFILE_NAME_OF(PROFILE) #PROFILE
+#define PROFILE_NAME(PROFILE) PROFILE_NAME_OF(PROFILE)
+
+typedef AirConditionerRemote<AC_PROFILE> UNIT;
+typedef UNIT::CODEBOOK CODEBOOK;
+
+const uint64_t PROFILES_BOOT_MICROSECONDS = 1000000; // 1 second
+const uint64_t PROFILES_CONVERGE_MICROSECONDS = 30000000; // 30 seconds
+const uint64_t PROFILES_CHECK_MICROSECONDS = 600000000; // 10 minutes
+
+struct ProfilePlansResult {
+  unsigned int pairsCount = 0,
+               failuresCount = 0,
+               framesMaximum = 0;
+};
+
+static bool isProfileCommand(unsigned int command) {
+  return (command == CODEBOOK::IR_COMMAND_SWITCH_POWER || command == CODEBOOK::IR_COMMAND_SWITCH_MODE || command == CODEBOOK::IR_COMMAND_TOGGLE_SWING || command == CODEBOOK::IR_COMMAND_TEMPERATURE_INCREASE || command == CODEBOOK::IR_COMMAND_TEMPERATURE_DECREASE);
+}
+
+static void checkPlan(ProfilePlansResult &result, const uint8_t startValues[], const uint8_t targetValues[]) {
+  InfraRedPlan plan;
+  AirConditionerUnit<AC_PROFILE> unit;
+
+  bool isValid = true;
+
+  memcpy(unit.values, startValues, STORAGE_SIZE);
+
+  bootUnit->planConvergence(plan, startValues, targetValues, STORAGE_MASK_ALL);
+
+  // Notice: a full plan would have been truncated
+  if (plan.size >= IR_PLAN_CAPACITY) {
+    isValid = false;
+  }
+
+  for (unsigned int i = 0; i < plan.size; i++) {
+    if (isProfileCommand(plan.steps[i].command) == false || unit.receive(plan.steps[i].command) == false || unit.values[plan.steps[i].index] != plan.steps[i].value) {
+      isValid = false;
+    }
+  }
+
+  if (memcmp(unit.values, targetValues, STORAGE_SIZE) != 0) {
+    isValid = false;
+  }
+
+  result.pairsCount++;
+  result.failuresCount += (isValid == true) ? 0 : 1;
+  result.framesMaximum = max(result.framesMaximum, plan.size);
+}
+
+static void checkPlansFrom(ProfilePlansResult &result, const uint8_t startValues[]) {
+  uint8_t targetValues[STORAGE_SIZE];
+
+  // Walk all target values that HK can request (other values are left \
+  //   untouched, thus stay on their start values)
+  for (unsigned int active = ACTIVE_INACTIVE; active <= ACTIVE_ACTIVE; active++) {
+    for (unsigned int mode = TARGET_HEATER_COOLER_STATE_AUTO; mode <= TARGET_HEATER_COOLER_STATE_COOL; mode++) {
+      memcpy(targetValues, startValues, STORAGE_SIZE);
+
+      targetValues[STORAGE_INDEX_SM_ACTIVE] = active;
+      targetValues[STORAGE_INDEX_SM_TARGET_HEATER_COOLER_STATE] = mode;
+
+      if (active == ACTIVE_ACTIVE && mode == TARGET_HEATER_COOLER_STATE_COOL) {
+        for (unsigned int i = 0; i < UNIT::STATES_COOLING_THRESHOLD_TEMPERATURE::SIZE; i++) {
+          for (unsigned int swingMode = ACTIVE_SWING_MODE_DISABLED; swingMode <= ACTIVE_SWING_MODE_ENABLED; swingMode++) {
+            targetValues[STORAGE_INDEX_SM_COOLING_THRESHOLD_TEMPERATURE] = UNIT::STATES_COOLING_THRESHOLD_TEMPERATURE::at(i);
+            targetValues[STORAGE_INDEX_SM_SWING_MODE] = swingMode;
+
+            checkPlan(result, startValues, targetValues);
+          }
+        }
+      } else if (active == ACTIVE_ACTIVE && mode == TARGET_HEATER_COOLER_STATE_HEAT) {
+        for (unsigned int i = 0; i < UNIT::STATES_HEATING_THRESHOLD_TEMPERATURE::SIZE; i++) {
+          for (unsigned int swingMode = ACTIVE_SWING_MODE_DISABLED; swingMode <= ACTIVE_SWING_MODE_ENABLED; swingMode++) {
+            targetValues[STORAGE_INDEX_SM_HEATING_THRESHOLD_TEMPERATURE] = UNIT::STATES_HEATING_THRESHOLD_TEMPERATURE::at(i);
+            targetValues[STORAGE_INDEX_SM_SWING_MODE] = swingMode;
+
+            checkPlan(result, startValues, targetValues);
+          }
+        }
+      } else {
+        checkPlan(result, startValues, targetValues);
+      }
+    }
+  }
+}
+
+static ProfilePlansResult checkAllPlans() {
+  ProfilePlansResult result;
+
+  uint8_t startValues[STORAGE_SIZE];
+
+  for (unsigned int active = 0; active < STATES_DIRECTION_ACTIVE::SIZE; active++) {
+    for (unsigned int mode = 0; mode < UNIT::STATES_DIRECTION_TARGET_HEATER_COOLER_STATE::SIZE; mode++) {
+      for (unsigned int cool = 0; cool < UNIT::STATES_COOLING_THRESHOLD_TEMPERATURE::SIZE; cool++) {
+        for (unsigned int heat = 0; heat < UNIT::STATES_HEATING_THRESHOLD_TEMPERATURE::SIZE; heat++) {
+          for (unsigned int swing = 0; swing < STATES_SWING_MODE::SIZE; swing++) {
+            startValues[STORAGE_INDEX_SM_ACTIVE] = STATES_DIRECTION_ACTIVE::at(active);
+            startValues[STORAGE_INDEX_SM_TARGET_HEATER_COOLER_STATE] = UNIT::STATES_DIRECTION_TARGET_HEATER_COOLER_STATE::at(mode);
+            startValues[STORAGE_INDEX_SM_COOLING_THRESHOLD_TEMPERATURE] = UNIT::STATES_COOLING_THRESHOLD_TEMPERATURE::at(cool);
+            startValues[STORAGE_INDEX_SM_HEATING_THRESHOLD_TEMPERATURE] = UNIT::STATES_HEATING_THRESHOLD_TEMPERATURE::at(heat);
+            startValues[STORAGE_INDEX_SM_SWING_MODE] = STATES_SWING_MODE::at(swing);
+
+            checkPlansFrom(result, startValues);
+          }
+        }
+      }
+    }
+  }
+
+  return result;
+}
+
+TEST(testPlansReachEveryTarget) {
+  hostFlashCreate(JOURNAL_PARTITION_LABEL, JOURNAL_REGION_SIZE);
+
+  bootSketch();
+
+  ProfilePlansResult result = checkAllPlans();
+
+  printf("     %s: %u start and target value pairs, %u invalid plans, %u frames at most (plan capacity %u)\n", PROFILE_NAME(AC_PROFILE), result.pairsCount, result.failuresCount, result.framesMaximum, IR_PLAN_CAPACITY);
+
+  CHECK(result.pairsCount > 0);
+  CHECK_EQUAL(0, result.failuresCount);
+}
+
+TEST(testChecksPlansFromConsole) {
+  hostFlashCreate(JOURNAL_PARTITION_LABEL, JOURNAL_REGION_SIZE);
+
+  bootSketch();
+
+  ProfilePlansResult result = checkAllPlans();
+
+  // Notice: the '@c' check walks the same pairs, on the device task
+  CHECK(hostRunCommand("c") == true);
+
+  while (hostSerialOutput.find("Checked ") == std::string::npos && hostMicros < PROFILES_CHECK_MICROSECONDS) {
+    bootRunUntil(hostMicros + PROFILES_BOOT_MICROSECONDS);
+  }
+
+  char line[96];
+
+  snprintf(line, sizeof(line), "Checked %u start and target value pairs in ", result.pairsCount);
+
+  CHECK(hostSerialOutput.find(line) != std::string::npos);
+  CHECK(hostSerialOutput.find(": 0 did not converge (PASS)") != std::string::npos);
+}
+
+TEST(testEmitsProfileFrames) {
+  hostFlashCreate(JOURNAL_PARTITION_LABEL, JOURNAL_REGION_SIZE);
+
+  bootSketch();
+  bootRunUntil(PROFILES_BOOT_MICROSECONDS);
+
+  // Cool at the warmest temperature of the profile, w/ swing
+  uint8_t targetValues[STORAGE_SIZE],
+          values[STORAGE_SIZE];
+
+  bootUnit->snapshotStateMachineValues(targetValues);
+
+  targetValues[STORAGE_INDEX_SM_ACTIVE] = ACTIVE_ACTIVE;
+  targetValues[STORAGE_INDEX_SM_TARGET_HEATER_COOLER_STATE] = TARGET_HEATER_COOLER_STATE_COOL;
+  targetValues[STORAGE_INDEX_SM_COOLING_THRESHOLD_TEMPERATURE] = CODEBOOK::RANGE_TEMPERATURE_COOL_MAXIMUM;
+  targetValues[STORAGE_INDEX_SM_SWING_MODE] = ACTIVE_SWING_MODE_ENABLED;
+
+  CHECK(bootUpdate(targetValues) == true);
+
+  bootRunUntil(PROFILES_BOOT_MICROSECONDS + PROFILES_CONVERGE_MICROSECONDS);
+
+  bootUnit->snapshotStateMachineValues(values);
+
+  CHECK(memcmp(values, targetValues, STORAGE_SIZE) == 0);
+
+  // All frames carry the address and commands of the profile
+  unsigned int framesCount = 0,
+               foreignFramesCount = 0;
+
+  for (const HostTransmission &transmission : hostTransmissions) {
+    NecReception reception = necDecode(transmission);
+
+    if (reception.isData == true) {
+      framesCount++;
+
+      if (reception.address != CODEBOOK::IR_ADDRESS || isProfileCommand(reception.command) == false) {
+        foreignFramesCount++;
+      }
+    }
+  }
+
+  CHECK(framesCount > 0);
+  CHECK_EQUAL(0, foreignFramesCount);
+}
+
+int main() {
+  RUN(testPlansReachEveryTarget);
+  RUN(testChecksPlansFromConsole);
+  RUN(testEmitsProfileFrames);
+
+  return harnessReport("profiles (" PROFILE_NAME(AC_PROFILE) ")");
+}
@@ -0,0 +1,250 @@
+// Host Tests
+//
+// Host-side tests for both projects (Linux, w/o an ESP32 board)
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#include <cmath>
+
+#include "sensors.h"
+
+#include "harness.h"
+#include "tank.h"
+
+/**
+  [Simulated Week]
+
+    - Same week as the polling test: the tank leaks slowly, the irrigation
+      system waters the garden every morning for 30 minutes, and the tank
+      gets refilled at noon once it went below a third
+
+    - Notifications are counted on the characteristics (after), and
+      compared to the readings handed over by the device task, which were
+      each set on their characteristic before the publishers (before)
+**/
+
+const uint64_t PUBLISHER_MINUTE_MICROSECONDS = 60000000;
+const unsigned int PUBLISHER_WEEK_MINUTES = 7 * 24 * 60;
+const unsigned int PUBLISHER_HISTORY_SIZE = 0x8000;
+
+const float PUBLISHER_START_LEVEL = 90.0; // %
+const float PUBLISHER_LEAK_RATE = 0.1; // % per hour
+const float PUBLISHER_IRRIGATION_RATE = 20.0; // % per hour
+const unsigned int PUBLISHER_IRRIGATION_START_MINUTE = 6 * 60; // 06:00
+const unsigned int PUBLISHER_IRRIGATION_MINUTES = 30;
+const float PUBLISHER_REFILL_BELOW_LEVEL = 33.0; // %
+const float PUBLISHER_REFILL_RATE = 120.0; // % per hour
+const unsigned int PUBLISHER_REFILL_START_MINUTE = 12 * 60; // 12:00
+const unsigned int PUBLISHER_REFILL_MINUTES = 30;
+
+static void advanceMinutes(unsigned int minutes) {
+  hostAdvanceMicros((uint64_t)minutes * PUBLISHER_MINUTE_MICROSECONDS);
+}
+
+static SpanCharacteristic *bootWaterLevel(Publisher &publisher) {
+  SpanCharacteristic *waterLevel = new Characteristic::BatteryLevel(100);
+
+  publisher.begin(waterLevel, PUBLISH_WATER_LEVEL_DEADBAND, PUBLISH_WATER_LEVEL_MINIMUM_INTERVAL_MILLISECONDS, PUBLISH_WATER_LEVEL_MAXIMUM_INTERVAL_MILLISECONDS);
+
+  return waterLevel;
+}
+
+TEST(testSuppressesChangesWithinDeadband) {
+  Publisher publisher;
+
+  SpanCharacteristic *waterLevel = bootWaterLevel(publisher);
+
+  // Notice: the first value is always published
+  CHECK(publisher.publish(50) == true);
+
+  advanceMinutes(10);
+
+  // Within the deadband (suppressed), then unchanged (not counted)
+  CHECK(publisher.publish(51) == false);
+  CHECK(publisher.publish(50) == false);
+  CHECK_EQUAL(1, publisher.suppressionsCount);
+
+  // Past the deadband (published)
+  CHECK(publisher.publish(52) == true);
+  CHECK_EQUAL(52, waterLevel->getVal());
+  CHECK_EQUAL(2, waterLevel->notificationsCount);
+  CHECK_EQUAL(2, publisher.publishesCount);
+}
+
+TEST(testSuppressesChangesWithinMinimumInterval) {
+  Publisher publisher;
+
+  SpanCharacteristic *waterLevel = bootWaterLevel(publisher);
+
+  CHECK(publisher.publish(50) == true);
+
+  // Significant changes, though too soon (suppressed)
+  for (unsigned int minute = 1; minute < PUBLISH_WATER_LEVEL_MINIMUM_INTERVAL_MILLISECONDS / 60000; minute++) {
+    advanceMinutes(1);
+
+    CHECK(publisher.publish(50 - 2 * minute) == false);
+  }
+
+  CHECK_EQUAL(50, waterLevel->getVal());
+
+  // Minimum interval elapsed (latest value published)
+  advanceMinutes(1);
+
+  CHECK(publisher.publish(40) == true);
+  CHECK_EQUAL(40, waterLevel->getVal());
+  CHECK_EQUAL(2, waterLevel->notificationsCount);
+  CHECK_EQUAL(PUBLISH_WATER_LEVEL_MINIMUM_INTERVAL_MILLISECONDS / 60000 - 1, publisher.suppressionsCount);
+}
+
+TEST(testPublishesDriftAfterMaximumInterval) {
+  Publisher publisher;
+
+  SpanCharacteristic *waterLevel = bootWaterLevel(publisher);
+
+  CHECK(publisher.publish(50) == true);
+
+  // A drift within the deadband, seen every 10 minutes
+  unsigned int suppressedMinutes = 0;
+
+  while (publisher.publish(49) == false) {
+    advanceMinutes(10);
+
+    suppressedMinutes += 10;
+  }
+
+  CHECK_EQUAL(PUBLISH_WATER_LEVEL_MAXIMUM_INTERVAL_MILLISECONDS / 60000, suppressedMinutes);
+  CHECK_EQUAL(49, waterLevel->getVal());
+  CHECK_EQUAL(suppressedMinutes / 10, publisher.suppressionsCount);
+
+  // Notice: an unchanged value is never published again
+  advanceMinutes(2 * PUBLISH_WATER_LEVEL_MAXIMUM_INTERVAL_MILLISECONDS / 60000);
+
+  CHECK(publisher.publish(49) == false);
+  CHECK_EQUAL(2, waterLevel->notificationsCount);
+}
+
+TEST(testDoesNotFlapAroundLowLevel) {
+  Publisher publisher;
+  Hysteresis lowLevel;
+
+  SpanCharacteristic *statusLowBattery = new Characteristic::StatusLowBattery(0);
+
+  publisher.begin(statusLowBattery, 0.0, PUBLISHER_INTERVAL_NONE, PUBLISHER_INTERVAL_NONE);
+  lowLevel.begin(WATER_LEVEL_LOW, WATER_LEVEL_LOW_CLEAR);
+
+  // Level hovers around the low level (±3%, under the clear level), then \
+  //   rises past the clear level (eg. a refill)
+  unsigned int thresholdFlipsCount = 0;
+
+  bool isThresholdRaised = false;
+
+  for (unsigned int i = 0; i < 200; i++) {
+    float level = WATER_LEVEL_LOW + 3.0 * sinf(i / 2.0);
+
+    if ((level <= WATER_LEVEL_LOW) != isThresholdRaised) {
+      isThresholdRaised = !isThresholdRaised;
+      thresholdFlipsCount++;
+    }
+
+    publisher.publish(lowLevel.update(level) ? 1 : 0);
+  }
+
+  CHECK_EQUAL(1, statusLowBattery->getVal());
+
+  publisher.publish(lowLevel.update(WATER_LEVEL_LOW_CLEAR) ? 1 : 0);
+
+  CHECK_EQUAL(0, statusLowBattery->getVal());
+
+  printf("     level hovering around %u%%: %u notifications w/ hysteresis (%u%%/%u%%), %u flips w/ a single threshold\n", WATER_LEVEL_LOW, statusLowBattery->notificationsCount, WATER_LEVEL_LOW, WATER_LEVEL_LOW_CLEAR, thresholdFlipsCount);
+
+  // Notice: raised once, then cleared once
+  CHECK_EQUAL(2, statusLowBattery->notificationsCount);
+  CHECK(thresholdFlipsCount > 10);
+}
+
+TEST(testReducesNotificationsOverAWeek) {
+  hostFlashCreate(HISTORY_PARTITION_LABEL, PUBLISHER_HISTORY_SIZE);
+
+  SimulatedTank tank;
+
+  tank.begin(WATER_LEVEL_SENSOR_PIN_TRIGGER, WATER_LEVEL_SENSOR_PIN_ECHO);
+  tank.noiseMicros = 2.0;
+
+  IrrigationSystem *irrigationSystem = new IrrigationSystem();
+
+  WaterTankLevelSensor *sensor = new WaterTankLevelSensor(irrigationSystem->statusFault, irrigationSystem->inUse);
+
+  float level = PUBLISHER_START_LEVEL;
+
+  unsigned int refillStartMinute = 0,
+               readingsCount = 0;
+
+  bool isRefilling = false;
+
+  for (unsigned int minute = 0; minute < PUBLISHER_WEEK_MINUTES; minute++) {
+    unsigned int minuteOfDay = minute % (24 * 60);
+
+    bool isIrrigating = (minuteOfDay >= PUBLISHER_IRRIGATION_START_MINUTE && minuteOfDay < PUBLISHER_IRRIGATION_START_MINUTE + PUBLISHER_IRRIGATION_MINUTES);
+
+    if (minuteOfDay == PUBLISHER_REFILL_START_MINUTE && level < PUBLISHER_REFILL_BELOW_LEVEL) {
+      isRefilling = true;
+      refillStartMinute = minute;
+    }
+
+    bool isFilling = (isRefilling == true && minute < refillStartMinute + PUBLISHER_REFILL_MINUTES);
+
+    level -= (PUBLISHER_LEAK_RATE + (isIrrigating ? PUBLISHER_IRRIGATION_RATE : 0.0) - (isFilling ? PUBLISHER_REFILL_RATE : 0.0)) / 60.0;
+
+    tank.level = level / 100.0;
+
+    if (isIrrigating != (irrigationSystem->active->getVal() == 1)) {
+      hostUpdate(irrigationSystem, {{irrigationSystem->active, isIrrigating ? 1.0f : 0.0f}});
+
+      sensor->loop();
+    }
+
+    // Run the device task for a minute, then hand readings over to HK (as \
+    //   the HomeSpan task would, while counting level readings)
+    hostIdleLimitMicros = (uint64_t)(minute + 1) * PUBLISHER_MINUTE_MICROSECONDS;
+
+    while (hostMicros < hostIdleLimitMicros) {
+      sensor->runDevice();
+    }
+
+    SensorReading reading;
+
+    while (sensor->readings.pop(reading) == true) {
+      if (reading.type == SENSOR_READING_TYPE_LEVEL || reading.type == SENSOR_READING_TYPE_LOW_LEVEL) {
+        readingsCount++;
+      }
+
+      sensor->applyReading(reading);
+    }
+  }
+
+  hostIdleLimitMicros = HOST_TIME_NEVER;
+
+  unsigned int notificationsCount = sensor->waterLevel->notificationsCount + sensor->statusLowBattery->notificationsCount,
+               suppressionsCount = sensor->waterLevelPublisher.suppressionsCount + sensor->statusLowBatteryPublisher.suppressionsCount;
+
+  printf("     notifications over a week: %u before, %u after (%u level, %u low level), %u suppressed changes, over %u probes\n", readingsCount, notificationsCount, sensor->waterLevel->notificationsCount, sensor->statusLowBattery->notificationsCount, suppressionsCount, sensor->probesCount);
+
+  CHECK_EQUAL(2 * sensor->probesCount, readingsCount);
+  CHECK_EQUAL(sensor->waterLevelPublisher.publishesCount + sensor->statusLowBatteryPublisher.publishesCount, notificationsCount);
+  CHECK(notificationsCount < readingsCount / 2);
+  CHECK(suppressionsCount > 0);
+
+  // Notice: the reported level still follows the tank (within the deadband \
+  //   and the rounding, or an irrigation started since the last publish)
+  CHECK(fabsf(sensor->waterLevel->getVal() - level) <= PUBLISH_WATER_LEVEL_DEADBAND + POLL_LEVEL_STEP);
+}
+
+int main() {
+  RUN(testSuppressesChangesWithinDeadband);
+  RUN(testSuppressesChangesWithinMinimumInterval);
+  RUN(testPublishesDriftAfterMaximumInterval);
+  RUN(testDoesNotFlapAroundLowLevel);
+  RUN(testReducesNotificationsOverAWeek);
+
+  return harnessReport("publisher");
+}
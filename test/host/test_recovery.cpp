@@ -0,0 +1,212 @@
+// Host Tests
+//
+// Host-side tests for both projects (Linux, w/o an ESP32 board)
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#include "services.h"
+
+#include "boot.h"
+#include "harness.h"
+#include "simulator.h"
+
+/**
+  [Crash Injection]
+
+    - The controller boots, HomeKit requests a multi-step change, and power
+      is cut at a given point in time while the plan is being emitted. The
+      controller then reboots from its flash image, while the AC unit keeps
+      its state: both must then agree on the state of the AC unit.
+
+    - Cuts are taken every millisecond across the whole plan, and every
+      25µs around the end of each data part (where the AC unit decodes a
+      command, and where the journal completes its intent)
+**/
+
+const uint64_t RECOVERY_UPDATE_MICROSECONDS = 1000000; // 1 second after boot
+const uint64_t RECOVERY_COARSE_STEP_MICROSECONDS = 1000;
+const uint64_t RECOVERY_DENSE_STEP_MICROSECONDS = 25;
+const uint64_t RECOVERY_DENSE_SPAN_MICROSECONDS = 3000;
+
+// Notice: power, mode (cool to heat, through dry and fan), 9 temperature \
+//   steps (18°C to 27°C), then swing
+const unsigned int RECOVERY_FRAMES_COUNT = 1 + 3 + 9 + 1;
+
+// Notice: the only window where the journal cannot tell, is from the end of \
+//   a data part to its completion record (1 loop pass + 1 flash write)
+const uint64_t RECOVERY_WINDOW_MAXIMUM_MICROSECONDS = 2000;
+
+// Power on, heat at 27°C w/o swing (from the factory state)
+const uint8_t RECOVERY_TARGET_VALUES[STORAGE_SIZE] = {1, 1, 18, 27, 0};
+
+static SimulatedAirConditioner simulator;
+
+static void powerOn() {
+  hostFlashCreate(JOURNAL_PARTITION_LABEL, JOURNAL_REGION_SIZE);
+
+  simulator.begin(IR_PIN_PWM);
+
+  bootSketch();
+}
+
+static void reboot() {
+  std::vector<uint8_t> image = hostFlashImage(JOURNAL_PARTITION_LABEL);
+
+  hostReset();
+  hostFlashCreate(JOURNAL_PARTITION_LABEL, JOURNAL_REGION_SIZE);
+  hostFlashImage(JOURNAL_PARTITION_LABEL) = image;
+
+  simulator.rewind();
+
+  bootSketch();
+}
+
+static bool isSynchronized() {
+  uint8_t values[STORAGE_SIZE];
+
+  bootUnit->snapshotStateMachineValues(values);
+
+  return memcmp(values, simulator.values, STORAGE_SIZE) == 0;
+}
+
+static uint64_t latestDataEndBefore(const std::vector<uint64_t> &dataEnds, uint64_t cutMicros) {
+  uint64_t latestMicros = 0;
+
+  for (uint64_t dataEndMicros : dataEnds) {
+    if (dataEndMicros <= cutMicros) {
+      latestMicros = dataEndMicros;
+    }
+  }
+
+  return latestMicros;
+}
+
+TEST(testConvergesWithoutPowerCut) {
+  powerOn();
+
+  bootRunUntil(RECOVERY_UPDATE_MICROSECONDS);
+
+  bootUpdate(RECOVERY_TARGET_VALUES);
+
+  bootRunUntil(RECOVERY_UPDATE_MICROSECONDS + 10000000);
+
+  simulator.receive();
+
+  CHECK_EQUAL(RECOVERY_FRAMES_COUNT, simulator.framesApplied);
+  CHECK_EQUAL(0, simulator.framesRejected);
+  CHECK_EQUAL(1, simulator.values[0]);
+  CHECK_EQUAL(1, simulator.values[1]);
+  CHECK_EQUAL(27, simulator.values[3]);
+  CHECK_EQUAL(0, simulator.values[4]);
+  CHECK(isSynchronized() == true);
+
+  // Notice: 1 intent + 1 completion per frame, after the boot snapshot
+  CHECK_EQUAL(1 + 2 * RECOVERY_FRAMES_COUNT, bootUnit->journal.appendsCount);
+}
+
+TEST(testRecoversFromPowerCutAtAnyPoint) {
+  // Reference run (collects data part ends, where the AC unit decodes)
+  powerOn();
+
+  bootRunUntil(RECOVERY_UPDATE_MICROSECONDS);
+
+  bootUpdate(RECOVERY_TARGET_VALUES);
+
+  bootRunUntil(RECOVERY_UPDATE_MICROSECONDS + 10000000);
+
+  std::vector<uint64_t> dataEnds;
+
+  for (const HostTransmission &transmission : hostTransmissions) {
+    NecReception reception = necDecode(transmission);
+
+    if (reception.isData == true) {
+      dataEnds.push_back(reception.dataEndMicros);
+    }
+  }
+
+  CHECK_EQUAL(RECOVERY_FRAMES_COUNT, dataEnds.size());
+
+  uint64_t lastMicros = hostTransmissions.back().endMicros + RECOVERY_COARSE_STEP_MICROSECONDS;
+
+  // Cut points (every 1ms, then densely around each data end)
+  std::vector<uint64_t> cuts;
+
+  for (uint64_t cutMicros = RECOVERY_UPDATE_MICROSECONDS; cutMicros <= lastMicros; cutMicros += RECOVERY_COARSE_STEP_MICROSECONDS) {
+    cuts.push_back(cutMicros);
+  }
+
+  for (uint64_t dataEndMicros : dataEnds) {
+    for (uint64_t cutMicros = dataEndMicros - RECOVERY_DENSE_SPAN_MICROSECONDS; cutMicros <= dataEndMicros + RECOVERY_DENSE_SPAN_MICROSECONDS; cutMicros += RECOVERY_DENSE_STEP_MICROSECONDS) {
+      cuts.push_back(cutMicros);
+    }
+  }
+
+  unsigned int mismatchesCount = 0,
+               unexpectedMismatchesCount = 0,
+               unconvergedCount = 0;
+
+  uint64_t windowMaximumMicros = 0;
+
+  for (uint64_t cutMicros : cuts) {
+    hostReset();
+
+    powerOn();
+
+    bootRunUntil(RECOVERY_UPDATE_MICROSECONDS);
+
+    bootUpdate(RECOVERY_TARGET_VALUES);
+
+    hostPowerCutMicros = cutMicros;
+
+    bootRunUntil(cutMicros);
+
+    // Notice: the AC unit only got what was on air before the IR LED went dark
+    simulator.receive(cutMicros);
+
+    reboot();
+
+    simulator.receive();
+
+    if (isSynchronized() == false) {
+      uint64_t sinceDataEndMicros = cutMicros - latestDataEndBefore(dataEnds, cutMicros);
+
+      mismatchesCount++;
+      windowMaximumMicros = max(windowMaximumMicros, sinceDataEndMicros);
+
+      if (sinceDataEndMicros > RECOVERY_WINDOW_MAXIMUM_MICROSECONDS) {
+        unexpectedMismatchesCount++;
+
+        if (unexpectedMismatchesCount <= 5) {
+          printf("     desync at cut %lluµs (%lluµs after a data end)\n", (unsigned long long)cutMicros, (unsigned long long)sinceDataEndMicros);
+        }
+      }
+
+      continue;
+    }
+
+    // Request again after the reboot (the plan resumes where it was cut)
+    bootRunUntil(hostMicros + RECOVERY_UPDATE_MICROSECONDS);
+
+    bootUpdate(RECOVERY_TARGET_VALUES);
+
+    bootRunUntil(hostMicros + 10000000);
+
+    simulator.receive();
+
+    if (isSynchronized() == false || simulator.values[3] != 27) {
+      unconvergedCount++;
+    }
+  }
+
+  printf("     %u cuts, %u desyncs, all within %lluµs of a data end\n", (unsigned int)cuts.size(), mismatchesCount, (unsigned long long)windowMaximumMicros);
+
+  CHECK_EQUAL(0, unexpectedMismatchesCount);
+  CHECK_EQUAL(0, unconvergedCount);
+}
+
+int main() {
+  RUN(testConvergesWithoutPowerCut);
+  RUN(testRecoversFromPowerCutAtAnyPoint);
+
+  return harnessReport("recovery");
+}
@@ -0,0 +1,192 @@
+// Host Tests
+//
+// Host-side tests for both projects (Linux, w/o an ESP32 board)
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#include "sensors.h"
+
+#include "harness.h"
+#include "tank.h"
+
+typedef SortingNetworks<unsigned int, WATER_LEVEL_PROBE_SAMPLES> NETWORKS;
+
+const unsigned int SAMPLING_PROBES = 500;
+const unsigned int SAMPLING_HISTORY_SIZE = 0x8000;
+
+// Notice: the true level sits in the middle of a reported step, thus a \
+//   probe is accurate when it reports that very step
+const float SAMPLING_LEVEL = 0.63;
+const unsigned int SAMPLING_LEVEL_PERCENT = 63;
+
+// Echo noise (standard deviation, in µs), where 1 permille of the tank is \
+//   1.63µs of echo
+const float SAMPLING_NOISES_MICROSECONDS[] = {0.0, 2.0, 5.0, 10.0, 20.0};
+
+struct SamplingResult {
+  float samplesPerProbe,
+        probeMillis,
+        accurateRatio;
+
+  unsigned int maximumErrorPercent;
+};
+
+static SimulatedTank tank;
+
+static WaterTankLevelSensor *bootSensor() {
+  hostFlashCreate(HISTORY_PARTITION_LABEL, SAMPLING_HISTORY_SIZE);
+
+  tank.~SimulatedTank();
+  new (&tank) SimulatedTank();
+
+  tank.begin(WATER_LEVEL_SENSOR_PIN_TRIGGER, WATER_LEVEL_SENSOR_PIN_ECHO);
+  tank.level = SAMPLING_LEVEL;
+
+  SpanCharacteristic *inUse = new Characteristic::InUse();
+  SpanCharacteristic *statusFault = new Characteristic::StatusFault(0);
+
+  return new WaterTankLevelSensor(statusFault, inUse);
+}
+
+static uint64_t runProbe(WaterTankLevelSensor *sensor) {
+  // Probe right away, then run the device task until the probe is done
+  sensor->scheduler.wake(sensor->taskProbe, 0);
+
+  uint64_t startMicros = hostMicros;
+
+  do {
+    sensor->runDevice();
+  } while (sensor->isSampling == true);
+
+  // Hand readings over to HK (as the HomeSpan task would)
+  sensor->loop();
+
+  return hostMicros - startMicros;
+}
+
+static unsigned int errorPercent(unsigned int levelPercent) {
+  return (levelPercent > SAMPLING_LEVEL_PERCENT) ? (levelPercent - SAMPLING_LEVEL_PERCENT) : (SAMPLING_LEVEL_PERCENT - levelPercent);
+}
+
+static SamplingResult runEarlyStop(float noiseMicros) {
+  WaterTankLevelSensor *sensor = bootSensor();
+
+  tank.noiseMicros = noiseMicros;
+
+  uint64_t probesMicros = 0;
+
+  unsigned int accurateCount = 0,
+               maximumErrorPercent = 0;
+
+  for (unsigned int i = 0; i < SAMPLING_PROBES; i++) {
+    probesMicros += runProbe(sensor);
+
+    unsigned int error = errorPercent(sensor->lastPollLevel);
+
+    accurateCount += (error == 0) ? 1 : 0;
+    maximumErrorPercent = max(maximumErrorPercent, error);
+  }
+
+  SamplingResult result;
+
+  result.samplesPerProbe = (float)sensor->probesSamplesCount / sensor->probesCount;
+  result.probeMillis = probesMicros / 1000.0 / SAMPLING_PROBES;
+  result.accurateRatio = (float)accurateCount / SAMPLING_PROBES;
+  result.maximumErrorPercent = maximumErrorPercent;
+
+  CHECK_EQUAL(SAMPLING_PROBES, sensor->probesCount);
+
+  return result;
+}
+
+static SamplingResult runFixed(float noiseMicros, WaterTankLevelSensor *sensor) {
+  // Former path: always acquire all samples, then take their median \
+  //   (drawn from the same tank, and converted by the sketch)
+  tank.noiseMicros = noiseMicros;
+
+  unsigned int accurateCount = 0,
+               maximumErrorPercent = 0;
+
+  for (unsigned int i = 0; i < SAMPLING_PROBES; i++) {
+    unsigned int values[WATER_LEVEL_PROBE_SAMPLES];
+
+    for (unsigned int j = 0; j < WATER_LEVEL_PROBE_SAMPLES; j++) {
+      values[j] = sensor->convertEchoToLevelPermille(tank.sampleEchoMicros());
+    }
+
+    unsigned int error = errorPercent((NETWORKS::median(values, WATER_LEVEL_PROBE_SAMPLES) + 5) / 10);
+
+    accurateCount += (error == 0) ? 1 : 0;
+    maximumErrorPercent = max(maximumErrorPercent, error);
+  }
+
+  SamplingResult result;
+
+  result.samplesPerProbe = WATER_LEVEL_PROBE_SAMPLES;
+  result.probeMillis = WATER_LEVEL_PROBE_SAMPLES * WATER_LEVEL_PROBE_DELAY;
+  result.accurateRatio = (float)accurateCount / SAMPLING_PROBES;
+  result.maximumErrorPercent = maximumErrorPercent;
+
+  return result;
+}
+
+TEST(testStopsAtMinimumOnQuietEcho) {
+  SamplingResult result = runEarlyStop(0.0);
+
+  // Notice: w/ no noise, all samples agree as soon as there are enough
+  CHECK(result.samplesPerProbe == WATER_LEVEL_PROBE_SAMPLES_MINIMUM);
+  CHECK(result.probeMillis < (WATER_LEVEL_PROBE_SAMPLES_MINIMUM + 1) * WATER_LEVEL_PROBE_DELAY);
+  CHECK(result.accurateRatio == 1.0);
+  CHECK_EQUAL(WATER_LEVEL_PROBE_SAMPLES_MINIMUM * SAMPLING_PROBES, tank.echoesCount);
+}
+
+TEST(testSamplesMoreAsEchoGetsNoisier) {
+  float lastSamplesPerProbe = 0.0;
+
+  for (float noiseMicros : SAMPLING_NOISES_MICROSECONDS) {
+    hostReset();
+
+    SamplingResult earlyStop = runEarlyStop(noiseMicros);
+    SamplingResult fixed = runFixed(noiseMicros, bootSensor());
+
+    printf("     noise %4.1fµs: early stop %.2f samples, %.1fms per probe, %.1f%% accurate (max error %u%%) | fixed %u samples, %.0fms per probe, %.1f%% accurate (max error %u%%)\n", noiseMicros, earlyStop.samplesPerProbe, earlyStop.probeMillis, earlyStop.accurateRatio * 100.0, earlyStop.maximumErrorPercent, WATER_LEVEL_PROBE_SAMPLES, fixed.probeMillis, fixed.accurateRatio * 100.0, fixed.maximumErrorPercent);
+
+    // Notice: more noise takes more samples to settle (up to the maximum)
+    CHECK(earlyStop.samplesPerProbe >= lastSamplesPerProbe);
+    CHECK(earlyStop.samplesPerProbe <= WATER_LEVEL_PROBE_SAMPLES);
+    CHECK(earlyStop.probeMillis <= fixed.probeMillis + WATER_LEVEL_PROBE_DELAY);
+
+    // Stopping early must not cost accuracy (beyond a step, at most)
+    CHECK(earlyStop.maximumErrorPercent <= fixed.maximumErrorPercent + 1);
+
+    lastSamplesPerProbe = earlyStop.samplesPerProbe;
+  }
+}
+
+TEST(testRetriesLostEchoes) {
+  WaterTankLevelSensor *sensor = bootSensor();
+
+  tank.noiseMicros = 2.0;
+  tank.dropoutRatio = 0.1;
+
+  for (unsigned int i = 0; i < SAMPLING_PROBES; i++) {
+    runProbe(sensor);
+  }
+
+  printf("     %u%% lost echoes: %u failed samples over %u probes (%.2f samples per probe, %u faults)\n", (unsigned int)(tank.dropoutRatio * 100), sensor->health.failuresCount, sensor->probesCount, (float)sensor->probesSamplesCount / sensor->probesCount, sensor->health.opensCount);
+
+  // Notice: a lost echo is a failed sample, which does not count towards \
+  //   the samples of a probe (though it takes an attempt), while too many \
+  //   lost echoes in a row end the probe w/ a fault
+  CHECK_EQUAL(tank.dropoutsCount, sensor->health.failuresCount);
+  CHECK_EQUAL(SAMPLING_PROBES, sensor->probesCount + sensor->health.opensCount);
+  CHECK_EQUAL(SAMPLING_LEVEL_PERCENT, sensor->lastPollLevel);
+}
+
+int main() {
+  RUN(testStopsAtMinimumOnQuietEcho);
+  RUN(testSamplesMoreAsEchoGetsNoisier);
+  RUN(testRetriesLostEchoes);
+
+  return harnessReport("sampling");
+}
@@ -0,0 +1,260 @@
+// Host Tests
+//
+// Host-side tests for both projects (Linux, w/o an ESP32 board)
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#include <chrono>
+#include <string>
+
+#include "services.h"
+
+#include "harness.h"
+
+const unsigned int SCHEDULER_BENCHMARK_PASSES = 10000000;
+
+struct Owner {
+  // Runs are logged as task names, in order
+  std::string runs;
+
+  unsigned long pollDelayMillis = 100,
+                pollRunMicros = 0,
+                smDelayMillis = 100;
+
+  unsigned long runPoll() {
+    runs += "p";
+
+    hostAdvanceMicros(pollRunMicros);
+
+    return pollDelayMillis;
+  }
+
+  unsigned long runSM() {
+    runs += "s";
+
+    return smDelayMillis;
+  }
+
+  unsigned long runOnce() {
+    runs += "o";
+
+    return SCHEDULER_DELAY_NEVER;
+  }
+};
+
+static Scheduler<Owner> taskScheduler;
+
+static Owner owner;
+
+static void beginScheduler() {
+  hostRenew(taskScheduler);
+  hostRenew(owner);
+
+  taskScheduler.begin();
+}
+
+static void runLoopUntil(uint64_t untilMicros) {
+  // Run due tasks, or idle until the next one is due (as the device task)
+  while (hostMicros < untilMicros) {
+    if (taskScheduler.run() == true) {
+      continue;
+    }
+
+    unsigned long idleMillis = taskScheduler.millisUntilNextDeadline();
+
+    hostAdvanceMicros(min((uint64_t)max(idleMillis, 1ul) * 1000, untilMicros - hostMicros));
+  }
+}
+
+TEST(testRunsMostUrgentTaskFirst) {
+  beginScheduler();
+
+  // Notice: poll is added first, and is due first, though SM is more urgent
+  taskScheduler.add("poll", 2, &owner, &Owner::runPoll, 10, 1000);
+  taskScheduler.add("sm", 1, &owner, &Owner::runSM, 20, 1000);
+
+  hostAdvanceMicros(30000);
+
+  CHECK(taskScheduler.run() == true);
+  CHECK(taskScheduler.run() == true);
+  CHECK(taskScheduler.run() == false);
+
+  CHECK(owner.runs == "sp");
+}
+
+TEST(testRunsEarliestDeadlineFirstOnEqualPriority) {
+  beginScheduler();
+
+  taskScheduler.add("sm", 1, &owner, &Owner::runSM, 20, 1000);
+  taskScheduler.add("poll", 1, &owner, &Owner::runPoll, 10, 1000);
+
+  hostAdvanceMicros(30000);
+
+  taskScheduler.run();
+  taskScheduler.run();
+
+  CHECK(owner.runs == "ps");
+}
+
+TEST(testSleepsDormantTasksUntilWoken) {
+  beginScheduler();
+
+  unsigned int once = taskScheduler.add("once", 1, &owner, &Owner::runOnce, 0, 1000);
+
+  CHECK(taskScheduler.run() == true);
+
+  // Notice: dormant tasks never run, and do not bound the idle time
+  CHECK_EQUAL(SCHEDULER_DELAY_NEVER, taskScheduler.millisUntilNextDeadline());
+
+  hostAdvanceMicros(1000000);
+
+  CHECK(taskScheduler.run() == false);
+
+  // Waking up again moves the deadline (debounce)
+  taskScheduler.wake(once, 50);
+  hostAdvanceMicros(40000);
+  taskScheduler.wake(once, 50);
+
+  CHECK_EQUAL(50, taskScheduler.millisUntilNextDeadline());
+
+  hostAdvanceMicros(40000);
+
+  CHECK(taskScheduler.run() == false);
+
+  hostAdvanceMicros(10000);
+
+  CHECK(taskScheduler.run() == true);
+  CHECK(owner.runs == "oo");
+}
+
+TEST(testAccountsForMissedDeadlines) {
+  beginScheduler();
+
+  // Poll holds the loop for 50ms, which makes SM late when both are due
+  owner.pollRunMicros = 50000;
+
+  taskScheduler.add("poll", 1, &owner, &Owner::runPoll, 10, 1000);
+  taskScheduler.add("sm", 2, &owner, &Owner::runSM, 10, 1000);
+
+  hostAdvanceMicros(10000);
+
+  taskScheduler.run();
+  taskScheduler.run();
+
+  CHECK_EQUAL(0, taskScheduler.tasks[0].deadlineMissesCount);
+  CHECK_EQUAL(1, taskScheduler.tasks[1].deadlineMissesCount);
+  CHECK_EQUAL(50, taskScheduler.tasks[1].maximumLatenessMillis);
+
+  // Notice: run time is measured from the high-resolution timer
+  CHECK_EQUAL(1, taskScheduler.tasks[0].budgetOverrunsCount);
+  CHECK_EQUAL(0, taskScheduler.tasks[1].budgetOverrunsCount);
+  CHECK_EQUAL(50000, taskScheduler.tasks[0].lastRunMicros);
+}
+
+TEST(testMeasuresSchedulingJitter) {
+  beginScheduler();
+
+  // Two periodic tasks, where poll takes 5ms to run (eg. a sensor read), \
+  //   w/ co-prime periods (so that deadlines fall at all phases of a poll)
+  owner.pollRunMicros = 5000;
+  owner.pollDelayMillis = 30;
+  owner.smDelayMillis = 7;
+
+  taskScheduler.add("poll", 2, &owner, &Owner::runPoll, 30, 10000);
+  taskScheduler.add("sm", 1, &owner, &Owner::runSM, 7, 10000);
+
+  runLoopUntil(60000000);
+
+  Scheduler<Owner>::Task &poll = taskScheduler.tasks[0],
+                         &sm = taskScheduler.tasks[1];
+
+  printf("     jitter over 60s: poll max %lums late (%u runs), sm max %lums late (%u runs)\n", poll.maximumLatenessMillis, poll.histogram.samplesCount, sm.maximumLatenessMillis, sm.histogram.samplesCount);
+
+  // Notice: a task is at most held back by a single run of another task \
+  //   (the loop never runs more than one task per pass)
+  CHECK(sm.maximumLatenessMillis > 0);
+  CHECK(sm.maximumLatenessMillis <= 5);
+  CHECK(poll.maximumLatenessMillis <= 5);
+  CHECK_EQUAL(0, sm.deadlineMissesCount);
+  CHECK_EQUAL(0, poll.deadlineMissesCount);
+
+  // Runs are relative to when the task was picked (no drift correction)
+  CHECK(sm.histogram.samplesCount >= 60000 / (7 + 5));
+  CHECK(poll.histogram.samplesCount >= 60000 / (30 + 5));
+}
+
+TEST(testRecordsHistogramsInAnyUnit) {
+  SchedulerHistogram histogram = {};
+
+  // Poll cadences, in µs (as recorded by the HomeSpan task)
+  const uint32_t samples[] = {0, 150, 180, 2000, 30000};
+
+  for (uint32_t sample : samples) {
+    histogram.record(sample);
+  }
+
+  CHECK_EQUAL(5, histogram.samplesCount);
+  CHECK_EQUAL(30000, histogram.maximum);
+  CHECK_EQUAL(32330, histogram.total);
+  CHECK_EQUAL(6466, histogram.mean());
+
+  // Notice: percentiles report the upper bound of their bucket, capped to \
+  //   the maximum (both in the unit recorded)
+  CHECK_EQUAL(255, histogram.percentile(50));
+  CHECK_EQUAL(30000, histogram.percentile(99));
+
+  histogram.printBuckets("µs");
+
+  CHECK(hostSerialOutput.find("[       128;        255] µs = 2") != std::string::npos);
+  CHECK(hostSerialOutput.find("[     16384;      32767] µs = 1") != std::string::npos);
+  CHECK(hostSerialOutput.find("cycles") == std::string::npos);
+}
+
+TEST(testPrintsTaskRunTimes) {
+  beginScheduler();
+
+  owner.pollRunMicros = 2000;
+
+  taskScheduler.add("poll", 1, &owner, &Owner::runPoll, 0, 1000);
+
+  taskScheduler.run();
+
+  taskScheduler.printStatistics();
+
+  CHECK_EQUAL(2000, taskScheduler.tasks[0].histogram.maximum);
+  CHECK(hostSerialOutput.find("max 2000µs") != std::string::npos);
+  CHECK(hostSerialOutput.find("cycles =") == std::string::npos);
+}
+
+TEST(testBenchmarksIdleLoopPasses) {
+  beginScheduler();
+
+  taskScheduler.add("sm", 1, &owner, &Owner::runSM, 1000, 1000);
+
+  unsigned int runsCount = 0;
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  for (unsigned int i = 0; i < SCHEDULER_BENCHMARK_PASSES; i++) {
+    runsCount += (taskScheduler.run() == true) ? 1 : 0;
+  }
+
+  double passNanos = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / SCHEDULER_BENCHMARK_PASSES;
+
+  printf("     idle loop pass (no task due): %.2fns (host, %u passes)\n", passNanos, SCHEDULER_BENCHMARK_PASSES);
+
+  CHECK_EQUAL(0, runsCount);
+}
+
+int main() {
+  RUN(testRunsMostUrgentTaskFirst);
+  RUN(testRunsEarliestDeadlineFirstOnEqualPriority);
+  RUN(testSleepsDormantTasksUntilWoken);
+  RUN(testAccountsForMissedDeadlines);
+  RUN(testMeasuresSchedulingJitter);
+  RUN(testRecordsHistogramsInAnyUnit);
+  RUN(testPrintsTaskRunTimes);
+  RUN(testBenchmarksIdleLoopPasses);
+
+  return harnessReport("scheduler");
+}
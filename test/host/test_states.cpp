@@ -0,0 +1,124 @@
+// Host Tests
+//
+// Host-side tests for both projects (Linux, w/o an ESP32 board)
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#include <chrono>
+
+#include "services.h"
+
+#include "harness.h"
+
+typedef AirConditionerRemote<AC_PROFILE> UNIT;
+
+const unsigned int STATES_BENCHMARK_STEPS = 10000000;
+
+// Notice: state lists as they were declared before lookup tables were \
+//   generated (the reference the tables must match)
+static const unsigned int REFERENCE_ACTIVE[] = {0, 1},
+                          REFERENCE_MODE[] = {1, 0, 2, 3, 4},
+                          REFERENCE_COOL[] = {18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32},
+                          REFERENCE_HEAT[] = {13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27},
+                          REFERENCE_SWING[] = {0, 1};
+
+static int referenceIndex(const unsigned int states[], unsigned int size, unsigned int value) {
+  // Linear scan (as the former findStateIndex())
+  for (unsigned int i = 0; i < size; i++) {
+    if (states[i] == value) {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+static unsigned int referenceProgress(const unsigned int states[], unsigned int size, unsigned int value, int increment, bool circle) {
+  // Linear scan, then step (as the former progressNextState(), w/ the \
+  //   index kept signed, as to clamp ranges at their first state)
+  int nextIndex = referenceIndex(states, size, value) + increment;
+
+  if (nextIndex >= (int)size) {
+    nextIndex = (circle == true) ? 0 : (size - 1);
+  } else if (nextIndex < 0) {
+    nextIndex = (circle == true) ? (size - 1) : 0;
+  }
+
+  return states[nextIndex];
+}
+
+template <typename STATES>
+static void checkMatchesReference(const unsigned int states[], unsigned int size, bool circle) {
+  CHECK_EQUAL(size, STATES::SIZE);
+
+  for (unsigned int i = 0; i < size; i++) {
+    CHECK_EQUAL(states[i], STATES::at(i));
+  }
+
+  // Notice: values past the tables are never looked up (checked at load)
+  for (unsigned int value = 0; value <= STATES::LAST + 2; value++) {
+    int index = referenceIndex(states, size, value);
+
+    CHECK((index >= 0) == STATES::contains(value));
+
+    if (index >= 0) {
+      CHECK_EQUAL(index, STATES::index(value));
+      CHECK_EQUAL(referenceProgress(states, size, value, 1, circle), STATES::progress(value, 1));
+      CHECK_EQUAL(referenceProgress(states, size, value, -1, circle), STATES::progress(value, -1));
+    }
+  }
+}
+
+TEST(testTablesMatchLinearScans) {
+  checkMatchesReference<STATES_DIRECTION_ACTIVE>(REFERENCE_ACTIVE, 2, true);
+  checkMatchesReference<UNIT::STATES_DIRECTION_TARGET_HEATER_COOLER_STATE>(REFERENCE_MODE, 5, true);
+  checkMatchesReference<UNIT::STATES_COOLING_THRESHOLD_TEMPERATURE>(REFERENCE_COOL, 15, false);
+  checkMatchesReference<UNIT::STATES_HEATING_THRESHOLD_TEMPERATURE>(REFERENCE_HEAT, 15, false);
+  checkMatchesReference<STATES_SWING_MODE>(REFERENCE_SWING, 2, true);
+}
+
+TEST(testRangesClampAtBounds) {
+  // Notice: the former scan wrapped a decremented minimum to the maximum
+  CHECK_EQUAL(UNIT::CODEBOOK::RANGE_TEMPERATURE_COOL_MINIMUM, UNIT::STATES_COOLING_THRESHOLD_TEMPERATURE::progress(UNIT::CODEBOOK::RANGE_TEMPERATURE_COOL_MINIMUM, -1));
+  CHECK_EQUAL(UNIT::CODEBOOK::RANGE_TEMPERATURE_COOL_MAXIMUM, UNIT::STATES_COOLING_THRESHOLD_TEMPERATURE::progress(UNIT::CODEBOOK::RANGE_TEMPERATURE_COOL_MAXIMUM, 1));
+  CHECK_EQUAL(UNIT::CODEBOOK::RANGE_TEMPERATURE_HEAT_MINIMUM, UNIT::STATES_HEATING_THRESHOLD_TEMPERATURE::progress(UNIT::CODEBOOK::RANGE_TEMPERATURE_HEAT_MINIMUM, -1));
+  CHECK_EQUAL(UNIT::CODEBOOK::RANGE_TEMPERATURE_HEAT_MAXIMUM, UNIT::STATES_HEATING_THRESHOLD_TEMPERATURE::progress(UNIT::CODEBOOK::RANGE_TEMPERATURE_HEAT_MAXIMUM, 1));
+}
+
+TEST(testBenchmarksTablesAgainstLinearScans) {
+  typedef UNIT::STATES_COOLING_THRESHOLD_TEMPERATURE STATES;
+
+  // Walk the cooling range up and down (each step depends on the previous \
+  //   one, so that steps cannot be hoisted out of the loop)
+  unsigned int referenceValue = STATES::FIRST,
+               tableValue = STATES::FIRST;
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  for (unsigned int i = 0; i < STATES_BENCHMARK_STEPS; i++) {
+    referenceValue = referenceProgress(REFERENCE_COOL, 15, referenceValue, ((i / 14) % 2 == 0) ? 1 : -1, false);
+  }
+
+  std::chrono::steady_clock::time_point middle = std::chrono::steady_clock::now();
+
+  for (unsigned int i = 0; i < STATES_BENCHMARK_STEPS; i++) {
+    tableValue = STATES::progress(tableValue, ((i / 14) % 2 == 0) ? 1 : -1);
+  }
+
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+  double referenceNanos = std::chrono::duration<double, std::nano>(middle - start).count() / STATES_BENCHMARK_STEPS,
+         tableNanos = std::chrono::duration<double, std::nano>(end - middle).count() / STATES_BENCHMARK_STEPS;
+
+  printf("     cooling range step: linear scan %.2fns, lookup table %.2fns (host, %u steps)\n", referenceNanos, tableNanos, STATES_BENCHMARK_STEPS);
+
+  CHECK_EQUAL(referenceValue, tableValue);
+}
+
+int main() {
+  RUN(testTablesMatchLinearScans);
+  RUN(testRangesClampAtBounds);
+  RUN(testBenchmarksTablesAgainstLinearScans);
+
+  return harnessReport("states");
+}
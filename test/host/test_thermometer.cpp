@@ -0,0 +1,191 @@
+// Host Tests
+//
+// Host-side tests for both projects (Linux, w/o an ESP32 board)
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#include <cmath>
+
+#include "services.h"
+
+#include "harness.h"
+
+// DHT timings, as timestamped by the RMT peripheral (1 tick = 1µs)
+const unsigned int THERMOMETER_RESPONSE_MICROSECONDS = 80;
+const unsigned int THERMOMETER_BIT_LOW_MICROSECONDS = 50;
+const unsigned int THERMOMETER_BIT_ZERO_MICROSECONDS = 27;
+const unsigned int THERMOMETER_BIT_ONE_MICROSECONDS = 70;
+const uint64_t THERMOMETER_FRAME_MICROSECONDS = 5000; // Response + 40 bits, roughly
+
+static Thermometer sensor;
+
+static rmt_item32_t itemOf(unsigned int lowMicros, unsigned int highMicros) {
+  rmt_item32_t item;
+
+  item.level0 = 0;
+  item.duration0 = lowMicros;
+  item.level1 = 1;
+  item.duration1 = highMicros;
+
+  return item;
+}
+
+static void queueFrame(const uint8_t data[], unsigned int bitsCount = DHT_BITS) {
+  // Response (low, then high), 1 item per data bit, then end of transmission
+  HostReception reception;
+
+  reception.durationMicros = THERMOMETER_FRAME_MICROSECONDS;
+  reception.items.push_back(itemOf(THERMOMETER_RESPONSE_MICROSECONDS, THERMOMETER_RESPONSE_MICROSECONDS));
+
+  for (unsigned int i = 0; i < bitsCount; i++) {
+    bool isOne = ((data[i / 8] >> (7 - (i % 8))) & 1) == 1;
+
+    reception.items.push_back(itemOf(THERMOMETER_BIT_LOW_MICROSECONDS, isOne ? THERMOMETER_BIT_ONE_MICROSECONDS : THERMOMETER_BIT_ZERO_MICROSECONDS));
+  }
+
+  reception.items.push_back(itemOf(THERMOMETER_BIT_LOW_MICROSECONDS, 0));
+
+  hostReceptions.push_back(reception);
+}
+
+static void queueReading(uint8_t integral, uint8_t decimal, bool isChecksumValid = true) {
+  uint8_t data[DHT_BITS / 8] = {55, 0, integral, decimal, 0};
+
+  data[4] = (data[0] + data[1] + data[2] + data[3] + (isChecksumValid ? 0 : 1)) & 0xFF;
+
+  queueFrame(data);
+}
+
+static void beginSensor(int type) {
+  hostRenew(sensor);
+
+  CHECK(sensor.begin(SENSOR_TEMPERATURE_PIN, type, POLL_EVERY_MILLISECONDS) == true);
+}
+
+TEST(testDecodesDHT11Frames) {
+  beginSensor(DHT_TYPE_DHT11);
+
+  ThermometerReading reading;
+
+  CHECK(sensor.read(reading) == false);
+
+  queueReading(23, 4);
+
+  sensor.capture();
+
+  CHECK(sensor.read(reading) == true);
+  CHECK(fabsf(reading.temperature - 23.4) < 0.01);
+  CHECK_EQUAL(DHT_START_LOW_MILLISECONDS * 1000 + THERMOMETER_FRAME_MICROSECONDS, reading.durationMicros);
+  CHECK_EQUAL(1, sensor.capturesCount.load());
+
+  // Negative temperatures carry a sign bit in the decimal byte
+  queueReading(2, 0x80 | 5);
+
+  sensor.capture();
+
+  CHECK(sensor.read(reading) == true);
+  CHECK(fabsf(reading.temperature + 2.5) < 0.01);
+}
+
+TEST(testDecodesDHT22Frames) {
+  beginSensor(DHT_TYPE_DHT22);
+
+  ThermometerReading reading;
+
+  // 0x00EB = 235 (ie. 23.5°C), then w/ the sign bit (ie. -10.1°C)
+  queueReading(0x00, 0xEB);
+  queueReading(0x80, 0x65);
+
+  sensor.capture();
+
+  CHECK(sensor.read(reading) == true);
+  CHECK(fabsf(reading.temperature - 23.5) < 0.01);
+
+  sensor.capture();
+
+  CHECK(sensor.read(reading) == true);
+  CHECK(fabsf(reading.temperature + 10.1) < 0.01);
+}
+
+TEST(testCountsChecksumFailures) {
+  beginSensor(DHT_TYPE_DHT11);
+
+  ThermometerReading reading;
+
+  queueReading(21, 0);
+
+  sensor.capture();
+
+  // Notice: a bad frame keeps the latest reading (not overwritten)
+  queueReading(40, 0, false);
+
+  sensor.capture();
+
+  CHECK(sensor.read(reading) == true);
+  CHECK(fabsf(reading.temperature - 21.0) < 0.01);
+
+  // A frame that got cut (fewer edges than bits) is a failure as well
+  uint8_t data[DHT_BITS / 8] = {55, 0, 30, 0, 85};
+
+  queueFrame(data, DHT_BITS / 2);
+
+  sensor.capture();
+
+  CHECK(sensor.read(reading) == true);
+  CHECK(fabsf(reading.temperature - 21.0) < 0.01);
+  CHECK_EQUAL(3, sensor.capturesCount.load());
+  CHECK_EQUAL(2, sensor.checksumFailuresCount.load());
+  CHECK_EQUAL(0, sensor.timeoutsCount.load());
+}
+
+TEST(testCountsTimeouts) {
+  beginSensor(DHT_TYPE_DHT11);
+
+  ThermometerReading reading;
+
+  // Nothing queued (ie. the sensor is not plugged)
+  sensor.capture();
+
+  CHECK(sensor.read(reading) == false);
+  CHECK_EQUAL(1, sensor.capturesCount.load());
+  CHECK_EQUAL(1, sensor.timeoutsCount.load());
+  CHECK_EQUAL(0, sensor.checksumFailuresCount.load());
+
+  // A response that comes too late is a timeout as well
+  queueReading(21, 0);
+
+  hostReceptions.back().durationMicros = (DHT_RESPONSE_TIMEOUT_MILLISECONDS + 1) * 1000;
+
+  sensor.capture();
+
+  CHECK(sensor.read(reading) == false);
+  CHECK_EQUAL(2, sensor.timeoutsCount.load());
+}
+
+TEST(testCountsLoopTimeSavedOnAllCaptures) {
+  beginSensor(DHT_TYPE_DHT11);
+
+  // 1 reading (25ms), 1 checksum failure (25ms) and 1 timeout (40ms)
+  queueReading(21, 0);
+  queueReading(21, 0, false);
+
+  sensor.capture();
+  sensor.capture();
+  sensor.capture();
+
+  unsigned int expectedMillis = 2 * (DHT_START_LOW_MILLISECONDS + THERMOMETER_FRAME_MICROSECONDS / 1000) + DHT_START_LOW_MILLISECONDS + DHT_RESPONSE_TIMEOUT_MILLISECONDS;
+
+  printf("     loop time saved over 3 captures (1 failure, 1 timeout): %ums\n", sensor.capturesMillis.load());
+
+  CHECK_EQUAL(expectedMillis, sensor.capturesMillis.load());
+}
+
+int main() {
+  RUN(testDecodesDHT11Frames);
+  RUN(testDecodesDHT22Frames);
+  RUN(testCountsChecksumFailures);
+  RUN(testCountsTimeouts);
+  RUN(testCountsLoopTimeSavedOnAllCaptures);
+
+  return harnessReport("thermometer");
+}
@@ -0,0 +1,224 @@
+// Host Tests
+//
+// Host-side tests for both projects (Linux, w/o an ESP32 board)
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#include <chrono>
+
+#include "services.h"
+
+#include "boot.h"
+#include "harness.h"
+#include "tracedump.h"
+
+const unsigned int TRACE_BENCHMARK_EVENTS = 1000000;
+
+static Trace events;
+
+static void beginTrace() {
+  hostRenew(events);
+
+  events.begin(TRACE_EVENT_FORMATS, TRACE_EVENTS_COUNT);
+}
+
+TEST(testDecodesRecords) {
+  beginTrace();
+
+  // Notice: calibration records do not show in dumps
+  CHECK_EQUAL(0, events.recordsCount.load());
+
+  hostAdvanceMicros(1500);
+  events.record(TRACE_EVENT_EMIT_COMMAND, 0x6B, 1);
+  hostAdvanceMicros(250);
+  events.record(TRACE_EVENT_SM_PLANNED, 3, 390);
+  events.record(TRACE_EVENTS_COUNT + 7, 1, 2);
+
+  events.print();
+
+  CHECK(hostSerialOutput.find("  [     1.500ms] (emit) Command 0x6B (value=1)\n") != std::string::npos);
+  CHECK(hostSerialOutput.find("  [     1.750ms] (sm) Planned 3 IR commands, ETA 390ms\n") != std::string::npos);
+  CHECK(hostSerialOutput.find("Unknown event #13 (1, 2)\n") != std::string::npos);
+  CHECK(hostSerialOutput.find("3 events recorded (3 in buffer, 0 skipped)") != std::string::npos);
+}
+
+TEST(testSkipsRecordsBeingWritten) {
+  beginTrace();
+
+  events.record(TRACE_EVENT_POLL, 21, 50);
+  events.record(TRACE_EVENT_POLL, 22, 0);
+
+  // A task was preempted while writing the second record
+  events.records[1].sequence = 0;
+
+  events.print();
+
+  CHECK(hostSerialOutput.find("Current temperature: 21.50°C") != std::string::npos);
+  CHECK(hostSerialOutput.find("Current temperature: 22.00°C") == std::string::npos);
+  CHECK(hostSerialOutput.find("2 events recorded (1 in buffer, 1 skipped)") != std::string::npos);
+}
+
+TEST(testKeepsLatestRecordsOnWrap) {
+  beginTrace();
+
+  for (unsigned int i = 0; i < TRACE_CAPACITY + 44; i++) {
+    events.record(TRACE_EVENT_EMIT_COMMAND, i, 0);
+  }
+
+  events.print();
+
+  // Notice: the oldest 44 records got overwritten
+  CHECK(hostSerialOutput.find("(emit) Command 0x2B (value=0)") == std::string::npos);
+  CHECK(hostSerialOutput.find("(emit) Command 0x2C (value=0)") != std::string::npos);
+  CHECK(hostSerialOutput.find("300 events recorded (256 in buffer, 0 skipped)") != std::string::npos);
+}
+
+TEST(testPrintsRecordCost) {
+  hostFlashCreate(JOURNAL_PARTITION_LABEL, JOURNAL_REGION_SIZE);
+
+  bootSketch();
+
+  CHECK(hostRunCommand("t") == true);
+
+  // Notice: the host cycle counter follows virtual time, thus it only \
+  //   measures on a board (costs read 0 cycles here)
+  CHECK(hostSerialOutput.find("Record cost: ") != std::string::npos);
+  CHECK(trace.formatBytes > 0);
+}
+
+TEST(testBenchmarksRecordAgainstLog) {
+  beginTrace();
+
+  homeSpan.setLogLevel(1);
+
+  char line[TRACE_LINE_SIZE_MAXIMUM];
+
+  unsigned long bytesCount = 0;
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  for (unsigned int i = 0; i < TRACE_BENCHMARK_EVENTS; i++) {
+    events.record(TRACE_EVENT_EMIT_COMMAND, i, i);
+  }
+
+  std::chrono::steady_clock::time_point recorded = std::chrono::steady_clock::now();
+
+  for (unsigned int i = 0; i < TRACE_BENCHMARK_EVENTS; i++) {
+    bytesCount += snprintf(line, sizeof(line), TRACE_EVENT_FORMATS[TRACE_EVENT_EMIT_COMMAND], i, i);
+  }
+
+  std::chrono::steady_clock::time_point formatted = std::chrono::steady_clock::now();
+
+  // Former path (formatted log line, to the serial console)
+  for (unsigned int i = 0; i < TRACE_BENCHMARK_EVENTS; i++) {
+    LOG1("[Service:AirConditionerRemote] (emit) Command 0x%02X (value=%u)\n", i, i);
+  }
+
+  std::chrono::steady_clock::time_point logged = std::chrono::steady_clock::now();
+
+  double recordNanos = std::chrono::duration<double, std::nano>(recorded - start).count() / TRACE_BENCHMARK_EVENTS,
+         formatNanos = std::chrono::duration<double, std::nano>(formatted - recorded).count() / TRACE_BENCHMARK_EVENTS,
+         logNanos = std::chrono::duration<double, std::nano>(logged - formatted).count() / TRACE_BENCHMARK_EVENTS;
+
+  unsigned int lineBytes = bytesCount / TRACE_BENCHMARK_EVENTS + strlen("[Service:AirConditionerRemote] \n");
+
+  printf("     per event: trace record %.2fns, snprintf %.2fns, LOG1 %.2fns (host, w/o UART), %u-byte log line = %luµs on the UART at %lu bauds\n", recordNanos, formatNanos, logNanos, lineBytes, lineBytes * 10 * 1000000ul / TRACE_UART_BAUDS, TRACE_UART_BAUDS);
+
+  CHECK(recordNanos < formatNanos);
+  CHECK_EQUAL(TRACE_BENCHMARK_EVENTS, events.recordsCount.load());
+}
+
+static std::string printedBody() {
+  // Notice: what the decoder prints, from the first record on
+  size_t start = hostSerialOutput.find("*** Trace ***\n\n");
+
+  if (start == std::string::npos) {
+    return "";
+  }
+
+  return hostSerialOutput.substr(start + strlen("*** Trace ***\n\n"));
+}
+
+TEST(testDecodesDumps) {
+  beginTrace();
+
+  for (unsigned int i = 0; i < TRACE_CAPACITY + 44; i++) {
+    hostAdvanceMicros(1000);
+
+    events.record(i % (TRACE_EVENTS_COUNT + 1), i, i * 3);
+  }
+
+  // A task was preempted while writing a record
+  events.records[7].sequence = 0;
+
+  events.print();
+
+  std::string printed = printedBody();
+
+  hostSerialOutput.clear();
+
+  events.dump();
+
+  std::string dumped = hostSerialOutput;
+
+  TraceDump dump = traceDecode(dumped);
+
+  CHECK(dump.isValid == true);
+  CHECK_EQUAL(TRACE_CAPACITY + 44, dump.header.recordsCount);
+  CHECK_EQUAL(TRACE_CAPACITY - 1, dump.records.size());
+  CHECK_EQUAL(1, dump.skippedCount);
+  CHECK_EQUAL(events.formatBytes, dump.header.formatBytes);
+
+  // Notice: decoded as the device would have printed it
+  CHECK(traceFormat(dump, TRACE_EVENT_FORMATS, TRACE_EVENTS_COUNT) == printed);
+
+  // A cut dump (eg. the console was closed) cannot be decoded
+  CHECK(traceDecode(dumped.substr(0, dumped.size() / 2)).isValid == false);
+  CHECK(traceDecode("").isValid == false);
+
+  printf("     dump: %u slots in %u bytes of text (vs %u bytes printed)\n", TRACE_CAPACITY, (unsigned int)dumped.size(), (unsigned int)printed.size());
+}
+
+TEST(testDecodesDumpsFromConsole) {
+  hostFlashCreate(JOURNAL_PARTITION_LABEL, JOURNAL_REGION_SIZE);
+
+  bootSketch();
+  bootRunUntil(1000000);
+
+  // Record real events (an update, its plan and IR commands)
+  uint8_t targetValues[STORAGE_SIZE];
+
+  bootUnit->snapshotStateMachineValues(targetValues);
+
+  targetValues[STORAGE_INDEX_SM_ACTIVE] = ACTIVE_ACTIVE;
+  targetValues[STORAGE_INDEX_SM_TARGET_HEATER_COOLER_STATE] = TARGET_HEATER_COOLER_STATE_COOL;
+
+  CHECK(bootUpdate(targetValues) == true);
+
+  bootRunUntil(30000000);
+
+  CHECK(hostRunCommand("t") == true);
+
+  std::string printed = printedBody();
+
+  CHECK(hostRunCommand("d") == true);
+
+  TraceDump dump = traceDecode(hostSerialOutput);
+
+  CHECK(dump.isValid == true);
+  CHECK(dump.records.size() > 0);
+  CHECK(traceFormat(dump, TRACE_EVENT_FORMATS, TRACE_EVENTS_COUNT) == printed);
+  CHECK(printed.find("(sm) Planned ") != std::string::npos);
+}
+
+int main() {
+  RUN(testDecodesRecords);
+  RUN(testSkipsRecordsBeingWritten);
+  RUN(testKeepsLatestRecordsOnWrap);
+  RUN(testPrintsRecordCost);
+  RUN(testDecodesDumps);
+  RUN(testDecodesDumpsFromConsole);
+  RUN(testBenchmarksRecordAgainstLog);
+
+  return harnessReport("trace");
+}
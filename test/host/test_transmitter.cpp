@@ -0,0 +1,303 @@
+// Host Tests
+//
+// Host-side tests for both projects (Linux, w/o an ESP32 board)
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#include "services.h"
+
+#include "harness.h"
+#include "nec.h"
+
+const int TEST_PIN_FIRST = 17,
+          TEST_PIN_SECOND = 18;
+
+static InfraRedTransmitter transmitter;
+
+static void tickFor(unsigned long durationMillis) {
+  // Tick the transmitter every millisecond (as the device task would)
+  for (unsigned long i = 0; i < durationMillis; i++) {
+    transmitter.tick();
+
+    hostAdvanceMicros(1000);
+  }
+}
+
+static std::vector<HostTransmission> dataTransmissions() {
+  // Notice: each frame is clocked out as a data part, then a repeat part
+  std::vector<HostTransmission> transmissions;
+
+  for (const HostTransmission &transmission : hostTransmissions) {
+    if (necDecode(transmission).isData == true) {
+      transmissions.push_back(transmission);
+    }
+  }
+
+  return transmissions;
+}
+
+static void beginTransmitter() {
+  hostRenew(transmitter);
+
+  transmitter.begin(IR_FRAME_GAP_MILLISECONDS);
+  transmitter.addChannel(TEST_PIN_FIRST);
+}
+
+TEST(testEncodesDecodableFrames) {
+  beginTransmitter();
+
+  transmitter.enqueueNEC(0, 0x10, 0xA5);
+
+  tickFor(1000);
+
+  CHECK_EQUAL(2, hostTransmissions.size());
+
+  NecReception reception = necDecode(hostTransmissions[0]);
+
+  CHECK(reception.isData == true);
+  CHECK_EQUAL(0x10, reception.address);
+  CHECK_EQUAL(0xA5, reception.command);
+
+  // Notice: the data part ends w/ its stop mark
+  CHECK_EQUAL(hostTransmissions[0].endMicros, reception.dataEndMicros);
+
+  // Repeat part starts once the repeat period elapsed (ticked every ms)
+  CHECK(necDecode(hostTransmissions[1]).isRepeat == true);
+  CHECK(hostTransmissions[1].startMicros >= hostTransmissions[0].startMicros + NEC_REPEAT_PERIOD_MICROSECONDS);
+  CHECK(hostTransmissions[1].startMicros <= hostTransmissions[0].startMicros + NEC_REPEAT_PERIOD_MICROSECONDS + 1000);
+}
+
+TEST(testSendsFramesInOrderWithoutOverlap) {
+  beginTransmitter();
+
+  for (unsigned int i = 0; i < 10; i++) {
+    CHECK(transmitter.enqueueNEC(0, 0x10, i) == true);
+  }
+
+  tickFor(5000);
+
+  CHECK_EQUAL(2 * 10, hostTransmissions.size());
+  CHECK_EQUAL(10, transmitter.framesSent);
+  CHECK_EQUAL(0, hostTransmissionOverlaps);
+
+  for (unsigned int i = 0; i < hostTransmissions.size(); i += 2) {
+    CHECK_EQUAL(i / 2, necDecode(hostTransmissions[i]).command);
+    CHECK(necDecode(hostTransmissions[i + 1]).isRepeat == true);
+
+    if (i > 0) {
+      // Notice: the gap is silence (ie. timed from the end of a frame)
+      CHECK(hostTransmissions[i].startMicros >= hostTransmissions[i - 1].endMicros + (uint64_t)IR_FRAME_GAP_MILLISECONDS * 1000);
+      CHECK(hostTransmissions[i].startMicros <= hostTransmissions[i - 1].endMicros + (uint64_t)(IR_FRAME_GAP_MILLISECONDS + 2) * 1000);
+    }
+  }
+}
+
+TEST(testDropsFramesWhenFull) {
+  beginTransmitter();
+
+  for (unsigned int i = 0; i < IR_QUEUE_CAPACITY; i++) {
+    CHECK(transmitter.enqueueNEC(0, 0x10, i) == true);
+  }
+
+  CHECK(transmitter.enqueueNEC(0, 0x10, 0xFF) == false);
+  CHECK_EQUAL(1, transmitter.framesDropped);
+  CHECK_EQUAL(0, transmitter.available());
+
+  tickFor(IR_QUEUE_CAPACITY * 1000);
+
+  CHECK_EQUAL(IR_QUEUE_CAPACITY, dataTransmissions().size());
+  CHECK_EQUAL(IR_QUEUE_CAPACITY, transmitter.available());
+}
+
+TEST(testRoutesFramesToTheirChannel) {
+  beginTransmitter();
+
+  unsigned int secondChannel = transmitter.addChannel(TEST_PIN_SECOND);
+
+  transmitter.enqueueNEC(0, 0x10, 0x01);
+  transmitter.enqueueNEC(secondChannel, 0x10, 0x02);
+  transmitter.enqueueNEC(0, 0x10, 0x03);
+
+  tickFor(2000);
+
+  std::vector<HostTransmission> transmissions = dataTransmissions();
+
+  CHECK_EQUAL(3, transmissions.size());
+  CHECK_EQUAL(TEST_PIN_FIRST, transmissions[0].pin);
+  CHECK_EQUAL(TEST_PIN_SECOND, transmissions[1].pin);
+  CHECK_EQUAL(TEST_PIN_FIRST, transmissions[2].pin);
+
+  // Notice: the repeat part goes to the same IR LED as its data part
+  for (unsigned int i = 0; i < hostTransmissions.size(); i += 2) {
+    CHECK_EQUAL(hostTransmissions[i].pin, hostTransmissions[i + 1].pin);
+  }
+
+  CHECK_EQUAL(2, transmitter.channels[0].framesSent);
+  CHECK_EQUAL(1, transmitter.channels[secondChannel].framesSent);
+
+  // Notice: the detached IR LED is held off
+  CHECK_EQUAL(LOW, digitalRead(TEST_PIN_SECOND));
+}
+
+TEST(testHoldsPowerLockWhileQueued) {
+  beginTransmitter();
+
+  CHECK_EQUAL(0, hostPowerLocksHeld);
+
+  transmitter.enqueueNEC(0, 0x10, 0x01);
+  transmitter.enqueueNEC(0, 0x10, 0x02);
+
+  CHECK_EQUAL(1, hostPowerLocksHeld);
+
+  tickFor(2000);
+
+  CHECK_EQUAL(0, hostPowerLocksHeld);
+  CHECK_EQUAL(1, transmitter.powerLock.acquiresCount);
+}
+
+TEST(testMeasuresEnqueueLatency) {
+  beginTransmitter();
+
+  // Notice: past boot, as the first frame waits for a frame period of uptime
+  hostAdvanceMicros(1000000);
+
+  transmitter.enqueueNEC(0, 0x10, 0x01);
+  transmitter.enqueueNEC(0, 0x10, 0x02);
+
+  tickFor(2000);
+
+  // Notice: the second frame waited for the first one (on air, then gap)
+  CHECK(transmitter.maximumLatencyMicros >= NEC_FRAME_MICROSECONDS + (unsigned long)IR_FRAME_GAP_MILLISECONDS * 1000);
+  CHECK(transmitter.maximumLatencyMicros <= (unsigned long)(IR_FRAME_EVERY_MILLISECONDS + 2) * 1000);
+}
+
+TEST(testTellsWhenToTickNext) {
+  beginTransmitter();
+
+  hostAdvanceMicros(1000000);
+
+  CHECK_EQUAL(IR_DELAY_NEVER, transmitter.millisUntilNextTick());
+
+  for (unsigned int i = 0; i < 10; i++) {
+    transmitter.enqueueNEC(0, 0x10, i);
+  }
+
+  // Tick only when told to (as the device task idles in between)
+  unsigned int ticksCount = 0;
+
+  while (transmitter.available() < IR_QUEUE_CAPACITY) {
+    transmitter.tick();
+
+    ticksCount++;
+
+    hostAdvanceMicros((uint64_t)max(transmitter.millisUntilNextTick(), 1ul) * 1000);
+  }
+
+  CHECK_EQUAL(2 * 10, hostTransmissions.size());
+  CHECK_EQUAL(0, hostTransmissionOverlaps);
+
+  // Notice: about 4 ticks per frame (start, data end, repeat, end), \
+  //   instead of 1 per millisecond on air or in the gap
+  CHECK(ticksCount <= 10 * 6);
+
+  // Repeat parts start on time, even when not ticked every millisecond
+  for (unsigned int i = 0; i < hostTransmissions.size(); i += 2) {
+    CHECK(hostTransmissions[i + 1].startMicros >= hostTransmissions[i].startMicros + NEC_REPEAT_PERIOD_MICROSECONDS);
+    CHECK(hostTransmissions[i + 1].startMicros <= hostTransmissions[i].startMicros + NEC_REPEAT_PERIOD_MICROSECONDS + 1000);
+  }
+
+  for (unsigned int i = 2; i < hostTransmissions.size(); i += 2) {
+    CHECK(hostTransmissions[i].startMicros >= hostTransmissions[i - 1].endMicros + (uint64_t)IR_FRAME_GAP_MILLISECONDS * 1000);
+    CHECK(hostTransmissions[i].startMicros <= hostTransmissions[i - 1].endMicros + (uint64_t)(IR_FRAME_GAP_MILLISECONDS + 2) * 1000);
+  }
+}
+
+TEST(testHoldsUnarmedFrames) {
+  beginTransmitter();
+
+  hostAdvanceMicros(1000000);
+
+  transmitter.enqueueNEC(0, 0x10, 0x01, false);
+
+  tickFor(1000);
+
+  // Notice: an unarmed frame never goes on air (and needs no tick)
+  CHECK_EQUAL(0, hostTransmissions.size());
+  CHECK(transmitter.isAwaitingArm(0) == true);
+  CHECK(transmitter.isAwaitingArm(1) == false);
+  CHECK_EQUAL(IR_DELAY_NEVER, transmitter.millisUntilNextTick());
+
+  transmitter.arm();
+
+  CHECK(transmitter.isAwaitingArm(0) == false);
+  CHECK_EQUAL(0, transmitter.millisUntilNextTick());
+
+  tickFor(1000);
+
+  CHECK_EQUAL(1, dataTransmissions().size());
+  CHECK_EQUAL(1, transmitter.framesSent);
+}
+
+TEST(testCountsFramesSentOnceDataIsSent) {
+  beginTransmitter();
+
+  hostAdvanceMicros(1000000);
+
+  transmitter.enqueueNEC(0, 0x10, 0x01);
+  transmitter.tick();
+
+  CHECK_EQUAL(1, hostTransmissions.size());
+
+  uint64_t dataEndMicros = necDecode(hostTransmissions[0]).dataEndMicros;
+
+  // Tick until the channel accounts for the frame
+  while (transmitter.channels[0].framesSent == 0) {
+    hostAdvanceMicros(1000);
+
+    transmitter.tick();
+  }
+
+  // Notice: the AC unit has the command, while the repeat is not on air yet
+  CHECK(hostMicros >= dataEndMicros);
+  CHECK(hostMicros < dataEndMicros + 1000);
+  CHECK_EQUAL(1, hostTransmissions.size());
+  CHECK_EQUAL(0, transmitter.framesSent);
+}
+
+TEST(testKeepsGapWhenTickedOften) {
+  beginTransmitter();
+
+  for (unsigned int i = 0; i < 3; i++) {
+    transmitter.enqueueNEC(0, 0x10, i);
+  }
+
+  // Notice: a loop that is not idle ticks at any point in a millisecond \
+  //   (the frame end must not get truncated to the millisecond)
+  for (unsigned long i = 0; i < 10000; i++) {
+    transmitter.tick();
+
+    hostAdvanceMicros(100);
+  }
+
+  CHECK_EQUAL(2 * 3, hostTransmissions.size());
+
+  for (unsigned int i = 2; i < hostTransmissions.size(); i += 2) {
+    CHECK(hostTransmissions[i].startMicros >= hostTransmissions[i - 1].endMicros + (uint64_t)IR_FRAME_GAP_MILLISECONDS * 1000);
+    CHECK(hostTransmissions[i].startMicros <= hostTransmissions[i - 1].endMicros + (uint64_t)IR_FRAME_GAP_MILLISECONDS * 1000 + 200);
+  }
+}
+
+int main() {
+  RUN(testEncodesDecodableFrames);
+  RUN(testSendsFramesInOrderWithoutOverlap);
+  RUN(testDropsFramesWhenFull);
+  RUN(testRoutesFramesToTheirChannel);
+  RUN(testHoldsPowerLockWhileQueued);
+  RUN(testMeasuresEnqueueLatency);
+  RUN(testTellsWhenToTickNext);
+  RUN(testKeepsGapWhenTickedOften);
+  RUN(testHoldsUnarmedFrames);
+  RUN(testCountsFramesSentOnceDataIsSent);
+
+  return harnessReport("transmitter");
+}
@@ -0,0 +1,42 @@
+// Host Tests
+//
+// Host-side tests for both projects (Linux, w/o an ESP32 board)
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#include <iostream>
+#include <iterator>
+
+#ifdef TRACE_DECODE_SPRINKLER
+#include "sensors.h"
+#else
+#include "services.h"
+#endif
+
+#include "tracedump.h"
+
+/**
+  [Trace Decoder]
+
+    - Reads a serial console capture that holds a trace dump (typed '@d')
+      from the standard input, and prints its events w/ the event formats
+      of the sketch it was built for (tracedecode_ac, tracedecode_sprinkler)
+
+    - Usage: ./build/tracedecode_ac < console.log
+**/
+
+int main() {
+  std::string text((std::istreambuf_iterator<char>(std::cin)), std::istreambuf_iterator<char>());
+
+  TraceDump dump = traceDecode(text);
+
+  if (dump.isValid == false) {
+    fprintf(stderr, "No trace dump found (or dump is cut)\n");
+
+    return 1;
+  }
+
+  fputs(traceFormat(dump, TRACE_EVENT_FORMATS, TRACE_EVENTS_COUNT).c_str(), stdout);
+
+  return 0;
+}
@@ -0,0 +1,149 @@
+// Host Tests
+//
+// Host-side tests for both projects (Linux, w/o an ESP32 board)
+// Copyright: 2022, Valerian Saliou <valerian@valeriansaliou.name>
+// License: Mozilla Public License v2.0 (MPL v2.0)
+
+#pragma once
+
+#include <algorithm>
+#include <sstream>
+
+#include "host.h"
+
+struct TraceDump {
+  bool isValid = false;
+
+  TraceDumpHeader header = {};
+
+  // Records ordered by sequence number (oldest first)
+  std::vector<TraceRecord> records;
+
+  unsigned int skippedCount = 0;
+};
+
+inline bool traceDecodeHex(const std::string &hex, void *bytes, size_t size) {
+  uint8_t *data = (uint8_t *)bytes;
+
+  if (hex.size() < size * 2) {
+    return false;
+  }
+
+  for (size_t i = 0; i < size; i++) {
+    const char *digitHigh = strchr(TRACE_DUMP_DIGITS, hex[i * 2]),
+               *digitLow = strchr(TRACE_DUMP_DIGITS, hex[i * 2 + 1]);
+
+    if (hex[i * 2] == '\0' || hex[i * 2 + 1] == '\0' || digitHigh == NULL || digitLow == NULL) {
+      return false;
+    }
+
+    data[i] = ((digitHigh - TRACE_DUMP_DIGITS) << 4) | (digitLow - TRACE_DUMP_DIGITS);
+  }
+
+  return true;
+}
+
+inline TraceDump traceDecode(const std::string &text) {
+  /**
+    [Trace Dump Decoder]
+
+      - Decodes the latest trace dump found in a serial console capture
+        (ie. the output of '@d'), as dumped by Trace::dump() from a device
+        of the same endianness (the ESP32 and x86 hosts are little-endian)
+
+      - Slots only hold a record if their sequence number falls within the
+        last ring of events, other slots were being written, or are leftovers
+        from a former ring (and get skipped, as the device would)
+  **/
+
+  TraceDump dump;
+
+  size_t start = text.rfind("*** Trace Dump ***");
+
+  if (start == std::string::npos) {
+    return dump;
+  }
+
+  std::istringstream lines(text.substr(start));
+  std::string line;
+
+  std::vector<TraceRecord> slots;
+
+  bool hasHeader = false;
+
+  while (std::getline(lines, line)) {
+    if (line.size() < 2 || line[1] != ':') {
+      continue;
+    }
+
+    if (line[0] == 'H') {
+      hasHeader = traceDecodeHex(line.substr(2), &dump.header, sizeof(dump.header));
+    } else if (line[0] == 'R') {
+      TraceRecord record;
+
+      if (traceDecodeHex(line.substr(2), &record, sizeof(record)) == false) {
+        return dump;
+      }
+
+      slots.push_back(record);
+    }
+  }
+
+  // Dump is cut, or comes from another trace layout? (cannot decode)
+  if (hasHeader == false || dump.header.magic != TRACE_DUMP_MAGIC || dump.header.recordSize != sizeof(TraceRecord) || slots.size() != dump.header.capacity) {
+    return dump;
+  }
+
+  uint32_t count = dump.header.recordsCount,
+           first = (count > dump.header.capacity) ? (count - dump.header.capacity) : 0;
+
+  for (const TraceRecord &record : slots) {
+    if (record.sequence > first && record.sequence <= count) {
+      dump.records.push_back(record);
+    }
+  }
+
+  std::sort(dump.records.begin(), dump.records.end(), [](const TraceRecord &left, const TraceRecord &right) {
+    return left.sequence < right.sequence;
+  });
+
+  dump.skippedCount = (count - first) - dump.records.size();
+  dump.isValid = true;
+
+  return dump;
+}
+
+inline std::string traceFormat(const TraceDump &dump, const char *const formats[], unsigned int formatsCount) {
+  // Notice: formatted as Trace::print() would on the device (from the \
+  //   first record, up to the record cost)
+  std::string text;
+
+  char line[TRACE_LINE_SIZE_MAXIMUM * 2];
+
+  for (const TraceRecord &record : dump.records) {
+    snprintf(line, sizeof(line), "  [%10.3fms] ", record.micros / 1000.0);
+
+    text += line;
+
+    if (record.event < formatsCount) {
+      snprintf(line, sizeof(line), formats[record.event], record.argument0, record.argument1);
+    } else {
+      snprintf(line, sizeof(line), "Unknown event #%u (%u, %u)", record.event, record.argument0, record.argument1);
+    }
+
+    text += line;
+    text += "\n";
+  }
+
+  const TraceDumpHeader &header = dump.header;
+
+  snprintf(line, sizeof(line), "\n%u events recorded (%u in buffer, %u skipped)\n", header.recordsCount, (unsigned int)dump.records.size(), dump.skippedCount);
+
+  text += line;
+
+  snprintf(line, sizeof(line), "Record cost: %u cycles per event, vs %u cycles to format it as a log line (+%luµs on the UART for %u bytes) (at %uMHz)\n\n", header.recordCycles, header.formatCycles, (unsigned long)header.formatBytes * 10 * 1000000ul / header.uartBauds, header.formatBytes, header.cpuFrequencyMhz);
+
+  text += line;
+
+  return text;
+}